@@ -67,18 +67,25 @@ LOCAL_SRC_FILES := \
     src/survive_default_devices.c \
     src/survive_disambiguator.c \
     src/survive_driverman.c \
+    src/survive_kalman_batch.c \
     src/survive_kalman_lighthouses.c \
     src/survive_kalman_tracker.c \
+    src/survive_latency.c \
     src/survive_optimizer.c \
+    src/survive_optimizer_sparse.c \
+    src/survive_pipeline.c \
     src/survive_recording.c \
+    src/survive_recording_binary.c \
     src/survive_plugins.c \
     src/survive_process.c \
     src/survive_process_gen1.c \
     src/survive_process_gen2.c \
     src/survive_reproject.c \
     src/survive_reproject_gen2.c \
+    src/survive_reproject_batch.c \
     src/survive_sensor_activations.c \
-    src/survive_str.c
+    src/survive_str.c \
+    src/survive_thread_pool.c
 
 ifneq ($(TARGET_SURVIVE_CONFIG_PATH),)
     LOCAL_CFLAGS += -DSURVIVE_CONFIG_PATH=\"$(TARGET_SURVIVE_CONFIG_PATH)\"
@@ -1272,7 +1272,9 @@ external_pose_process_func = CFUNCTYPE(UNCHECKED(None), POINTER(SurviveContext),
 
 external_velocity_process_func = CFUNCTYPE(UNCHECKED(None), POINTER(SurviveContext), String, POINTER(SurviveVelocity))# /home/justin/source/oss/libsurvive/include/libsurvive/survive_types.h: 341
 
-lighthouse_pose_process_func = CFUNCTYPE(UNCHECKED(None), POINTER(SurviveContext), c_uint8, POINTER(SurvivePose))# /home/justin/source/oss/libsurvive/include/libsurvive/survive_types.h: 346
+lighthouse_pose_process_func = CFUNCTYPE(UNCHECKED(None), POINTER(SurviveContext), c_uint8, POINTER(SurvivePose))# /home/justin/source/oss/libsurvive/include/libsurvive/survive_types.h: 366
+
+raw_lighthouse_pose_process_func = CFUNCTYPE(UNCHECKED(None), POINTER(SurviveContext), c_uint8, POINTER(SurvivePose))# /home/justin/source/oss/libsurvive/include/libsurvive/survive_types.h: 367
 
 new_object_process_func = CFUNCTYPE(UNCHECKED(None), POINTER(SurviveObject))# /home/justin/source/oss/libsurvive/include/libsurvive/survive_types.h: 351
 
@@ -1631,6 +1633,7 @@ struct_SurviveSensorActivations_params.__slots__ = [
     'filterLightChange',
     'filterOutlierCriteria',
     'filterVarianceMin',
+    'filterOutlierMinCount',
 ]
 struct_SurviveSensorActivations_params._fields_ = [
     ('moveThresholdGyro', c_double),
@@ -1639,6 +1642,7 @@ struct_SurviveSensorActivations_params._fields_ = [
     ('filterLightChange', c_double),
     ('filterOutlierCriteria', c_double),
     ('filterVarianceMin', c_double),
+    ('filterOutlierMinCount', c_int),
 ]
 
 struct_SurviveSensorActivations_s.__slots__ = [
@@ -1816,6 +1820,25 @@ except:
 class struct_SurviveKalmanTracker(Structure):
     pass
 
+# /home/justin/source/oss/libsurvive/include/libsurvive/survive_types.h: 389
+class struct_SurvivePluginPair(Structure):
+    pass
+
+struct_SurvivePluginPair.__slots__ = [
+    'key',
+    'data',
+]
+struct_SurvivePluginPair._fields_ = [
+    ('key', POINTER(None)),
+    ('data', POINTER(None)),
+]
+
+SurvivePluginPair = struct_SurvivePluginPair# /home/justin/source/oss/libsurvive/include/libsurvive/survive_types.h: 392
+
+# /home/justin/source/oss/libsurvive/include/libsurvive/survive.h: 377
+class struct_survive_hook_latency(Structure):
+    pass
+
 # /home/justin/source/oss/libsurvive/include/libsurvive/survive.h: 213
 class struct_anon_49(Structure):
     pass
@@ -1825,6 +1848,7 @@ struct_anon_49.__slots__ = [
     'skipped_syncs',
     'bad_syncs',
     'hit_from_lhs',
+    'accepted_data',
     'rejected_data',
     'dropped_light',
     'sync_resets',
@@ -1839,6 +1863,7 @@ struct_anon_49._fields_ = [
     ('skipped_syncs', c_uint32 * int(16)),
     ('bad_syncs', c_uint32 * int(16)),
     ('hit_from_lhs', c_uint32 * int(16)),
+    ('accepted_data', c_uint32 * int(16)),
     ('rejected_data', c_uint32 * int(16)),
     ('dropped_light', c_uint32 * int(16)),
     ('sync_resets', c_uint32 * int(16)),
@@ -1872,7 +1897,6 @@ struct_SurviveObject.__slots__ = [
     'velocity',
     'velocity_timecode',
     'FromLHPose',
-    'PoserFnData',
     'sensor_ct',
     'channel_map',
     'has_sensor_locations',
@@ -1904,6 +1928,13 @@ struct_SurviveObject.__slots__ = [
     'acceleration',
     'sensor_scale',
     'sensor_scale_var',
+    'lh_correction',
+    'lh_correction_variance',
+    'PluginDataEntries',
+    'PluginDataEntries_cnt',
+    'PluginDataEntries_space',
+    'object_lock',
+    'hook_latency',
 ]
 struct_SurviveObject._fields_ = [
     ('ctx', POINTER(SurviveContext)),
@@ -1928,7 +1959,6 @@ struct_SurviveObject._fields_ = [
     ('velocity', SurviveVelocity),
     ('velocity_timecode', survive_long_timecode),
     ('FromLHPose', SurvivePose * int(16)),
-    ('PoserFnData', POINTER(None)),
     ('sensor_ct', c_int8),
     ('channel_map', POINTER(c_int)),
     ('has_sensor_locations', c_bool),
@@ -1960,6 +1990,13 @@ struct_SurviveObject._fields_ = [
     ('acceleration', LinmathPoint3d),
     ('sensor_scale', c_double),
     ('sensor_scale_var', c_double),
+    ('lh_correction', (c_double * int(3)) * int(16)),
+    ('lh_correction_variance', (c_double * int(3)) * int(16)),
+    ('PluginDataEntries', POINTER(SurvivePluginPair)),
+    ('PluginDataEntries_cnt', c_size_t),
+    ('PluginDataEntries_space', c_size_t),
+    ('object_lock', POINTER(None)),
+    ('hook_latency', POINTER(struct_survive_hook_latency)),
 ]
 
 # /home/justin/source/oss/libsurvive/include/libsurvive/survive.h: 232
@@ -2060,6 +2097,11 @@ struct_BaseStationData.__slots__ = [
     'disable',
     'OOTXChecked',
     'tracker',
+    'variance',
+    'old_pos_time',
+    'old_pos',
+    'true_pos_time',
+    'true_pos',
 ]
 struct_BaseStationData._fields_ = [
     ('PositionSet', c_uint8, 1),
@@ -2076,6 +2118,11 @@ struct_BaseStationData._fields_ = [
     ('disable', c_bool),
     ('OOTXChecked', c_uint8, 1),
     ('tracker', POINTER(struct_SurviveKalmanLighthouse)),
+    ('variance', LinmathAxisAnglePose),
+    ('old_pos_time', c_double),
+    ('old_pos', SurvivePose),
+    ('true_pos_time', c_double),
+    ('true_pos', SurvivePose),
 ]
 
 # /home/justin/source/oss/libsurvive/include/libsurvive/survive.h: 280
@@ -2156,6 +2203,21 @@ SVCal_Gib = 8# /home/justin/source/oss/libsurvive/include/libsurvive/survive.h:
 
 SVCal_All = (((SVCal_Gib | SVCal_Curve) | SVCal_Tilt) | SVCal_Phase)# /home/justin/source/oss/libsurvive/include/libsurvive/survive.h: 312
 
+# /home/justin/source/oss/libsurvive/include/libsurvive/survive.h: 455
+class struct_anon_62(Structure):
+    pass
+
+struct_anon_62.__slots__ = [
+    'lh_max_update',
+    'lh_max_nudge_distance',
+    'lh_update_velocity',
+]
+struct_anon_62._fields_ = [
+    ('lh_max_update', c_double),
+    ('lh_max_nudge_distance', c_double),
+    ('lh_update_velocity', c_double),
+]
+
 struct_SurviveContext.__slots__ = [
     'lh_version_configed',
     'lh_version_forced',
@@ -2183,6 +2245,7 @@ struct_SurviveContext.__slots__ = [
     'velocityproc',
     'external_poseproc',
     'external_velocityproc',
+    'raw_lighthouse_poseproc',
     'lighthouse_poseproc',
     'datalogproc',
     'new_object_call_time',
@@ -2277,6 +2340,10 @@ struct_SurviveContext.__slots__ = [
     'external_velocity_call_cnt',
     'external_velocity_call_over_cnt',
     'external_velocity_max_call_time',
+    'raw_lighthouse_pose_call_time',
+    'raw_lighthouse_pose_call_cnt',
+    'raw_lighthouse_pose_call_over_cnt',
+    'raw_lighthouse_pose_max_call_time',
     'lighthouse_pose_call_time',
     'lighthouse_pose_call_cnt',
     'lighthouse_pose_call_over_cnt',
@@ -2310,6 +2377,9 @@ struct_SurviveContext.__slots__ = [
     'temporary_config_values',
     'private_members',
     'request_floor_set',
+    'floor_offset',
+    'settings',
+    'hook_latency',
 ]
 struct_SurviveContext._fields_ = [
     ('lh_version_configed', c_int),
@@ -2338,6 +2408,7 @@ struct_SurviveContext._fields_ = [
     ('velocityproc', velocity_process_func),
     ('external_poseproc', external_pose_process_func),
     ('external_velocityproc', external_velocity_process_func),
+    ('raw_lighthouse_poseproc', raw_lighthouse_pose_process_func),
     ('lighthouse_poseproc', lighthouse_pose_process_func),
     ('datalogproc', datalog_process_func),
     ('new_object_call_time', c_double),
@@ -2432,6 +2503,10 @@ struct_SurviveContext._fields_ = [
     ('external_velocity_call_cnt', c_uint32),
     ('external_velocity_call_over_cnt', c_uint32),
     ('external_velocity_max_call_time', c_double),
+    ('raw_lighthouse_pose_call_time', c_double),
+    ('raw_lighthouse_pose_call_cnt', c_uint32),
+    ('raw_lighthouse_pose_call_over_cnt', c_uint32),
+    ('raw_lighthouse_pose_max_call_time', c_double),
     ('lighthouse_pose_call_time', c_double),
     ('lighthouse_pose_call_cnt', c_uint32),
     ('lighthouse_pose_call_over_cnt', c_uint32),
@@ -2465,6 +2540,9 @@ struct_SurviveContext._fields_ = [
     ('temporary_config_values', POINTER(struct_config_group)),
     ('private_members', POINTER(None)),
     ('request_floor_set', c_bool),
+    ('floor_offset', c_double),
+    ('settings', struct_anon_62),
+    ('hook_latency', POINTER(struct_survive_hook_latency)),
 ]
 
 # /home/justin/source/oss/libsurvive/include/libsurvive/survive.h: 375
@@ -30,6 +30,7 @@ typedef struct
 {
 	PoserType pt;
 	survive_long_timecode timecode; // In object-local ticks.
+	survive_us received_us;			// Host time the data arrived; see survive_received_time. 0 if unknown.
 	poser_pose_func poseproc;
 	poser_lighthouse_pose_func lighthouseposeproc;
 	void *userdata;
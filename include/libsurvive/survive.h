@@ -14,6 +14,7 @@ extern "C" {
 #endif
 
 #ifdef _MSC_VER
+	#include <intrin.h>
 	#define SURVIVE_EXPORT_CONSTRUCTOR SURVIVE_EXPORT
 #else
 	#define SURVIVE_EXPORT_CONSTRUCTOR __attribute__((constructor))
@@ -239,6 +240,15 @@ struct SurviveObject {
 	// Plugins / posers / etc can add to this entry list via `survive_object_plugin_data`
 	SurvivePluginPair *PluginDataEntries;
 	size_t PluginDataEntries_cnt, PluginDataEntries_space;
+
+	// New fields go at the end so the layout the language bindings see doesn't shift
+
+	// Guards the per object state above (activations, tracker, poser data) when 'object-locks' is enabled. Use
+	// survive_get_so_lock / survive_release_so_lock rather than touching this directly.
+	void *object_lock;
+
+	// Latency histograms of the hooks invoked for this object; owned by the context. Null if 'hook-latency' is off.
+	struct survive_hook_latency *hook_latency;
 };
 
 // These exports are mostly for language binding against
@@ -359,6 +369,15 @@ enum SurviveCalFlag {
 	SVCal_All = SVCal_Gib | SVCal_Curve | SVCal_Tilt | SVCal_Phase
 };
 
+// Index of each hook in survive_hooks.h, for use with survive_hook_latency and friends
+enum SurviveHookId {
+#define SURVIVE_HOOK_PROCESS_DEF(hook) SURVIVE_HOOK_ID_##hook,
+#include "survive_hooks.h"
+	SURVIVE_HOOK_COUNT
+};
+
+struct survive_hook_latency;
+
 struct SurviveContext_private;
 struct SurviveContext {
 	int lh_version_configed;
@@ -418,6 +437,11 @@ struct SurviveContext {
 		FLT lh_max_update, lh_max_nudge_distance;
 		FLT lh_update_velocity;
 	} settings;
+
+	// New fields go at the end so the layout the language bindings see doesn't shift
+
+	// Latency histograms of every hook over all objects. Null if 'hook-latency' is off.
+	struct survive_hook_latency *hook_latency;
 };
 
 SURVIVE_EXPORT void survive_verify_FLT_size(
@@ -466,10 +490,50 @@ SURVIVE_EXPORT void survive_close(SurviveContext *ctx);
 SURVIVE_EXPORT void survive_get_ctx_lock(SurviveContext *ctx);
 SURVIVE_EXPORT void survive_release_ctx_lock(SurviveContext *ctx);
 
+// Per object lock; guards everything hanging off of the given object. If 'object-locks' is disabled this is the same
+// as the ctx lock. Lock order is ctx lock -> object lock -> bsd lock.
+SURVIVE_EXPORT void survive_get_so_lock(SurviveObject *so);
+SURVIVE_EXPORT void survive_release_so_lock(SurviveObject *so);
+
+// Guards ctx->bsd, ctx->activeLighthouses, ctx->floor_offset, the ctx->objs list and survive_context_plugin_data.
+// Recursive, and safe to take while holding an object lock.
+SURVIVE_EXPORT void survive_get_bsd_lock(SurviveContext *ctx);
+SURVIVE_EXPORT void survive_release_bsd_lock(SurviveContext *ctx);
+
 SURVIVE_EXPORT const char *survive_build_tag();
 
 SURVIVE_EXPORT SurviveObject *survive_get_so_by_name(SurviveContext *ctx, const char *name);
 
+// Latency of a hook's invocations, in seconds. Percentiles are accurate to within ~3%.
+typedef struct SurviveHookLatency {
+	uint64_t count;
+	FLT mean, max;
+	FLT p50, p90, p99, p999;
+} SurviveHookLatency;
+
+SURVIVE_EXPORT const char *survive_hook_name(enum SurviveHookId hook);
+// @return the hook's id, or -1 if there is no hook by that name
+SURVIVE_EXPORT int survive_hook_id(const char *name);
+
+/**
+ * Latency statistics for a hook; over all objects if 'so' is null. Returns false if 'hook-latency' is disabled or the
+ * object has no histograms. Counts are approximate while hooks are running on other threads.
+ */
+SURVIVE_EXPORT bool survive_hook_latency(const SurviveContext *ctx, const SurviveObject *so, enum SurviveHookId hook,
+										 SurviveHookLatency *latency);
+// @param percentile in [0, 100]
+SURVIVE_EXPORT FLT survive_hook_latency_percentile(const SurviveContext *ctx, const SurviveObject *so,
+												   enum SurviveHookId hook, FLT percentile);
+/**
+ * Time from data arriving from the device to the pose computed from it being published, for an object or, if 'so' is
+ * null, every object. Only covers drivers which report arrival times.
+ */
+SURVIVE_EXPORT bool survive_motion_to_pose_latency(const SurviveContext *ctx, const SurviveObject *so,
+												   SurviveHookLatency *latency);
+SURVIVE_EXPORT void survive_hook_latency_reset(SurviveContext *ctx);
+// Writes the statistics of every hook that was invoked, for the context and each object, as a json object
+SURVIVE_EXPORT void survive_hook_latency_write_json(const SurviveContext *ctx, FILE *f);
+
 // Utilitiy functions.
 SURVIVE_EXPORT int survive_simple_inflate(SurviveContext *ctx, const uint8_t *input, int inlen, uint8_t *output, int outlen);
 
@@ -525,33 +589,76 @@ SURVIVE_EXPORT void survive_detach_config(SurviveContext *ctx, const char *tag,
 
 SURVIVE_EXPORT int8_t survive_get_bsd_idx(SurviveContext *ctx, survive_channel channel);
 
+/**
+ * Cheap monotonic timestamp for timing hooks. The unit is CPU specific -- the TSC on x86, the virtual counter on
+ * aarch64, microseconds elsewhere; survive_timestamp_ticks_period converts it to seconds.
+ */
+static inline uint64_t survive_timestamp_ticks(void) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	return __rdtsc();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	return __builtin_ia32_rdtsc();
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+	uint64_t ticks;
+	__asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+	return ticks;
+#else
+	return OGGetAbsoluteTimeUS();
+#endif
+}
+
+/**
+ * Seconds per survive_timestamp_ticks tick. Calibrated against the wall clock on first use.
+ */
+SURVIVE_EXPORT double survive_timestamp_ticks_period(void);
+
+/**
+ * Adds one hook invocation which took 'ticks' to the context's and, if given, the object's latency histograms.
+ *
+ * @return The invocation time in seconds
+ */
+SURVIVE_EXPORT FLT survive_hook_latency_record(SurviveContext *ctx, SurviveObject *so, enum SurviveHookId hook,
+											   uint64_t ticks);
+
+/**
+ * Adds one invocation taking this_time seconds to a hook's hook##_call_time, and raises hook##_max_call_time to it.
+ * Any thread may invoke a hook, so both are compare and swap updates like the counters next to them.
+ */
+SURVIVE_EXPORT void survive_hook_call_time_add(FLT *call_time, FLT *max_call_time, FLT this_time);
+
+/**
+ * Host time, in OGGetAbsoluteTimeUS microseconds, that the data the calling thread is processing arrived at. Drivers
+ * set this before invoking the data hooks; it is carried through PoserData to the pose output to measure motion to
+ * pose latency. 0 means unknown.
+ */
+SURVIVE_EXPORT void survive_set_received_time(survive_us received_us);
+SURVIVE_EXPORT survive_us survive_received_time(void);
+
 #define SURVIVE_INVOKE_HOOK(hook, ctx, ...)                                                                            \
 	{                                                                                                                  \
-		if (ctx && ctx->hook##proc) {                                                                                         \
-			FLT start_time = OGRelativeTime();                                                                         \
+		if (ctx && ctx->hook##proc) {                                                                                  \
+			uint64_t start_ticks = survive_timestamp_ticks();                                                          \
 			ctx->hook##proc(ctx, __VA_ARGS__);                                                                         \
-			FLT this_time = OGRelativeTime() - start_time;                                                             \
-			if (this_time > ctx->hook##_max_call_time)                                                                 \
-				ctx->hook##_max_call_time = this_time;                                                                 \
+			FLT this_time = survive_hook_latency_record(ctx, 0, SURVIVE_HOOK_ID_##hook,                                \
+														survive_timestamp_ticks() - start_ticks);                      \
+			survive_hook_call_time_add(&ctx->hook##_call_time, &ctx->hook##_max_call_time, this_time);                 \
 			if (this_time > .001)                                                                                      \
-				ctx->hook##_call_over_cnt++;                                                                           \
-			ctx->hook##_call_time += this_time;                                                                        \
-			ctx->hook##_call_cnt++;                                                                                    \
+				OGAtomicAddU32(&ctx->hook##_call_over_cnt, 1);                                                         \
+			OGAtomicAddU32(&ctx->hook##_call_cnt, 1);                                                                  \
 		}                                                                                                              \
 	}
 
 #define SURVIVE_INVOKE_HOOK_SO(hook, so, ...)                                                                          \
 	{                                                                                                                  \
 		if (so->ctx->hook##proc) {                                                                                     \
-			FLT start_time = OGRelativeTime();                                                                         \
+			uint64_t start_ticks = survive_timestamp_ticks();                                                          \
 			so->ctx->hook##proc(so, ##__VA_ARGS__);                                                                    \
-			FLT this_time = OGRelativeTime() - start_time;                                                             \
-			if (this_time > so->ctx->hook##_max_call_time)                                                             \
-				so->ctx->hook##_max_call_time = this_time;                                                             \
+			FLT this_time = survive_hook_latency_record(so->ctx, so, SURVIVE_HOOK_ID_##hook,                           \
+														survive_timestamp_ticks() - start_ticks);                      \
+			survive_hook_call_time_add(&so->ctx->hook##_call_time, &so->ctx->hook##_max_call_time, this_time);         \
 			if (this_time > .001)                                                                                      \
-				so->ctx->hook##_call_over_cnt++;                                                                       \
-			so->ctx->hook##_call_time += this_time;                                                                    \
-			so->ctx->hook##_call_cnt++;                                                                                \
+				OGAtomicAddU32(&so->ctx->hook##_call_over_cnt, 1);                                                     \
+			OGAtomicAddU32(&so->ctx->hook##_call_cnt, 1);                                                              \
 		}                                                                                                              \
 	}
 
@@ -698,6 +805,8 @@ SURVIVE_EXPORT void survive_reset_lighthouse_positions(SurviveContext *ctx);
 SURVIVE_EXPORT void survive_reset_lighthouse_position(SurviveContext *ctx, int bsd_idx);
 SURVIVE_EXPORT const SurvivePose *survive_get_lighthouse_true_position(const SurviveContext *ctx, int bsd_idx);
 SURVIVE_EXPORT const SurvivePose *survive_get_lighthouse_position(const SurviveContext *ctx, int bsd_idx);
+// Copies the lighthouse pose out under the bsd lock; for callers that only hold an object lock
+SURVIVE_EXPORT SurvivePose survive_copy_lighthouse_position(SurviveContext *ctx, int bsd_idx);
 
 // This is the disambiguator function, for taking light timing and figuring out place-in-sweep for a given photodiode.
 SURVIVE_EXPORT uint8_t survive_map_sensor_id(SurviveObject *so, uint8_t reported_id);
@@ -62,6 +62,15 @@ typedef struct SurviveSimplePoseUpdatedEvent {
 	SurviveVelocity velocity;
 } SurviveSimplePoseUpdatedEvent;
 
+typedef struct SurviveSimplePoseSnapshot {
+	const SurviveSimpleObject *object;
+	FLT time;		   // Same value survive_simple_object_get_latest_pose returns
+	FLT velocity_time; // Same value survive_simple_object_get_latest_velocity returns
+	SurvivePose pose;
+	SurviveVelocity velocity;
+	FLT position_covariance[9]; // Row major 3x3; zeros if the object has no tracker
+} SurviveSimplePoseSnapshot;
+
 typedef struct SurviveSimpleObjectEvent {
 	FLT time;
 	const SurviveSimpleObject *object;
@@ -128,6 +137,33 @@ SURVIVE_EXPORT void survive_simple_object_get_transform_to_imu(const SurviveSimp
  */
 SURVIVE_EXPORT FLT survive_simple_object_get_latest_velocity(const SurviveSimpleObject *sao, SurviveVelocity *pose);
 
+/**
+ * Gets a consistent copy of an objects latest pose, velocity and covariance. For tracked and external objects this never
+ * takes a lock, so it is safe to call at render rate.
+ * @return false if the object hasn't reported a pose yet
+ */
+SURVIVE_EXPORT bool survive_simple_object_get_pose_snapshot(const SurviveSimpleObject *sao,
+															SurviveSimplePoseSnapshot *snapshot);
+
+/**
+ * Predicts an objects pose, velocity and position covariance at the given time -- ie the next display vsync -- from
+ * the latest filter state, which is updated on every IMU and light sample rather than every reported pose. Time is on
+ * the clock of SurviveSimplePoseSnapshot::time. Doesn't take a lock. Objects without a filter get their latest
+ * snapshot as is.
+ * @return false if the object has neither a filter state nor a reported pose yet
+ */
+SURVIVE_EXPORT bool survive_simple_object_predict_pose(const SurviveSimpleObject *sao, FLT time,
+													   SurviveSimplePoseSnapshot *snapshot);
+
+/**
+ * Fills the given array with the latest snapshot of every object which has a pose. Tracked and external objects are
+ * read without locking and reflect one point in time, unless they are being updated too fast to get a quiet read, in
+ * which case each entry is still consistent by itself. Lighthouses come last.
+ * @return Number of entries written
+ */
+SURVIVE_EXPORT size_t survive_simple_get_pose_snapshots(SurviveSimpleContext *actx,
+														SurviveSimplePoseSnapshot *snapshots, size_t max_cnt);
+
 /**
  * @return Whether or not the object is charging
  */
@@ -171,6 +207,43 @@ SURVIVE_EXPORT enum SurviveSimpleEventType survive_simple_next_event(SurviveSimp
 SURVIVE_EXPORT enum SurviveSimpleEventType survive_simple_wait_for_event(SurviveSimpleContext *actx,
 																		 SurviveSimpleEvent *event);
 
+/**
+ * Number of button, config and device events survive_simple_next_event missed because the consumer fell more than a
+ * full buffer ('simple-event-buffer-size') behind.
+ */
+SURVIVE_EXPORT size_t survive_simple_get_dropped_events(SurviveSimpleContext *actx);
+
+/**
+ * Independent event stream. Every consumer sees every event, including each individual pose update rather than the
+ * coalesced ones survive_simple_next_event returns, so several threads can consume without stealing from each other.
+ * Producers never block on consumers; a consumer which falls behind by more than the buffer size loses the oldest
+ * events. Each consumer must only be used from one thread at a time.
+ */
+typedef struct SurviveSimpleEventConsumer SurviveSimpleEventConsumer;
+
+/**
+ * Creates a consumer which sees events published from this point on.
+ */
+SURVIVE_EXPORT SurviveSimpleEventConsumer *survive_simple_event_consumer_create(SurviveSimpleContext *actx);
+SURVIVE_EXPORT void survive_simple_event_consumer_destroy(SurviveSimpleEventConsumer *consumer);
+
+/**
+ * Gets the next event for this consumer; button, config and device events are returned before pose events. Can return
+ * an event with NONE type.
+ */
+SURVIVE_EXPORT enum SurviveSimpleEventType survive_simple_event_consumer_next(SurviveSimpleEventConsumer *consumer,
+																			  SurviveSimpleEvent *event);
+/**
+ * Blocks until the consumer has an event or a timeout passes. How promptly pose events arrive depends on the
+ * 'simple-event-wake-count' and 'simple-event-wake-us' options.
+ */
+SURVIVE_EXPORT enum SurviveSimpleEventType survive_simple_event_consumer_wait(SurviveSimpleEventConsumer *consumer,
+																			  SurviveSimpleEvent *event);
+/**
+ * @return How many events this consumer missed by falling behind
+ */
+SURVIVE_EXPORT size_t survive_simple_event_consumer_dropped(const SurviveSimpleEventConsumer *consumer);
+
 SURVIVE_EXPORT int survive_simple_object_haptic(struct SurviveSimpleObject *sao, FLT frequency, FLT amplitude,
 												FLT time_s);
 SURVIVE_EXPORT enum SurviveSimpleObject_type survive_simple_object_get_type(const struct SurviveSimpleObject *sao);
@@ -99,6 +99,13 @@ typedef struct {
   FLT *p;
 } survive_optimizer_parameter;
 
+// Loss applied to each normalized light residual, so outliers are down weighted inside the solve
+enum survive_optimizer_robust_loss {
+	survive_optimizer_robust_loss_none,
+	survive_optimizer_robust_loss_huber,
+	survive_optimizer_robust_loss_cauchy,
+};
+
 typedef struct survive_optimizer_settings {
 	bool use_quat_model;
 	bool disable_filter;
@@ -108,11 +115,46 @@ typedef struct survive_optimizer_settings {
 	FLT optimize_scale_threshold;
 	FLT current_pos_bias;
 	FLT current_rot_bias;
+	bool sparse_solver;
+	// One of survive_optimizer_robust_loss; when set, the up front lighthouse filter is skipped
+	int robust_loss;
+	// Light error, in sigmas, where the robust loss stops being quadratic; <= 0 turns the loss off
+	FLT robust_scale;
 } survive_optimizer_settings;
 
 struct mp_par_struct;
 struct mp_result_struct;
 
+/**
+ * Reusable scratch memory for optimizer runs. The problem buffers, mpfit's work arrays and the cost function's
+ * temporaries are all carved out of one block; anything that doesn't fit comes from the heap, and the next reset grows
+ * the block to the most that was ever needed at once. After the first few runs of a given problem size nothing touches
+ * the heap, and nothing big goes on the stack.
+ */
+typedef struct survive_optimizer_workspace {
+	char *buffer;
+	size_t size, used, high_water;
+	struct survive_optimizer_workspace_overflow *overflow;
+} survive_optimizer_workspace;
+
+#define SURVIVE_OPTIMIZER_WARM_START_MAX_FREE 32
+
+/**
+ * Solver state carried from one solve to the next, for problems that barely change between runs; ie tracking the
+ * same object sync after sync. Starting from where the last solve's damping and scaling ended up lets a solve that
+ * starts near the answer finish in an iteration or two. Only the sparse backend uses this. Zero initialize it.
+ */
+typedef struct survive_optimizer_warm_start {
+	// Damping the last solve finished with; 0 if there hasn't been one
+	FLT lambda;
+	// Free parameter count of the last solve. The state is only reused when the next problem has the same count.
+	int nfree;
+	// Running max of the diagonal of J^T J -- the column scaling of the damping -- by free parameter
+	FLT diag[SURVIVE_OPTIMIZER_WARM_START_MAX_FREE];
+	// How many solves in a row have started from this state
+	uint32_t warm_solves;
+} survive_optimizer_warm_start;
+
 typedef struct survive_optimizer {
     const survive_optimizer_settings* settings;
 
@@ -155,6 +197,15 @@ typedef struct survive_optimizer {
 
 	void *user;
 	void (*iteration_cb)(struct survive_optimizer *opt_ctx, int m, int n, FLT *p, FLT *deviates, FLT **derivs);
+
+	// Threads to evaluate large problems on. If null, the 'optimizer-threads' pool of the objects' context is used.
+	struct survive_thread_pool *thread_pool;
+
+	// If set, the solve runs on the sparse backend and starts from, and updates, this state
+	survive_optimizer_warm_start *warm_start;
+
+	// If set, runs take their scratch memory from here instead of the stack and heap
+	survive_optimizer_workspace *workspace;
 } survive_optimizer;
 
 #define SURVIVE_OPTIMIZER_SETUP_BUFFERS(ctx, alloc_fn, ...)                                                            \
@@ -182,16 +233,35 @@ typedef struct survive_optimizer {
 	SURVIVE_OPTIMIZER_SETUP_BUFFERS((ctx), SURVIVE_OPTIMIZER_ALLOCA, __VA_ARGS__)
 #define SURVIVE_OPTIMIZER_SETUP_HEAP_BUFFERS(ctx, ...)                                                                 \
 	SURVIVE_OPTIMIZER_SETUP_BUFFERS((ctx), survive_optimizer_realloc, __VA_ARGS__)
+#define SURVIVE_OPTIMIZER_WORKSPACE_ALLOC(ctx, size)                                                                  \
+	survive_optimizer_workspace_alloc(survive_optimizer_setup_workspace_, size)
+// The buffers live until the next survive_optimizer_workspace_reset; runs use the same workspace for their scratch
+#define SURVIVE_OPTIMIZER_SETUP_WORKSPACE_BUFFERS(ctx, ws, ...)                                                        \
+	{                                                                                                                  \
+		survive_optimizer_workspace *survive_optimizer_setup_workspace_ = (ws);                                        \
+		(ctx).workspace = survive_optimizer_setup_workspace_;                                                          \
+		SURVIVE_OPTIMIZER_SETUP_BUFFERS((ctx), SURVIVE_OPTIMIZER_WORKSPACE_ALLOC, __VA_ARGS__)                         \
+	}
 #define SURVIVE_OPTIMIZER_CLEANUP_STACK_BUFFERS(ctx)
 #define SURVIVE_OPTIMIZER_CLEANUP_HEAP_BUFFERS(ctx)                                                                    \
 	{                                                                                                                  \
-		free(ctx.parameters);                                                                                          \
-		free(ctx.mp_parameters_info);                                                                                  \
-		free(ctx.measurements);                                                                                        \
+		free((ctx).parameters);                                                                                        \
+		free((ctx).mp_parameters_info);                                                                                \
+		free((ctx).parameters_info);                                                                                   \
+		free((ctx).measurements);                                                                                      \
+		free((ctx).sos);                                                                                               \
 	}
 
 SURVIVE_EXPORT void *survive_optimizer_realloc(void *old_ptr, size_t size);
 
+// Uninitialized memory, 16 byte aligned, valid until the workspace is reset or released past it
+SURVIVE_EXPORT void *survive_optimizer_workspace_alloc(survive_optimizer_workspace *ws, size_t size);
+// Frees everything allocated since ws->used was 'mark'
+SURVIVE_EXPORT void survive_optimizer_workspace_release(survive_optimizer_workspace *ws, size_t mark);
+// Frees everything, and grows the block to fit the most that was in use at once
+SURVIVE_EXPORT void survive_optimizer_workspace_reset(survive_optimizer_workspace *ws);
+SURVIVE_EXPORT void survive_optimizer_workspace_free(survive_optimizer_workspace *ws);
+
 SURVIVE_EXPORT int survive_optimizer_get_max_measurements_count(const survive_optimizer *ctx);
 SURVIVE_EXPORT int survive_optimizer_get_max_parameters_count(const survive_optimizer *ctx);
 SURVIVE_EXPORT int survive_optimizer_get_parameters_count(const survive_optimizer *ctx);
@@ -246,15 +316,36 @@ SURVIVE_EXPORT const char *survive_optimizer_error(int status);
 
 SURVIVE_EXPORT int survive_optimizer_run(survive_optimizer *optimizer, struct mp_result_struct *result,
 										 struct CnMat *R);
+
+/**
+ * Drop in replacement for mpfit which exploits block sparsity. param_block gives, for each parameter, the block it
+ * belongs to, or -1 for parameters shared by all residuals. No residual may depend on two different blocks -- if one
+ * does, the solve falls back to treating every parameter as shared.
+ *
+ * warm_start is optional; see survive_optimizer_warm_start. Work arrays come from config->alloc when it is set, and
+ * from the heap otherwise.
+ */
+SURVIVE_EXPORT int survive_optimizer_sparse_lm(mp_func funct, int m, int npar, FLT *xall, mp_par *pars,
+											   mp_config *config, void *private_data, const int *param_block,
+											   survive_optimizer_warm_start *warm_start, mp_result *result);
 SURVIVE_EXPORT void survive_optimizer_covariance_expand(survive_optimizer *optimizer, const struct CnMat *R_free,
 														struct CnMat *R);
 
 SURVIVE_EXPORT void survive_optimizer_set_reproject_model(survive_optimizer *optimizer,
 														  const survive_reproject_model_t *reprojectModel);
 
+/**
+ * Writes the problem as text: settings, parameter blocks, parameters, measurements, and the object geometry and
+ * lighthouse calibration it was using, so it can be loaded and solved again without the context it came from.
+ */
 SURVIVE_EXPORT void survive_optimizer_serialize(const survive_optimizer *optimizer, const char *fn);
 
+/**
+ * Reads a problem written by survive_optimizer_serialize. Returns null if the file is missing or malformed. The problem
+ * owns its settings and objects; free it with survive_optimizer_free_loaded.
+ */
 SURVIVE_EXPORT survive_optimizer *survive_optimizer_load(const char *fn);
+SURVIVE_EXPORT void survive_optimizer_free_loaded(survive_optimizer *optimizer);
 
 SURVIVE_EXPORT FLT survive_optimizer_current_norm(const survive_optimizer *optimizer);
 
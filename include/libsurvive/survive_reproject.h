@@ -22,6 +22,16 @@ extern "C" {
 typedef FLT SurviveAngleReading[2];
 
 typedef FLT (*survive_reproject_axis_fn_t)(const BaseStationCal *, const FLT *pt);
+// Reprojects n points along one axis. The points are in the lighthouse's frame, split into x, y and z arrays; bcal is
+// the lighthouse's pair of calibrations, same as for survive_reproject_axis_fn_t.
+typedef void (*survive_reproject_axis_batch_fn_t)(const BaseStationCal *bcal, const FLT *x, const FLT *y, const FLT *z,
+												  FLT *out, size_t n);
+// float32 version of survive_reproject_axis_batch_fn_t; agrees with it to well under the measurement noise
+typedef void (*survive_reproject_axis_batch_f32_fn_t)(const BaseStationCal *bcal, const float *x, const float *y,
+													  const float *z, float *out, size_t n);
+// survive_reproject_axis_batch_fn_t that also fills jac, n x 3 row major, with d out / d (x, y, z) of each point
+typedef void (*survive_reproject_axis_jacob_batch_fn_t)(const BaseStationCal *bcal, const FLT *x, const FLT *y,
+														const FLT *z, FLT *out, FLT *jac, size_t n);
 typedef void (*survive_reproject_xy_fn_t)(const BaseStationCal *bcal, LinmathVec3d const ptInLh, FLT *out);
 
 typedef FLT (*survive_reproject_full_xy_fn_t)(const SurvivePose *obj2world, const LinmathVec3d ptInObj,
@@ -80,6 +90,18 @@ typedef struct survive_reproject_model_t {
 
 	survive_reproject_axis_jacob_sensor_pt_fn_t reprojectAxisJacobSensorPt[2];
 	survive_reproject_axisangle_axis_jacob_sensor_pt_fn_t reprojectAxisAngleAxisJacobSensorPt[2];
+
+	// Optional; see survive_reproject_axis_batch_fn_t
+	survive_reproject_axis_batch_fn_t reprojectAxisBatchFn[2];
+	// Optional; see survive_reproject_axis_batch_f32_fn_t
+	survive_reproject_axis_batch_f32_fn_t reprojectAxisBatchF32Fn[2];
+
+	// d axis / d BaseStationCal of that axis, in field order
+	survive_reproject_axis_jacob_fn_t reprojectAxisJacobCalFn[2];
+	survive_reproject_axisangle_axis_jacob_fn_t reprojectAxisAngleAxisJacobCalFn[2];
+
+	// Optional; see survive_reproject_axis_jacob_batch_fn_t
+	survive_reproject_axis_jacob_batch_fn_t reprojectAxisJacobBatchFn[2];
 } survive_reproject_model_t;
 
 SURVIVE_EXPORT const survive_reproject_model_t* survive_reproject_model(SurviveContext* ctx);
@@ -88,6 +110,19 @@ SURVIVE_IMPORT extern const survive_reproject_model_t survive_reproject_gen1_mod
 SURVIVE_EXPORT FLT survive_reproject_axis_x(const BaseStationCal *bcal, LinmathVec3d const ptInLh);
 SURVIVE_EXPORT FLT survive_reproject_axis_y(const BaseStationCal *bcal, LinmathVec3d const ptInLh);
 
+SURVIVE_EXPORT void survive_reproject_axis_x_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y,
+												   const FLT *z, FLT *out, size_t n);
+SURVIVE_EXPORT void survive_reproject_axis_y_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y,
+												   const FLT *z, FLT *out, size_t n);
+SURVIVE_EXPORT void survive_reproject_axis_x_jac_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y,
+													   const FLT *z, FLT *out, FLT *jac, size_t n);
+SURVIVE_EXPORT void survive_reproject_axis_y_jac_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y,
+													   const FLT *z, FLT *out, FLT *jac, size_t n);
+SURVIVE_EXPORT void survive_reproject_axis_x_batch_f32(const BaseStationCal *bcal, const float *x, const float *y,
+													   const float *z, float *out, size_t n);
+SURVIVE_EXPORT void survive_reproject_axis_y_batch_f32(const BaseStationCal *bcal, const float *x, const float *y,
+													   const float *z, float *out, size_t n);
+
 SURVIVE_EXPORT void survive_reproject_xy(const BaseStationCal *bcal, LinmathVec3d const ptInLh, SurviveAngleReading out);
 SURVIVE_EXPORT void survive_reproject_from_pose(const SurviveContext *ctx, int lighthouse, const SurvivePose *world2lh,
 								 LinmathVec3d const ptInWorld, SurviveAngleReading out);
@@ -22,6 +22,18 @@ extern "C" {
 
 SURVIVE_EXPORT FLT survive_reproject_axis_x_gen2(const BaseStationCal *bcal, LinmathVec3d const ptInLh);
 SURVIVE_EXPORT FLT survive_reproject_axis_y_gen2(const BaseStationCal *bcal, LinmathVec3d const ptInLh);
+SURVIVE_EXPORT void survive_reproject_axis_x_gen2_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y,
+														const FLT *z, FLT *out, size_t n);
+SURVIVE_EXPORT void survive_reproject_axis_y_gen2_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y,
+														const FLT *z, FLT *out, size_t n);
+SURVIVE_EXPORT void survive_reproject_axis_x_gen2_jac_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y,
+															const FLT *z, FLT *out, FLT *jac, size_t n);
+SURVIVE_EXPORT void survive_reproject_axis_y_gen2_jac_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y,
+															const FLT *z, FLT *out, FLT *jac, size_t n);
+SURVIVE_EXPORT void survive_reproject_axis_x_gen2_batch_f32(const BaseStationCal *bcal, const float *x,
+															const float *y, const float *z, float *out, size_t n);
+SURVIVE_EXPORT void survive_reproject_axis_y_gen2_batch_f32(const BaseStationCal *bcal, const float *x,
+															const float *y, const float *z, float *out, size_t n);
 
 SURVIVE_EXPORT void survive_reproject_xy_gen2(const BaseStationCal *bcal, LinmathVec3d const ptInLh,
 											  SurviveAngleReading out);
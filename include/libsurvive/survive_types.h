@@ -392,6 +392,10 @@ typedef struct SurvivePluginPair {
 } SurvivePluginPair;
 
 SURVIVE_EXPORT SurvivePluginData *survive_object_plugin_data(SurviveObject *so, SurvivePluginKey k);
+// Per context counterpart of survive_object_plugin_data, for state a plugin shares between every object of one context.
+// Call it holding the bsd lock, which can be taken from any object's thread; the returned slot only stays put until
+// the next call.
+SURVIVE_EXPORT SurvivePluginData *survive_context_plugin_data(struct SurviveContext *ctx, SurvivePluginKey k);
 
 typedef int (*DeviceDriverCb)(struct SurviveContext *ctx, void *driver);
 typedef int (*DeviceDriverMagicCb)( struct SurviveContext * ctx, void * driver, int magic_code, void * data, int datalen );
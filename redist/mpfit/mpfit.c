@@ -30,7 +30,8 @@
 /* Forward declarations of functions in this module */
 static int mp_fdjac2(mp_func funct, int m, int n, int *ifree, int npar, FLT *x, FLT *fvec, FLT *fjac, int ldfjac,
 					 FLT epsfcn, FLT *wa, void *priv, int *nfev, FLT *step, FLT *dstep, int *dside, int *qulimited,
-					 FLT *ulimit, int *ddebug, FLT *ddrtol, FLT *ddatol, FLT *wa2, FLT **dvecptr, mp_par *pars);
+					 FLT *ulimit, int *ddebug, FLT *ddrtol, FLT *ddatol, FLT *wa2, FLT **dvecptr, mp_par *pars,
+					 int *nderivfail);
 static void mp_qrfac(int m, int n, FLT *a, int lda, int pivot, int *ipvt, int lipvt, FLT *rdiag, FLT *acnorm, FLT *wa);
 static void mp_qrsolv(int n, FLT *r, int ldr, int *ipvt, FLT *diag, FLT *qtb, FLT *x, FLT *sdiag, FLT *wa);
 static void mp_lmpar(int n, FLT *r, int ldr, int *ipvt, int *ifree, FLT *diag, FLT *qtb, FLT delta, FLT *par, FLT *x,
@@ -51,7 +52,7 @@ static int mp_covar(int n, FLT *r, int ldr, int *ipvt, FLT tol, FLT *wa);
 /* Macro to safely allocate memory */
 #define mp_malloc(dest, type, size)                                                                                    \
 	(void)(verify_alloc_free_##dest);                                                                                  \
-	dest = (type *)alloca(sizeof(type) * (size));                                                                      \
+	dest = (type *)(conf.alloc ? conf.alloc(conf.alloc_user, sizeof(type) * (size)) : alloca(sizeof(type) * (size)));  \
 	if (dest == 0) {                                                                                                   \
 		info = MP_ERR_MEMORY;                                                                                          \
 		goto CLEANUP;                                                                                                  \
@@ -292,6 +293,7 @@ int mpfit(mp_func funct, int m, int npar, FLT *xall, mp_par *pars, mp_config *co
 	static FLT p0001 = 1.0e-4;
 	static FLT zero = 0.0;
 	int nfev = 0;
+	int nderivfail = 0;
 
 	mp_declare(step, FLT);
 	mp_declare(dstep, FLT);
@@ -335,6 +337,8 @@ int mpfit(mp_func funct, int m, int npar, FLT *xall, mp_par *pars, mp_config *co
 	conf.maxfev = 0;
 	conf.covtol = 1e-14;
 	conf.nofinitecheck = 0;
+	conf.alloc = 0;
+	conf.alloc_user = 0;
 
 	if (config) {
 		/* Transfer any user-specified configurations */
@@ -364,6 +368,8 @@ int mpfit(mp_func funct, int m, int npar, FLT *xall, mp_par *pars, mp_config *co
 		if (config->normtol > 0.)
 			conf.normtol = FLT_SQRT(config->normtol);
 		conf.maxfev = config->maxfev;
+		conf.alloc = config->alloc;
+		conf.alloc_user = config->alloc_user;
 	}
 
 	info = MP_ERR_INPUT; /* = 0 */
@@ -522,7 +528,7 @@ OUTER_LOOP:
 
 	/* Calculate the jacobian matrix */
 	iflag = mp_fdjac2(funct, m, nfree, ifree, npar, xnew, fvec, fjac, ldfjac, conf.epsfcn, wa4, private_data, &nfev,
-					  step, dstep, mpside, qulim, ulim, ddebug, ddrtol, ddatol, wa2, dvecptr, pars);
+					  step, dstep, mpside, qulim, ulim, ddebug, ddrtol, ddatol, wa2, dvecptr, pars, &nderivfail);
 	if (iflag < 0) {
 		goto CLEANUP;
 	}
@@ -1005,6 +1011,7 @@ L300:
 		result->status = info;
 		result->niter = iter;
 		result->nfev = nfev;
+		result->nderivfail = nderivfail;
 		result->npar = npar;
 		result->nfree = nfree;
 		result->npegged = npegged;
@@ -1049,7 +1056,8 @@ CLEANUP:
 
 static int mp_fdjac2(mp_func funct, int m, int n, int *ifree, int npar, FLT *x, FLT *fvec, FLT *fjac, int ldfjac,
 					 FLT epsfcn, FLT *wa, void *priv, int *nfev, FLT *step, FLT *dstep, int *dside, int *qulimited,
-					 FLT *ulimit, int *ddebug, FLT *ddrtol, FLT *ddatol, FLT *wa2, FLT **dvec, mp_par *pars) {
+					 FLT *ulimit, int *ddebug, FLT *ddrtol, FLT *ddatol, FLT *wa2, FLT **dvec, mp_par *pars,
+					 int *nderivfail) {
 	/*
 	 *     **********
 	 *
@@ -1240,6 +1248,8 @@ static int mp_fdjac2(mp_func funct, int m, int n, int *ifree, int npar, FLT *x,
 							((da != 0 || dr != 0) && (fabs(fjold - fjac[ij]) > da + fabs(fjold) * dr))) {
 							fprintf(stderr, "   %10d %10.4g %10.4g %10.4g %10.4g %10.4g\n", i, fvec[i], fjold, fjac[ij],
 									fjold - fjac[ij], (fjold == 0) ? (0) : ((fjold - fjac[ij]) / fjold));
+							if (nderivfail)
+								*nderivfail = *nderivfail + 1;
 						}
 					}
 				} /* end debugging */
@@ -1274,6 +1284,8 @@ static int mp_fdjac2(mp_func funct, int m, int n, int *ifree, int npar, FLT *x,
 							((da != 0 || dr != 0) && (fabs(fjold - fjac[ij]) > da + fabs(fjold) * dr))) {
 							fprintf(stderr, "   %10d %10.4g %10.4g %10.4g %10.4g %10.4g\n", i, fvec[i], fjold, fjac[ij],
 									fjold - fjac[ij], (fjold == 0) ? (0) : ((fjold - fjac[ij]) / fjold));
+							if (nderivfail)
+								*nderivfail = *nderivfail + 1;
 						}
 					}
 				} /* end debugging */
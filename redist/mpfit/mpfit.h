@@ -99,6 +99,11 @@ struct mp_config_struct {
 					*/
 	mp_iterproc iterproc; /* Placeholder pointer - must set to 0 */
 	FLT normtol;		  /* Norm convergence criteria Default: 0 */
+
+	/* Allocator for the work arrays, which are never freed through it;
+	   alloca is used if this is 0. Default: 0 */
+	void *(*alloc)(void *alloc_user, size_t size);
+	void *alloc_user;
 };
 
 /* Definition of results structure, for when fit completes */
@@ -113,6 +118,8 @@ struct mp_result_struct {
 	int nfree;   /* Number of free parameters */
 	int npegged; /* Number of pegged parameters */
 	int nfunc;   /* Number of residuals (= num. of data points) */
+	int nderivfail; /* Number of derivative debug entries outside of
+			   deriv_abstol/deriv_reltol */
 
 	FLT *resid;		  /* Final residuals
 					 nfunc-vector, or 0 if not desired */
@@ -29,6 +29,15 @@
 //  void OGUnlockSema( og_sema_t os );
 //  void OGDeleteSema( og_sema_t os );
 
+	Atomics, for the handful of lock free queues and counters.
+		uint32_t OGAtomicLoadU32( const volatile uint32_t * p );  //acquire
+		void OGAtomicStoreU32( volatile uint32_t * p, uint32_t v );  //release
+		uint32_t OGAtomicAddU32( volatile uint32_t * p, uint32_t v );  //returns the new value
+		uint32_t OGAtomicExchangeU32( volatile uint32_t * p, uint32_t v );  //returns the old value
+		uint32_t OGAtomicCompareExchangeU32( volatile uint32_t * p, uint32_t expected, uint32_t v );  //returns the old value
+		(and the same for U64)
+		void OGMemoryBarrier();  //full fence
+
 
 
    Copyright (c) 2011-2012,2013,2016,2018 <>< Charles Lohr
@@ -117,6 +126,17 @@ OSG_INLINE void OGDeleteConditionVariable(og_cv_t cv);
 
 OSG_INLINE og_cv_t OGCreateConditionVariable();  
 
+OSG_INLINE uint32_t OGAtomicLoadU32(const volatile uint32_t *p);
+OSG_INLINE void OGAtomicStoreU32(volatile uint32_t *p, uint32_t v);
+OSG_INLINE uint32_t OGAtomicAddU32(volatile uint32_t *p, uint32_t v);
+OSG_INLINE uint32_t OGAtomicExchangeU32(volatile uint32_t *p, uint32_t v);
+OSG_INLINE uint32_t OGAtomicCompareExchangeU32(volatile uint32_t *p, uint32_t expected, uint32_t v);
+OSG_INLINE uint64_t OGAtomicLoadU64(const volatile uint64_t *p);
+OSG_INLINE void OGAtomicStoreU64(volatile uint64_t *p, uint64_t v);
+OSG_INLINE uint64_t OGAtomicAddU64(volatile uint64_t *p, uint64_t v);
+OSG_INLINE uint64_t OGAtomicCompareExchangeU64(volatile uint64_t *p, uint64_t expected, uint64_t v);
+OSG_INLINE void OGMemoryBarrier();
+
 #if defined(WIN32) || defined(WINDOWS) || defined(_WIN32)
 #define USE_WINDOWS
 #endif
@@ -204,3 +204,27 @@ OSG_INLINE og_cv_t OGCreateConditionVariable() {
 	return cv;
 }
 
+OSG_INLINE uint32_t OGAtomicLoadU32(const volatile uint32_t *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+OSG_INLINE void OGAtomicStoreU32(volatile uint32_t *p, uint32_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+OSG_INLINE uint32_t OGAtomicAddU32(volatile uint32_t *p, uint32_t v) {
+	return __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST);
+}
+OSG_INLINE uint32_t OGAtomicExchangeU32(volatile uint32_t *p, uint32_t v) {
+	return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+}
+OSG_INLINE uint32_t OGAtomicCompareExchangeU32(volatile uint32_t *p, uint32_t expected, uint32_t v) {
+	__atomic_compare_exchange_n(p, &expected, v, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return expected;
+}
+
+OSG_INLINE uint64_t OGAtomicLoadU64(const volatile uint64_t *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+OSG_INLINE void OGAtomicStoreU64(volatile uint64_t *p, uint64_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+OSG_INLINE uint64_t OGAtomicAddU64(volatile uint64_t *p, uint64_t v) {
+	return __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST);
+}
+OSG_INLINE uint64_t OGAtomicCompareExchangeU64(volatile uint64_t *p, uint64_t expected, uint64_t v) {
+	__atomic_compare_exchange_n(p, &expected, v, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return expected;
+}
+
+OSG_INLINE void OGMemoryBarrier() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
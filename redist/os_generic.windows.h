@@ -139,3 +139,31 @@ OSG_INLINE og_cv_t OGCreateConditionVariable() {
 	return cv;
 }
 
+OSG_INLINE uint32_t OGAtomicLoadU32(const volatile uint32_t *p) {
+	return (uint32_t)InterlockedCompareExchange((volatile LONG *)p, 0, 0);
+}
+OSG_INLINE void OGAtomicStoreU32(volatile uint32_t *p, uint32_t v) { InterlockedExchange((volatile LONG *)p, (LONG)v); }
+OSG_INLINE uint32_t OGAtomicAddU32(volatile uint32_t *p, uint32_t v) {
+	return (uint32_t)InterlockedAdd((volatile LONG *)p, (LONG)v);
+}
+OSG_INLINE uint32_t OGAtomicExchangeU32(volatile uint32_t *p, uint32_t v) {
+	return (uint32_t)InterlockedExchange((volatile LONG *)p, (LONG)v);
+}
+OSG_INLINE uint32_t OGAtomicCompareExchangeU32(volatile uint32_t *p, uint32_t expected, uint32_t v) {
+	return (uint32_t)InterlockedCompareExchange((volatile LONG *)p, (LONG)v, (LONG)expected);
+}
+
+OSG_INLINE uint64_t OGAtomicLoadU64(const volatile uint64_t *p) {
+	return (uint64_t)InterlockedCompareExchange64((volatile LONG64 *)p, 0, 0);
+}
+OSG_INLINE void OGAtomicStoreU64(volatile uint64_t *p, uint64_t v) {
+	InterlockedExchange64((volatile LONG64 *)p, (LONG64)v);
+}
+OSG_INLINE uint64_t OGAtomicAddU64(volatile uint64_t *p, uint64_t v) {
+	return (uint64_t)InterlockedAdd64((volatile LONG64 *)p, (LONG64)v);
+}
+OSG_INLINE uint64_t OGAtomicCompareExchangeU64(volatile uint64_t *p, uint64_t expected, uint64_t v) {
+	return (uint64_t)InterlockedCompareExchange64((volatile LONG64 *)p, (LONG64)v, (LONG64)expected);
+}
+
+OSG_INLINE void OGMemoryBarrier() { MemoryBarrier(); }
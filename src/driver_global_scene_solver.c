@@ -346,6 +346,21 @@ static void ootx_recv(struct SurviveContext *ctx, uint8_t bsd_idx) {
 	set_needs_solve(gss);
 }
 
+// The solve reads every object's activations and calibration; with object locks the ctx lock alone doesn't keep the
+// objects' own threads out. Nobody else holds more than one object lock, so taking them all in list order is safe.
+static void lock_objects(SurviveContext *ctx, bool lock) {
+	for (int i = 0; i < ctx->objs_ct; i++) {
+		SurviveObject *so = ctx->objs[i];
+		if (so->object_lock) {
+			if (lock) {
+				OGLockMutex(so->object_lock);
+			} else {
+				OGUnlockMutex(so->object_lock);
+			}
+		}
+	}
+}
+
 void *survive_threaded_gss_thread_fn(void *_poser) {
 	struct global_scene_solver *self = (struct global_scene_solver *)_poser;
 	OGLockMutex(self->data_available_lock);
@@ -356,7 +371,9 @@ void *survive_threaded_gss_thread_fn(void *_poser) {
 			OGUnlockMutex(self->data_available_lock);
 			self->needsSolve = false;
 			survive_get_ctx_lock(self->ctx);
+			lock_objects(self->ctx, true);
 			run_optimization(self);
+			lock_objects(self->ctx, false);
 			survive_release_ctx_lock(self->ctx);
 			self->run_count++;
 
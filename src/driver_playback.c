@@ -5,6 +5,7 @@
 #include "survive.h"
 
 #include "survive_recording.h"
+#include "survive_recording_binary.h"
 #include "survive_internal.h"
 
 #include "survive_default_devices.h"
@@ -46,6 +47,12 @@ typedef struct SurvivePlaybackData {
     gzFile playback_file;
     int lineno;
 
+	struct survive_binary_reader *binary_file;
+	const survive_binary_record *next_record;
+	// Indexed by binary device index; cleared whenever a config record creates a device
+	SurviveObject **binary_objects;
+	size_t binary_objects_cnt;
+
 	double time_start;
 	double next_time_s;
 	double time_now;
@@ -310,24 +317,14 @@ static int parse_and_run_externalvelocity(const char *line, SurvivePlaybackData
 	return 0;
 }
 
-static int parse_and_run_config(const char *line, SurvivePlaybackData *driver) {
-	const char *configStart = line;
+static int run_config(SurvivePlaybackData *driver, const char *dev, const char *configStart, size_t len) {
 	SurviveContext *ctx = driver->ctx;
 
-	char dev[10] = {0};
-	for (int i = 0; i < sizeof(dev) && *configStart != ' '; i++) {
-		dev[i] = *configStart++;
-	}
-
 	SurviveObject *old_so = survive_get_so_by_name(ctx, dev);
 	if (old_so) {
 		survive_destroy_device(old_so);
 	}
 
-	configStart += strlen("CONFIG") + 1;
-
-	size_t len = strlen(configStart);
-
 	SurviveObject *so = survive_create_device(ctx, "replay", driver, dev, 0);
 	if(so == 0) {
         return 0;
@@ -345,6 +342,18 @@ static int parse_and_run_config(const char *line, SurvivePlaybackData *driver) {
 	return 0;
 }
 
+static int parse_and_run_config(const char *line, SurvivePlaybackData *driver) {
+	const char *configStart = line;
+
+	char dev[10] = {0};
+	for (int i = 0; i < sizeof(dev) - 1 && *configStart != ' '; i++) {
+		dev[i] = *configStart++;
+	}
+
+	configStart += strlen("CONFIG") + 1;
+	return run_config(driver, dev, configStart, strlen(configStart));
+}
+
 static int parse_and_run_rawlight(const char *line, SurvivePlaybackData *driver) {
 	if (driver->time_now < driver->playback_start_time)
 		return 0;
@@ -541,6 +550,213 @@ static int playback_pump_msg(struct SurviveContext *ctx, void *_driver) {
 	return 0;
 }
 
+static SurviveObject *binary_record_object(SurvivePlaybackData *driver, const survive_binary_record *record) {
+	if (record->device >= driver->binary_objects_cnt) {
+		size_t cnt = survive_binary_reader_device_count(driver->binary_file);
+		if (record->device >= cnt) {
+			return 0;
+		}
+		driver->binary_objects = SV_REALLOC(driver->binary_objects, sizeof(SurviveObject *) * cnt);
+		memset(driver->binary_objects + driver->binary_objects_cnt, 0,
+			   sizeof(SurviveObject *) * (cnt - driver->binary_objects_cnt));
+		driver->binary_objects_cnt = cnt;
+	}
+
+	SurviveObject *so = driver->binary_objects[record->device];
+	if (so == 0) {
+		const char *dev = survive_binary_reader_device_name(driver->binary_file, record->device);
+		so = driver->binary_objects[record->device] = dev ? find_or_warn(driver, dev) : 0;
+	}
+	return so;
+}
+
+static void binary_pose(const double *p, SurvivePose *pose) {
+	for (int i = 0; i < 3; i++) {
+		pose->Pos[i] = p[i];
+	}
+	for (int i = 0; i < 4; i++) {
+		pose->Rot[i] = p[3 + i];
+	}
+}
+
+static void binary_record_pose(const survive_binary_record *record, SurvivePose *pose) {
+	const survive_binary_pose *p = survive_binary_record_payload(record);
+	binary_pose(p->pose, pose);
+}
+
+static void binary_record_velocity(const survive_binary_record *record, SurviveVelocity *velocity) {
+	const survive_binary_velocity *v = survive_binary_record_payload(record);
+	for (int i = 0; i < 3; i++) {
+		velocity->Pos[i] = v->velocity[i];
+		velocity->AxisAngleRot[i] = v->velocity[3 + i];
+	}
+}
+
+// The reader only hands out records whose size covers the fixed payload for their type, and for configs their length
+static void run_binary_record(SurvivePlaybackData *driver, const survive_binary_record *record) {
+	SurviveContext *ctx = driver->ctx;
+	const void *payload = survive_binary_record_payload(record);
+	const char *dev = survive_binary_reader_device_name(driver->binary_file, record->device);
+	bool started = driver->time_now >= driver->playback_start_time;
+
+	switch (record->type) {
+	case SURVIVE_BINARY_RECORD_CONFIG: {
+		const survive_binary_config *config = payload;
+		if (dev == 0) {
+			break;
+		}
+		memset(driver->binary_objects, 0, sizeof(SurviveObject *) * driver->binary_objects_cnt);
+		run_config(driver, dev, (const char *)(config + 1), config->length);
+		break;
+	}
+	case SURVIVE_BINARY_RECORD_SYNC: {
+		const survive_binary_sync *r = payload;
+		SurviveObject *so = started ? binary_record_object(driver, record) : 0;
+		if (so) {
+			SURVIVE_INVOKE_HOOK_SO(sync, so, r->channel, r->timecode, r->ootx, r->gen);
+		}
+		break;
+	}
+	case SURVIVE_BINARY_RECORD_SWEEP: {
+		const survive_binary_sweep *r = payload;
+		SurviveObject *so = started ? binary_record_object(driver, record) : 0;
+		if (so) {
+			driver->hasSweepAngle = true;
+			SURVIVE_INVOKE_HOOK_SO(sweep, so, r->channel, r->sensor_id, r->timecode, r->flag);
+		}
+		break;
+	}
+	case SURVIVE_BINARY_RECORD_SWEEP_ANGLE: {
+		const survive_binary_sweep_angle *r = payload;
+		SurviveObject *so = started && !driver->hasSweepAngle ? binary_record_object(driver, record) : 0;
+		if (so) {
+			SURVIVE_INVOKE_HOOK_SO(sweep_angle, so, r->channel, r->sensor_id, r->timecode, r->plane, r->angle);
+		}
+		break;
+	}
+	case SURVIVE_BINARY_RECORD_LIGHTCAP: {
+		const survive_binary_lightcap *r = payload;
+		if (!started) {
+			break;
+		}
+		driver->hasRawLight = true;
+		SurviveObject *so = binary_record_object(driver, record);
+		if (so) {
+			LightcapElement le = {.sensor_id = r->sensor_id, .length = r->length, .timestamp = r->timestamp};
+			handle_lightcap(so, &le);
+		}
+		break;
+	}
+	case SURVIVE_BINARY_RECORD_LIGHT: {
+		const survive_binary_light *r = payload;
+		SurviveObject *so = started && !driver->hasRawLight ? binary_record_object(driver, record) : 0;
+		if (so) {
+			SURVIVE_INVOKE_HOOK_SO(light, so, r->sensor_id, r->acode, r->timeinsweep, r->timecode, r->length, r->lh);
+		}
+		break;
+	}
+	case SURVIVE_BINARY_RECORD_RAW_IMU:
+	case SURVIVE_BINARY_RECORD_IMU: {
+		const survive_binary_imu *r = payload;
+		bool raw = record->type == SURVIVE_BINARY_RECORD_RAW_IMU;
+		SurviveObject *so = started ? binary_record_object(driver, record) : 0;
+		if (so == 0) {
+			break;
+		}
+
+		FLT accelgyro[9];
+		for (int i = 0; i < 9; i++) {
+			accelgyro[i] = r->accelgyro[i];
+		}
+		if (raw) {
+			driver->hasRawIMU = true;
+			SURVIVE_INVOKE_HOOK_SO(raw_imu, so, r->mask, accelgyro, r->timecode, r->id);
+		} else if (!driver->hasRawIMU) {
+			SURVIVE_INVOKE_HOOK_SO(imu, so, r->mask, accelgyro, r->timecode, r->id);
+		}
+		break;
+	}
+	case SURVIVE_BINARY_RECORD_IMU_SCALES: {
+		const survive_binary_imu_scales *r = payload;
+		SurviveObject *so = binary_record_object(driver, record);
+		if (so) {
+			survive_default_set_imu_scale_modes(so, r->gyro_scale_mode, r->acc_scale_mode);
+		}
+		break;
+	}
+	case SURVIVE_BINARY_RECORD_POSE:
+	case SURVIVE_BINARY_RECORD_VELOCITY: {
+		if (!driver->outputCalculatedPose || dev == 0) {
+			break;
+		}
+
+		char name[128];
+		snprintf(name, sizeof(name), "replay_%s", dev);
+		if (record->type == SURVIVE_BINARY_RECORD_POSE) {
+			SurvivePose pose;
+			binary_record_pose(record, &pose);
+			SURVIVE_INVOKE_HOOK(external_pose, ctx, name, &pose);
+		} else {
+			SurviveVelocity velocity;
+			binary_record_velocity(record, &velocity);
+			SURVIVE_INVOKE_HOOK(external_velocity, ctx, name, &velocity);
+		}
+		break;
+	}
+	case SURVIVE_BINARY_RECORD_EXTERNAL_POSE:
+		if (started && driver->outputExternalPose && dev) {
+			SurvivePose pose;
+			binary_record_pose(record, &pose);
+			SURVIVE_INVOKE_HOOK(external_pose, ctx, dev, &pose);
+		}
+		break;
+	case SURVIVE_BINARY_RECORD_EXTERNAL_VELOCITY:
+		if (started && driver->outputExternalPose && dev) {
+			SurviveVelocity velocity;
+			binary_record_velocity(record, &velocity);
+			SURVIVE_INVOKE_HOOK(external_velocity, ctx, dev, &velocity);
+		}
+		break;
+	case SURVIVE_BINARY_RECORD_LH_POSE:
+		if (driver->outputCalculatedPose) {
+			const survive_binary_lh_pose *r = payload;
+			SurvivePose pose;
+			binary_pose(r->pose, &pose);
+			char buffer[32] = {0};
+			snprintf(buffer, 31, "previous_LH%d", r->mode);
+			SURVIVE_INVOKE_HOOK(external_pose, ctx, buffer, &pose);
+		}
+		break;
+	default:
+		// Disconnect, angle and button records aren't replayed, same as the text format. Unknown types are skipped.
+		break;
+	}
+}
+
+static int playback_pump_binary(struct SurviveContext *ctx, SurvivePlaybackData *driver) {
+	if (driver->next_record == 0) {
+		driver->next_record = survive_binary_reader_next(driver->binary_file);
+		if (driver->next_record == 0) {
+			SV_VERBOSE(100, "EOF for playback received.");
+			return -1;
+		}
+		driver->next_time_s = driver->next_record->time;
+	}
+
+	if (driver->next_time_s * driver->playback_factor > (OGRelativeTime() + driver->time_start))
+		return 0;
+
+	const survive_binary_record *record = driver->next_record;
+	driver->time_now = record->time;
+	driver->next_time_s = 0;
+	driver->next_record = 0;
+
+	survive_get_ctx_lock(ctx);
+	run_binary_record(driver, record);
+	survive_release_ctx_lock(ctx);
+	return 0;
+}
+
 static void *playback_thread(void *_driver) {
 	SurvivePlaybackData *driver = _driver;
 	int last_output_minute = 0;
@@ -554,7 +770,8 @@ static void *playback_thread(void *_driver) {
 			return 0;
 		}
 		if (next_time_s_scaled == 0 || next_time_s_scaled < time_now) {
-			int rtnVal = playback_pump_msg(driver->ctx, driver);
+			int rtnVal = driver->binary_file ? playback_pump_binary(driver->ctx, driver)
+											 : playback_pump_msg(driver->ctx, driver);
 			SurviveContext *ctx = driver->ctx;
 			if (last_output_minute != output_minute) {
 				SV_VERBOSE(10, "Playback thread played back %6.2fs in %6.2fs real-time... (%6.2fx)", driver->time_now,
@@ -584,6 +801,9 @@ static int playback_close(struct SurviveContext *ctx, void *_driver) {
 	if (driver->playback_file)
 		gzclose(driver->playback_file);
 	driver->playback_file = 0;
+	survive_binary_reader_close(driver->binary_file);
+	driver->binary_file = 0;
+	free(driver->binary_objects);
 
 	survive_detach_config(ctx, PLAYBACK_START_TIME_TAG, &driver->playback_start_time);
 	survive_detach_config(ctx, "playback-factor", &driver->playback_factor);
@@ -619,6 +839,38 @@ int DriverRegPlayback(SurviveContext *ctx) {
 	sp->outputCalculatedPose = survive_configi(ctx, "playback-replay-pose", SC_GET, 0);
 	sp->outputExternalPose = survive_configi(ctx, PLAYBACK_REPLAY_EXTERNAL_POSE_TAG, SC_GET, 0);
 
+	if (survive_binary_recording_detect(playback_file)) {
+		sp->binary_file = survive_binary_reader_open(ctx, playback_file);
+		if (sp->binary_file == 0) {
+			SV_ERROR(SURVIVE_ERROR_INVALID_CONFIG, "Could not open binary playback file %s", playback_file);
+			free(sp);
+			return -1;
+		}
+
+		survive_install_run_time_fn(ctx, survive_playback_run_time, sp);
+		survive_attach_configf(ctx, "playback-factor", &sp->playback_factor);
+		survive_attach_configf(ctx, "playback-time", &sp->playback_time);
+		survive_attach_configf(ctx, PLAYBACK_START_TIME_TAG, &sp->playback_start_time);
+
+		SV_INFO("Using binary playback file '%s' with timefactor of %f until %f", playback_file, sp->playback_factor,
+				sp->playback_time);
+
+		// Jump to the keyframe before the start time; records before that point are never read
+		if (sp->playback_start_time > 0 && survive_binary_reader_seek(sp->binary_file, sp->playback_start_time)) {
+			SV_VERBOSE(10, "Seeked binary playback to %f", sp->playback_start_time);
+		}
+
+		sp->next_record = survive_binary_reader_next(sp->binary_file);
+		if (sp->next_record) {
+			sp->next_time_s = sp->time_start = sp->next_record->time;
+		}
+		if (sp->time_start < sp->playback_start_time)
+			sp->time_start = sp->playback_start_time;
+
+		sp->keepRunning = survive_add_threaded_driver(ctx, sp, "playback", playback_thread, playback_close);
+		return 0;
+	}
+
 	sp->playback_file = gzopen(playback_file, "r");
 	if (sp->playback_file == 0) {
 		SV_ERROR(SURVIVE_ERROR_INVALID_CONFIG, "Could not open playback events file %s", playback_file);
@@ -649,9 +649,16 @@ void survive_data_on_setup_write(SurviveObject *so, uint8_t bmRequestType, uint8
 void survive_data_cb_locked(uint64_t time_received_us, SurviveUSBInterface *si);
 void survive_data_cb(uint64_t time_received_us, SurviveUSBInterface *si) {
 	SurviveContext *ctx = si->ctx;
-	survive_get_ctx_lock(ctx);
-	survive_data_cb_locked(time_received_us, si);
-	survive_release_ctx_lock(ctx);
+	SurviveObject *so = si->assoc_obj;
+	if (so) {
+		survive_get_so_lock(so);
+		survive_data_cb_locked(time_received_us, si);
+		survive_release_so_lock(so);
+	} else {
+		survive_get_ctx_lock(ctx);
+		survive_data_cb_locked(time_received_us, si);
+		survive_release_ctx_lock(ctx);
+	}
 }
 
 // USB Subsystem
@@ -2875,6 +2882,8 @@ void survive_data_cb_locked(uint64_t time_received_us, SurviveUSBInterface *si)
 	if (obj == 0)
 		return;
 
+	survive_set_received_time(time_received_us);
+
 	int id = POP1;
 	size--;
 
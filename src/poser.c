@@ -222,7 +222,10 @@ void PoserData_lighthouse_pose_func(PoserData *poser_data, SurviveObject *so, ui
 		for (int i = 0; i < 7; i++)
 			assert(!isnan(((FLT *)&lighthouse2world)[i]));
 
-		survive_kalman_lighthouse_integrate_observation(so->ctx->bsd[lighthouse].tracker, lighthouse_pose, R);
+		// The lighthouse tracker is shared by every object that sees this lighthouse
+		survive_get_bsd_lock(ctx);
+		survive_kalman_lighthouse_integrate_observation(ctx->bsd[lighthouse].tracker, lighthouse_pose, R);
+		survive_release_bsd_lock(ctx);
 	}
 }
 
@@ -387,16 +390,19 @@ void PoserData_lighthouse_poses_func(PoserData *poser_data, SurviveObject *so, S
 }
 
 FLT survive_lighthouse_adjust_confidence(SurviveContext *ctx, uint8_t bsd_idx, FLT v) {
+	survive_get_bsd_lock(ctx);
 	ctx->bsd[bsd_idx].confidence += v;
 
 	if (ctx->bsd[bsd_idx].confidence < 0) {
 		ctx->bsd[bsd_idx].PositionSet = 0;
 		SV_WARN("Position for LH%d seems bad; queuing for recal", bsd_idx);
 	} else if (ctx->bsd[bsd_idx].confidence > 1.) {
-		return ctx->bsd[bsd_idx].confidence = 1;
+		ctx->bsd[bsd_idx].confidence = 1;
 	}
 
-	return ctx->bsd[bsd_idx].confidence;
+	FLT rtn = ctx->bsd[bsd_idx].confidence;
+	survive_release_bsd_lock(ctx);
+	return rtn;
 }
 
 SURVIVE_EXPORT FLT survive_adjust_confidence(SurviveObject *so, FLT delta) {
@@ -437,9 +443,9 @@ void *survive_threaded_poser_thread_fn(void *_poser) {
 			self->has_new_data = false;
 			OGUnlockMutex(self->data_available_lock);
 
-			survive_get_ctx_lock(self->so->ctx);
+			survive_get_so_lock(so);
 			self->innerPoser(so, &self->PoserData.pd);
-			survive_release_ctx_lock(self->so->ctx);
+			survive_release_so_lock(so);
 			self->run_count++;
 
 			OGLockMutex(self->data_available_lock);
@@ -472,9 +478,9 @@ int survive_threaded_poser_fn(SurviveObject *so, PoserData *pd) {
 		self->active = 0;
 		OGSignalCond(self->data_available);
 		OGUnlockMutex(self->data_available_lock);
-		survive_release_ctx_lock(self->so->ctx);
+		survive_release_so_lock(so);
 		OGJoinThread(self->thread);
-		survive_get_ctx_lock(self->so->ctx);
+		survive_get_so_lock(so);
 
 		self->innerPoser(so, pd);
 
@@ -280,9 +280,9 @@ int PoserBaryCentricSVD(SurviveObject *so, PoserData *pd) {
 
 					if (dd->bc.meas_cnt >= dd->required_meas) {
 
-						survive_release_ctx_lock(so->ctx);
+						survive_release_so_lock(so);
 						SurvivePose obj2Lh = solve_correspondence(dd, false);
-						survive_get_ctx_lock(so->ctx);
+						survive_get_so_lock(so);
 
 						if (quatmagnitude(obj2Lh.Rot) != 0) {
 							const SurvivePose *lh2world = survive_get_lighthouse_position(so->ctx, lh);
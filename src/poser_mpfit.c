@@ -29,6 +29,8 @@
 #endif
 
 STATIC_CONFIG_ITEM(SERIALIZE_SOLVE, "serialize-lh-mpfit", 's', "Serialize MPFIT formulization", 0)
+STATIC_CONFIG_ITEM(SERIALIZE_GSS_SOLVE, "serialize-gss-mpfit", 's', "Serialize MPFIT formulization of global scene solves",
+				   0)
 STATIC_CONFIG_ITEM(USE_JACOBIAN_FUNCTION, "use-jacobian-function", 'i',
 				   "If set to false, a slower numerical approximation of the jacobian is used. Set to -1 to see debug output", 1)
 STATIC_CONFIG_ITEM(SENSOR_VARIANCE_PER_SEC, "sensor-variance-per-sec", 'f',
@@ -37,7 +39,10 @@ STATIC_CONFIG_ITEM(SENSOR_VARIANCE, "sensor-variance", 'f', "Base variance for e
 
 STATIC_CONFIG_ITEM(DISABLE_LIGHTHOUSE, "disable-lighthouse", 'i', "Disable given lighthouse from tracking", -1)
 STATIC_CONFIG_ITEM(RUN_EVERY_N_SYNCS, "syncs-per-run", 'i', "Number of sync pulses before running optimizer", 1)
-STATIC_CONFIG_ITEM(RUN_POSER_ASYNC, "poser-async", 'i', "Run the poser in it's own thread", 0)
+STATIC_CONFIG_ITEM(RUN_POSER_ASYNC, "poser-async", 'i',
+				   "Threads, shared by every object, to run pose solves on. 0 solves on the poser's thread", 0)
+STATIC_CONFIG_ITEM(POSER_ASYNC_BUFFERS, "poser-async-buffers", 'i',
+				   "Pose solves each object can have in flight with poser-async", 2)
 
 STATIC_CONFIG_ITEM(PRECISE_POSE, "precise", 'b', "Always calculate precise pose", 0)
 STATIC_CONFIG_ITEM(USE_STATIONARY_SENSOR_WINDOW, "use-stationary-sensor-window", 'i',
@@ -59,15 +64,18 @@ typedef struct MPFITStats {
 	uint32_t dropped_lh_cnt;
 } MPFITStats;
 
+// Shared by every object in one context; kept in survive_context_plugin_data and guarded by the bsd lock
 typedef struct MPFITGlobalData {
 	size_t instances;
 	MPFITStats stats;
-} MPFITGlobalData;
 
-static MPFITGlobalData g;
+	// Created by the first instance when poser-async is set, and freed with the last one
+	struct survive_async_optimizer *async_optimizer;
+} MPFITGlobalData;
 
 typedef struct MPFITData {
 	GeneralOptimizerData opt;
+	MPFITGlobalData *global;
 
 	int disable_lighthouse;
 	int sensor_time_window;
@@ -84,10 +92,15 @@ typedef struct MPFITData {
   FLT sensor_variance;
   FLT sensor_variance_per_second;
 
+  // Throttles the 'not enough measurements' message
+  int failure_count;
+
   bool alwaysPrecise;
 
   bool useStationaryWindow;
   const char *serialize_prefix;
+  const char *serialize_gss_prefix;
+  int gss_solves;
   MPFITStats stats;
 
   FLT record_reprojection_error;
@@ -95,9 +108,14 @@ typedef struct MPFITData {
   FLT sensor_variance_cal;
   bool model_velocity;
   bool globalDataAvailable;
-  struct survive_async_optimizer *async_optimizer;
 
   survive_optimizer_settings optimizer_settings;
+
+  bool incremental;
+  survive_optimizer_warm_start warm_start;
+
+  // Every run's problem and scratch memory
+  survive_optimizer_workspace workspace;
 } MPFITData;
 
 STRUCT_CONFIG_SECTION(MPFITData)
@@ -115,6 +133,10 @@ STRUCT_CONFIG_ITEM("mpfit-cal-stationary-object-up-variance",
 				   1e-3, t->calibration_stationary_obj_up_variance)
 STRUCT_CONFIG_ITEM("mpfit-lighthouse-up-variance",
 				   "How much to weight having the accel direction on lighthouses pointing up", 1e-2, t->lh_up_variance)
+STRUCT_CONFIG_ITEM("mpfit-incremental",
+				   "Start each pose solve from the damping and scaling the last one ended with. Only those carry "
+				   "over; the information matrix and measurements are rebuilt every solve",
+				   false, t->incremental)
 END_STRUCT_CONFIG_SECTION(MPFITData)
 
 static size_t remove_lh_from_meas(survive_optimizer *mpfitctx, int lh) {
@@ -137,6 +159,9 @@ struct async_optimizer_user {
 	size_t meas_for_lhs_axis[NUM_GEN2_LIGHTHOUSES * 2];
 	struct variance_measure meas_variance[NUM_GEN2_LIGHTHOUSES * 2];
 
+	// This solve's copy of d->warm_start; the solve runs without the object lock, so it never touches d's directly
+	survive_optimizer_warm_start warm_start;
+
 	struct {
 		survive_long_timecode old_measurements_age;
 		uint32_t time_window;
@@ -228,7 +253,6 @@ static size_t construct_input_from_scene(const MPFITData *d, survive_long_timeco
 }
 
 static bool invalid_starting_condition(MPFITData *d, size_t meas_size, const size_t *meas_for_lhs_axis) {
-	static int failure_count = 500;
 	struct SurviveObject *so = d->opt.so;
 
 	size_t meas_size_known_lh = 0;
@@ -246,17 +270,17 @@ static bool invalid_starting_condition(MPFITData *d, size_t meas_size, const siz
 	}
 
 	if (meas_size_known_lh < d->required_meas || axis_known_lh < 2) {
-		if (failure_count++ == 500) {
+		if (d->failure_count++ == 500) {
 			SurviveContext *ctx = so->ctx;
 			SV_INFO("Can't solve for position with just %u measurements", (unsigned int)meas_size_known_lh);
-			failure_count = 0;
+			d->failure_count = 0;
 		}
 		if (meas_size_known_lh < d->required_meas || axis_known_lh < 2) {
 			d->stats.meas_failures++;
 		}
 		return true;
 	}
-	failure_count = 0;
+	d->failure_count = 0;
 	return false;
 }
 
@@ -268,6 +292,15 @@ static inline void serialize_mpfit(MPFITData *d, survive_optimizer *mpfitctx) {
 	}
 }
 
+// One global scene solve covers every object, so these are numbered on their own
+static inline void serialize_gss_mpfit(MPFITData *d, survive_optimizer *mpfitctx) {
+	if (d->serialize_gss_prefix) {
+		char path[1024] = {0};
+		snprintf(path, 1023, "%s_gss_%d.opt", d->serialize_gss_prefix, d->gss_solves);
+		survive_optimizer_serialize(mpfitctx, path);
+	}
+}
+
 static inline bool has_data_for_lh(const size_t *meas_for_lhs_axis, int lh) {
 	return meas_for_lhs_axis[2 * lh] > 0 && meas_for_lhs_axis[2 * lh + 1] > 0;
 }
@@ -677,13 +710,13 @@ static void handle_results(MPFITData *d, PoserDataLight *lightData, FLT error, S
 
 typedef void (*handle_results_fn)(MPFITData *d, PoserDataLight *lightData, FLT error, SurvivePose *estimate);
 
-static FLT run_mpfit_find_3d_structure(MPFITData *d, PoserDataLight *pdl, SurviveSensorActivations *scene,
-									   SurvivePose *out, CnMat *R) {
+static void setup_mpfit_problem(MPFITData *d, const PoserDataLight *pdl, survive_optimizer *mpfitctx,
+								survive_optimizer_workspace *workspace) {
 	SurviveObject *so = d->opt.so;
 	struct SurviveContext *ctx = so->ctx;
 
 	bool objectStationary = SurviveSensorActivations_stationary_time(&so->activations) > so->timebase_hz;
-	survive_optimizer mpfitctx = {
+	*mpfitctx = (survive_optimizer){
 	        .settings = &d->optimizer_settings,
 	        .reprojectModel = survive_reproject_model(ctx),
 								  .poseLength = 1,
@@ -694,24 +727,104 @@ static FLT run_mpfit_find_3d_structure(MPFITData *d, PoserDataLight *pdl, Surviv
 								  .disableVelocity = d->model_velocity == false || objectStationary,
 								  .user = d};
 	// stationary_obj_up_variance;
-	SURVIVE_OPTIMIZER_SETUP_STACK_BUFFERS(mpfitctx, so);
+	survive_optimizer_workspace_reset(workspace);
+	SURVIVE_OPTIMIZER_SETUP_WORKSPACE_BUFFERS(*mpfitctx, workspace, so);
+}
 
-	struct async_optimizer_user user_data = {.d = d, .pdl = *pdl};
+// Runs on a pool thread holding the object's lock
+static void async_optimizer_cb(struct survive_async_optimizer_buffer *buffer, int res, mp_result *result) {
+	struct async_optimizer_user *user_data = buffer->user;
+	MPFITData *d = user_data->d;
 
-	int setup_results = setup_optimizer(&user_data, &mpfitctx, scene);
-	if (setup_results < 0) {
-		return setup_results;
+	SurvivePose estimate = {0};
+	FLT error = handle_optimizer_results(&buffer->optimizer, res, result, user_data, 0, &estimate);
+	if (buffer->optimizer.warm_start) {
+		d->warm_start = error < 0 ? (survive_optimizer_warm_start){0} : user_data->warm_start;
+	}
+	handle_results(d, &user_data->pdl, error, &estimate, 0);
+}
+
+static FLT solve_mpfit_problem(MPFITData *d, survive_optimizer *mpfitctx, struct async_optimizer_user *user_data,
+							   SurvivePose *out, CnMat *R) {
+	SurviveObject *so = d->opt.so;
+
+	// Lighthouse solves are a different problem every time; nothing carries over
+	if (d->incremental && !user_data->canPossiblySolveLHS) {
+		user_data->warm_start = d->warm_start;
+		mpfitctx->warm_start = &user_data->warm_start;
 	}
 
 	mp_result result = {0};
 
-	int nfree = survive_optimizer_get_free_parameters_count(&mpfitctx);
-	survive_release_ctx_lock(ctx);
-	int res = survive_optimizer_run(&mpfitctx, &result, R);
+	int nfree = survive_optimizer_get_free_parameters_count(mpfitctx);
+	survive_release_so_lock(so);
+	int res = survive_optimizer_run(mpfitctx, &result, R);
 //	cn_print_mat(R);
-	survive_get_ctx_lock(ctx);
+	survive_get_so_lock(so);
 
-	return handle_optimizer_results(&mpfitctx, res, &result, &user_data, R, out);
+	FLT rtn = handle_optimizer_results(mpfitctx, res, &result, user_data, R, out);
+	if (mpfitctx->warm_start) {
+		d->warm_start = rtn < 0 ? (survive_optimizer_warm_start){0} : user_data->warm_start;
+	}
+	return rtn;
+}
+
+// Pose solves are handed to the pool, and their results reported from async_optimizer_cb without a covariance; 'rtn'
+// is 0 for those. Returns false if there is no buffer free to set the problem up in.
+static bool run_mpfit_find_3d_structure_async(MPFITData *d, PoserDataLight *pdl, SurviveSensorActivations *scene,
+											  SurvivePose *out, CnMat *R, FLT *rtn) {
+	struct survive_async_optimizer *pool = d->global->async_optimizer;
+	survive_async_optimizer_buffer *buffer = survive_async_optimizer_alloc_object_optimizer(pool, d->opt.so);
+	if (buffer == 0) {
+		return false;
+	}
+
+	if (buffer->user == 0) {
+		buffer->user = SV_MALLOC(sizeof(struct async_optimizer_user));
+	}
+	struct async_optimizer_user *user_data = buffer->user;
+	*user_data = (struct async_optimizer_user){.d = d, .pdl = *pdl};
+
+	setup_mpfit_problem(d, pdl, &buffer->optimizer, &buffer->workspace);
+	*rtn = setup_optimizer(user_data, &buffer->optimizer, scene);
+	if (*rtn < 0) {
+		survive_async_optimizer_cancel(pool, buffer);
+		return true;
+	}
+
+	// Lighthouse solves move the whole scene, and need their covariance; they stay on this thread
+	if (user_data->canPossiblySolveLHS) {
+		*rtn = solve_mpfit_problem(d, &buffer->optimizer, user_data, out, R);
+		survive_async_optimizer_cancel(pool, buffer);
+		return true;
+	}
+
+	if (d->incremental) {
+		user_data->warm_start = d->warm_start;
+		buffer->optimizer.warm_start = &user_data->warm_start;
+	}
+	survive_async_optimizer_run(pool, buffer);
+	return true;
+}
+
+static FLT run_mpfit_find_3d_structure(MPFITData *d, PoserDataLight *pdl, SurviveSensorActivations *scene,
+									   SurvivePose *out, CnMat *R) {
+	FLT rtn = 0;
+	if (d->global->async_optimizer && run_mpfit_find_3d_structure_async(d, pdl, scene, out, R, &rtn)) {
+		return rtn;
+	}
+
+	survive_optimizer mpfitctx;
+	setup_mpfit_problem(d, pdl, &mpfitctx, &d->workspace);
+
+	struct async_optimizer_user user_data = {.d = d, .pdl = *pdl};
+
+	int setup_results = setup_optimizer(&user_data, &mpfitctx, scene);
+	if (setup_results < 0) {
+		return setup_results;
+	}
+
+	return solve_mpfit_problem(d, &mpfitctx, &user_data, out, R);
 }
 
 static inline void print_stats(SurviveContext *ctx, MPFITStats *stats) {
@@ -948,6 +1061,8 @@ bool solve_global_scene(struct SurviveContext *ctx, MPFITData *d, PoserDataGloba
 
 	mp_result result = {0};
 	mpfitctx.cfg = survive_optimizer_precise_config();
+	serialize_gss_mpfit(d, &mpfitctx);
+	d->gss_solves++;
 
 	survive_release_ctx_lock(ctx);
 	CN_CREATE_STACK_MAT(R_free, (scenes_cnt + ctx->activeLighthouses) * 7, (scenes_cnt + ctx->activeLighthouses) * 7);
@@ -1058,6 +1173,69 @@ bool solve_global_scene(struct SurviveContext *ctx, MPFITData *d, PoserDataGloba
 
 	return true;
 }
+int PoserMPFIT(SurviveObject *so, PoserData *pd);
+
+static MPFITGlobalData *mpfit_global_data_acquire(SurviveContext *ctx) {
+	survive_get_bsd_lock(ctx);
+	MPFITGlobalData **slot = (MPFITGlobalData **)survive_context_plugin_data(ctx, PoserMPFIT);
+	if (*slot == 0) {
+		*slot = SV_CALLOC(sizeof(MPFITGlobalData));
+		int async_threads = survive_configi(ctx, RUN_POSER_ASYNC_TAG, SC_GET, 0);
+		if (async_threads > 0) {
+			(*slot)->async_optimizer = survive_async_optimizer_init_pool(SV_CALLOC(sizeof(survive_async_optimizer)),
+																		 async_optimizer_cb, 0, async_threads);
+		}
+	}
+	MPFITGlobalData *g = *slot;
+	g->instances++;
+	survive_release_bsd_lock(ctx);
+	return g;
+}
+
+// Folds an instance's stats into the context's, and frees the shared data with the last instance
+static void mpfit_global_data_release(SurviveContext *ctx, MPFITGlobalData *g, const MPFITStats *stats) {
+	survive_get_bsd_lock(ctx);
+	g->stats.total_lh_cnt += stats->total_lh_cnt;
+	g->stats.dropped_lh_cnt += stats->dropped_lh_cnt;
+	g->stats.total_meas_cnt += stats->total_meas_cnt;
+	g->stats.dropped_meas_cnt += stats->dropped_meas_cnt;
+	g->stats.total_fev += stats->total_fev;
+	g->stats.total_runs += stats->total_runs;
+	g->stats.sum_errors += stats->sum_errors;
+	g->stats.meas_failures += stats->meas_failures;
+	g->stats.total_iterations += stats->total_iterations;
+	g->stats.sum_origerrors += stats->sum_origerrors;
+	for (int i = 0; i < sizeof(stats->status_cnts) / sizeof(int); i++) {
+		g->stats.status_cnts[i] += stats->status_cnts[i];
+	}
+
+	bool last = --g->instances == 0;
+	if (last) {
+		*survive_context_plugin_data(ctx, PoserMPFIT) = 0;
+	}
+	survive_release_bsd_lock(ctx);
+
+	if (!last) {
+		return;
+	}
+
+	if (ctx->log_level >= 1) {
+		SV_INFO("MPFIT overall stats:");
+		print_stats(ctx, &g->stats);
+
+		if (g->async_optimizer) {
+			SV_INFO("\tjobs submitted    %lu", g->async_optimizer->submitted);
+			SV_INFO("\tjobs completed    %lu", g->async_optimizer->completed);
+			SV_INFO("\tjobs coalesced    %lu", g->async_optimizer->coalesced);
+			SV_INFO("\tjobs dropped      %lu", g->async_optimizer->dropped);
+			SV_INFO("\tmax queue depth   %lu", g->async_optimizer->max_queue_depth);
+		}
+	}
+	// Every object's buffers are gone, so nothing is left running
+	survive_async_free(g->async_optimizer);
+	free(g);
+}
+
 int PoserMPFIT(SurviveObject *so, PoserData *pd) {
 	void **user = survive_object_plugin_data(so, PoserMPFIT);
 	SurviveContext *ctx = so->ctx;
@@ -1066,7 +1244,6 @@ int PoserMPFIT(SurviveObject *so, PoserData *pd) {
 	}
 	if (*user == 0) {
 		*user = SV_CALLOC(sizeof(MPFITData));
-		g.instances++;
 		MPFITData *d = *user;
 
 		general_optimizer_data_init(&d->opt, so);
@@ -1075,6 +1252,7 @@ int PoserMPFIT(SurviveObject *so, PoserData *pd) {
 		d->useStationaryWindow = (bool)survive_configi(ctx, USE_STATIONARY_SENSOR_WINDOW_TAG, SC_GET, 1);
 
 		d->syncs_to_setup = 16;
+		d->failure_count = 500;
 		d->required_meas = survive_configi(ctx, "required-meas", SC_GET, 8);
 		d->syncs_per_run = survive_configi(ctx, "syncs-per-run", SC_GET, 1);
 		d->sensor_time_window = survive_configi(ctx, "time-window", SC_GET, SurviveSensorActivations_default_tolerance);
@@ -1086,6 +1264,7 @@ int PoserMPFIT(SurviveObject *so, PoserData *pd) {
 					"all to debug.");
 		}
 		d->serialize_prefix = survive_configs(ctx, "serialize-lh-mpfit", SC_GET, 0);
+		d->serialize_gss_prefix = survive_configs(ctx, "serialize-gss-mpfit", SC_GET, 0);
 		survive_attach_configi(ctx, "disable-lighthouse", &d->disable_lighthouse);
 		survive_attach_configf(ctx, "sensor-variance-per-sec", &d->sensor_variance_per_second);
 		survive_attach_configf(ctx, "sensor-variance", &d->sensor_variance);
@@ -1096,6 +1275,12 @@ int PoserMPFIT(SurviveObject *so, PoserData *pd) {
 		MPFITData_attach_config(ctx, d);
         survive_optimizer_settings_attach_config(ctx, &d->optimizer_settings);
 
+		d->global = mpfit_global_data_acquire(ctx);
+		if (d->global->async_optimizer) {
+			size_t async_buffers = survive_configi(ctx, POSER_ASYNC_BUFFERS_TAG, SC_GET, 2);
+			survive_async_optimizer_add_object(d->global->async_optimizer, so, async_buffers);
+		}
+
 		SV_VERBOSE(110, "Initializing MPFIT:");
 		SV_VERBOSE(110, "\trequired-meas: %d", d->required_meas);
 		SV_VERBOSE(110, "\ttime-window: %d", d->sensor_time_window);
@@ -1134,44 +1319,27 @@ int PoserMPFIT(SurviveObject *so, PoserData *pd) {
 	}
 
 	case POSERDATA_DISASSOCIATE: {
+		// Problems still in the pool point back at d. Running ones finish by taking the object's lock, which the
+		// caller holds, so hand it back while they do.
+		if (d->global->async_optimizer) {
+			survive_release_so_lock(so);
+			survive_async_optimizer_remove_object(d->global->async_optimizer, so);
+			survive_get_so_lock(so);
+		}
+
 		SV_INFO("MPFIT stats for %s:", so->codename);
 		if (ctx->log_level > 5) {
 			print_stats(ctx, &d->stats);
-
-			if (d->async_optimizer) {
-				SV_INFO("\tjobs submitted     %lu", d->async_optimizer->submitted);
-				SV_INFO("\tjobs completed     %lu", d->async_optimizer->completed);
-			}
-		}
-
-		g.stats.total_lh_cnt += d->stats.total_lh_cnt;
-		g.stats.dropped_lh_cnt += d->stats.dropped_lh_cnt;
-		g.stats.total_meas_cnt += d->stats.total_meas_cnt;
-		g.stats.dropped_meas_cnt += d->stats.dropped_meas_cnt;
-		g.stats.total_fev += d->stats.total_fev;
-		g.stats.total_runs += d->stats.total_runs;
-		g.stats.sum_errors += d->stats.sum_errors;
-		g.stats.meas_failures += d->stats.meas_failures;
-		g.stats.total_iterations += d->stats.total_iterations;
-		g.stats.sum_origerrors += d->stats.sum_origerrors;
-		for (int i = 0; i < sizeof(d->stats.status_cnts) / sizeof(int); i++) {
-			g.stats.status_cnts[i] += d->stats.status_cnts[i];
 		}
 
-		g.instances--;
-		if (ctx->log_level >= 1) {
-			if (g.instances == 0) {
-				SV_INFO("MPFIT overall stats:");
-				print_stats(ctx, &g.stats);
-			}
-		}
+		mpfit_global_data_release(ctx, d->global, &d->stats);
 		general_optimizer_data_dtor(&d->opt);
 		MPFITData_detach_config(ctx, d);
         survive_optimizer_settings_detach_config(ctx, &d->optimizer_settings);
 		survive_detach_config(ctx, "disable-lighthouse", &d->disable_lighthouse);
 		survive_detach_config(ctx, "sensor-variance-per-sec", &d->sensor_variance_per_second);
 		survive_detach_config(ctx, "sensor-variance", &d->sensor_variance);
-		survive_async_free(d->async_optimizer);
+		survive_optimizer_workspace_free(&d->workspace);
 		*user = 0;
 		free(d);
 		return 0;
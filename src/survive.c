@@ -16,6 +16,9 @@
 #include "survive_config.h"
 #include "survive_default_devices.h"
 #include "survive_kalman_lighthouses.h"
+#include "survive_kalman_tracker.h"
+#include "survive_latency.h"
+#include "survive_pipeline.h"
 #include "survive_recording.h"
 
 #include <stdarg.h>
@@ -29,6 +32,7 @@
 #endif
 
 #include "survive_private.h"
+#include "survive_thread_pool.h"
 
 #define DEFAULT_CONFIG_PATH "config.json"
 STATIC_CONFIG_ITEM(SURVIVE_VERBOSE, "v", 'i', "Verbosity level", 0)
@@ -44,6 +48,8 @@ STATIC_CONFIG_ITEM(LIGHTHOUSE_GEN, "lighthouse-gen", 'i',
 STATIC_CONFIG_ITEM(OUTPUT_CALLBACK_STATS, "output-callback-stats", 'f',
 				   "Print cb stats every given number of seconds. 0 disables this output.", 0.);
 STATIC_CONFIG_ITEM(THREADED_POSERS, "threaded-posers", 'b', "Whether or not to run each poser in their own thread.", 1)
+STATIC_CONFIG_ITEM(OBJECT_LOCKS, "object-locks", 'b',
+				   "Guard each device with its own lock instead of the context lock so devices process concurrently.", 0)
 
 STATIC_CONFIG_ITEM(LH_0_DISABLE, "lighthouse-0-disable", 'b', "Disable lh at idx 0", 0)
 STATIC_CONFIG_ITEM(LH_1_DISABLE, "lighthouse-1-disable", 'b', "Disable lh at idx 1", 0)
@@ -222,10 +228,7 @@ static void PrintMatchingDrivers( const char * prefix, const char * matchingpara
 	}
 }
 
-SURVIVE_EXPORT int8_t survive_get_bsd_idx(SurviveContext *ctx, survive_channel channel) {
-	if (channel < 0 || channel >= 16) {
-		return -1;
-	}
+static int8_t survive_get_bsd_idx_locked(SurviveContext *ctx, survive_channel channel) {
 
 	if (ctx->lh_version == 0) {
 		if (ctx->bsd[channel].mode == 0xFF) {
@@ -256,6 +259,22 @@ SURVIVE_EXPORT int8_t survive_get_bsd_idx(SurviveContext *ctx, survive_channel c
 	return -1;
 }
 
+SURVIVE_EXPORT int8_t survive_get_bsd_idx(SurviveContext *ctx, survive_channel channel) {
+	if (channel < 0 || channel >= 16) {
+		return -1;
+	}
+
+	// Fast path; once a channel is mapped it stays mapped
+	if (ctx->lh_version != 0 && ctx->bsd_map[channel] != -1) {
+		return ctx->bsd_map[channel];
+	}
+
+	survive_get_bsd_lock(ctx);
+	int8_t rtn = survive_get_bsd_idx_locked(ctx, channel);
+	survive_release_bsd_lock(ctx);
+	return rtn;
+}
+
 void survive_get_ctx_lock(SurviveContext *ctx) {
 	struct SurviveContext_private *pctx = ctx->private_members;
 	// SV_VERBOSE(100, "Trying to get lock on %lx", pthread_self());
@@ -269,6 +288,30 @@ void survive_release_ctx_lock(SurviveContext *ctx) {
 	// SV_VERBOSE(100, "Signaled on %lx", pthread_self());
 }
 
+void survive_get_so_lock(SurviveObject *so) {
+	if (so->object_lock) {
+		OGLockMutex(so->object_lock);
+	} else {
+		survive_get_ctx_lock(so->ctx);
+	}
+}
+void survive_release_so_lock(SurviveObject *so) {
+	if (so->object_lock) {
+		OGUnlockMutex(so->object_lock);
+	} else {
+		survive_release_ctx_lock(so->ctx);
+	}
+}
+
+void survive_get_bsd_lock(SurviveContext *ctx) {
+	struct SurviveContext_private *pctx = ctx->private_members;
+	OGLockMutex(pctx->bsd_lock);
+}
+void survive_release_bsd_lock(SurviveContext *ctx) {
+	struct SurviveContext_private *pctx = ctx->private_members;
+	OGUnlockMutex(pctx->bsd_lock);
+}
+
 static inline bool find_correct_config_file(struct SurviveContext *ctx, const char **config_prefix_fields) {
 	for (const char **name = config_prefix_fields; *name; name++) {
 		if (survive_config_is_set(ctx, *name)) {
@@ -326,6 +369,7 @@ SurviveContext *survive_init_internal(int argc, char *const *argv, void *userDat
 	pctx->external2world.Rot[0] = 1;
 
 	pctx->poll_sema = OGCreateSema();
+	pctx->bsd_lock = OGCreateMutex();
 
 	for (int i = 0; i < NUM_GEN2_LIGHTHOUSES; i++) {
 		ctx->bsd[i].mode = -1;
@@ -468,6 +512,16 @@ SurviveContext *survive_init_internal(int argc, char *const *argv, void *userDat
 	ctx->activeLighthouses = 0;
 
 	pctx->callbackStatsTimeBetween = survive_configf(ctx, "output-callback-stats", SC_GET, 0.0);
+	pctx->report_in_imu = survive_configi(ctx, "report-in-imu", SC_GET, 0);
+	survive_hook_latency_init(ctx);
+	pctx->optimizer_pool = survive_thread_pool_create(survive_configi(ctx, "optimizer-threads", SC_GET, 1));
+	// The pipeline workers need to run without the ctx lock
+	pctx->object_locks =
+		survive_configi(ctx, "object-locks", SC_GET, 0) || survive_configi(ctx, "pipeline", SC_GET, 0);
+	// The batch is shared by every object, so it needs all of them to run under the ctx lock
+	if (!pctx->object_locks) {
+		pctx->imu_batch = survive_kalman_tracker_imu_batch_create(survive_configi(ctx, "kalman-imu-batch", SC_GET, 0));
+	}
 
 	for (int i = 0; i < NUM_GEN2_LIGHTHOUSES; i++) {
 		if (config_read_lighthouse(ctx->lh_config, &(ctx->bsd[i]), i)) {
@@ -686,6 +740,8 @@ int survive_startup(SurviveContext *ctx) {
 		ctx->PoserFn = PreferredPoserCB;
 	}
 
+	survive_pipeline_install(ctx);
+
 	// saving the config extra to make sure that the user has a config file they can change.
 	config_save(ctx);
 
@@ -792,11 +848,14 @@ int survive_add_object(SurviveContext *ctx, SurviveObject *obj) {
 	}
 
 	SV_INFO("Adding tracked object %s from %s", survive_colorize(obj->codename), survive_colorize(obj->drivername));
+	survive_get_bsd_lock(ctx);
 	int oldct = ctx->objs_ct;
 	ctx->objs = SV_REALLOC(ctx->objs, sizeof(SurviveObject *) * (oldct + 1));
 	ctx->objs[oldct] = obj;
 	ctx->objs_ct = oldct + 1;
+	survive_release_bsd_lock(ctx);
 
+	survive_hook_latency_add_object(ctx, obj);
 	SURVIVE_INVOKE_HOOK_SO(new_object, obj);
 
 	return 0;
@@ -814,6 +873,7 @@ void survive_remove_object(SurviveContext *ctx, SurviveObject *obj) {
 		return;
 	}
 
+	survive_get_bsd_lock(ctx);
 	// Swap the last item into this items slot; this assumes order doesn't matter in this list
 	if (obj_idx != ctx->objs_ct - 1) {
 		ctx->objs[obj_idx] = ctx->objs[ctx->objs_ct - 1];
@@ -824,6 +884,7 @@ void survive_remove_object(SurviveContext *ctx, SurviveObject *obj) {
 	// Blank out the spot; but this is only really necessary for diagnostic reasons -- presumably no one will ever read
 	// past the end of the list
 	ctx->objs[ctx->objs_ct] = 0;
+	survive_release_bsd_lock(ctx);
 
 	SV_INFO("Removing tracked object %s from %s", obj->codename, obj->drivername);
 	free(obj);
@@ -879,6 +940,12 @@ SURVIVE_EXPORT const SurvivePose *survive_get_lighthouse_position(const SurviveC
 	}
 	return &ctx->bsd[bsd_idx].Pose;
 }
+SURVIVE_EXPORT SurvivePose survive_copy_lighthouse_position(SurviveContext *ctx, int bsd_idx) {
+	survive_get_bsd_lock(ctx);
+	SurvivePose rtn = *survive_get_lighthouse_position(ctx, bsd_idx);
+	survive_release_bsd_lock(ctx);
+	return rtn;
+}
 
 void survive_reset_lighthouse_positions(SurviveContext *ctx) {
 	// survive_get_ctx_lock(ctx);
@@ -993,13 +1060,24 @@ void survive_close(SurviveContext *ctx) {
 		}
 	}
 
+	survive_pipeline_close(ctx);
+
 	for (int i = 0; i < ctx->objs_ct; i++) {
+		SurviveObject *so = ctx->objs[i];
 		PoserData pd;
 		pd.pt = POSERDATA_DISASSOCIATE;
 		if (ctx->PoserFn) {
-			ctx->PoserFn(ctx->objs[i], &pd);
+			// The ctx lock is held here already; posers expect to be disassociated under the object lock too since the
+			// threaded poser hands it back while it joins its thread
+			if (so->object_lock) {
+				OGLockMutex(so->object_lock);
+			}
+			ctx->PoserFn(so, &pd);
+			if (so->object_lock) {
+				OGUnlockMutex(so->object_lock);
+			}
 		}
-		SURVIVE_INVOKE_HOOK_SO(lightcap, ctx->objs[i], 0);
+		SURVIVE_INVOKE_HOOK_SO(lightcap, so, 0);
 	}
 	ctx->PoserFn = 0;
 
@@ -1018,7 +1096,13 @@ void survive_close(SurviveContext *ctx) {
 	}
 
 	survive_output_callback_stats(ctx);
+	survive_hook_latency_close(ctx);
 
+	survive_pipeline_free(ctx);
+	survive_thread_pool_free(ctx->private_members->optimizer_pool);
+	ctx->private_members->optimizer_pool = 0;
+	survive_kalman_tracker_imu_batch_free(ctx->private_members->imu_batch);
+	ctx->private_members->imu_batch = 0;
 	survive_destroy_recording(ctx);
 
 	SurviveContext_detach_config(ctx, ctx);
@@ -1037,6 +1121,9 @@ void survive_close(SurviveContext *ctx) {
 
 	struct SurviveContext_private *pctx = ctx->private_members;
 	OGDeleteSema(pctx->poll_sema);
+	OGDeleteMutex(pctx->bsd_lock);
+	free(pctx->PluginDataEntries);
+	free(pctx->optimizer_cfg);
 	free(pctx);
 
 	free(ctx->objs);
@@ -1190,6 +1277,26 @@ SURVIVE_EXPORT SurvivePluginData *survive_object_plugin_data(SurviveObject *so,
 	return &so->PluginDataEntries[so->PluginDataEntries_cnt - 1].data;
 }
 
+SURVIVE_EXPORT SurvivePluginData *survive_context_plugin_data(SurviveContext *ctx, SurvivePluginKey k) {
+	struct SurviveContext_private *pctx = ctx->private_members;
+	for (size_t i = 0; i < pctx->PluginDataEntries_cnt; i++) {
+		if (pctx->PluginDataEntries[i].key == k) {
+			return &pctx->PluginDataEntries[i].data;
+		}
+	}
+
+	if (pctx->PluginDataEntries_cnt >= pctx->PluginDataEntries_space) {
+		pctx->PluginDataEntries_space += 8;
+		pctx->PluginDataEntries =
+			SV_REALLOC(pctx->PluginDataEntries, sizeof(SurvivePluginPair) * pctx->PluginDataEntries_space);
+	}
+
+	pctx->PluginDataEntries_cnt++;
+	pctx->PluginDataEntries[pctx->PluginDataEntries_cnt - 1].key = k;
+	pctx->PluginDataEntries[pctx->PluginDataEntries_cnt - 1].data = 0;
+	return &pctx->PluginDataEntries[pctx->PluginDataEntries_cnt - 1].data;
+}
+
 const SurvivePose *survive_object_pose(SurviveObject *so) { return &so->OutPose; }
 
 int8_t survive_object_sensor_ct(SurviveObject *so) { return so->sensor_ct; }
@@ -9,6 +9,19 @@
 #include "stdio.h"
 #include "string.h"
 #include "survive.h"
+#include "survive_config.h"
+#include "survive_kalman_tracker.h"
+
+STATIC_CONFIG_ITEM(SIMPLE_EVENT_BUFFER_SIZE, "simple-event-buffer-size", 'i',
+				   "Button, config and device events buffered per simple api consumer. Rounded up to a power of two.", 64)
+STATIC_CONFIG_ITEM(SIMPLE_POSE_EVENT_BUFFER_SIZE, "simple-pose-event-buffer-size", 'i',
+				   "Pose events buffered for simple api event consumers. Rounded up to a power of two.", 1024)
+STATIC_CONFIG_ITEM(SIMPLE_EVENT_WAKE_COUNT, "simple-event-wake-count", 'i',
+				   "Wake waiting simple api consumers after this many pose events", 1)
+STATIC_CONFIG_ITEM(SIMPLE_EVENT_WAKE_US, "simple-event-wake-us", 'i',
+				   "Wake waiting simple api consumers if this many microseconds passed since the last wake. 0 wakes on "
+				   "simple-event-wake-count alone.",
+				   0)
 
 struct SurviveExternalObject {
 	SurvivePose pose;
@@ -20,6 +33,14 @@ struct SurviveLighthouseData {
 	char serial_number[16];
 };
 
+// Seqlock guarded copy of an objects latest state so readers never need poll_mutex. Writers are serialized by the
+// object (or ctx) lock for tracked objects and by poll_mutex for external ones.
+struct SurviveSimpleSnapshotSlot {
+	volatile uint32_t seq;
+	bool valid;
+	SurviveSimplePoseSnapshot data;
+};
+
 struct SurviveSimpleObject {
 	struct SurviveSimpleContext *actx;
 
@@ -32,7 +53,10 @@ struct SurviveSimpleObject {
 	} data;
 
 	char name[32];
-	bool has_update;
+	// Set by pose hooks that don't hold poll_mutex; only ever exchanged atomically
+	volatile uint32_t has_update;
+
+	struct SurviveSimpleSnapshotSlot snapshot;
 
 	SurviveSimpleObject *next;
 };
@@ -42,7 +66,27 @@ struct SurviveSimpleObjectList {
 	SurviveSimpleObject *head, *tail;
 };
 
-#define MAX_EVENT_SIZE 64
+// Multi producer, multi consumer broadcast ring. Producers claim an index with an atomic add and publish the slot with
+// a per slot sequence number; consumers each keep their own cursor. Producers never wait on consumers -- a consumer that
+// falls a full ring behind skips ahead and counts what it missed.
+struct SurviveSimpleEventSlot {
+	// 2 * index + 1 while being written, 2 * index + 2 once published
+	volatile uint64_t seq;
+	SurviveSimpleEvent event;
+};
+
+struct SurviveSimpleEventRing {
+	struct SurviveSimpleEventSlot *slots;
+	uint64_t mask;
+	volatile uint64_t head;
+};
+
+struct SurviveSimpleEventConsumer {
+	SurviveSimpleContext *actx;
+	uint64_t event_cursor, pose_cursor;
+	uint64_t dropped, dropped_poses;
+};
+
 struct SurviveSimpleContext {
 	SurviveContext *ctx;
 	SurviveSimpleLogFn log_fn;
@@ -53,11 +97,17 @@ struct SurviveSimpleContext {
 	og_mutex_t poll_mutex;
 	og_cv_t update_cv;
 
-	size_t events_cnt;
-	size_t event_next_write;
-	struct SurviveSimpleEvent events[MAX_EVENT_SIZE];
+	struct SurviveSimpleEventRing events, pose_events;
+	// Consumer behind survive_simple_next_event; it only reads 'events' and coalesces poses via has_update
+	struct SurviveSimpleEventConsumer default_consumer;
+
+	uint32_t wake_count, wake_us;
+	volatile uint64_t unsignaled_poses, last_wake_us;
 
 	struct SurviveSimpleObjectList objects;
+
+	// Bumped around every snapshot write; lets the batch reader detect writes across the whole object set
+	volatile uint32_t snapshot_writes_started, snapshot_writes_finished;
 };
 
 static enum SurviveSimpleObject_type to_simple_type(SurviveObjectType sot) {
@@ -77,30 +127,155 @@ static void unlock_and_notify_change(SurviveSimpleContext *actx) {
 	OGUnlockMutex(actx->poll_mutex);
 }
 
-static void insert_into_event_buffer(SurviveSimpleContext *actx, const SurviveSimpleEvent *event) {
-	bool buffer_full = actx->events_cnt == MAX_EVENT_SIZE;
+static void event_ring_init(struct SurviveSimpleEventRing *ring, int32_t requested_size) {
+	uint64_t size = 16;
+	while (size < requested_size && size < (1u << 20)) {
+		size <<= 1;
+	}
+	ring->mask = size - 1;
+	ring->slots = SV_CALLOC_N(size, sizeof(struct SurviveSimpleEventSlot));
+}
+
+static void event_ring_publish(struct SurviveSimpleEventRing *ring, const SurviveSimpleEvent *event) {
+	uint64_t idx = OGAtomicAddU64(&ring->head, 1) - 1;
+	struct SurviveSimpleEventSlot *slot = &ring->slots[idx & ring->mask];
+
+	OGAtomicStoreU64(&slot->seq, 2 * idx + 1);
+	OGMemoryBarrier();
+	slot->event = *event;
+	OGAtomicStoreU64(&slot->seq, 2 * idx + 2);
+}
 
-	actx->events[actx->event_next_write] = *event;
-	actx->event_next_write = (actx->event_next_write + 1) % MAX_EVENT_SIZE;
-	if (!buffer_full)
-		actx->events_cnt++;
+static bool event_ring_read(const struct SurviveSimpleEventRing *ring, uint64_t *cursor, uint64_t *dropped,
+							SurviveSimpleEvent *event) {
+	for (;;) {
+		uint64_t head = OGAtomicLoadU64(&ring->head);
+		if (*cursor >= head) {
+			return false;
+		}
+
+		if (head - *cursor > ring->mask + 1) {
+			uint64_t oldest = head - (ring->mask + 1);
+			*dropped += oldest - *cursor;
+			*cursor = oldest;
+		}
+
+		const struct SurviveSimpleEventSlot *slot = &ring->slots[*cursor & ring->mask];
+		uint64_t expected = 2 * *cursor + 2;
+		uint64_t seq = OGAtomicLoadU64(&slot->seq);
+		if (seq < expected) {
+			// Claimed but not yet published; keep ordering and pick it up next time
+			return false;
+		}
+
+		if (seq == expected) {
+			*event = slot->event;
+			OGMemoryBarrier();
+			if (OGAtomicLoadU64(&slot->seq) == expected) {
+				(*cursor)++;
+				return true;
+			}
+		}
+
+		// A producer lapped us while reading
+		(*dropped)++;
+		(*cursor)++;
+	}
+}
+
+static bool event_ring_pending(const struct SurviveSimpleEventRing *ring, uint64_t cursor) {
+	return OGAtomicLoadU64(&ring->head) > cursor;
+}
+
+static void wake_consumers(SurviveSimpleContext *actx) {
+	OGLockMutex(actx->poll_mutex);
+	OGBroadcastCond(actx->update_cv);
+	OGUnlockMutex(actx->poll_mutex);
+}
+
+// Expects poll_mutex to be held; releases it
+static void insert_into_event_buffer(SurviveSimpleContext *actx, const SurviveSimpleEvent *event) {
+	event_ring_publish(&actx->events, event);
 	unlock_and_notify_change(actx);
 }
 
-static bool pop_from_event_buffer(SurviveSimpleContext *actx, SurviveSimpleEvent *event) {
-	if (actx->events_cnt == 0)
-		return false;
+static void publish_pose_event(SurviveSimpleContext *actx, const SurviveSimpleObject *sao) {
+	SurviveSimpleEvent event = {.event_type = SurviveSimpleEventType_PoseUpdateEvent,
+								.d = {.pose_event = {.object = sao}}};
+	event.d.pose_event.time = survive_simple_object_get_latest_pose(sao, &event.d.pose_event.pose);
+	survive_simple_object_get_latest_velocity(sao, &event.d.pose_event.velocity);
+	event_ring_publish(&actx->pose_events, &event);
 
-	size_t read_idx = (MAX_EVENT_SIZE + actx->event_next_write - actx->events_cnt) % MAX_EVENT_SIZE;
-	*event = actx->events[read_idx];
+	// Batch wakeups so a busy tracker doesn't hammer the mutex; consumers wait at most wake_us for the rest.
+	uint64_t pending = OGAtomicAddU64(&actx->unsignaled_poses, 1);
+	// With wake_us == 0 only the count batches wakeups; there is no time window to expire
+	uint64_t now = actx->wake_us ? OGGetAbsoluteTimeUS() : 0;
+	bool window_expired = actx->wake_us > 0 && now - OGAtomicLoadU64(&actx->last_wake_us) >= actx->wake_us;
+	if (pending >= actx->wake_count || window_expired) {
+		OGAtomicStoreU64(&actx->unsignaled_poses, 0);
+		OGAtomicStoreU64(&actx->last_wake_us, now);
+		wake_consumers(actx);
+	}
+}
 
-	// Mark read events as invalid and assert if they are about to be passed on. This means there is a logic bug in the
-	// circular buffer
-	assert(event->event_type != -1);
-	actx->events[read_idx].event_type = -1;
+static void snapshot_write(SurviveSimpleObject *sao, const SurviveSimplePoseSnapshot *data) {
+	SurviveSimpleContext *actx = sao->actx;
+	struct SurviveSimpleSnapshotSlot *slot = &sao->snapshot;
 
-	actx->events_cnt--;
-	return true;
+	OGAtomicAddU32(&actx->snapshot_writes_started, 1);
+	uint32_t seq = slot->seq;
+	OGAtomicStoreU32(&slot->seq, seq + 1);
+	OGMemoryBarrier();
+
+	slot->data = *data;
+	slot->data.object = sao;
+	slot->valid = true;
+
+	OGAtomicStoreU32(&slot->seq, seq + 2);
+	OGAtomicAddU32(&actx->snapshot_writes_finished, 1);
+}
+
+static bool snapshot_read(const SurviveSimpleObject *sao, SurviveSimplePoseSnapshot *data) {
+	const struct SurviveSimpleSnapshotSlot *slot = &sao->snapshot;
+	for (int attempt = 0;; attempt++) {
+		// Don't spin against a writer that was preempted mid write
+		if (attempt >= 16) {
+			OGUSleep(1);
+		}
+
+		uint32_t seq = OGAtomicLoadU32(&slot->seq);
+		if (seq & 1) {
+			continue;
+		}
+
+		bool valid = slot->valid;
+		*data = slot->data;
+
+		OGMemoryBarrier();
+		if (OGAtomicLoadU32(&slot->seq) == seq) {
+			return valid;
+		}
+	}
+}
+
+static void snapshot_update_from_object(SurviveSimpleObject *sao) {
+	SurviveObject *so = sao->data.so;
+	SurviveSimplePoseSnapshot snapshot = {
+		.time = SurviveSensorActivations_runtime(&so->activations, so->OutPose_timecode) * 1e-6,
+		.velocity_time = SurviveSensorActivations_runtime(&so->activations, so->velocity_timecode) * 1e-6,
+		.pose = so->OutPose,
+		.velocity = so->velocity,
+	};
+
+	if (so->tracker && so->tracker->model.P.rows >= 3) {
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				snapshot.position_covariance[i * 3 + j] = cnMatrixGet(&so->tracker->model.P, i, j);
+			}
+		}
+	}
+
+	snapshot_write(sao, &snapshot);
 }
 
 static void SurviveSimpleObjectList_add(struct SurviveSimpleObjectList *list, SurviveSimpleObject *so) {
@@ -137,8 +312,9 @@ static void external_velocity_fn(SurviveContext *ctx, const char *name, const Su
 	survive_default_external_velocity_process(ctx, name, velocity);
 
 	SurviveSimpleObject *so = find_or_create_external(actx, name);
-	so->has_update = true;
+	OGAtomicStoreU32(&so->has_update, 1);
 	so->data.seo.velocity = *velocity;
+	snapshot_write(so, &(SurviveSimplePoseSnapshot){.pose = so->data.seo.pose, .velocity = so->data.seo.velocity});
 	unlock_and_notify_change(actx);
 }
 
@@ -148,18 +324,28 @@ static void external_pose_fn(SurviveContext *ctx, const char *name, const Surviv
 	survive_default_external_pose_process(ctx, name, pose);
 
 	SurviveSimpleObject *so = find_or_create_external(actx, name);
-	so->has_update = true;
+	OGAtomicStoreU32(&so->has_update, 1);
 	so->data.seo.pose = *pose;
+	snapshot_write(so, &(SurviveSimplePoseSnapshot){.pose = so->data.seo.pose, .velocity = so->data.seo.velocity});
 	unlock_and_notify_change(actx);
 }
 static void pose_fn(SurviveObject *so, survive_long_timecode timecode, const SurvivePose *pose) {
 	SurviveSimpleContext *actx = so->ctx->user_ptr;
-	OGLockMutex(actx->poll_mutex);
 	survive_default_pose_process(so, timecode, pose);
 
 	struct SurviveSimpleObject *sao = so->user_ptr;
-	sao->has_update = true;
-	unlock_and_notify_change(actx);
+	OGAtomicStoreU32(&sao->has_update, 1);
+	snapshot_update_from_object(sao);
+	publish_pose_event(actx, sao);
+}
+
+static void velocity_fn(SurviveObject *so, survive_long_timecode timecode, const SurviveVelocity *velocity) {
+	survive_default_velocity_process(so, timecode, velocity);
+
+	struct SurviveSimpleObject *sao = so->user_ptr;
+	if (sao) {
+		snapshot_update_from_object(sao);
+	}
 }
 
 static inline SurviveSimpleObject *create_lighthouse(SurviveSimpleContext *actx, size_t i) {
@@ -194,7 +380,7 @@ static void lh_fn(SurviveContext *ctx, uint8_t lighthouse, const SurvivePose *li
 	struct SurviveSimpleObject *sao = ctx->bsd[lighthouse].user_ptr;
 	if (sao == 0)
 		sao = create_lighthouse(actx, lighthouse);
-	sao->has_update = true;
+	OGAtomicStoreU32(&sao->has_update, 1);
 
 	unlock_and_notify_change(actx);
 }
@@ -301,6 +487,12 @@ SURVIVE_EXPORT SurviveSimpleContext *survive_simple_init_with_logger(int argc, c
 	actx->poll_mutex = OGCreateMutex();
 	actx->update_cv = OGCreateConditionVariable();
 
+	event_ring_init(&actx->events, survive_configi(ctx, SIMPLE_EVENT_BUFFER_SIZE_TAG, SC_GET, 64));
+	event_ring_init(&actx->pose_events, survive_configi(ctx, SIMPLE_POSE_EVENT_BUFFER_SIZE_TAG, SC_GET, 1024));
+	actx->wake_count = survive_configi(ctx, SIMPLE_EVENT_WAKE_COUNT_TAG, SC_GET, 1);
+	actx->wake_us = survive_configi(ctx, SIMPLE_EVENT_WAKE_US_TAG, SC_GET, 0);
+	actx->default_consumer.actx = actx;
+
 	survive_startup(ctx);
 
 	intptr_t i = 0;
@@ -309,6 +501,7 @@ SURVIVE_EXPORT SurviveSimpleContext *survive_simple_init_with_logger(int argc, c
 	}
 
 	survive_install_pose_fn(ctx, pose_fn);
+	survive_install_velocity_fn(ctx, velocity_fn);
 	survive_install_external_pose_fn(ctx, external_pose_fn);
 	survive_install_external_velocity_fn(ctx, external_velocity_fn);
 	survive_install_button_fn(ctx, button_fn);
@@ -345,6 +538,8 @@ void survive_simple_close(SurviveSimpleContext *actx) {
 	OGJoinThread(actx->thread);
 
 	OGDeleteConditionVariable(actx->update_cv);
+	free(actx->events.slots);
+	free(actx->pose_events.slots);
 	actx->thread = 0;
 	free(actx);
 }
@@ -383,8 +578,7 @@ size_t survive_simple_get_object_count(SurviveSimpleContext *actx) { return actx
 
 const SurviveSimpleObject *survive_simple_get_next_updated(SurviveSimpleContext *actx) {
 	for (struct SurviveSimpleObject *n = actx->objects.head; n; n = n->next) {
-		if (n->has_update) {
-			n->has_update = false;
+		if (OGAtomicExchangeU32(&n->has_update, 0)) {
 			return n;
 		}
 	}
@@ -392,34 +586,11 @@ const SurviveSimpleObject *survive_simple_get_next_updated(SurviveSimpleContext
 }
 
 FLT survive_simple_object_get_latest_velocity(const SurviveSimpleObject *sao, SurviveVelocity *velocity) {
-	FLT timecode = 0;
-	OGLockMutex(sao->actx->poll_mutex);
-
-	switch (sao->type) {
-	case SurviveSimpleObject_LIGHTHOUSE:
-		if (velocity)
-			*velocity = (SurviveVelocity){ 0 };
-		timecode = survive_simple_run_time_since_epoch(sao->actx);
-		break;
-	case SurviveSimpleObject_HMD:
-	case SurviveSimpleObject_OBJECT:
-		if (velocity)
-			*velocity = sao->data.so->velocity;
-		timecode = SurviveSensorActivations_runtime(&sao->data.so->activations, sao->data.so->velocity_timecode) * 1e-6;
-		break;
-	case SurviveSimpleObject_EXTERNAL:
-		if (velocity)
-			*velocity = sao->data.seo.velocity;
-		break;
-
-	default: {
-		SurviveContext *ctx = sao->actx->ctx;
-		SV_GENERAL_ERROR("Invalid object type %d", sao->type);
-	}
-	}
-
-	OGUnlockMutex(sao->actx->poll_mutex);
-	return timecode;
+	SurviveSimplePoseSnapshot snapshot;
+	survive_simple_object_get_pose_snapshot(sao, &snapshot);
+	if (velocity)
+		*velocity = snapshot.velocity;
+	return snapshot.velocity_time;
 }
 
 void survive_simple_object_get_transform_to_imu(const SurviveSimpleObject *sao, SurvivePose *pose) {
@@ -431,36 +602,103 @@ void survive_simple_object_get_transform_to_imu(const SurviveSimpleObject *sao,
 }
 
 FLT survive_simple_object_get_latest_pose(const SurviveSimpleObject *sao, SurvivePose *pose) {
-	FLT timecode = 0;
-	OGLockMutex(sao->actx->poll_mutex);
+	SurviveSimplePoseSnapshot snapshot;
+	survive_simple_object_get_pose_snapshot(sao, &snapshot);
+	if (pose)
+		*pose = snapshot.pose;
+	return snapshot.time;
+}
+
+static void external_snapshot_to_world(const SurviveSimpleObject *sao, SurviveSimplePoseSnapshot *snapshot) {
+	SurvivePose pose = snapshot->pose;
+	ApplyPoseToPose(&snapshot->pose, survive_external_to_world(sao->actx->ctx), &pose);
+}
+
+bool survive_simple_object_get_pose_snapshot(const SurviveSimpleObject *sao, SurviveSimplePoseSnapshot *snapshot) {
+	*snapshot = (SurviveSimplePoseSnapshot){.object = sao};
 
 	switch (sao->type) {
 	case SurviveSimpleObject_LIGHTHOUSE: {
-		if (pose)
-			*pose = *survive_get_lighthouse_position(sao->actx->ctx, sao->data.lh.lighthouse);
-		timecode = survive_simple_run_time_since_epoch(sao->actx);
-		break;
+		// Reading a lighthouse position can advance its interpolation, so this stays behind the mutex. Lighthouses
+		// don't move much; this isn't a hot path.
+		OGLockMutex(sao->actx->poll_mutex);
+		snapshot->pose = *survive_get_lighthouse_position(sao->actx->ctx, sao->data.lh.lighthouse);
+		snapshot->time = snapshot->velocity_time = survive_simple_run_time_since_epoch(sao->actx);
+		bool valid = sao->actx->ctx->bsd[sao->data.lh.lighthouse].PositionSet;
+		OGUnlockMutex(sao->actx->poll_mutex);
+		return valid;
 	}
 	case SurviveSimpleObject_HMD:
 	case SurviveSimpleObject_OBJECT:
-		if (pose)
-			*pose = sao->data.so->OutPose;
-		timecode = SurviveSensorActivations_runtime(&sao->data.so->activations, sao->data.so->OutPose_timecode) * 1e-6;
-		break;
-	case SurviveSimpleObject_EXTERNAL:
-		if (pose) {
-			ApplyPoseToPose(pose, survive_external_to_world(sao->actx->ctx), &sao->data.seo.pose);
-		}
-		break;
+		return snapshot_read(sao, snapshot);
+	case SurviveSimpleObject_EXTERNAL: {
+		bool valid = snapshot_read(sao, snapshot);
+		external_snapshot_to_world(sao, snapshot);
+		return valid;
+	}
 
 	default: {
 		SurviveContext *ctx = sao->actx->ctx;
 		SV_GENERAL_ERROR("Invalid object type %d", sao->type);
 	}
 	}
+	return false;
+}
+
+bool survive_simple_object_predict_pose(const SurviveSimpleObject *sao, FLT time, SurviveSimplePoseSnapshot *snapshot) {
+	const SurviveObject *so = survive_simple_get_survive_object(sao);
+	SurviveKalmanTrackerSnapshot filter;
+	if (so == 0 || so->tracker == 0 || !survive_kalman_tracker_read_snapshot(so->tracker, &filter)) {
+		return survive_simple_object_get_pose_snapshot(sao, snapshot);
+	}
 
-	OGUnlockMutex(sao->actx->poll_mutex);
-	return timecode;
+	*snapshot = (SurviveSimplePoseSnapshot){.object = sao, .time = time, .velocity_time = time};
+	survive_kalman_tracker_predict_snapshot(&filter, filter.t + (time - filter.runtime), &snapshot->pose,
+											&snapshot->velocity, snapshot->position_covariance);
+	return true;
+}
+
+size_t survive_simple_get_pose_snapshots(SurviveSimpleContext *actx, SurviveSimplePoseSnapshot *snapshots,
+										 size_t max_cnt) {
+	size_t cnt = 0;
+
+	// find_or_create_external adds to the object list under poll_mutex. Tracked object snapshots are written without
+	// it, so this only holds off new external objects and external writes.
+	OGLockMutex(actx->poll_mutex);
+
+	// Retry until no write started or finished while we were copying, which makes the array consistent across
+	// objects. If writers keep us from ever getting a quiet window, settle for per object consistency.
+	for (int attempt = 0; attempt < 16; attempt++) {
+		uint32_t finished = OGAtomicLoadU32(&actx->snapshot_writes_finished);
+		uint32_t started = OGAtomicLoadU32(&actx->snapshot_writes_started);
+
+		cnt = 0;
+		for (const SurviveSimpleObject *sao = actx->objects.head; sao && cnt < max_cnt; sao = sao->next) {
+			if (sao->type == SurviveSimpleObject_LIGHTHOUSE) {
+				continue;
+			}
+			if (snapshot_read(sao, &snapshots[cnt])) {
+				if (sao->type == SurviveSimpleObject_EXTERNAL) {
+					external_snapshot_to_world(sao, &snapshots[cnt]);
+				}
+				cnt++;
+			}
+		}
+
+		OGMemoryBarrier();
+		if (started == finished && OGAtomicLoadU32(&actx->snapshot_writes_started) == started) {
+			break;
+		}
+	}
+
+	for (const SurviveSimpleObject *sao = actx->objects.head; sao && cnt < max_cnt; sao = sao->next) {
+		if (sao->type == SurviveSimpleObject_LIGHTHOUSE && survive_simple_object_get_pose_snapshot(sao, &snapshots[cnt])) {
+			cnt++;
+		}
+	}
+	OGUnlockMutex(actx->poll_mutex);
+
+	return cnt;
 }
 
 SURVIVE_EXPORT bool survive_simple_object_charging(const SurviveSimpleObject *sao) {
@@ -569,16 +807,82 @@ bool survive_simple_wait_for_update(SurviveSimpleContext *actx) {
 	return survive_simple_is_running(actx);
 }
 
+static void wait_for_consumer(SurviveSimpleContext *actx, bool (*has_pending)(const SurviveSimpleEventConsumer *),
+							  const SurviveSimpleEventConsumer *consumer) {
+	// Pose wakeups may be batched, so don't sleep much past the batching window
+	uint32_t timeout_ms = actx->wake_us ? (actx->wake_us + 999) / 1000 : 100;
+
+	OGLockMutex(actx->poll_mutex);
+	if (!has_pending(consumer)) {
+		OGWaitCondTimeout(actx->update_cv, actx->poll_mutex, timeout_ms);
+	}
+	OGUnlockMutex(actx->poll_mutex);
+}
+
+static bool default_consumer_pending(const SurviveSimpleEventConsumer *consumer) {
+	return event_ring_pending(&consumer->actx->events, consumer->event_cursor);
+}
+
+static bool consumer_pending(const SurviveSimpleEventConsumer *consumer) {
+	return event_ring_pending(&consumer->actx->events, consumer->event_cursor) ||
+		   event_ring_pending(&consumer->actx->pose_events, consumer->pose_cursor);
+}
+
 enum SurviveSimpleEventType survive_simple_wait_for_event(SurviveSimpleContext *actx, SurviveSimpleEvent *event) {
-	survive_simple_wait_for_update(actx);
+	wait_for_consumer(actx, default_consumer_pending, &actx->default_consumer);
 	return survive_simple_next_event(actx, event);
 }
 
+size_t survive_simple_get_dropped_events(SurviveSimpleContext *actx) {
+	OGLockMutex(actx->poll_mutex);
+	size_t dropped = actx->default_consumer.dropped;
+	OGUnlockMutex(actx->poll_mutex);
+	return dropped;
+}
+
+SurviveSimpleEventConsumer *survive_simple_event_consumer_create(SurviveSimpleContext *actx) {
+	SurviveSimpleEventConsumer *consumer = SV_CALLOC(sizeof(SurviveSimpleEventConsumer));
+	consumer->actx = actx;
+	consumer->event_cursor = OGAtomicLoadU64(&actx->events.head);
+	consumer->pose_cursor = OGAtomicLoadU64(&actx->pose_events.head);
+	return consumer;
+}
+
+void survive_simple_event_consumer_destroy(SurviveSimpleEventConsumer *consumer) { free(consumer); }
+
+enum SurviveSimpleEventType survive_simple_event_consumer_next(SurviveSimpleEventConsumer *consumer,
+															   SurviveSimpleEvent *event) {
+	SurviveSimpleContext *actx = consumer->actx;
+	event->event_type = SurviveSimpleEventType_None;
+
+	if (event_ring_read(&actx->events, &consumer->event_cursor, &consumer->dropped, event) ||
+		event_ring_read(&actx->pose_events, &consumer->pose_cursor, &consumer->dropped_poses, event)) {
+		return event->event_type;
+	}
+
+	if (survive_simple_is_running(actx) == false) {
+		return event->event_type = SurviveSimpleEventType_Shutdown;
+	}
+	return event->event_type;
+}
+
+enum SurviveSimpleEventType survive_simple_event_consumer_wait(SurviveSimpleEventConsumer *consumer,
+															   SurviveSimpleEvent *event) {
+	wait_for_consumer(consumer->actx, consumer_pending, consumer);
+	return survive_simple_event_consumer_next(consumer, event);
+}
+
+size_t survive_simple_event_consumer_dropped(const SurviveSimpleEventConsumer *consumer) {
+	return consumer->dropped + consumer->dropped_poses;
+}
+
 enum SurviveSimpleEventType survive_simple_next_event(SurviveSimpleContext *actx, SurviveSimpleEvent *event) {
 	event->event_type = SurviveSimpleEventType_None;
 
+	// The default consumer is shared by every caller, so its cursor is only advanced under poll_mutex
+	struct SurviveSimpleEventConsumer *consumer = &actx->default_consumer;
 	OGLockMutex(actx->poll_mutex);
-	pop_from_event_buffer(actx, event);
+	event_ring_read(&actx->events, &consumer->event_cursor, &consumer->dropped, event);
 	OGUnlockMutex(actx->poll_mutex);
 
 	if (event->event_type == SurviveSimpleEventType_None) {
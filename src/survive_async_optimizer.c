@@ -1,70 +1,246 @@
 #include "survive_async_optimizer.h"
 
-static void run_buffer(survive_async_optimizer *self, uint8_t idx) {
+// Called with the lock held. The oldest queued problem whose object doesn't already have one running.
+static survive_async_optimizer_buffer *next_job(survive_async_optimizer *self) {
+	survive_async_optimizer_buffer *rtn = 0;
+	for (size_t i = 0; i < self->buffer_cnt; i++) {
+		survive_async_optimizer_buffer *buffer = self->buffers[i];
+		if (buffer->state != survive_async_optimizer_buffer_queued || (rtn && rtn->seq < buffer->seq)) {
+			continue;
+		}
+
+		bool object_busy = false;
+		for (size_t j = 0; j < self->buffer_cnt && buffer->so; j++) {
+			object_busy |= self->buffers[j]->state == survive_async_optimizer_buffer_running &&
+						   self->buffers[j]->so == buffer->so;
+		}
+		if (!object_busy) {
+			rtn = buffer;
+		}
+	}
+	return rtn;
+}
+
+static void run_buffer(survive_async_optimizer *self, survive_async_optimizer_buffer *buffer) {
 	struct mp_result_struct results = {0};
-	self->active_buffer = idx;
+	buffer->state = survive_async_optimizer_buffer_running;
+	self->queue_depth--;
+	survive_async_optimizer_cb cb = self->cb;
 	OGUnlockMutex(self->active_buffer_lock);
-	self->completed++;
-	int status = survive_optimizer_run(&self->buffers[idx].optimizer, &results, 0);
-	if (self->cb) {
-		self->cb(&self->buffers[idx], status, &results);
+
+	int status = survive_optimizer_run(&buffer->optimizer, &results, 0);
+	if (cb) {
+		if (buffer->so) {
+			survive_get_so_lock(buffer->so);
+		}
+		cb(buffer, status, &results);
+		if (buffer->so) {
+			survive_release_so_lock(buffer->so);
+		}
 	}
+
 	OGLockMutex(self->active_buffer_lock);
-	self->buffer_ready[idx] = false;
-	self->active_buffer = -1;
+	self->completed++;
+	buffer->state = survive_async_optimizer_buffer_free;
+	// Problems for this object may have been waiting on this one
+	OGBroadcastCond(self->job_available);
+	OGBroadcastCond(self->job_done);
 }
 
 static void *async_thread(void *param) {
 	survive_async_optimizer *self = param;
 	OGLockMutex(self->active_buffer_lock);
 	while (self->cb) {
-		for (uint8_t i = 0; i < 2; i++) {
-			if (self->buffer_ready[i]) {
-				run_buffer(self, i);
-			}
+		survive_async_optimizer_buffer *buffer = next_job(self);
+		if (buffer) {
+			run_buffer(self, buffer);
+		} else {
+			OGWaitCond(self->job_available, self->active_buffer_lock);
 		}
-
-		OGWaitCond(self->job_available, self->active_buffer_lock);
 	}
 
 	OGUnlockMutex(self->active_buffer_lock);
 	return 0;
 }
 
-struct survive_async_optimizer *survive_async_optimizer_init(struct survive_async_optimizer *self,
-															 survive_async_optimizer_cb cb) {
+struct survive_async_optimizer *survive_async_optimizer_init_pool(struct survive_async_optimizer *self,
+																  survive_async_optimizer_cb cb, size_t buffer_cnt,
+																  int thread_cnt) {
 	self->cb = cb;
-	self->active_buffer = -1;
 	self->active_buffer_lock = OGCreateMutex();
 	self->job_available = OGCreateConditionVariable();
+	self->job_done = OGCreateConditionVariable();
 
-	self->async_thread = OGCreateThread(async_thread, "async optimizer", self);
+	self->buffer_cnt = buffer_cnt;
+	// A pool can start out with no shared buffers and only have per object ones added
+	self->buffers = buffer_cnt ? SV_CALLOC(sizeof(survive_async_optimizer_buffer *) * buffer_cnt) : 0;
+	for (size_t i = 0; i < buffer_cnt; i++) {
+		self->buffers[i] = SV_CALLOC(sizeof(survive_async_optimizer_buffer));
+	}
+
+	self->thread_cnt = thread_cnt;
+	self->threads = SV_CALLOC(sizeof(og_thread_t) * thread_cnt);
+	for (int i = 0; i < thread_cnt; i++) {
+		self->threads[i] = OGCreateThread(async_thread, "async optimizer", self);
+	}
 	return self;
 }
 
+struct survive_async_optimizer *survive_async_optimizer_init(struct survive_async_optimizer *self,
+															 survive_async_optimizer_cb cb) {
+	return survive_async_optimizer_init_pool(self, cb, 2, 1);
+}
+
+// Called with the lock held. One of the buffers reserved for 'owner', or a shared one if it is null; the oldest queued
+// problem among those is dropped if none are free.
+static survive_async_optimizer_buffer *alloc_buffer(survive_async_optimizer *self, const SurviveObject *owner) {
+	survive_async_optimizer_buffer *rtn = 0, *oldest_queued = 0;
+	for (size_t i = 0; i < self->buffer_cnt && rtn == 0; i++) {
+		survive_async_optimizer_buffer *buffer = self->buffers[i];
+		if (buffer->owner != owner) {
+			continue;
+		}
+		if (buffer->state == survive_async_optimizer_buffer_free) {
+			rtn = buffer;
+		} else if (buffer->state == survive_async_optimizer_buffer_queued &&
+				   (oldest_queued == 0 || buffer->seq < oldest_queued->seq)) {
+			oldest_queued = buffer;
+		}
+	}
+
+	if (rtn == 0 && oldest_queued) {
+		rtn = oldest_queued;
+		self->queue_depth--;
+		self->dropped++;
+	}
+
+	if (rtn) {
+		rtn->state = survive_async_optimizer_buffer_filling;
+		rtn->so = 0;
+	}
+	return rtn;
+}
+
 survive_async_optimizer_buffer *survive_async_optimizer_alloc_optimizer(struct survive_async_optimizer *self) {
 	OGLockMutex(self->active_buffer_lock);
-	survive_async_optimizer_buffer *rtn = 0;
-	if (self->active_buffer == 0) {
-		rtn = &self->buffers[1];
-		self->buffer_ready[1] = false;
-	} else {
-		rtn = &self->buffers[0];
-		self->buffer_ready[0] = false;
+	survive_async_optimizer_buffer *rtn = alloc_buffer(self, 0);
+	OGUnlockMutex(self->active_buffer_lock);
+	return rtn;
+}
+
+survive_async_optimizer_buffer *survive_async_optimizer_alloc_object_optimizer(struct survive_async_optimizer *self,
+																			   SurviveObject *so) {
+	OGLockMutex(self->active_buffer_lock);
+	survive_async_optimizer_buffer *rtn = alloc_buffer(self, so);
+	if (rtn) {
+		rtn->so = so;
 	}
-	self->submitted++;
 	OGUnlockMutex(self->active_buffer_lock);
 	return rtn;
 }
 
+void survive_async_optimizer_add_object(struct survive_async_optimizer *self, const SurviveObject *so,
+										size_t buffer_cnt) {
+	if (buffer_cnt == 0) {
+		return;
+	}
+
+	OGLockMutex(self->active_buffer_lock);
+	self->buffers =
+		SV_REALLOC(self->buffers, sizeof(survive_async_optimizer_buffer *) * (self->buffer_cnt + buffer_cnt));
+	for (size_t i = 0; i < buffer_cnt; i++) {
+		survive_async_optimizer_buffer *buffer = SV_CALLOC(sizeof(survive_async_optimizer_buffer));
+		buffer->owner = so;
+		self->buffers[self->buffer_cnt++] = buffer;
+	}
+	OGUnlockMutex(self->active_buffer_lock);
+}
+
 void survive_async_optimizer_run(struct survive_async_optimizer *self, survive_async_optimizer_buffer *opt) {
 	OGLockMutex(self->active_buffer_lock);
-	uint8_t idx = opt == &self->buffers[0] ? 0 : 1;
-	self->buffer_ready[idx] = true;
+	// Newest problem wins; anything still waiting for the same object is stale
+	for (size_t i = 0; i < self->buffer_cnt && opt->so; i++) {
+		survive_async_optimizer_buffer *buffer = self->buffers[i];
+		if (buffer != opt && buffer->state == survive_async_optimizer_buffer_queued && buffer->so == opt->so) {
+			buffer->state = survive_async_optimizer_buffer_free;
+			self->queue_depth--;
+			self->coalesced++;
+		}
+	}
+
+	opt->state = survive_async_optimizer_buffer_queued;
+	opt->seq = self->next_seq++;
+	self->submitted++;
+	if (++self->queue_depth > self->max_queue_depth) {
+		self->max_queue_depth = self->queue_depth;
+	}
 	OGSignalCond(self->job_available);
 	OGUnlockMutex(self->active_buffer_lock);
 }
 
+void survive_async_optimizer_cancel(struct survive_async_optimizer *self, survive_async_optimizer_buffer *opt) {
+	OGLockMutex(self->active_buffer_lock);
+	opt->state = survive_async_optimizer_buffer_free;
+	OGUnlockMutex(self->active_buffer_lock);
+}
+
+// Called with the lock held
+static bool has_pending_job(const survive_async_optimizer *self, const SurviveObject *so) {
+	for (size_t i = 0; i < self->buffer_cnt; i++) {
+		const survive_async_optimizer_buffer *buffer = self->buffers[i];
+		bool pending = buffer->state == survive_async_optimizer_buffer_queued ||
+					   buffer->state == survive_async_optimizer_buffer_running;
+		if (pending && (so == 0 || buffer->so == so)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void survive_async_optimizer_wait(struct survive_async_optimizer *self, const SurviveObject *so) {
+	OGLockMutex(self->active_buffer_lock);
+	while (has_pending_job(self, so)) {
+		OGWaitCond(self->job_done, self->active_buffer_lock);
+	}
+	OGUnlockMutex(self->active_buffer_lock);
+}
+
+static void free_buffer(survive_async_optimizer_buffer *buffer) {
+	// Problems set up in the buffer's workspace don't own their buffers
+	if (buffer->optimizer.workspace == 0) {
+		SURVIVE_OPTIMIZER_CLEANUP_HEAP_BUFFERS(buffer->optimizer);
+	}
+	survive_optimizer_workspace_free(&buffer->workspace);
+	free(buffer->user);
+	free(buffer);
+}
+
+void survive_async_optimizer_remove_object(struct survive_async_optimizer *self, const SurviveObject *so) {
+	OGLockMutex(self->active_buffer_lock);
+	for (size_t i = 0; i < self->buffer_cnt; i++) {
+		survive_async_optimizer_buffer *buffer = self->buffers[i];
+		if (buffer->so == so && buffer->state == survive_async_optimizer_buffer_queued) {
+			buffer->state = survive_async_optimizer_buffer_free;
+			self->queue_depth--;
+		}
+	}
+	while (has_pending_job(self, so)) {
+		OGWaitCond(self->job_done, self->active_buffer_lock);
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < self->buffer_cnt; i++) {
+		survive_async_optimizer_buffer *buffer = self->buffers[i];
+		if (buffer->owner == so) {
+			free_buffer(buffer);
+		} else {
+			self->buffers[kept++] = buffer;
+		}
+	}
+	self->buffer_cnt = kept;
+	OGUnlockMutex(self->active_buffer_lock);
+}
+
 void survive_async_free(struct survive_async_optimizer *self) {
 	if (self == 0) {
 		return;
@@ -72,18 +248,22 @@ void survive_async_free(struct survive_async_optimizer *self) {
 
 	OGLockMutex(self->active_buffer_lock);
 	self->cb = 0;
-	OGSignalCond(self->job_available);
+	OGBroadcastCond(self->job_available);
 	OGUnlockMutex(self->active_buffer_lock);
 
-	OGJoinThread(self->async_thread);
+	for (int i = 0; i < self->thread_cnt; i++) {
+		OGJoinThread(self->threads[i]);
+	}
 
 	OGDeleteConditionVariable(self->job_available);
+	OGDeleteConditionVariable(self->job_done);
 	OGDeleteMutex(self->active_buffer_lock);
 
-	for (int i = 0; i < 2; i++) {
-		SURVIVE_OPTIMIZER_CLEANUP_HEAP_BUFFERS(self->buffers[i].optimizer);
-		free(self->buffers[i].user);
+	for (size_t i = 0; i < self->buffer_cnt; i++) {
+		free_buffer(self->buffers[i]);
 	}
 
+	free(self->buffers);
+	free(self->threads);
 	free(self);
 }
@@ -3,9 +3,29 @@
 #include <survive_optimizer.h>
 #include <survive_types.h>
 
+enum survive_async_optimizer_buffer_state {
+	survive_async_optimizer_buffer_free,
+	// Handed out by survive_async_optimizer_alloc_optimizer, not submitted yet
+	survive_async_optimizer_buffer_filling,
+	survive_async_optimizer_buffer_queued,
+	survive_async_optimizer_buffer_running,
+};
+
 typedef struct survive_async_optimizer_buffer {
 	survive_optimizer optimizer;
 	void *user;
+
+	// Object the problem is for. A queued problem is dropped when a newer one for the same object is submitted, and
+	// the completion callback runs holding this object's lock. Can be null.
+	SurviveObject *so;
+	// Object this buffer is reserved for by survive_async_optimizer_add_object; null for the shared buffers
+	const SurviveObject *owner;
+
+	// Memory for problems set up with SURVIVE_OPTIMIZER_SETUP_WORKSPACE_BUFFERS; lives as long as the pool does
+	survive_optimizer_workspace workspace;
+
+	enum survive_async_optimizer_buffer_state state;
+	uint64_t seq;
 } survive_async_optimizer_buffer;
 
 typedef void (*survive_async_optimizer_cb)(struct survive_async_optimizer_buffer *buffer, int return_code,
@@ -15,24 +35,74 @@ typedef struct survive_async_optimizer {
 	survive_async_optimizer_cb cb;
 	void *user;
 
-	og_thread_t async_thread;
+	og_thread_t *threads;
+	int thread_cnt;
 
-	int8_t active_buffer;
-	bool buffer_ready[2];
-	struct survive_async_optimizer_buffer buffers[2];
+	// Allocated one at a time so running problems keep their buffer while objects come and go
+	struct survive_async_optimizer_buffer **buffers;
+	size_t buffer_cnt;
 	og_mutex_t active_buffer_lock;
 
 	og_cv_t job_available;
+	// Broadcast every time a problem finishes running
+	og_cv_t job_done;
+	uint64_t next_seq;
 
 	size_t submitted;
 	size_t completed;
+	// Queued problems replaced by a newer one for the same object
+	size_t coalesced;
+	// Queued problems taken back to hand out because every buffer was in use
+	size_t dropped;
+	size_t queue_depth, max_queue_depth;
 } survive_async_optimizer;
 
+/**
+ * Two buffers and one worker thread; a submission replaces whatever is still waiting.
+ */
 SURVIVE_EXPORT struct survive_async_optimizer *survive_async_optimizer_init(struct survive_async_optimizer *self,
 																			survive_async_optimizer_cb cb);
+/**
+ * buffer_cnt problems in flight across thread_cnt worker threads. Problems for different objects run in parallel;
+ * problems for the same object run in submission order, and only the newest waiting one is kept.
+ */
+SURVIVE_EXPORT struct survive_async_optimizer *survive_async_optimizer_init_pool(struct survive_async_optimizer *self,
+																				 survive_async_optimizer_cb cb,
+																				 size_t buffer_cnt, int thread_cnt);
+// Waits for running problems to finish, so it can't be called holding the lock of an object that has one
 SURVIVE_EXPORT void survive_async_free(struct survive_async_optimizer *optimizer);
 
+/**
+ * Returns a shared buffer to set up a problem in. If none are free, the oldest queued problem is dropped to make room.
+ * Returns null if every buffer is running or being filled.
+ */
 SURVIVE_EXPORT survive_async_optimizer_buffer *
 survive_async_optimizer_alloc_optimizer(struct survive_async_optimizer *optimizer);
+/**
+ * Reserves buffer_cnt buffers for 'so' alone, so objects that solve often can't starve the others. They are handed
+ * out by survive_async_optimizer_alloc_object_optimizer.
+ */
+SURVIVE_EXPORT void survive_async_optimizer_add_object(struct survive_async_optimizer *optimizer,
+													   const SurviveObject *so, size_t buffer_cnt);
+/**
+ * Like survive_async_optimizer_alloc_optimizer, but from the buffers reserved for 'so', and only ever drops one of its
+ * own queued problems. The buffer comes back with so set.
+ */
+SURVIVE_EXPORT survive_async_optimizer_buffer *
+survive_async_optimizer_alloc_object_optimizer(struct survive_async_optimizer *optimizer, SurviveObject *so);
+/**
+ * Drops anything queued for 'so', waits for what is running, and frees the buffers reserved for it. The user pointers
+ * of those buffers are freed with them. Same locking rules as survive_async_optimizer_wait.
+ */
+SURVIVE_EXPORT void survive_async_optimizer_remove_object(struct survive_async_optimizer *optimizer,
+														  const SurviveObject *so);
 SURVIVE_EXPORT void survive_async_optimizer_run(struct survive_async_optimizer *optimizer,
 												survive_async_optimizer_buffer *);
+// Hands back a buffer from survive_async_optimizer_alloc_optimizer without running it
+SURVIVE_EXPORT void survive_async_optimizer_cancel(struct survive_async_optimizer *optimizer,
+												   survive_async_optimizer_buffer *);
+/**
+ * Blocks until nothing is queued or running for 'so', or for any object if it is null. Like survive_async_free, it
+ * can't be called holding the lock of an object that has a problem running.
+ */
+SURVIVE_EXPORT void survive_async_optimizer_wait(struct survive_async_optimizer *optimizer, const SurviveObject *so);
@@ -1,8 +1,10 @@
 #include "survive_default_devices.h"
 #include "assert.h"
 #include "json_helpers.h"
+#include "os_generic.h"
 #include "survive_internal.h"
 #include "survive_kalman_tracker.h"
+#include "survive_private.h"
 #include <jsmn.h>
 #include <math.h>
 #include <stdio.h>
@@ -62,6 +64,12 @@ SurviveObject *survive_create_device(SurviveContext *ctx, const char *driver_nam
 
 	SurviveSensorActivations_ctor(device, &device->activations);
 
+	// Contexts put together by hand, like the tests', have no private members
+	struct SurviveContext_private *pctx = ctx->private_members;
+	if (pctx && pctx->object_locks) {
+		device->object_lock = OGCreateMutex();
+	}
+
 	FLT playback_factor = survive_configf(ctx, "playback-factor", SC_GET, 1.);
 	bool use_async_posers = survive_configi(ctx, "threaded-posers", SC_GET, 1) && playback_factor != 0;
 	if (use_async_posers) {
@@ -667,6 +675,11 @@ void survive_destroy_device(SurviveObject *so) {
 		ctx->objs_ct--;
 	}
 
+	// The ctx lock is held here already; the object lock keeps any in flight threaded poser out while we tear down
+	if (so->object_lock) {
+		OGLockMutex(so->object_lock);
+	}
+
 	PoserData pd;
 	pd.pt = POSERDATA_DISASSOCIATE;
 	if (ctx->PoserFn) {
@@ -698,6 +711,12 @@ void survive_destroy_device(SurviveObject *so) {
 	survive_kalman_tracker_free(so->tracker);
 	SurviveSensorActivations_dtor(so);
 	free(so->tracker);
+
+	if (so->object_lock) {
+		OGUnlockMutex(so->object_lock);
+		OGDeleteMutex(so->object_lock);
+	}
+
 	free(so->sensor_locations);
 	free(so->sensor_normals);
 	free(so->conf);
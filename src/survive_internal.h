@@ -10,6 +10,12 @@
 #include <survive.h>
 
 
+#ifdef _MSC_VER
+#define SURVIVE_THREAD_LOCAL __declspec(thread)
+#else
+#define SURVIVE_THREAD_LOCAL __thread
+#endif
+
 //Driver registration
 #define MAX_DRIVERS 32
 
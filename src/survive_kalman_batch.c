@@ -0,0 +1,162 @@
+#include "survive_kalman_batch.h"
+
+#include "force_O3.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#if defined(__x86_64__) || defined(__i386__)
+#define SURVIVE_KALMAN_BATCH_AVX2 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define SURVIVE_KALMAN_BATCH_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
+// The vector paths hold four double precision lanes
+#if !defined(CN_USE_FLOAT)
+#define SURVIVE_KALMAN_BATCH_SIMD 1
+#endif
+
+#define LANES SURVIVE_KALMAN_BATCH_LANES
+#define IDX(n, i, j) SURVIVE_KALMAN_BATCH_INDEX(n, i, j, 0)
+
+void survive_kalman_batch_pack(size_t n, size_t lane, FLT *batch, const FLT *src) {
+	for (size_t i = 0; i < n * n; i++) {
+		batch[i * LANES + lane] = src[i];
+	}
+}
+
+void survive_kalman_batch_unpack(size_t n, size_t lane, FLT *dst, const FLT *batch) {
+	for (size_t i = 0; i < n * n; i++) {
+		dst[i] = batch[i * LANES + lane];
+	}
+}
+
+static inline void mirror_upper(size_t n, FLT *P) {
+	for (size_t i = 1; i < n; i++) {
+		for (size_t j = 0; j < i; j++) {
+			for (size_t l = 0; l < LANES; l++) {
+				P[IDX(n, i, j) + l] = P[IDX(n, j, i) + l];
+			}
+		}
+	}
+}
+
+/*
+ * Every path sums in the same order and without fused multiply adds, so they all give bit identical results.
+ */
+static void propagate_scalar(size_t n, FLT *P, const FLT *F, const FLT *Q, FLT *FP) {
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < n; j++) {
+			FLT acc[LANES] = {0};
+			for (size_t k = 0; k < n; k++) {
+				for (size_t l = 0; l < LANES; l++) {
+					acc[l] += F[IDX(n, i, k) + l] * P[IDX(n, k, j) + l];
+				}
+			}
+			for (size_t l = 0; l < LANES; l++) {
+				FP[IDX(n, i, j) + l] = acc[l];
+			}
+		}
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = i; j < n; j++) {
+			FLT acc[LANES] = {0};
+			for (size_t k = 0; k < n; k++) {
+				for (size_t l = 0; l < LANES; l++) {
+					acc[l] += FP[IDX(n, i, k) + l] * F[IDX(n, j, k) + l];
+				}
+			}
+			for (size_t l = 0; l < LANES; l++) {
+				P[IDX(n, i, j) + l] = acc[l] + Q[IDX(n, i, j) + l];
+			}
+		}
+	}
+	mirror_upper(n, P);
+}
+
+#if defined(SURVIVE_KALMAN_BATCH_SIMD) && defined(SURVIVE_KALMAN_BATCH_AVX2)
+// Built for AVX2 regardless of the compiler flags; only called after checking the CPU supports it
+#define AVX2_FN __attribute__((target("avx2")))
+
+AVX2_FN static void propagate_avx2(size_t n, FLT *P, const FLT *F, const FLT *Q, FLT *FP) {
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < n; j++) {
+			__m256d acc = _mm256_setzero_pd();
+			for (size_t k = 0; k < n; k++) {
+				acc = _mm256_add_pd(acc,
+									_mm256_mul_pd(_mm256_loadu_pd(F + IDX(n, i, k)), _mm256_loadu_pd(P + IDX(n, k, j))));
+			}
+			_mm256_storeu_pd(FP + IDX(n, i, j), acc);
+		}
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = i; j < n; j++) {
+			__m256d acc = _mm256_setzero_pd();
+			for (size_t k = 0; k < n; k++) {
+				acc = _mm256_add_pd(acc,
+									_mm256_mul_pd(_mm256_loadu_pd(FP + IDX(n, i, k)), _mm256_loadu_pd(F + IDX(n, j, k))));
+			}
+			_mm256_storeu_pd(P + IDX(n, i, j), _mm256_add_pd(acc, _mm256_loadu_pd(Q + IDX(n, i, j))));
+		}
+	}
+	mirror_upper(n, P);
+}
+
+static bool has_avx2(void) {
+	static int supported = -1;
+	if (supported == -1) {
+		__builtin_cpu_init();
+		supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+	}
+	return supported;
+}
+#endif
+
+#if defined(SURVIVE_KALMAN_BATCH_SIMD) && defined(SURVIVE_KALMAN_BATCH_NEON)
+// Two registers per element; lanes 0-1 and 2-3
+static void propagate_neon(size_t n, FLT *P, const FLT *F, const FLT *Q, FLT *FP) {
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < n; j++) {
+			float64x2_t lo = vdupq_n_f64(0), hi = vdupq_n_f64(0);
+			for (size_t k = 0; k < n; k++) {
+				const FLT *f = F + IDX(n, i, k), *p = P + IDX(n, k, j);
+				lo = vaddq_f64(lo, vmulq_f64(vld1q_f64(f), vld1q_f64(p)));
+				hi = vaddq_f64(hi, vmulq_f64(vld1q_f64(f + 2), vld1q_f64(p + 2)));
+			}
+			vst1q_f64(FP + IDX(n, i, j), lo);
+			vst1q_f64(FP + IDX(n, i, j) + 2, hi);
+		}
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = i; j < n; j++) {
+			float64x2_t lo = vdupq_n_f64(0), hi = vdupq_n_f64(0);
+			for (size_t k = 0; k < n; k++) {
+				const FLT *fp = FP + IDX(n, i, k), *f = F + IDX(n, j, k);
+				lo = vaddq_f64(lo, vmulq_f64(vld1q_f64(fp), vld1q_f64(f)));
+				hi = vaddq_f64(hi, vmulq_f64(vld1q_f64(fp + 2), vld1q_f64(f + 2)));
+			}
+			const FLT *q = Q + IDX(n, i, j);
+			vst1q_f64(P + IDX(n, i, j), vaddq_f64(lo, vld1q_f64(q)));
+			vst1q_f64(P + IDX(n, i, j) + 2, vaddq_f64(hi, vld1q_f64(q + 2)));
+		}
+	}
+	mirror_upper(n, P);
+}
+#endif
+
+void survive_kalman_batch_propagate(size_t n, FLT *P, const FLT *F, const FLT *Q, FLT *scratch) {
+#if defined(SURVIVE_KALMAN_BATCH_SIMD) && defined(SURVIVE_KALMAN_BATCH_AVX2)
+	if (has_avx2()) {
+		propagate_avx2(n, P, F, Q, scratch);
+		return;
+	}
+#elif defined(SURVIVE_KALMAN_BATCH_SIMD) && defined(SURVIVE_KALMAN_BATCH_NEON)
+	propagate_neon(n, P, F, Q, scratch);
+	return;
+#endif
+	propagate_scalar(n, P, F, Q, scratch);
+}
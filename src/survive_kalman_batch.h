@@ -0,0 +1,33 @@
+#pragma once
+
+#include "survive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Covariance propagation for several filters at once. The matrices of up to SURVIVE_KALMAN_BATCH_LANES filters with
+ * the same state size are interleaved so that one vector register holds the same element of every filter; element
+ * (i, j) of lane l of an n x n batch is at SURVIVE_KALMAN_BATCH_INDEX(n, i, j, l). A batch matrix takes
+ * SURVIVE_KALMAN_BATCH_SIZE(n) FLTs.
+ */
+#define SURVIVE_KALMAN_BATCH_LANES 4
+#define SURVIVE_KALMAN_BATCH_INDEX(n, i, j, lane) ((((i) * (n)) + (j)) * SURVIVE_KALMAN_BATCH_LANES + (lane))
+#define SURVIVE_KALMAN_BATCH_SIZE(n) ((n) * (n)*SURVIVE_KALMAN_BATCH_LANES)
+
+// Copies the row major n x n matrix src into / out of one lane of a batch matrix
+SURVIVE_EXPORT void survive_kalman_batch_pack(size_t n, size_t lane, FLT *batch, const FLT *src);
+SURVIVE_EXPORT void survive_kalman_batch_unpack(size_t n, size_t lane, FLT *dst, const FLT *batch);
+
+/**
+ * P = F * P * F^T + Q in every lane. Only the upper triangle of the result is computed; it is mirrored into the lower
+ * one. Lanes nobody packed are computed on whatever they hold, so zero them if that might not be finite.
+ *
+ * @param scratch SURVIVE_KALMAN_BATCH_SIZE(n) FLTs
+ */
+SURVIVE_EXPORT void survive_kalman_batch_propagate(size_t n, FLT *P, const FLT *F, const FLT *Q, FLT *scratch);
+
+#ifdef __cplusplus
+}
+#endif
@@ -19,11 +19,21 @@
 #include "generated/lighthouse_model.gen.h"
 
 #include "generated/survive_reproject.aux.generated.h"
+#include "survive_kalman_batch.h"
 #include "survive_kalman_lighthouses.h"
+#include "survive_latency.h"
+#include "survive_private.h"
 #include "survive_recording.h"
+#include "survive_reproject_batch.h"
 
 #define SURVIVE_MODEL_MAX_STATE_CNT (sizeof(SurviveKalmanModel) / sizeof(FLT))
 
+STATIC_CONFIG_ITEM(KALMAN_IMU_BATCH, "kalman-imu-batch", 'i',
+				   "Objects whose IMU samples are integrated together; a sample waits at most until the next one from the "
+				   "same object. The batch is shared by every object, so it is disabled when 'object-locks' or "
+				   "'pipeline' are on.",
+				   0)
+
 // clang-format off
 STRUCT_CONFIG_SECTION(SurviveKalmanTracker)
 	STRUCT_CONFIG_ITEM("light-error-threshold",  "Error limit to invalidate position",
@@ -91,6 +101,18 @@ STRUCT_CONFIG_SECTION(SurviveKalmanTracker)
 	STRUCT_CONFIG_ITEM("imu-gyro-variance", "Variance of gyroscope", 0.0000304617, t->gyro_var)
 
 	STRUCT_CONFIG_ITEM("light-batch-size", "", 32, t->light_batchsize)
+	STRUCT_CONFIG_ITEM("light-float32",
+					   "Residual-only option: evaluate light h(x) in float32 on the calls that don't ask for a jacobian. "
+					   "The analytic light update and the IMU model stay in FLT, so the per-measurement update is "
+					   "unchanged. Ignored with a numeric light jacobian step.",
+					   0, t->light_float32)
+	STRUCT_CONFIG_ITEM("kalman-oosm-history",
+					   "Measurements kept to re-run the filter when late data arrives. Every measurement checkpoints "
+					   "the filter's state and covariance, so this costs a copy per IMU sample; 0 drops late data.",
+					   0, t->history_length)
+	STRUCT_CONFIG_ITEM("kalman-imu-rate",
+					   "Rate in hz to preintegrate IMU samples down to between light updates; 0 uses every sample", 0,
+					   t->imu_rate)
 END_STRUCT_CONFIG_SECTION(SurviveKalmanTracker)
 
 // clang-format off
@@ -191,6 +213,76 @@ static void normalize_model(SurviveKalmanTracker *pTracker) {
 	}
 }
 
+static inline SurviveKalmanTrackerHistoryEntry *history_at(SurviveKalmanTracker *tracker, size_t i) {
+	return &tracker->history.entries[(tracker->history.start + i) % tracker->history.capacity];
+}
+
+// Covariances are stored by slot, so they don't move when entries shift to make room for a late one
+static inline FLT *history_P(SurviveKalmanTracker *tracker, size_t i) {
+	size_t slot = (tracker->history.start + i) % tracker->history.capacity;
+	return tracker->history.P + slot * tracker->history.P_stride;
+}
+
+static void history_checkpoint(SurviveKalmanTracker *tracker, size_t i) {
+	SurviveKalmanTrackerHistoryEntry *entry = history_at(tracker, i);
+	entry->state = tracker->state;
+	entry->model_t = tracker->model.t;
+	entry->imu_bias_t = tracker->imu_bias_model.t;
+	entry->last_light_time = tracker->last_light_time;
+
+	FLT *P = history_P(tracker, i);
+	CnMat model_P = cnMat(tracker->model.P.rows, tracker->model.P.cols, P);
+	cnCopy(&tracker->model.P, &model_P, 0);
+	if (tracker->imu_bias_model.P.rows > 0) {
+		CnMat imu_bias_P = cnMat(tracker->imu_bias_model.P.rows, tracker->imu_bias_model.P.cols,
+								 P + model_P.rows * model_P.cols);
+		cnCopy(&tracker->imu_bias_model.P, &imu_bias_P, 0);
+	}
+}
+
+static void history_restore(SurviveKalmanTracker *tracker, size_t i) {
+	const SurviveKalmanTrackerHistoryEntry *entry = history_at(tracker, i);
+	tracker->state = entry->state;
+	tracker->model.t = entry->model_t;
+	tracker->imu_bias_model.t = entry->imu_bias_t;
+	tracker->last_light_time = entry->last_light_time;
+
+	FLT *P = history_P(tracker, i);
+	CnMat model_P = cnMat(tracker->model.P.rows, tracker->model.P.cols, P);
+	cnCopy(&model_P, &tracker->model.P, 0);
+	if (tracker->imu_bias_model.P.rows > 0) {
+		CnMat imu_bias_P = cnMat(tracker->imu_bias_model.P.rows, tracker->imu_bias_model.P.cols,
+								 P + model_P.rows * model_P.cols);
+		cnCopy(&imu_bias_P, &tracker->imu_bias_model.P, 0);
+	}
+}
+
+/*
+ * Checkpoints the filter and returns the entry to fill in with the measurement about to be applied. Returns null when
+ * there is no history, or when the measurement is itself being re-run.
+ */
+static SurviveKalmanTrackerHistoryEntry *history_push(SurviveKalmanTracker *tracker,
+													  enum survive_kalman_tracker_history_type type, FLT time) {
+	if (tracker->history.entries == 0 || tracker->history.replaying) {
+		return 0;
+	}
+
+	if (tracker->history.cnt == tracker->history.capacity - 1) {
+		tracker->history.start = (tracker->history.start + 1) % tracker->history.capacity;
+		tracker->history.cnt--;
+	}
+
+	size_t i = tracker->history.cnt++;
+	history_checkpoint(tracker, i);
+	SurviveKalmanTrackerHistoryEntry *entry = history_at(tracker, i);
+	entry->type = type;
+	entry->time = time;
+	return entry;
+}
+
+static bool history_insert(SurviveKalmanTracker *tracker, const SurviveKalmanTrackerHistoryEntry *late);
+static void flush_queued_imu(SurviveKalmanTracker *tracker);
+
 struct map_light_data_ctx {
 	SurviveKalmanTracker *tracker;
 };
@@ -291,6 +383,91 @@ static bool map_joint_light_data(void *user, const struct CnMat *Z, const struct
  * and uses that measurement to compare from the actual observed angle. These functions have jacobian functions that
  * correspond to them; see @survive_reproject.c and @survive_reproject_gen2.c
  */
+static void light_hx_batch_flush(const survive_reproject_model_t *mdl, bool f32, const BaseStationCal *cal, int axis,
+								 const FLT *xs, const FLT *ys, const FLT *zs, const int *rows, size_t n, FLT *h_x) {
+	if (f32) {
+		float x[SURVIVE_REPROJECT_BATCH_CHUNK], y[SURVIVE_REPROJECT_BATCH_CHUNK], z[SURVIVE_REPROJECT_BATCH_CHUNK];
+		float out[SURVIVE_REPROJECT_BATCH_CHUNK];
+		for (size_t j = 0; j < n; j++) {
+			x[j] = xs[j], y[j] = ys[j], z[j] = zs[j];
+		}
+		mdl->reprojectAxisBatchF32Fn[axis](cal, x, y, z, out, n);
+		for (size_t j = 0; j < n; j++) {
+			h_x[rows[j]] = out[j];
+		}
+		return;
+	}
+
+	FLT out[SURVIVE_REPROJECT_BATCH_CHUNK];
+	mdl->reprojectAxisBatchFn[axis](cal, xs, ys, zs, out, n);
+	for (size_t j = 0; j < n; j++) {
+		h_x[rows[j]] = out[j];
+	}
+}
+
+/*
+ * h(x) for every light measurement being integrated, using the model's batch reprojection grouped by lighthouse and
+ * axis. Matches the generated LightMeas functions for dt = 0, which is all map_light_data uses. This only serves
+ * h(x)-only calls -- finite difference jacobians and residual checks; the analytic H_k still comes from the generated
+ * per-point functions.
+ *
+ * That is also where light-float32 stops. The analytic update gets h(x) from the same generated call as its jacobian
+ * row, which shares the subexpressions, so a separate float32 h(x) would only add work. The IMU model isn't converted
+ * either: its h(x) is two rotations for a single six row measurement, with no run of points to spread over float32
+ * lanes, and its cost is in the jacobian and the covariance update, not in evaluating h(x).
+ */
+static void light_hx_batch(const SurviveKalmanTracker *tracker, const SurvivePose *obj2world, int cnt, FLT *h_x) {
+	SurviveObject *so = tracker->so;
+	struct SurviveContext *ctx = so->ctx;
+	const survive_reproject_model_t *mdl = survive_reproject_model(ctx);
+	// Finite differences of a float32 h(x) would be mostly rounding, so only use it with analytic jacobians
+	bool f32 = tracker->light_float32 && tracker->lightcap_model.numeric_step_size <= 0 &&
+			   mdl->reprojectAxisBatchF32Fn[0] && mdl->reprojectAxisBatchF32Fn[1];
+
+	FLT xs[SURVIVE_REPROJECT_BATCH_CHUNK], ys[SURVIVE_REPROJECT_BATCH_CHUNK], zs[SURVIVE_REPROJECT_BATCH_CHUNK];
+	int rows[SURVIVE_REPROJECT_BATCH_CHUNK];
+
+	for (int lh = 0; lh < NUM_GEN2_LIGHTHOUSES; lh++) {
+		bool has_world2lh = false;
+		SurvivePose world2lh;
+		const BaseStationCal *cal = survive_basestation_cal(ctx, lh, 0);
+
+		for (int axis = 0; axis < 2; axis++) {
+			size_t n = 0;
+			for (int i = 0; i < cnt; i++) {
+				const LightInfo *info = &tracker->savedLight[tracker->savedLight_idx + i];
+				if (info->lh != lh || info->axis != axis) {
+					continue;
+				}
+
+				if (!has_world2lh) {
+					SurvivePose lh2world = survive_copy_lighthouse_position(ctx, lh);
+					world2lh = InvertPoseRtn(&lh2world);
+					has_world2lh = true;
+				}
+
+				LinmathPoint3d ptInObj, ptInWorld, ptInLh;
+				gen_scale_sensor_pt(ptInObj, &so->sensor_locations[info->sensor_idx * 3], &so->imu2trackref,
+									so->sensor_scale);
+				ApplyPoseToPoint(ptInWorld, obj2world, ptInObj);
+				ApplyPoseToPoint(ptInLh, &world2lh, ptInWorld);
+
+				xs[n] = ptInLh[0];
+				ys[n] = ptInLh[1];
+				zs[n] = ptInLh[2];
+				rows[n++] = i;
+				if (n == SURVIVE_REPROJECT_BATCH_CHUNK) {
+					light_hx_batch_flush(mdl, f32, cal, axis, xs, ys, zs, rows, n, h_x);
+					n = 0;
+				}
+			}
+			if (n) {
+				light_hx_batch_flush(mdl, f32, cal, axis, xs, ys, zs, rows, n, h_x);
+			}
+		}
+	}
+}
+
 static bool map_light_data(void *user, const struct CnMat *Z, const struct CnMat *x_t, struct CnMat *y,
 						   struct CnMat *H_k) {
 	struct map_light_data_ctx *cbctx = (struct map_light_data_ctx *)user;
@@ -311,13 +488,45 @@ static bool map_light_data(void *user, const struct CnMat *Z, const struct CnMat
 
 	CN_CREATE_STACK_VEC(h_x, 1);
 	FLT *Y = cn_as_vector(y);
+
+	// Without the jacobian only h(x) is needed, which the batch reprojection does a run at a time. This is the path
+	// numeric light jacobians take once per state column; analytic updates fall through to the per-point code below.
+	if (H_k == 0 && y && mdl->reprojectAxisBatchFn[0] && mdl->reprojectAxisBatchFn[1]) {
+		FLT *h_xs = alloca(sizeof(FLT) * Z->rows);
+		// The generated functions use the state's rotation as is, so don't use the normalized pose
+		light_hx_batch(tracker, (const SurvivePose *)cn_as_const_vector(x_t), Z->rows, h_xs);
+
+		for (int i = 0; i < Z->rows; i++) {
+			const LightInfo *info = &tracker->savedLight[tracker->savedLight_idx + i];
+			assert(ctx->bsd[info->lh].PositionSet);
+
+			Y[i] = cn_as_const_vector(Z)[i] - h_xs[i];
+			if (tracker->lightcap_max_error > 0) {
+				Y[i] = linmath_enforce_range(Y[i], -tracker->lightcap_max_error, tracker->lightcap_max_error);
+			}
+			SV_DATA_LOG("h_light[%d][%d][%d]", &h_xs[i], 1, info->lh, info->axis, info->sensor_idx);
+			SV_DATA_LOG("Y_light[%d][%d][%d]", &Y[i], 1, info->lh, info->axis, info->sensor_idx);
+			SV_DATA_LOG("Z_light[%d][%d][%d]", &info->value, 1, info->lh, info->axis, info->sensor_idx);
+		}
+
+		survive_recording_write_matrix(tracker->so->ctx->recptr, tracker->so, 100, "light-y", y);
+		return true;
+	}
+
+	// Measurements come in runs per lighthouse, so the locked copy of its pose is only refreshed when that changes
+	int world2lh_idx = -1;
+	SurvivePose world2lh;
 	for (int i = 0; i < Z->rows; i++) {
 		const LightInfo *info = &tracker->savedLight[tracker->savedLight_idx + i];
 		int axis = info->axis;
 
 		assert(ctx->bsd[info->lh].PositionSet);
 
-		const SurvivePose world2lh = InvertPoseRtn(survive_get_lighthouse_position(ctx, info->lh));
+		if (world2lh_idx != info->lh) {
+			SurvivePose lh2world = survive_copy_lighthouse_position(ctx, info->lh);
+			world2lh = InvertPoseRtn(&lh2world);
+			world2lh_idx = info->lh;
+		}
 
 		const FLT *pt = &so->sensor_locations[info->sensor_idx * 3];
         SurvivePose imu2trackref = so->imu2trackref;
@@ -371,6 +580,7 @@ int sort_by_lh_axis_sensor(const void * _info1, const void * _info2) {
 
 void survive_kalman_tracker_integrate_saved_light(SurviveKalmanTracker *tracker, PoserData *pd) {
 	SurviveContext *ctx = tracker->so->ctx;
+	flush_queued_imu(tracker);
 	FLT time = pd->timecode / (FLT)tracker->so->timebase_hz;
 	if (tracker->use_raw_obs) {
 		return;
@@ -400,7 +610,16 @@ void survive_kalman_tracker_integrate_saved_light(SurviveKalmanTracker *tracker,
             return;
         }
 
-		bool useJointModel = tracker->joint_lightcap_ratio >= 0;
+		SurviveKalmanTrackerHistoryEntry *entry =
+			history_push(tracker, survive_kalman_tracker_history_light, linmath_max(time, tracker->model.t));
+		if (entry) {
+			entry->light.hdr = *pd;
+			entry->light.cnt = tracker->savedLight_idx;
+			memcpy(entry->light.light, tracker->savedLight, sizeof(LightInfo) * tracker->savedLight_idx);
+		}
+
+		// Lighthouse states aren't part of the history, so a replay can't re-run a joint update into them
+		bool useJointModel = tracker->joint_lightcap_ratio >= 0 && !tracker->history.replaying;
 		if(useJointModel) {
 			qsort(tracker->savedLight, tracker->savedLight_idx, sizeof(tracker->savedLight[0]), sort_by_lh_axis_sensor);
 		}
@@ -463,11 +682,14 @@ void survive_kalman_tracker_integrate_saved_light(SurviveKalmanTracker *tracker,
 			tracker->last_light_time = time;
 
 			if(useJointModel && tracker->joint_lightcap_ratio < ratio) {
+				// The joint model updates the lighthouse's filter too, which other objects share
+				survive_get_bsd_lock(ctx);
 				tracker->joint_model.ks[0] = &ctx->bsd[lh].tracker->model;
 				tracker->joint_model.ks[1] = &ctx->bsd[lh].tracker->bsd_model;
 				rtn += cnkalman_meas_model_predict_update(time, &tracker->joint_model, &cbctx, &Z, &R);
 				tracker->stats.joint_model_sensor_cnt_sum += cnt;
 				survive_kalman_lighthouse_report(ctx->bsd[lh].tracker);
+				survive_release_bsd_lock(ctx);
 			} else {
 				rtn += cnkalman_meas_model_predict_update(time, &tracker->lightcap_model, &cbctx, &Z, &R);
 				tracker->stats.lightcap_model_sensor_cnt_sum += cnt;
@@ -764,51 +986,26 @@ static FLT integrate_pose(SurviveKalmanTracker *tracker, FLT time, const Survive
 	return rtn;
 }
 
-void survive_kalman_tracker_integrate_imu(SurviveKalmanTracker *tracker, PoserDataIMU *data) {
+// sample_cnt is how many raw samples data averages; their noise averages out so the variances shrink to match
+static void integrate_imu(SurviveKalmanTracker *tracker, const PoserDataIMU *data, uint32_t sample_cnt, FLT time) {
 	SurviveContext *ctx = tracker->so->ctx;
 	SurviveObject *so = tracker->so;
 
-	FLT time = data->hdr.timecode / (FLT)tracker->so->timebase_hz;
-	FLT time_diff = time - tracker->model.t;
-
 	FLT norm = norm3d(data->accel);
-	SV_DATA_LOG("acc_norm", &norm, 1);
-
 	bool isStationary = SurviveSensorActivations_stationary_time(&tracker->so->activations) > 4800000;
 
-	if (tracker->use_raw_obs) {
-		return;
-	}
-
-	// Wait til observation is in before reading IMU; gets rid of bad IMU data at the start
-	if (tracker->model.t == 0) {
-		return;
-	}
-
-	if (tracker->stats.obs_count < 16 && tracker->obs_pos_var > -1) {
-		return;
-	}
-
-	if (time_diff < -.01) {
-		// SV_WARN("Processing imu data from the past %fs", time - tracker->rot.t);
-		tracker->stats.late_imu_dropped++;
-		return;
-	}
-
-	if (time_diff > 0.5) {
-		SV_WARN("%s is probably dropping IMU packets; %f time reported between %" PRIu64, tracker->so->codename,
-				time_diff, data->hdr.timecode);
-	}
-
 	FLT rotation_variance[] = {1e5, 1e5, 1e5, 1e5, 1e5, 1e5};
 
 	bool no_light = (time - tracker->last_light_time) > tracker->zvu_no_light_time;
 	FLT zvu_var = tracker->zvu_moving_var;
 	if(isStationary && tracker->zvu_stationary_var >= 0) zvu_var = linmath_min(tracker->zvu_stationary_var, zvu_var < 0 ? INFINITY : zvu_var);
 	if(no_light && tracker->zvu_no_light_var >= 0) zvu_var = linmath_min(tracker->zvu_no_light_var, zvu_var < 0 ? INFINITY : zvu_var);
+	if (zvu_var >= 0) {
+		zvu_var /= sample_cnt;
+	}
 
 	bool disable_ang_vel = no_light && !isStationary;
-	tracker->stats.no_light_imu_count += no_light;
+	tracker->stats.no_light_imu_count += no_light * sample_cnt;
 
 	if (zvu_var >= 0) {//time - tracker->last_light_time > .1) {//|| isStationary || fabs(1 - norm) < .001 ) {
 		// If we stop seeing light data; tank all velocity / acceleration measurements
@@ -869,6 +1066,10 @@ void survive_kalman_tracker_integrate_imu(SurviveKalmanTracker *tracker, PoserDa
 			rotation_variance[3 + i] = tracker->gyro_var;
 	}
 
+	for (int i = 0; i < 6; i++) {
+		rotation_variance[i] /= sample_cnt;
+	}
+
 	if (fn_ctx.use_gyro || fn_ctx.use_accel) {
 		int rows = 6;
 		int offset = 0;
@@ -885,21 +1086,32 @@ void survive_kalman_tracker_integrate_imu(SurviveKalmanTracker *tracker, PoserDa
 
 		tracker->datalog_tag = "imu_meas";
 
-        CnMat R = cnMat(6, tracker->imu_model.adaptive ? 6 : 1, tracker->imu_model.adaptive ? tracker->IMU_R : rotation_variance);
+		// The adaptive R is kept at single sample scale; averaged samples are measured against a share of it
+		FLT *adaptive_R = tracker->IMU_R;
+		if (tracker->imu_model.adaptive) {
+			scalend(adaptive_R, adaptive_R, 1. / sample_cnt, 36);
+		}
+
+        CnMat R = cnMat(6, tracker->imu_model.adaptive ? 6 : 1, tracker->imu_model.adaptive ? adaptive_R : rotation_variance);
         FLT err = cnkalman_meas_model_predict_update(time, &tracker->imu_model, &fn_ctx, &Z, &R);
 		tracker->datalog_tag = 0;
 
+		if (tracker->imu_model.adaptive) {
+			scalend(adaptive_R, adaptive_R, sample_cnt, 36);
+		}
+
         SV_DATA_LOG("res_err_imu", &err, 1);
 		tracker->stats.imu_total_error += err;
 		tracker->imu_residuals *= .9;
 		tracker->imu_residuals += .1 * err;
 
-        tracker->stats.acc_norm += norm3d(data->accel);
+        tracker->stats.acc_norm += sample_cnt * norm3d(data->accel);
         if(isStationary) {
-            tracker->stats.stationary_acc_norm += norm3d(data->accel);
-            tracker->stats.stationary_imu_count++;
+            tracker->stats.stationary_acc_norm += sample_cnt * norm3d(data->accel);
+            tracker->stats.stationary_imu_count += sample_cnt;
         }
-		tracker->stats.imu_count++;
+		tracker->stats.imu_count += sample_cnt;
+		tracker->stats.imu_updates++;
 		if (tracker->first_imu_time == 0) {
 		  tracker->first_imu_time = time;
 		}
@@ -910,7 +1122,373 @@ void survive_kalman_tracker_integrate_imu(SurviveKalmanTracker *tracker, PoserDa
 				   LINMATH_VEC26_EXPAND(cn_as_const_vector(&tracker->model.state)));
 	}
 
-	survive_kalman_tracker_report_state(&data->hdr, tracker);
+	survive_kalman_tracker_report_state((PoserData *)&data->hdr, tracker);
+}
+
+// Returns whether the sample still needs integrate_imu; late samples are handled here
+static bool prepare_imu(SurviveKalmanTracker *tracker, const PoserDataIMU *data, uint32_t sample_cnt, FLT *time_out) {
+	SurviveContext *ctx = tracker->so->ctx;
+	SurviveObject *so = tracker->so;
+
+	FLT time = *time_out = data->hdr.timecode / (FLT)tracker->so->timebase_hz;
+	FLT time_diff = time - tracker->model.t;
+
+	FLT norm = norm3d(data->accel);
+	SV_DATA_LOG("acc_norm", &norm, 1);
+
+	if (tracker->use_raw_obs) {
+		return false;
+	}
+
+	// Wait til observation is in before reading IMU; gets rid of bad IMU data at the start
+	if (tracker->model.t == 0) {
+		return false;
+	}
+
+	if (tracker->stats.obs_count < 16 && tracker->obs_pos_var > -1) {
+		return false;
+	}
+
+	if (time_diff < -.01) {
+		SurviveKalmanTrackerHistoryEntry late = {
+			.type = survive_kalman_tracker_history_imu, .time = time, .imu_sample_cnt = sample_cnt, .imu = *data};
+		if (!history_insert(tracker, &late)) {
+			tracker->stats.late_imu_dropped++;
+		}
+		return false;
+	}
+
+	if (time_diff > 0.5) {
+		SV_WARN("%s is probably dropping IMU packets; %f time reported between %" PRIu64, tracker->so->codename,
+				time_diff, data->hdr.timecode);
+	}
+
+	SurviveKalmanTrackerHistoryEntry *entry = history_push(tracker, survive_kalman_tracker_history_imu, time);
+	if (entry) {
+		entry->imu = *data;
+		entry->imu_sample_cnt = sample_cnt;
+	}
+	return true;
+}
+
+static void integrate_imu_sample(SurviveKalmanTracker *tracker, const PoserDataIMU *data, uint32_t sample_cnt) {
+	FLT time;
+	if (prepare_imu(tracker, data, sample_cnt, &time)) {
+		integrate_imu(tracker, data, sample_cnt, time);
+	}
+}
+
+void survive_imu_preintegration_add(SurviveIMUPreintegration *pi, const PoserDataIMU *data, FLT time) {
+	if (pi->cnt == 0) {
+		*pi = (SurviveIMUPreintegration){.rotation = {1},
+										 .first_time = time,
+										 .closed_time = pi->closed_time,
+										 .first_timecode = data->hdr.timecode};
+	} else {
+		// The gyro reads angular velocity in the sample's own frame, so each step composes on the right
+		LinmathAxisAngle step;
+		add3d(step, pi->newest.gyro, data->gyro);
+		scale3d(step, step, (time - pi->last_time) / 2.);
+
+		LinmathQuat q;
+		quatfromaxisanglemag(q, step);
+		quatrotateabout(pi->rotation, pi->rotation, q);
+		quatnormalize(pi->rotation, pi->rotation);
+	}
+
+	LinmathVec3d v;
+	quatrotatevector(v, pi->rotation, data->accel);
+	add3d(pi->accel, pi->accel, v);
+	quatrotatevector(v, pi->rotation, data->gyro);
+	add3d(pi->gyro, pi->gyro, v);
+
+	pi->newest = *data;
+	pi->last_time = time;
+	pi->time_sum += time - pi->first_time;
+	pi->timecode_offset_sum += data->hdr.timecode - pi->first_timecode;
+	pi->cnt++;
+}
+
+uint32_t survive_imu_preintegration_finish(SurviveIMUPreintegration *pi, PoserDataIMU *out) {
+	uint32_t cnt = pi->cnt;
+	if (cnt == 0) {
+		return 0;
+	}
+
+	*out = pi->newest;
+	out->hdr.timecode = pi->first_timecode + (pi->timecode_offset_sum + cnt / 2) / cnt;
+
+	// The gyro is taken as steady over the window to find the frame at the mean time
+	FLT span = pi->last_time - pi->first_time;
+	FLT mean_fraction = span > 0 ? pi->time_sum / cnt / span : 0;
+	LinmathAxisAngleMag mean_step;
+	quattoaxisanglemag(mean_step, pi->rotation);
+	scale3d(mean_step, mean_step, mean_fraction);
+	LinmathQuat mean2first, first2mean;
+	quatfromaxisanglemag(mean2first, mean_step);
+	quatgetreciprocal(first2mean, mean2first);
+
+	LinmathVec3d mean;
+	scale3d(mean, pi->accel, 1. / cnt);
+	quatrotatevector(out->accel, first2mean, mean);
+	scale3d(mean, pi->gyro, 1. / cnt);
+	quatrotatevector(out->gyro, first2mean, mean);
+
+	pi->closed_time = pi->last_time;
+	pi->cnt = 0;
+	return cnt;
+}
+
+/*
+ * Folds data into the tracker's window when 'kalman-imu-rate' is set. Returns true with the sample to integrate in out
+ * once 1 / imu_rate has passed since the last integrated IMU sample, or right away for samples the window can't take:
+ * before the filter starts, or older than the filter or the window, which go through the late data path on their own.
+ */
+static bool preintegrate_imu(SurviveKalmanTracker *tracker, const PoserDataIMU *data, PoserDataIMU *out,
+							 uint32_t *sample_cnt) {
+	SurviveIMUPreintegration *window = &tracker->imu_window;
+	FLT time = data->hdr.timecode / (FLT)tracker->so->timebase_hz;
+	if (tracker->imu_rate <= 0 || tracker->model.t == 0 || time < tracker->model.t ||
+		(window->cnt && time < window->last_time)) {
+		*out = *data;
+		*sample_cnt = 1;
+		return true;
+	}
+
+	survive_imu_preintegration_add(window, data, time);
+	if (time - window->closed_time < 1. / tracker->imu_rate) {
+		return false;
+	}
+
+	*sample_cnt = survive_imu_preintegration_finish(window, out);
+	if (*sample_cnt > 1) {
+		tracker->stats.imu_preintegrated += *sample_cnt;
+	}
+	return true;
+}
+
+void survive_kalman_tracker_integrate_imu(SurviveKalmanTracker *tracker, PoserDataIMU *data) {
+	PoserDataIMU sample;
+	uint32_t sample_cnt;
+	if (preintegrate_imu(tracker, data, &sample, &sample_cnt)) {
+		integrate_imu_sample(tracker, &sample, sample_cnt);
+	}
+}
+
+SurviveKalmanTrackerIMUBatch *survive_kalman_tracker_imu_batch_create(size_t capacity) {
+	if (capacity < 2) {
+		return 0;
+	}
+
+	SurviveKalmanTrackerIMUBatch *batch = SV_CALLOC(sizeof(SurviveKalmanTrackerIMUBatch));
+	batch->capacity = capacity;
+	batch->trackers = SV_CALLOC_N(capacity, sizeof(SurviveKalmanTracker *));
+	batch->imu = SV_CALLOC_N(capacity, sizeof(PoserDataIMU));
+	batch->imu_sample_cnts = SV_CALLOC_N(capacity, sizeof(uint32_t));
+	batch->times = SV_CALLOC_N(capacity, sizeof(FLT));
+	batch->ready = SV_CALLOC_N(capacity, sizeof(bool));
+	batch->propagate = SV_CALLOC_N(capacity, sizeof(bool));
+
+	size_t batch_size = SURVIVE_KALMAN_BATCH_SIZE(SURVIVE_MODEL_MAX_STATE_CNT);
+	batch->F = SV_CALLOC_N(batch_size, sizeof(FLT));
+	batch->Q = SV_CALLOC_N(batch_size, sizeof(FLT));
+	batch->P = SV_CALLOC_N(batch_size, sizeof(FLT));
+	batch->scratch = SV_CALLOC_N(batch_size, sizeof(FLT));
+	return batch;
+}
+
+void survive_kalman_tracker_imu_batch_free(SurviveKalmanTrackerIMUBatch *batch) {
+	if (batch == 0) {
+		return;
+	}
+
+	free(batch->trackers);
+	free(batch->imu);
+	free(batch->imu_sample_cnts);
+	free(batch->times);
+	free(batch->ready);
+	free(batch->propagate);
+	free(batch->F);
+	free(batch->Q);
+	free(batch->P);
+	free(batch->scratch);
+	free(batch);
+}
+
+/*
+ * The covariance half of cnkalman's predict step: F and x1 from the tracker's transition function, Q from the process
+ * noise plus state_variance_per_second. Each tracker's state is moved up to its sample time here, so cnkalman sees no
+ * time step for the main model when the sample is integrated and only predicts the IMU bias model.
+ */
+static void propagate_lanes(SurviveKalmanTrackerIMUBatch *batch, const size_t *idxs, size_t lane_cnt, size_t n) {
+	size_t batch_size = SURVIVE_KALMAN_BATCH_SIZE(n);
+	// Unused lanes have to stay finite
+	memset(batch->F, 0, batch_size * sizeof(FLT));
+	memset(batch->Q, 0, batch_size * sizeof(FLT));
+	memset(batch->P, 0, batch_size * sizeof(FLT));
+
+	CN_CREATE_STACK_MAT(F, n, n);
+	CN_CREATE_STACK_MAT(Q, n, n);
+	CN_CREATE_STACK_MAT(P, n, n);
+	for (size_t lane = 0; lane < lane_cnt; lane++) {
+		SurviveKalmanTracker *tracker = batch->trackers[idxs[lane]];
+		FLT t = batch->times[idxs[lane]];
+		FLT dt = t - tracker->model.t;
+
+		CN_CREATE_STACK_MAT(x1, tracker->model.state_cnt, 1);
+		if (tracker->use_error_state) {
+			survive_kalman_error_tracker_predict_jac(dt, &tracker->model, &tracker->model.state, &x1, &F);
+		} else {
+			survive_kalman_tracker_predict_jac(dt, &tracker->model, &tracker->model.state, &x1, &F);
+		}
+		survive_kalman_tracker_process_noise(&tracker->params, tracker->use_error_state, dt, &x1, &Q);
+		const CnMat *variance_per_second = &tracker->model.state_variance_per_second;
+		for (int i = 0; i < variance_per_second->rows && (size_t)i < n; i++) {
+			cnMatrixSet(&Q, i, i, cnMatrixGet(&Q, i, i) + dt * cn_as_const_vector(variance_per_second)[i]);
+		}
+		cnCopy(&tracker->model.P, &P, 0);
+
+		survive_kalman_batch_pack(n, lane, batch->F, cn_as_const_vector(&F));
+		survive_kalman_batch_pack(n, lane, batch->Q, cn_as_const_vector(&Q));
+		survive_kalman_batch_pack(n, lane, batch->P, cn_as_const_vector(&P));
+
+		cnCopy(&x1, &tracker->model.state, 0);
+		tracker->model.t = t;
+		CN_FREE_STACK_MAT(x1);
+	}
+
+	survive_kalman_batch_propagate(n, batch->P, batch->F, batch->Q, batch->scratch);
+
+	for (size_t lane = 0; lane < lane_cnt; lane++) {
+		SurviveKalmanTracker *tracker = batch->trackers[idxs[lane]];
+		survive_kalman_batch_unpack(n, lane, cn_as_vector(&P), batch->P);
+		cnCopy(&P, &tracker->model.P, 0);
+		tracker->stats.imu_batched++;
+	}
+	batch->propagated += lane_cnt;
+
+	CN_FREE_STACK_MAT(P);
+	CN_FREE_STACK_MAT(Q);
+	CN_FREE_STACK_MAT(F);
+}
+
+// Only the process noise model has a Q to batch; the rest predict inside cnkalman as usual
+static inline bool can_propagate(const SurviveKalmanTracker *tracker, FLT time) {
+	return tracker->noise_model == 0 && time > tracker->model.t && tracker->model.P.rows <= SURVIVE_MODEL_MAX_STATE_CNT;
+}
+
+void survive_kalman_tracker_imu_batch_flush(SurviveKalmanTrackerIMUBatch *batch) {
+	if (batch == 0 || batch->cnt == 0 || batch->flushing) {
+		return;
+	}
+	batch->flushing = true;
+
+	size_t cnt = batch->cnt;
+	for (size_t i = 0; i < cnt; i++) {
+		SurviveKalmanTracker *tracker = batch->trackers[i];
+		tracker->imu_batch_queued = false;
+		batch->ready[i] = prepare_imu(tracker, &batch->imu[i], batch->imu_sample_cnts[i], &batch->times[i]);
+		batch->propagate[i] = batch->ready[i] && can_propagate(tracker, batch->times[i]);
+	}
+
+	// Group trackers with the same state size into lanes
+	for (size_t i = 0; i < cnt; i++) {
+		if (!batch->propagate[i]) {
+			continue;
+		}
+
+		size_t n = batch->trackers[i]->model.P.rows;
+		size_t idxs[SURVIVE_KALMAN_BATCH_LANES];
+		size_t lane_cnt = 0;
+		for (size_t j = i; j < cnt && lane_cnt < SURVIVE_KALMAN_BATCH_LANES; j++) {
+			if (batch->propagate[j] && batch->trackers[j]->model.P.rows == n) {
+				batch->propagate[j] = false;
+				idxs[lane_cnt++] = j;
+			}
+		}
+		double start = OGGetAbsoluteTime();
+		propagate_lanes(batch, idxs, lane_cnt, n);
+		batch->propagate_time += OGGetAbsoluteTime() - start;
+	}
+
+	for (size_t i = 0; i < cnt; i++) {
+		if (batch->ready[i]) {
+			integrate_imu(batch->trackers[i], &batch->imu[i], batch->imu_sample_cnts[i], batch->times[i]);
+		}
+	}
+
+	batch->flushes++;
+	batch->samples += cnt;
+	batch->cnt = 0;
+	batch->flushing = false;
+}
+
+static void enqueue_imu(SurviveKalmanTracker *tracker, const PoserDataIMU *data, uint32_t sample_cnt) {
+	SurviveKalmanTrackerIMUBatch *batch = tracker->imu_batch;
+	if (batch == 0 || batch->flushing) {
+		integrate_imu_sample(tracker, data, sample_cnt);
+		return;
+	}
+
+	if (tracker->imu_batch_queued || batch->cnt >= batch->capacity) {
+		survive_kalman_tracker_imu_batch_flush(batch);
+	}
+
+	batch->trackers[batch->cnt] = tracker;
+	batch->imu[batch->cnt] = *data;
+	batch->imu_sample_cnts[batch->cnt] = sample_cnt;
+	batch->cnt++;
+	tracker->imu_batch_queued = true;
+}
+
+void survive_kalman_tracker_queue_imu(SurviveKalmanTracker *tracker, PoserDataIMU *data) {
+	PoserDataIMU sample;
+	uint32_t sample_cnt;
+	if (preintegrate_imu(tracker, data, &sample, &sample_cnt)) {
+		enqueue_imu(tracker, &sample, sample_cnt);
+	}
+}
+
+/*
+ * A partly filled preintegration window, then a sample still waiting in the batch, go in before anything newer for the
+ * same tracker. A replay only ever re-runs data older than both, so they keep waiting through it.
+ */
+static void flush_queued_imu(SurviveKalmanTracker *tracker) {
+	if (tracker->history.replaying) {
+		return;
+	}
+
+	PoserDataIMU sample;
+	uint32_t sample_cnt = survive_imu_preintegration_finish(&tracker->imu_window, &sample);
+	if (sample_cnt) {
+		if (sample_cnt > 1) {
+			tracker->stats.imu_preintegrated += sample_cnt;
+		}
+		enqueue_imu(tracker, &sample, sample_cnt);
+	}
+
+	if (tracker->imu_batch_queued) {
+		survive_kalman_tracker_imu_batch_flush(tracker->imu_batch);
+	}
+}
+
+static void remove_queued_imu(SurviveKalmanTracker *tracker) {
+	SurviveKalmanTrackerIMUBatch *batch = tracker->imu_batch;
+	if (!tracker->imu_batch_queued) {
+		return;
+	}
+
+	for (size_t i = 0; i < batch->cnt; i++) {
+		if (batch->trackers[i] == tracker) {
+			memmove(&batch->trackers[i], &batch->trackers[i + 1], (batch->cnt - i - 1) * sizeof(batch->trackers[0]));
+			memmove(&batch->imu[i], &batch->imu[i + 1], (batch->cnt - i - 1) * sizeof(batch->imu[0]));
+			memmove(&batch->imu_sample_cnts[i], &batch->imu_sample_cnts[i + 1],
+					(batch->cnt - i - 1) * sizeof(batch->imu_sample_cnts[0]));
+			batch->cnt--;
+			break;
+		}
+	}
+	tracker->imu_batch_queued = false;
 }
 
 void survive_kalman_tracker_predict(const SurviveKalmanTracker *tracker, FLT t, SurvivePose *out) {
@@ -928,6 +1506,130 @@ void survive_kalman_tracker_predict(const SurviveKalmanTracker *tracker, FLT t,
 	SV_VERBOSE(300, "Predict pose %f %f " SurvivePose_format, t, t - tracker->model.t, SURVIVE_POSE_EXPAND(*out))
 }
 
+static void write_snapshot(SurviveKalmanTracker *tracker, bool valid) {
+	SurviveObject *so = tracker->so;
+	bool report_in_imu = survive_report_in_imu(so->ctx);
+
+	uint32_t seq = tracker->snapshot.seq;
+	OGAtomicStoreU32(&tracker->snapshot.seq, seq + 1);
+	OGMemoryBarrier();
+
+	SurviveKalmanTrackerSnapshot *snapshot = &tracker->snapshot.data;
+	tracker->snapshot.valid = valid;
+	if (valid) {
+		snapshot->t = tracker->model.t;
+		snapshot->runtime = SurviveSensorActivations_runtime(
+								&so->activations, (survive_long_timecode)(tracker->model.t * so->timebase_hz)) *
+							1e-6;
+		snapshot->state = tracker->state;
+		// Match the inputs survive_kalman_tracker_predict_jac uses
+		if (!tracker->use_error_state && tracker->params.process_weight_acc == 0) {
+			scale3d(snapshot->state.Acc, snapshot->state.Acc, 0);
+		}
+		if (!tracker->use_error_state && tracker->params.process_weight_vel == 0) {
+			scalend(snapshot->state.Velocity.Pos, snapshot->state.Velocity.Pos, 0, 6);
+		}
+
+		int idxs[3] = {offsetof(SurviveKalmanModel, Pose.Pos) / sizeof(FLT),
+					   offsetof(SurviveKalmanModel, Velocity.Pos) / sizeof(FLT),
+					   offsetof(SurviveKalmanModel, Acc) / sizeof(FLT)};
+		if (tracker->use_error_state) {
+			idxs[1] = offsetof(SurviveKalmanErrorModel, Velocity.Pos) / sizeof(FLT);
+			idxs[2] = offsetof(SurviveKalmanErrorModel, Acc) / sizeof(FLT);
+		}
+		memset(snapshot->P, 0, sizeof(snapshot->P));
+		for (int a = 0; a < 3; a++) {
+			for (int b = 0; b < 3; b++) {
+				for (int i = 0; i < 3; i++) {
+					for (int j = 0; j < 3; j++) {
+						int row = idxs[a] + i, col = idxs[b] + j;
+						if (row < tracker->model.P.rows && col < tracker->model.P.cols) {
+							snapshot->P[(a * 3 + i) * 9 + b * 3 + j] = cnMatrixGet(&tracker->model.P, row, col);
+						}
+					}
+				}
+			}
+		}
+
+		snapshot->params = tracker->params;
+		snapshot->use_process_noise = tracker->noise_model == 0;
+		snapshot->head2imu = report_in_imu ? LinmathPose_Identity : so->head2imu;
+		snapshot->floor_offset = so->ctx->floor_offset;
+	}
+
+	OGAtomicStoreU32(&tracker->snapshot.seq, seq + 2);
+}
+
+bool survive_kalman_tracker_read_snapshot(const SurviveKalmanTracker *tracker, SurviveKalmanTrackerSnapshot *out) {
+	for (int attempt = 0;; attempt++) {
+		// Writes are a short copy, so only a writer that got preempted mid write keeps us here; let it run
+		if (attempt >= 16) {
+			OGUSleep(1);
+		}
+
+		uint32_t seq = OGAtomicLoadU32(&tracker->snapshot.seq);
+		if (seq & 1) {
+			continue;
+		}
+
+		bool valid = tracker->snapshot.valid;
+		*out = tracker->snapshot.data;
+
+		OGMemoryBarrier();
+		if (OGAtomicLoadU32(&tracker->snapshot.seq) == seq) {
+			return valid;
+		}
+	}
+}
+
+void survive_kalman_tracker_predict_snapshot(const SurviveKalmanTrackerSnapshot *snapshot, FLT t, SurvivePose *pose,
+											 SurviveVelocity *velocity, FLT *position_covariance) {
+	FLT dt = t - snapshot->t;
+
+	SurviveKalmanModel s_in = snapshot->state, s_out = {0};
+	quatnormalize(s_in.Pose.Rot, s_in.Pose.Rot);
+	SurviveKalmanModelPredict(&s_out, dt, &s_in);
+	quatnormalize(s_out.Pose.Rot, s_out.Pose.Rot);
+
+	if (pose) {
+		ApplyPoseToPose(pose, &s_out.Pose, &snapshot->head2imu);
+		pose->Pos[2] -= snapshot->floor_offset;
+	}
+	if (velocity) {
+		*velocity = s_out.Velocity;
+	}
+
+	if (position_covariance) {
+		// p(t) = p + v * dt + a * dt^2 / 2
+		FLT J[3] = {1, dt, dt * dt / 2.};
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				FLT v = 0;
+				for (int a = 0; a < 3; a++) {
+					for (int b = 0; b < 3; b++) {
+						v += J[a] * J[b] * snapshot->P[(a * 3 + i) * 9 + b * 3 + j];
+					}
+				}
+				position_covariance[i * 3 + j] = v;
+			}
+		}
+
+		if (snapshot->use_process_noise && dt > 0) {
+			// The error state process noise doesn't depend on the state and has the same position block
+			size_t error_state_cnt = sizeof(SurviveKalmanErrorModel) / sizeof(FLT);
+			CN_CREATE_STACK_MAT(Q, error_state_cnt, error_state_cnt);
+			CnMat x = cnVec(SURVIVE_MODEL_MAX_STATE_CNT, (FLT *)&s_in);
+			survive_kalman_tracker_process_noise(&snapshot->params, true, dt, &x, &Q);
+			for (int i = 0; i < 3; i++) {
+				for (int j = 0; j < 3; j++) {
+					position_covariance[i * 3 + j] += cnMatrixGet(&Q, i, j);
+				}
+			}
+			CN_FREE_STACK_MAT(Q);
+		}
+	}
+}
+
 static void survive_kalman_tracker_process_noise_bounce(void *user, FLT t, const CnMat *x, struct CnMat *q_out) {
 	struct SurviveKalmanTracker_Params *params = (struct SurviveKalmanTracker_Params *)user;
 	survive_kalman_tracker_process_noise(params, false, t, x, q_out);
@@ -1152,18 +1854,32 @@ void survive_show_covariance(SurviveObject *so, const SurvivePose *pose, const s
     }
 }
 
+static void history_fill_obs(SurviveKalmanTrackerHistoryEntry *entry, const PoserData *pd, const SurvivePose *pose,
+							 const struct CnMat *Ri) {
+	entry->obs.hdr = *pd;
+	entry->obs.pose = *pose;
+	entry->obs.R_rows = entry->obs.R_cols = 0;
+	if (Ri && Ri->rows * Ri->cols <= (int)SURVIVE_ARRAY_SIZE(entry->obs.R)) {
+		entry->obs.R_rows = Ri->rows;
+		entry->obs.R_cols = Ri->cols;
+		CnMat R = cnMat(Ri->rows, Ri->cols, entry->obs.R);
+		cnCopy(Ri, &R, 0);
+	}
+}
+
+static void integrate_observation(SurviveKalmanTracker *tracker, PoserData *pd, FLT time, const SurvivePose *pose,
+								  const struct CnMat *Ri);
+
 void survive_kalman_tracker_integrate_observation(PoserData *pd, SurviveKalmanTracker *tracker, const SurvivePose *pose,
 												  const struct CnMat *Ri) {
 	SurviveObject *so = tracker->so;
     SurviveContext *ctx = so->ctx;
+	flush_queued_imu(tracker);
 
 	integrate_variance_tracker(tracker, &tracker->pose_variance, (FLT*)pose->Pos, 7);
 
     if (tracker->show_raw_obs) {
-        static int report_in_imu = -1;
-        if (report_in_imu == -1) {
-            report_in_imu = survive_configi(so->ctx, "report-in-imu", SC_GET, 0);
-        }
+        bool report_in_imu = survive_report_in_imu(so->ctx);
 
         char external_name[16] = {0};
 		sprintf(external_name, "%s-raw-obs", so->codename);
@@ -1175,6 +1891,7 @@ void survive_kalman_tracker_integrate_observation(PoserData *pd, SurviveKalmanTr
 	}
 
 	if (tracker->use_raw_obs) {
+		survive_motion_to_pose_record(so, pd);
 		SURVIVE_INVOKE_HOOK_SO(imupose, so, pd->timecode, pose);
 		return;
 	}
@@ -1204,12 +1921,27 @@ void survive_kalman_tracker_integrate_observation(PoserData *pd, SurviveKalmanTr
 
 			time = tracker->model.t;
 		} else {
-			// CN_WARN("Processing light data from the past %fs", time - tracker->model.t );
-			tracker->stats.late_light_dropped++;
+			SurviveKalmanTrackerHistoryEntry late = {.type = survive_kalman_tracker_history_obs, .time = time};
+			history_fill_obs(&late, pd, pose, Ri);
+			if (!history_insert(tracker, &late)) {
+				tracker->stats.late_light_dropped++;
+			}
 			return;
 		}
 	}
 
+	SurviveKalmanTrackerHistoryEntry *entry = history_push(tracker, survive_kalman_tracker_history_obs, time);
+	if (entry) {
+		history_fill_obs(entry, pd, pose, Ri);
+	}
+	integrate_observation(tracker, pd, time, pose, Ri);
+}
+
+static void integrate_observation(SurviveKalmanTracker *tracker, PoserData *pd, FLT time, const SurvivePose *pose,
+								  const struct CnMat *Ri) {
+	SurviveObject *so = tracker->so;
+	SurviveContext *ctx = so->ctx;
+
 	tracker->last_light_time = time;
 
 	if (tracker->obs_pos_var >= 0 && tracker->obs_rot_var >= 0) {
@@ -1246,6 +1978,114 @@ void survive_kalman_tracker_integrate_observation(PoserData *pd, SurviveKalmanTr
 	}
 }
 
+// Checkpoints the filter before the i'th entry and runs it again
+static void history_apply(SurviveKalmanTracker *tracker, size_t i) {
+	history_checkpoint(tracker, i);
+
+	SurviveKalmanTrackerHistoryEntry *entry = history_at(tracker, i);
+	switch (entry->type) {
+	case survive_kalman_tracker_history_imu:
+		integrate_imu(tracker, &entry->imu, entry->imu_sample_cnt, entry->time);
+		break;
+	case survive_kalman_tracker_history_obs: {
+		CnMat R = cnMat(entry->obs.R_rows, entry->obs.R_cols, entry->obs.R);
+		integrate_observation(tracker, &entry->obs.hdr, entry->time, &entry->obs.pose, entry->obs.R_rows ? &R : 0);
+		break;
+	}
+	case survive_kalman_tracker_history_light: {
+		// Set aside whatever light is collecting for the next batch
+		LightInfo pending[SURVIVE_ARRAY_SIZE(tracker->savedLight)];
+		uint32_t pending_cnt = tracker->savedLight_idx;
+		memcpy(pending, tracker->savedLight, sizeof(pending));
+
+		memcpy(tracker->savedLight, entry->light.light, sizeof(LightInfo) * entry->light.cnt);
+		tracker->savedLight_idx = entry->light.cnt;
+		survive_kalman_tracker_integrate_saved_light(tracker, &entry->light.hdr);
+
+		memcpy(tracker->savedLight, pending, sizeof(pending));
+		tracker->savedLight_idx = pending_cnt;
+		break;
+	}
+	}
+}
+
+/*
+ * Puts a measurement from before the filter's current time into the history in time order, rewinds the filter to the
+ * checkpoint before it and re-runs everything from there. Returns false if the history doesn't reach back that far.
+ */
+static bool history_insert(SurviveKalmanTracker *tracker, const SurviveKalmanTrackerHistoryEntry *late) {
+	if (tracker->history.entries == 0 || tracker->history.replaying) {
+		return false;
+	}
+
+	size_t cnt = tracker->history.cnt;
+	size_t k = cnt;
+	while (k > 0 && history_at(tracker, k - 1)->time > late->time) {
+		k--;
+	}
+	if (k == cnt || history_at(tracker, k)->model_t > late->time) {
+		return false;
+	}
+
+	FLT rewind_time = tracker->model.t - late->time;
+
+	// Poses go out once, after the replay, stamped like the newest measurement
+	const SurviveKalmanTrackerHistoryEntry *newest = history_at(tracker, cnt - 1);
+	PoserData report_hdr = newest->type == survive_kalman_tracker_history_imu	? newest->imu.hdr
+						   : newest->type == survive_kalman_tracker_history_obs ? newest->obs.hdr
+																				: newest->light.hdr;
+	report_hdr.received_us = 0;
+
+	history_restore(tracker, k);
+	for (size_t i = cnt; i > k; i--) {
+		*history_at(tracker, i) = *history_at(tracker, i - 1);
+	}
+	*history_at(tracker, k) = *late;
+	tracker->history.cnt++;
+
+	tracker->history.replaying = true;
+	history_apply(tracker, k);
+
+	// Everything after the late measurement was counted the first time it ran
+	uint8_t stats[sizeof(tracker->stats)];
+	memcpy(stats, &tracker->stats, sizeof(stats));
+	for (size_t i = k + 1; i < tracker->history.cnt; i++) {
+		history_apply(tracker, i);
+	}
+	memcpy(&tracker->stats, stats, sizeof(stats));
+	tracker->history.replaying = false;
+
+	size_t depth = tracker->history.cnt - k;
+	if (tracker->history.cnt == tracker->history.capacity) {
+		tracker->history.start = (tracker->history.start + 1) % tracker->history.capacity;
+		tracker->history.cnt--;
+	}
+
+	tracker->stats.oosm_inserted++;
+	tracker->stats.oosm_replayed += depth;
+	tracker->stats.oosm_max_depth = linmath_imax(tracker->stats.oosm_max_depth, depth);
+	tracker->stats.oosm_rewind_time += rewind_time;
+	tracker->stats.oosm_max_rewind_time = linmath_max(tracker->stats.oosm_max_rewind_time, rewind_time);
+
+	survive_kalman_tracker_report_state(&report_hdr, tracker);
+	return true;
+}
+
+void survive_kalman_tracker_set_history_length(SurviveKalmanTracker *tracker, int32_t history_length) {
+	free(tracker->history.entries);
+	free(tracker->history.P);
+	memset(&tracker->history, 0, sizeof(tracker->history));
+
+	tracker->history_length = history_length;
+	if (history_length > 0) {
+		tracker->history.capacity = history_length + 1;
+		tracker->history.P_stride = tracker->model.P.rows * tracker->model.P.cols +
+									tracker->imu_bias_model.P.rows * tracker->imu_bias_model.P.cols;
+		tracker->history.entries = SV_CALLOC_N(tracker->history.capacity, sizeof(SurviveKalmanTrackerHistoryEntry));
+		tracker->history.P = SV_CALLOC_N(tracker->history.capacity * tracker->history.P_stride, sizeof(FLT));
+	}
+}
+
 typedef void (*survive_attach_detach_fn)(SurviveContext *ctx, const char *tag, FLT *var);
 
 void survive_kalman_tracker_reinit(SurviveKalmanTracker *tracker) {
@@ -1254,6 +2094,8 @@ void survive_kalman_tracker_reinit(SurviveKalmanTracker *tracker) {
 	tracker->report_ignore_start_cnt = 0;
 	tracker->last_light_time = 0;
 	tracker->light_residuals_all = 0;
+	tracker->history.start = tracker->history.cnt = 0;
+	tracker->imu_window = (SurviveIMUPreintegration){0};
 
 	memset(&tracker->state, 0, sizeof(tracker->state));
 	tracker->state.Pose.Rot[0] = 1;
@@ -1262,6 +2104,7 @@ void survive_kalman_tracker_reinit(SurviveKalmanTracker *tracker) {
 		tracker->state.IMUBias.AccScale[i] = 1.;
 
 	cnkalman_state_reset(&tracker->model);
+	write_snapshot(tracker, false);
 	for (int i = 0; i < 6; i++) {
 		cnMatrixSet(&tracker->model.P, i, i, cnMatrixGet(&tracker->model.P, i, i) + 1e5);
 	}
@@ -1420,6 +2263,12 @@ void survive_kalman_tracker_init(SurviveKalmanTracker *tracker, SurviveObject *s
 	cnkalman_meas_model_t_obj_obs_attach_config(ctx, &tracker->obs_model);
 	tracker->obs_model.term_criteria.max_iterations = 10;
 
+	survive_kalman_tracker_set_history_length(tracker, tracker->history_length);
+
+	if (ctx->private_members) {
+		tracker->imu_batch = ctx->private_members->imu_batch;
+	}
+
 	survive_kalman_tracker_reinit(tracker);
 
 	SV_VERBOSE(10, "Tracker config for %s (%d state count)", survive_colorize_codename(tracker->so), (int)state_cnt);
@@ -1469,6 +2318,24 @@ void survive_kalman_tracker_stats(SurviveKalmanTracker *tracker) {
 
 	SV_VERBOSE(5, "\t%-32s %u", "late imu", tracker->stats.late_imu_dropped);
 	SV_VERBOSE(5, "\t%-32s %u", "late light", tracker->stats.late_light_dropped);
+	if (tracker->stats.oosm_inserted > 0) {
+		SV_VERBOSE(5, "\t%-32s %u (%7.3f avg replayed, %u max, %7.3fms avg rewind, %7.3fms max)", "late inserted",
+				   tracker->stats.oosm_inserted, tracker->stats.oosm_replayed / (FLT)tracker->stats.oosm_inserted,
+				   tracker->stats.oosm_max_depth,
+				   1000. * tracker->stats.oosm_rewind_time / tracker->stats.oosm_inserted,
+				   1000. * tracker->stats.oosm_max_rewind_time);
+	}
+	if (tracker->imu_batch && tracker->imu_batch->flushes > 0) {
+		const SurviveKalmanTrackerIMUBatch *batch = tracker->imu_batch;
+		SV_VERBOSE(5, "\t%-32s %zu of %zu (%7.3f avg samples per flush, %7.3fus per propagated sample)", "batched imu",
+				   tracker->stats.imu_batched, tracker->stats.imu_updates, batch->samples / (FLT)batch->flushes,
+				   batch->propagated ? 1e6 * batch->propagate_time / batch->propagated : 0.);
+	}
+	if (tracker->imu_rate > 0) {
+		SV_VERBOSE(5, "\t%-32s %zu of %zu samples into %zu updates at %7.3fhz", "preintegrated imu",
+				   tracker->stats.imu_preintegrated, tracker->stats.imu_count, tracker->stats.imu_updates,
+				   tracker->imu_rate);
+	}
 	//joint_model_sensor_cnt_sum
 	SV_VERBOSE(5, "\t%-32s %7.7f avg cnt %8d dropped", "joint model", tracker->stats.joint_model_sensor_cnt_sum / (FLT) tracker->joint_model.stats.total_runs,
 			   tracker->stats.joint_model_dropped);
@@ -1493,8 +2360,8 @@ void survive_kalman_tracker_stats(SurviveKalmanTracker *tracker) {
 
 	variance_tracker_calc(&tracker->imu_variance, integration_variance);
 	SV_VERBOSE(5, "\t%-32s %e (%7u integrations, %7.3fhz) " Point6_format, "IMU error",
-			   tracker->stats.imu_total_error / (FLT)tracker->stats.imu_count, (unsigned)tracker->stats.imu_count,
-			   (unsigned)tracker->stats.imu_count / imu_runtime, LINMATH_VEC6_EXPAND(integration_variance));
+			   tracker->stats.imu_total_error / (FLT)tracker->stats.imu_updates, (unsigned)tracker->stats.imu_updates,
+			   (unsigned)tracker->stats.imu_updates / imu_runtime, LINMATH_VEC6_EXPAND(integration_variance));
 	SV_VERBOSE(5, "\t%-32s " FLT_format " " FLT_format " (%7u)", "IMU acc avg norm",
 		   tracker->stats.acc_norm / (FLT)tracker->stats.imu_count,  (FLT)tracker->stats.imu_count / tracker->stats.acc_norm,
 			   (unsigned)tracker->stats.imu_count);
@@ -1567,9 +2434,12 @@ void survive_kalman_tracker_free(SurviveKalmanTracker *tracker) {
 	SurviveContext *ctx = tracker->so->ctx;
 
 	survive_kalman_tracker_stats(tracker);
+	remove_queued_imu(tracker);
 
 	cnkalman_state_free(&tracker->model);
 	cnkalman_state_free(&tracker->imu_bias_model);
+	free(tracker->history.entries);
+	free(tracker->history.P);
 
 	cnkalman_meas_model_t_joint_lightcap_detach_config(tracker->so->ctx, &tracker->joint_model);
 	cnkalman_meas_model_t_obj_imu_detach_config(tracker->so->ctx, &tracker->imu_model);
@@ -1600,18 +2470,21 @@ void survive_kalman_tracker_lost_tracking(SurviveKalmanTracker *tracker, bool al
 	if (!allowLHReset)
 		return;
 
+	// Only this object's lock is held; the bsd lock keeps the object list and the lighthouses steady
+	survive_get_bsd_lock(ctx);
 	bool objectsAreValid = false;
 	for (int i = 0; i < ctx->objs_ct && !objectsAreValid; i++) {
 		objectsAreValid |= !quatiszero(ctx->objs[i]->OutPoseIMU.Rot);
 	}
 
 	if (!objectsAreValid) {
-	  ctx->floor_offset = 0;
+		ctx->floor_offset = 0;
 		for (int lh = 0; lh < ctx->activeLighthouses; lh++) {
 			ctx->bsd[lh].PositionSet = 0;
 			SV_WARN("Lost tracking for LH%d %f", lh, tracker->light_residuals[lh]);
 		}
 	}
+	survive_release_bsd_lock(ctx);
 }
 
 bool survive_kalman_tracker_check_valid(SurviveKalmanTracker *tracker) {
@@ -1634,6 +2507,14 @@ void survive_kalman_tracker_report_state(PoserData *pd, SurviveKalmanTracker *tr
 	SurvivePose pose = {0};
 	normalize_model(tracker);
 
+	// A replay reports once it has caught back up
+	if (tracker->history.replaying) {
+		return;
+	}
+
+	// Every filter update is published, not just the ones that get reported
+	write_snapshot(tracker, tracker->model.t != 0);
+
 	FLT t = pd->timecode / (FLT)tracker->so->timebase_hz;
 
 	if (t < tracker->model.t) {
@@ -1743,6 +2624,7 @@ void survive_kalman_tracker_report_state(PoserData *pd, SurviveKalmanTracker *tr
     copy3d(so->acceleration, tracker->state.Acc);
 	SV_VERBOSE(110, "%s confidence %7.7f", survive_colorize_codename(so), 1. / p_threshold);
 	if (so->OutPose_timecode < pd->timecode) {
+		survive_motion_to_pose_record(so, pd);
 		SURVIVE_INVOKE_HOOK_SO(imupose, so, pd->timecode, &pose);
 	}
 	if(tracker->stats.imu_count > 100) {
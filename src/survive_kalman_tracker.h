@@ -35,6 +35,100 @@ struct SurviveKalmanTracker_Params {
 	FLT initial_variance_imu_correction;
 };
 
+enum survive_kalman_tracker_history_type {
+	survive_kalman_tracker_history_imu,
+	survive_kalman_tracker_history_obs,
+	survive_kalman_tracker_history_light,
+};
+
+/**
+ * One measurement the filter took, along with the filter state from just before it was applied. Covariances for the
+ * checkpoint live in SurviveKalmanTracker::history.P, by slot.
+ */
+typedef struct SurviveKalmanTrackerHistoryEntry {
+	enum survive_kalman_tracker_history_type type;
+	FLT time;
+	// How many raw IMU samples a preintegrated imu entry stands in for
+	uint32_t imu_sample_cnt;
+	union {
+		PoserDataIMU imu;
+		struct {
+			PoserData hdr;
+			SurvivePose pose;
+			FLT R[7 * 7];
+			int R_rows, R_cols;
+		} obs;
+		struct {
+			PoserData hdr;
+			LightInfo light[32];
+			uint32_t cnt;
+		} light;
+	};
+
+	SurviveKalmanModel state;
+	FLT model_t, imu_bias_t, last_light_time;
+} SurviveKalmanTrackerHistoryEntry;
+
+/**
+ * IMU samples from several trackers waiting to be integrated together, at most one per tracker; see
+ * survive_kalman_tracker_queue_imu and 'kalman-imu-batch'. Everything queueing into one batch has to hold the same lock.
+ */
+typedef struct SurviveKalmanTrackerIMUBatch {
+	size_t capacity, cnt;
+	struct SurviveKalmanTracker **trackers;
+	PoserDataIMU *imu;
+	uint32_t *imu_sample_cnts;
+	FLT *times;
+	bool *ready, *propagate;
+	bool flushing;
+
+	// Batch matrices for survive_kalman_batch_propagate, sized for the largest model
+	FLT *F, *Q, *P, *scratch;
+
+	size_t flushes, samples, propagated;
+	// Seconds spent predicting covariances in the batch, F and Q included; divided by propagated it is the per object
+	// cost to compare against predicting inside cnkalman
+	double propagate_time;
+} SurviveKalmanTrackerIMUBatch;
+
+/**
+ * IMU samples folded into one between light updates; see 'kalman-imu-rate'. Each sample is rotated into the frame of
+ * the first one with the gyro integrated up to it, and the averages are rotated into the frame at the samples' mean
+ * time. The result reads as one sample taken at that time, with the noise of cnt samples averaged out; stamping it with
+ * the newest sample's time instead would make the filter lag by half a window.
+ */
+typedef struct SurviveIMUPreintegration {
+	uint32_t cnt;
+	FLT first_time, last_time, time_sum;
+	// Newest sample time of the last finished window; the next window is measured from it
+	FLT closed_time;
+	// The result takes the newest sample's mag, and a timecode of first_timecode plus the mean offset
+	PoserDataIMU newest;
+	survive_long_timecode first_timecode, timecode_offset_sum;
+	// Rotation from the newest sample's frame into the first one's
+	LinmathQuat rotation;
+	// Sums of the samples in the first sample's frame
+	LinmathVec3d accel, gyro;
+} SurviveIMUPreintegration;
+
+/**
+ * What survive_kalman_tracker_predict_snapshot needs to extrapolate the filter, copied out after every filter update so
+ * it can be read without the tracker's lock; see survive_kalman_tracker_read_snapshot.
+ */
+typedef struct SurviveKalmanTrackerSnapshot {
+	// Filter time in seconds of the tracker's clock, and the same instant in SurviveSensorActivations_runtime seconds
+	FLT t, runtime;
+	SurviveKalmanModel state;
+	// Covariance of position, velocity and acceleration, row major; zero for anything the model doesn't have
+	FLT P[9 * 9];
+	struct SurviveKalmanTracker_Params params;
+	bool use_process_noise;
+
+	// Turns the IMU pose into the reported pose the way the imupose hook does
+	SurvivePose head2imu;
+	FLT floor_offset;
+} SurviveKalmanTrackerSnapshot;
+
 /**
  * The kalman model as it pertains to LH tracking has a state space like so:
  *
@@ -126,6 +220,19 @@ typedef struct SurviveKalmanTracker {
 		uint32_t joint_model_sensor_cnt_sum;
 		uint32_t lightcap_model_dropped;
 		uint32_t lightcap_model_sensor_cnt_sum;
+
+		// Late measurements put back in time order, and what it took to re-run the filter past them
+		uint32_t oosm_inserted;
+		size_t oosm_replayed;
+		uint32_t oosm_max_depth;
+		FLT oosm_rewind_time, oosm_max_rewind_time;
+
+		// IMU samples whose covariance prediction went through survive_kalman_batch_propagate
+		size_t imu_batched;
+		// Raw IMU samples that went in as part of a preintegrated one
+		size_t imu_preintegrated;
+		// Filter updates from IMU data; imu_count counts raw samples, which is more when they are preintegrated
+		size_t imu_updates;
 	} stats;
 
 	FLT imu_residuals;
@@ -150,16 +257,83 @@ typedef struct SurviveKalmanTracker {
 
 	struct variance_tracker imu_variance, pose_variance;
 	struct variance_tracker light_variance[NUM_GEN2_LIGHTHOUSES][SENSORS_PER_OBJECT][2];
+
+	// Evaluate the batched, residual-only light h(x) in float32; see survive_reproject_axis_batch_f32_fn_t. The
+	// analytic light update and the IMU model always run in FLT; see light_hx_batch
+	bool light_float32;
+
+	/*
+	 * The last history_length measurements, oldest first, in a ring of history_length + 1 slots; the extra slot makes
+	 * room to insert a late measurement before the oldest gets trimmed. IMU and pose data older than the filter state
+	 * is inserted in time order and everything after it is re-run from the checkpoint before it. Data older than the
+	 * whole history is still dropped.
+	 */
+	int32_t history_length;
+	struct {
+		SurviveKalmanTrackerHistoryEntry *entries;
+		FLT *P;
+		size_t capacity, P_stride;
+		size_t start, cnt;
+		bool replaying;
+	} history;
+
+	// The context's IMU batch, or null when IMU samples are integrated as they come in
+	SurviveKalmanTrackerIMUBatch *imu_batch;
+	bool imu_batch_queued;
+
+	// 'kalman-imu-rate'; 0 integrates every IMU sample on its own
+	FLT imu_rate;
+	SurviveIMUPreintegration imu_window;
+
+	// Seqlock guarded; seq is odd while a write is in progress. Only the thread updating the filter writes it.
+	struct {
+		volatile uint32_t seq;
+		bool valid;
+		SurviveKalmanTrackerSnapshot data;
+	} snapshot;
 } SurviveKalmanTracker;
 
 SURVIVE_EXPORT SurviveVelocity survive_kalman_tracker_velocity(const SurviveKalmanTracker *tracker);
 SURVIVE_EXPORT bool survive_kalman_tracker_predict_variance(const SurviveKalmanTracker *tracker, FLT time, CnMat* P);
 SURVIVE_EXPORT void survive_kalman_tracker_predict(const SurviveKalmanTracker *tracker, FLT time, SurvivePose *out);
+/**
+ * Copies the latest filter snapshot without locking; safe from any thread while the tracker is alive.
+ * @return false if the filter hasn't been initialized
+ */
+SURVIVE_EXPORT bool survive_kalman_tracker_read_snapshot(const SurviveKalmanTracker *tracker,
+														 SurviveKalmanTrackerSnapshot *out);
+/**
+ * Extrapolates a snapshot to time t, in seconds of the tracker's clock. The pose is the reported one, not the IMU's;
+ * velocity is in the IMU frame like the velocity hook. The position covariance is row major 3x3 and includes the
+ * process noise over the extrapolation. Any output can be null.
+ */
+SURVIVE_EXPORT void survive_kalman_tracker_predict_snapshot(const SurviveKalmanTrackerSnapshot *snapshot, FLT t,
+															SurvivePose *pose, SurviveVelocity *velocity,
+															FLT *position_covariance);
 SURVIVE_EXPORT void survive_kalman_tracker_init(SurviveKalmanTracker *tracker, SurviveObject *so);
+// Replaces the late data history with an empty one of the given length; see 'kalman-oosm-history'
+SURVIVE_EXPORT void survive_kalman_tracker_set_history_length(SurviveKalmanTracker *tracker, int32_t history_length);
 SURVIVE_EXPORT void survive_kalman_tracker_free(SurviveKalmanTracker *tracker);
 SURVIVE_EXPORT void survive_kalman_tracker_integrate_imu(SurviveKalmanTracker *tracker, PoserDataIMU *data);
 SURVIVE_EXPORT void survive_kalman_tracker_integrate_light(SurviveKalmanTracker *tracker, PoserDataLight *data);
 
+/**
+ * Same result as survive_kalman_tracker_integrate_imu, but with a batch the sample waits until the batch is full, until
+ * the next sample for the same tracker or until other data for the tracker comes in. The waiting samples are then
+ * integrated together, with the covariance prediction for trackers of the same state size done up to
+ * SURVIVE_KALMAN_BATCH_LANES at a time.
+ */
+SURVIVE_EXPORT void survive_kalman_tracker_queue_imu(SurviveKalmanTracker *tracker, PoserDataIMU *data);
+// Returns null if capacity is less than 2
+SURVIVE_EXPORT SurviveKalmanTrackerIMUBatch *survive_kalman_tracker_imu_batch_create(size_t capacity);
+SURVIVE_EXPORT void survive_kalman_tracker_imu_batch_flush(SurviveKalmanTrackerIMUBatch *batch);
+SURVIVE_EXPORT void survive_kalman_tracker_imu_batch_free(SurviveKalmanTrackerIMUBatch *batch);
+
+// time is the sample's time in seconds
+SURVIVE_EXPORT void survive_imu_preintegration_add(SurviveIMUPreintegration *pi, const PoserDataIMU *data, FLT time);
+// Writes out the combined sample and empties pi. Returns how many samples went into it; 0 leaves out untouched.
+SURVIVE_EXPORT uint32_t survive_imu_preintegration_finish(SurviveIMUPreintegration *pi, PoserDataIMU *out);
+
 SURVIVE_EXPORT void survive_kalman_tracker_integrate_observation(PoserData *pd, SurviveKalmanTracker *tracker,
 																 const SurvivePose *pose, const struct CnMat *R);
 SURVIVE_EXPORT void survive_kalman_tracker_report_state(PoserData *pd, SurviveKalmanTracker *tracker);
@@ -167,6 +341,8 @@ SURVIVE_EXPORT void survive_kalman_tracker_lost_tracking(SurviveKalmanTracker *t
 
 SURVIVE_EXPORT void survive_kalman_tracker_predict_jac(FLT dt, const struct cnkalman_state_s *k, const struct CnMat *x0,
 													   struct CnMat *x1, struct CnMat *f_out);
+SURVIVE_EXPORT void survive_kalman_error_tracker_predict_jac(FLT dt, const struct cnkalman_state_s *k,
+															 const struct CnMat *x0, struct CnMat *x1, struct CnMat *f_out);
 SURVIVE_EXPORT void survive_kalman_tracker_process_noise(const struct SurviveKalmanTracker_Params *params,
 														 bool errorState, FLT t, const CnMat *x, struct CnMat *q_out);
 SURVIVE_EXPORT bool survive_kalman_tracker_imu_measurement_model(void *user, const struct CnMat *Z,
@@ -0,0 +1,322 @@
+#include "survive_latency.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "os_generic.h"
+#include "survive_internal.h"
+
+STATIC_CONFIG_ITEM(HOOK_LATENCY, "hook-latency", 'b', "Keep latency histograms of every hook, per object.", 0)
+STATIC_CONFIG_ITEM(HOOK_LATENCY_JSON, "hook-latency-json", 's', "Write hook latency statistics as json to this file on close.",
+				   "")
+STATIC_CONFIG_ITEM(MOTION_TO_POSE_WARN, "motion-to-pose-warn-ms", 'f',
+				   "Warn when a pose is published more than this many ms after its data arrived. 0 disables the warning.",
+				   50.)
+
+// Arrival times further off than this come from capture files, not live devices
+#define MAX_PLAUSIBLE_LATENCY_US 10000000
+
+static double tick_period = 0;
+static SURVIVE_THREAD_LOCAL survive_us received_time;
+
+void survive_set_received_time(survive_us received_us) { received_time = received_us; }
+survive_us survive_received_time(void) { return received_time; }
+
+double survive_timestamp_ticks_period(void) {
+	if (tick_period == 0) {
+		// 5ms against the wall clock puts the error far below the histograms' resolution
+		uint64_t start_us = OGGetAbsoluteTimeUS(), now_us;
+		uint64_t start_ticks = survive_timestamp_ticks();
+		while ((now_us = OGGetAbsoluteTimeUS()) - start_us < 5000) {
+		}
+		uint64_t ticks = survive_timestamp_ticks() - start_ticks;
+		tick_period = (now_us - start_us) * 1e-6 / (double)(ticks ? ticks : 1);
+	}
+	return tick_period;
+}
+
+FLT survive_hook_latency_record(SurviveContext *ctx, SurviveObject *so, enum SurviveHookId hook, uint64_t ticks) {
+	struct survive_hook_latency *latency = ctx->hook_latency;
+	if (latency) {
+		survive_latency_histogram_add(&latency->hooks[hook], ticks);
+		if (so && so->hook_latency) {
+			survive_latency_histogram_add(&so->hook_latency->hooks[hook], ticks);
+		}
+	}
+
+	double period = tick_period;
+	if (period == 0) {
+		period = survive_timestamp_ticks_period();
+	}
+	return ticks * period;
+}
+
+// Compare and swap on the FLT's bit pattern; sums when 'max' is false, otherwise keeps the larger
+static void atomic_update_flt(FLT *p, FLT v, bool max) {
+	FLT cur, next;
+	if (sizeof(FLT) == sizeof(uint64_t)) {
+		volatile uint64_t *bits = (volatile uint64_t *)p;
+		uint64_t old = OGAtomicLoadU64(bits), seen, desired = 0;
+		for (;; old = seen) {
+			memcpy(&cur, &old, sizeof(cur));
+			next = max ? (v > cur ? v : cur) : cur + v;
+			if (next == cur && max) {
+				return;
+			}
+			memcpy(&desired, &next, sizeof(next));
+			if ((seen = OGAtomicCompareExchangeU64(bits, old, desired)) == old) {
+				return;
+			}
+		}
+	} else {
+		volatile uint32_t *bits = (volatile uint32_t *)p;
+		uint32_t old = OGAtomicLoadU32(bits), seen, desired = 0;
+		for (;; old = seen) {
+			memcpy(&cur, &old, sizeof(cur));
+			next = max ? (v > cur ? v : cur) : cur + v;
+			if (next == cur && max) {
+				return;
+			}
+			memcpy(&desired, &next, sizeof(next));
+			if ((seen = OGAtomicCompareExchangeU32(bits, old, desired)) == old) {
+				return;
+			}
+		}
+	}
+}
+
+void survive_hook_call_time_add(FLT *call_time, FLT *max_call_time, FLT this_time) {
+	atomic_update_flt(max_call_time, this_time, true);
+	atomic_update_flt(call_time, this_time, false);
+}
+
+uint64_t survive_latency_histogram_percentile(const survive_latency_histogram *h, FLT percentile) {
+	// Other threads might be adding to it; go by the buckets rather than 'count' so the two can't disagree
+	uint64_t total = 0;
+	for (size_t i = 0; i < SURVIVE_LATENCY_BUCKETS; i++) {
+		total += h->buckets[i];
+	}
+	if (total == 0) {
+		return 0;
+	}
+
+	uint64_t target = (uint64_t)ceil(percentile / 100. * total);
+	if (target < 1) {
+		target = 1;
+	}
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < SURVIVE_LATENCY_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= target) {
+			// The top bucket holds the max, which is known exactly
+			if (seen >= total) {
+				return h->max_ticks;
+			}
+			uint64_t v = survive_latency_bucket_lower(i) + survive_latency_bucket_width(i) / 2;
+			return v > h->max_ticks ? h->max_ticks : v;
+		}
+	}
+	return h->max_ticks;
+}
+
+void survive_latency_histogram_merge(survive_latency_histogram *dst, const survive_latency_histogram *src) {
+	for (size_t i = 0; i < SURVIVE_LATENCY_BUCKETS; i++) {
+		dst->buckets[i] += src->buckets[i];
+	}
+	dst->count += src->count;
+	dst->total_ticks += src->total_ticks;
+	if (src->max_ticks > dst->max_ticks)
+		dst->max_ticks = src->max_ticks;
+}
+
+void survive_motion_to_pose_record(SurviveObject *so, const PoserData *pd) {
+	SurviveContext *ctx = so->ctx;
+	if (pd->received_us == 0 || ctx->hook_latency == 0 || so->hook_latency == 0) {
+		return;
+	}
+
+	survive_us now = OGGetAbsoluteTimeUS();
+	if (now < pd->received_us || now - pd->received_us > MAX_PLAUSIBLE_LATENCY_US) {
+		return;
+	}
+
+	survive_us latency_us = now - pd->received_us;
+	uint64_t ticks = (uint64_t)(latency_us * 1e-6 / survive_timestamp_ticks_period());
+	survive_latency_histogram_add(&ctx->hook_latency->motion_to_pose, ticks);
+	survive_latency_histogram_add(&so->hook_latency->motion_to_pose, ticks);
+
+	FLT warn_ms = ctx->hook_latency->warn_ms;
+	if (warn_ms > 0 && latency_us > warn_ms * 1000.) {
+		struct survive_hook_latency *latency = so->hook_latency;
+		uint32_t late_cnt = OGAtomicAddU32(&latency->late_cnt, 1);
+		OGAtomicAddU32(&ctx->hook_latency->late_cnt, 1);
+		if (latency->last_late_warning + 1000000 < now) {
+			SV_WARN("%s is falling behind real time; pose published %.1fms after its data arrived (%u late so far)",
+					survive_colorize_codename(so), latency_us / 1000., late_cnt);
+			latency->last_late_warning = now;
+		}
+	}
+}
+
+static const char *hook_names[] = {
+#define SURVIVE_HOOK_PROCESS_DEF(hook) #hook,
+#include "survive_hooks.h"
+};
+
+const char *survive_hook_name(enum SurviveHookId hook) {
+	if ((int)hook < 0 || hook >= SURVIVE_HOOK_COUNT) {
+		return 0;
+	}
+	return hook_names[hook];
+}
+
+int survive_hook_id(const char *name) {
+	for (int i = 0; i < SURVIVE_HOOK_COUNT; i++) {
+		if (strcmp(hook_names[i], name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static const survive_latency_histogram *find_histogram(const SurviveContext *ctx, const SurviveObject *so,
+													   enum SurviveHookId hook) {
+	if ((int)hook < 0 || hook >= SURVIVE_HOOK_COUNT || ctx->hook_latency == 0) {
+		return 0;
+	}
+	const struct survive_hook_latency *latency = so ? so->hook_latency : ctx->hook_latency;
+	return latency ? &latency->hooks[hook] : 0;
+}
+
+static void summarize(const survive_latency_histogram *h, SurviveHookLatency *latency) {
+	double period = survive_timestamp_ticks_period();
+	latency->count = h->count;
+	latency->mean = h->count ? h->total_ticks * period / h->count : 0;
+	latency->max = h->max_ticks * period;
+	latency->p50 = survive_latency_histogram_percentile(h, 50) * period;
+	latency->p90 = survive_latency_histogram_percentile(h, 90) * period;
+	latency->p99 = survive_latency_histogram_percentile(h, 99) * period;
+	latency->p999 = survive_latency_histogram_percentile(h, 99.9) * period;
+}
+
+bool survive_motion_to_pose_latency(const SurviveContext *ctx, const SurviveObject *so, SurviveHookLatency *latency) {
+	const struct survive_hook_latency *l = ctx->hook_latency ? (so ? so->hook_latency : ctx->hook_latency) : 0;
+	if (l == 0) {
+		return false;
+	}
+	summarize(&l->motion_to_pose, latency);
+	return true;
+}
+
+bool survive_hook_latency(const SurviveContext *ctx, const SurviveObject *so, enum SurviveHookId hook,
+						  SurviveHookLatency *latency) {
+	const survive_latency_histogram *h = find_histogram(ctx, so, hook);
+	if (h == 0) {
+		return false;
+	}
+	summarize(h, latency);
+	return true;
+}
+
+FLT survive_hook_latency_percentile(const SurviveContext *ctx, const SurviveObject *so, enum SurviveHookId hook,
+									FLT percentile) {
+	const survive_latency_histogram *h = find_histogram(ctx, so, hook);
+	if (h == 0) {
+		return 0;
+	}
+	return survive_latency_histogram_percentile(h, percentile) * survive_timestamp_ticks_period();
+}
+
+void survive_hook_latency_reset(SurviveContext *ctx) {
+	for (struct survive_hook_latency *latency = ctx->hook_latency; latency; latency = latency->next) {
+		memset(latency->hooks, 0, sizeof(latency->hooks));
+		memset(&latency->motion_to_pose, 0, sizeof(latency->motion_to_pose));
+		latency->late_cnt = 0;
+	}
+}
+
+static void write_json_latency(FILE *f, const char *name, const survive_latency_histogram *h) {
+	SurviveHookLatency l;
+	summarize(h, &l);
+	fprintf(f,
+			",\n\t\t\"%s\": {\"count\": %" PRIu64 ", \"mean_us\": %.3f, \"max_us\": %.3f, \"p50_us\": %.3f, "
+			"\"p90_us\": %.3f, \"p99_us\": %.3f, \"p999_us\": %.3f}",
+			name, l.count, l.mean * 1e6, l.max * 1e6, l.p50 * 1e6, l.p90 * 1e6, l.p99 * 1e6,
+			l.p999 * 1e6);
+}
+
+static void write_json_hooks(const struct survive_hook_latency *latency, FILE *f) {
+	fprintf(f, "{\n\t\t\"late_cnt\": %u", latency->late_cnt);
+	write_json_latency(f, "motion_to_pose", &latency->motion_to_pose);
+	for (int i = 0; i < SURVIVE_HOOK_COUNT; i++) {
+		if (latency->hooks[i].count != 0) {
+			write_json_latency(f, hook_names[i], &latency->hooks[i]);
+		}
+	}
+	fprintf(f, "\n\t}");
+}
+
+void survive_hook_latency_write_json(const SurviveContext *ctx, FILE *f) {
+	fprintf(f, "{\n\t\"tick_period\": %.6e", survive_timestamp_ticks_period());
+	if (ctx->hook_latency) {
+		fprintf(f, ",\n\t\"context\": ");
+		write_json_hooks(ctx->hook_latency, f);
+		fprintf(f, ",\n\t\"objects\": {");
+		for (const struct survive_hook_latency *latency = ctx->hook_latency->next; latency; latency = latency->next) {
+			fprintf(f, "%s\n\t\t\"%s\": ", latency == ctx->hook_latency->next ? "" : ",", latency->name);
+			write_json_hooks(latency, f);
+		}
+		fprintf(f, "\n\t}");
+	}
+	fprintf(f, "\n}\n");
+}
+
+void survive_hook_latency_init(SurviveContext *ctx) {
+	if (!survive_configi(ctx, HOOK_LATENCY_TAG, SC_GET, 0)) {
+		return;
+	}
+	survive_timestamp_ticks_period();
+	ctx->hook_latency = SV_CALLOC(sizeof(struct survive_hook_latency));
+	strcpy(ctx->hook_latency->name, "context");
+	ctx->hook_latency->warn_ms = survive_configf(ctx, MOTION_TO_POSE_WARN_TAG, SC_GET, 50.);
+}
+
+void survive_hook_latency_add_object(SurviveContext *ctx, SurviveObject *so) {
+	if (ctx->hook_latency == 0) {
+		return;
+	}
+
+	// Reconnecting devices pick their old histograms back up
+	struct survive_hook_latency *latency = ctx->hook_latency;
+	while (latency->next && strcmp(latency->next->name, so->codename) != 0) {
+		latency = latency->next;
+	}
+	if (latency->next == 0) {
+		struct survive_hook_latency *added = SV_CALLOC(sizeof(struct survive_hook_latency));
+		strncpy(added->name, so->codename, sizeof(added->name) - 1);
+		latency->next = added;
+	}
+	so->hook_latency = latency->next;
+}
+
+void survive_hook_latency_close(SurviveContext *ctx) {
+	const char *path = survive_configs(ctx, HOOK_LATENCY_JSON_TAG, SC_GET, "");
+	if (ctx->hook_latency && path && *path) {
+		FILE *f = fopen(path, "w");
+		if (f) {
+			survive_hook_latency_write_json(ctx, f);
+			fclose(f);
+		} else {
+			SV_WARN("Could not open %s to write hook latencies", path);
+		}
+	}
+
+	struct survive_hook_latency *latency = ctx->hook_latency;
+	ctx->hook_latency = 0;
+	while (latency) {
+		struct survive_hook_latency *next = latency->next;
+		free(latency);
+		latency = next;
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "os_generic.h"
+#include "survive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Log-linear (HDR style) histogram of survive_timestamp_ticks durations. Values below 16 ticks get a bucket each; past
+ * that every power of two is split into 16 buckets, so a bucket is never wider than 1/16th of the values in it.
+ * Durations of 2^40 ticks or more -- minutes on any of the clocks used -- land in the last bucket.
+ *
+ * Counts and totals are updated atomically, so hooks running on several threads don't lose samples; the max can
+ * briefly lose out to a concurrent smaller one.
+ */
+#define SURVIVE_LATENCY_SUB_BUCKET_BITS 4
+#define SURVIVE_LATENCY_SUB_BUCKETS (1 << SURVIVE_LATENCY_SUB_BUCKET_BITS)
+#define SURVIVE_LATENCY_MAX_BITS 40
+#define SURVIVE_LATENCY_BUCKETS                                                                                        \
+	((SURVIVE_LATENCY_MAX_BITS - SURVIVE_LATENCY_SUB_BUCKET_BITS + 1) * SURVIVE_LATENCY_SUB_BUCKETS)
+
+typedef struct survive_latency_histogram {
+	volatile uint64_t count, total_ticks, max_ticks;
+	volatile uint32_t buckets[SURVIVE_LATENCY_BUCKETS];
+} survive_latency_histogram;
+
+// Histograms for every hook, either for the whole context or for one object
+struct survive_hook_latency {
+	char name[32];
+	survive_latency_histogram hooks[SURVIVE_HOOK_COUNT];
+
+	// From survive_received_time of the data to the pose computed from it being published
+	survive_latency_histogram motion_to_pose;
+	volatile uint32_t late_cnt;
+	survive_us last_late_warning;
+	// Only set on the context's entry; 0 disables the late warning
+	FLT warn_ms;
+
+	struct survive_hook_latency *next;
+};
+
+static inline int survive_latency_msb(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+	return 63 - __builtin_clzll(v);
+#else
+	int msb = 0;
+	while (v >>= 1)
+		msb++;
+	return msb;
+#endif
+}
+
+static inline size_t survive_latency_bucket(uint64_t ticks) {
+	if (ticks < SURVIVE_LATENCY_SUB_BUCKETS) {
+		return (size_t)ticks;
+	}
+	if (ticks >> SURVIVE_LATENCY_MAX_BITS) {
+		return SURVIVE_LATENCY_BUCKETS - 1;
+	}
+	int shift = survive_latency_msb(ticks) - SURVIVE_LATENCY_SUB_BUCKET_BITS;
+	return (shift + 1) * SURVIVE_LATENCY_SUB_BUCKETS + (size_t)((ticks >> shift) - SURVIVE_LATENCY_SUB_BUCKETS);
+}
+
+static inline uint64_t survive_latency_bucket_lower(size_t bucket) {
+	if (bucket < SURVIVE_LATENCY_SUB_BUCKETS) {
+		return bucket;
+	}
+	int shift = (int)(bucket / SURVIVE_LATENCY_SUB_BUCKETS) - 1;
+	return (uint64_t)(SURVIVE_LATENCY_SUB_BUCKETS + bucket % SURVIVE_LATENCY_SUB_BUCKETS) << shift;
+}
+
+static inline uint64_t survive_latency_bucket_width(size_t bucket) {
+	if (bucket < SURVIVE_LATENCY_SUB_BUCKETS) {
+		return 1;
+	}
+	return (uint64_t)1 << (bucket / SURVIVE_LATENCY_SUB_BUCKETS - 1);
+}
+
+static inline void survive_latency_histogram_add(survive_latency_histogram *h, uint64_t ticks) {
+	OGAtomicAddU32(&h->buckets[survive_latency_bucket(ticks)], 1);
+	OGAtomicAddU64(&h->count, 1);
+	OGAtomicAddU64(&h->total_ticks, ticks);
+	for (uint64_t max = OGAtomicLoadU64(&h->max_ticks), seen; ticks > max; max = seen) {
+		if ((seen = OGAtomicCompareExchangeU64(&h->max_ticks, max, ticks)) == max)
+			break;
+	}
+}
+
+/**
+ * @param percentile in [0, 100]
+ * @return the middle of the bucket holding the given percentile, in ticks. Never more than the largest value added.
+ */
+SURVIVE_EXPORT uint64_t survive_latency_histogram_percentile(const survive_latency_histogram *h, FLT percentile);
+SURVIVE_EXPORT void survive_latency_histogram_merge(survive_latency_histogram *dst,
+													 const survive_latency_histogram *src);
+
+void survive_hook_latency_init(SurviveContext *ctx);
+void survive_hook_latency_add_object(SurviveContext *ctx, SurviveObject *so);
+// Called right before a pose computed from 'pd' is published for 'so'
+void survive_motion_to_pose_record(SurviveObject *so, const PoserData *pd);
+// Writes out 'hook-latency-json' if it is set, and frees all of the histograms
+void survive_hook_latency_close(SurviveContext *ctx);
+
+#ifdef __cplusplus
+}
+#endif
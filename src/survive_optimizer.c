@@ -14,8 +14,12 @@
 
 #include "mpfit/mpfit.h"
 #include "survive_default_devices.h"
+#include "os_generic.h"
+#include "survive_internal.h"
 #include "survive_kalman_tracker.h"
+#include "survive_private.h"
 #include "survive_recording.h"
+#include "survive_thread_pool.h"
 
 #if !defined(__FreeBSD__) && !defined(__APPLE__)
 #include <cnmatrix/cn_matrix.h>
@@ -34,6 +38,10 @@ STATIC_CONFIG_ITEM(OPTIMIZER_MAXITER, "optimizer-maxiter", 'i', "Maximum iterati
 STATIC_CONFIG_ITEM(OPTIMIZER_MAXFEV, "optimizer-maxfev", 'i', "Maximum function evals", 0)
 STATIC_CONFIG_ITEM(OPTIMIZER_NORMTOL, "optimizer-normtol", 'f', "Convergence for norm", 0.00005)
 STATIC_CONFIG_ITEM(OPTIMIZER_NPRINT, "optimizer-nprint", 'i', "", 0)
+STATIC_CONFIG_ITEM(OPTIMIZER_THREADS, "optimizer-threads", 'i',
+				   "Threads evaluating the optimizer's cost function on large problems. Solves match running on one; the "
+				   "reported error stats can differ by rounding.",
+				   1)
 
 STRUCT_CONFIG_SECTION(survive_optimizer_settings)
 	STRUCT_CONFIG_ITEM("mpfit-disable-filter", "Model mpfit as quaternion", 0, t->disable_filter)
@@ -44,6 +52,12 @@ STRUCT_CONFIG_SECTION(survive_optimizer_settings)
 	STRUCT_CONFIG_ITEM("mpfit-optimize-scale-threshold", "Treat scale as mutable", -1, t->optimize_scale_threshold)
 	STRUCT_CONFIG_ITEM("mpfit-current-pos-bias", "", -1, t->current_pos_bias)
 	STRUCT_CONFIG_ITEM("mpfit-current-rot-bias", "", -1, t->current_rot_bias)
+	STRUCT_CONFIG_ITEM("mpfit-sparse-solver", "Solve with the block sparse LM backend instead of mpfit", 0,
+					   t->sparse_solver)
+	STRUCT_CONFIG_ITEM("mpfit-robust-loss", "Robust loss for light residuals; 0 none, 1 Huber, 2 Cauchy", 0,
+					   t->robust_loss)
+	STRUCT_CONFIG_ITEM("mpfit-robust-scale", "Light error, in sigmas, past which the robust loss down weights", 2,
+					   t->robust_scale)
 END_STRUCT_CONFIG_SECTION(survive_optimizer_settings)
 
 static char *object_parameter_names[] = {"Pose x",	   "Pose y",	 "Pose z",	  "Pose Rot w",
@@ -97,6 +111,22 @@ FLT get_lighthouse_correction_for(survive_optimizer *optimizer, int obj, int lh,
 	return optimizer->parameters[idx];
 }
 
+// Negative use_jacobian_function has mpfit check the analytic derivative against finite differences, taken with
+// debug_step if it is set
+static void setup_param_jacobian(struct mp_par_struct *info, int use_jacobian_function, FLT tol, FLT debug_step) {
+	if (use_jacobian_function < 0) {
+		info->side = 2;
+		info->deriv_debug = 1;
+		info->deriv_abstol = tol;
+		info->deriv_reltol = tol;
+		if (debug_step > 0) {
+			info->step = debug_step;
+		}
+	} else if (use_jacobian_function > 0) {
+		info->side = 3;
+	}
+}
+
 void survive_optimizer_setup_pose_n(survive_optimizer *mpfit_ctx, const SurvivePose *pose, size_t n, bool isFixed,
 									int use_jacobian_function) {
 	if (pose)
@@ -110,27 +140,18 @@ void survive_optimizer_setup_pose_n(survive_optimizer *mpfit_ctx, const SurviveP
 		mpfit_ctx->mp_parameters_info[i].fixed = isFixed;
 		mpfit_ctx->mp_parameters_info[i].parname = object_parameter_names[i % 7];
 
-		if (use_jacobian_function != 0) {
-			assert(mpfit_ctx->reprojectModel->reprojectAxisAngleFullJacObjPose);
-			if (use_jacobian_function < 0) {
-				mpfit_ctx->mp_parameters_info[i].side = 2;
-				mpfit_ctx->mp_parameters_info[i].deriv_debug = 1;
-				mpfit_ctx->mp_parameters_info[i].deriv_abstol = .01;
-				mpfit_ctx->mp_parameters_info[i].deriv_reltol = .01;
-				mpfit_ctx->mp_parameters_info[i].step = 1e-3;
-			} else {
-				mpfit_ctx->mp_parameters_info[i].side = 3;
-			}
-		}
+		assert(use_jacobian_function == 0 || mpfit_ctx->reprojectModel->reprojectAxisAngleFullJacObjPose);
+		setup_param_jacobian(&mpfit_ctx->mp_parameters_info[i], use_jacobian_function, .01, 1e-3);
 	}
 
 	if (!mpfit_ctx->disableVelocity) {
-		int v_idx = survive_optimizer_get_velocity_index(mpfit_ctx);
+		int v_idx = survive_optimizer_get_velocity_index(mpfit_ctx) + n * 6;
 		survive_optimizer_get_velocity(mpfit_ctx)[n] = (SurviveVelocity){0};
 		for (int i = 0; i < 6; i++) {
 			mpfit_ctx->mp_parameters_info[i + v_idx].fixed = true;
 			mpfit_ctx->mp_parameters_info[i + v_idx].parname = vel_parameter_names[i % 6];
 			mpfit_ctx->mp_parameters_info[i + v_idx].side = 0;
+			setup_param_jacobian(&mpfit_ctx->mp_parameters_info[i + v_idx], use_jacobian_function, 1e-4, 0);
 		}
 	}
 	survive_optimizer_parameter * lh_correction = survive_optimizer_get_start_parameter_info(mpfit_ctx, survive_optimizer_parameter_object_lighthouse_correction);
@@ -148,19 +169,7 @@ void survive_optimizer_setup_pose_n(survive_optimizer *mpfit_ctx, const SurviveP
 					p_info->fixed = true;
 					lh_obj_params[lh * SURVIVE_CORRECTION_PARAMS + axis] = so->lh_correction[lh][axis];
 					p_info->step = 1e-5;
-
-					if (use_jacobian_function != 0 && axis != 2) {
-						if (use_jacobian_function < 0) {
-							p_info->side = 2;
-							p_info->deriv_debug = 1;
-							p_info->deriv_abstol = 1e-4;
-							p_info->deriv_reltol = 1e-4;
-							//p_info->step = 1e-1;
-						} else {
-							p_info->side = 3;
-						}
-					}
-
+					setup_param_jacobian(p_info, use_jacobian_function, 1e-4, 0);
 				}
 			}
 		}
@@ -174,16 +183,7 @@ void survive_optimizer_setup_pose_n(survive_optimizer *mpfit_ctx, const SurviveP
 			pinfo->fixed = mpfit_ctx->settings->optimize_scale_threshold > mpfit_ctx->sos[n]->sensor_scale_var;
 			pinfo->parname = "scale";
 
-			if (use_jacobian_function != 0) {
-				if (use_jacobian_function < 0) {
-					pinfo->side = 2;
-					pinfo->deriv_debug = 1;
-					pinfo->deriv_abstol = .0001;
-					pinfo->deriv_reltol = .0001;
-				} else {
-					pinfo->side = 3;
-				}
-			}
+			setup_param_jacobian(pinfo, use_jacobian_function, 1e-4, 0);
 
 			pinfo->limited[0] = pinfo->limited[1] = true;
 			pinfo->limits[0] = 1 - .1;
@@ -287,18 +287,8 @@ void survive_optimizer_setup_camera(survive_optimizer *mpfit_ctx, int8_t lh, con
 		mpfit_ctx->mp_parameters_info[i].fixed = (isFixed || poseIsInvalid);
 		mpfit_ctx->mp_parameters_info[i].parname = lh_parameter_names[i - start];
 
-		if (use_jacobian_function != 0 &&
-			mpfit_ctx->reprojectModel
-				->reprojectAxisAngleFullJacLhPose /*mpfit_ctx->reprojectModel->reprojectFullJacLhPose*/) {
-			if (use_jacobian_function < 0) {
-				mpfit_ctx->mp_parameters_info[i].side = 2;
-				mpfit_ctx->mp_parameters_info[i].deriv_debug = 1;
-				mpfit_ctx->mp_parameters_info[i].deriv_abstol = .0001;
-				mpfit_ctx->mp_parameters_info[i].deriv_reltol = .0001;
-				mpfit_ctx->mp_parameters_info[i].step = .0001;
-			} else {
-				mpfit_ctx->mp_parameters_info[i].side = 3;
-			}
+		if (mpfit_ctx->reprojectModel->reprojectAxisAngleFullJacLhPose) {
+			setup_param_jacobian(&mpfit_ctx->mp_parameters_info[i], use_jacobian_function, 1e-4, 1e-4);
 		}
 	}
 }
@@ -331,6 +321,9 @@ void survive_optimizer_setup_cameras(survive_optimizer *mpfit_ctx, SurviveContex
 	for (int i = start; i < start + 2 * sizeof(BaseStationCal) / sizeof(FLT) * mpfit_ctx->cameraLength; i++) {
 		mpfit_ctx->mp_parameters_info[i].parname = "Fcal parameter";
 		mpfit_ctx->mp_parameters_info[i].fixed = true;
+		if (mpfit_ctx->reprojectModel->reprojectAxisAngleAxisJacobCalFn[0]) {
+			setup_param_jacobian(&mpfit_ctx->mp_parameters_info[i], use_jacobian_function, 1e-4, 0);
+		}
 	}
 }
 
@@ -451,32 +444,125 @@ static void ApplyDualPoseToPoint(const survive_optimizer *mpfit_ctx, LinmathVec3
     }
 }
 
+// How the pose a measurement sees depends on the object's velocity; idx is -1 when there is no velocity block
+typedef struct velocity_jac {
+	int idx;
+	FLT dt;
+	// d rotation / d angular velocity; ang_size x 3
+	FLT rot[4 * 3];
+} velocity_jac;
+
+static inline bool needs_derivs(FLT **derivs, int idx, int cnt) {
+	bool rtn = false;
+	for (int i = 0; i < cnt && idx >= 0 && derivs; i++) {
+		rtn |= derivs[idx + i] != 0;
+	}
+	return rtn;
+}
+
+// d deviate / d velocity from jac_pose, the derivative of the reprojection w.r.t. the pose at the measurement time
+static void write_velocity_derivs(const velocity_jac *vel_jac, int ang_size, const FLT *jac_pose, FLT variance,
+								  FLT **derivs, size_t meas_idx) {
+	for (int j = 0; j < 3; j++) {
+		if (derivs[vel_jac->idx + j]) {
+			derivs[vel_jac->idx + j][meas_idx] = fix_infinity(jac_pose[j] * vel_jac->dt / variance);
+		}
+		if (derivs[vel_jac->idx + 3 + j]) {
+			FLT d = dotnd_strided(jac_pose + 3, vel_jac->rot + j, ang_size, 1, 3);
+			derivs[vel_jac->idx + 3 + j][meas_idx] = fix_infinity(d / variance);
+		}
+	}
+}
+
+// d deviate / d calibration for the lighthouse and axis of meas
+static void write_calibration_derivs(survive_optimizer *mpfunc_ctx, const survive_optimizer_measurement *meas,
+									 const LinmathDualPose *obj2world, const FLT *pt, const LinmathDualPose *world2lh,
+									 const BaseStationCal *cal, FLT **derivs, size_t meas_idx) {
+	const int cal_size = sizeof(BaseStationCal) / sizeof(FLT);
+	int cal_idx = survive_optimizer_get_calibration_index(mpfunc_ctx);
+	if (cal_idx < 0) {
+		return;
+	}
+	cal_idx += (2 * meas->light.lh + meas->light.axis) * cal_size;
+	if (!needs_derivs(derivs, cal_idx, cal_size)) {
+		return;
+	}
+
+	const survive_reproject_model_t *reprojectModel = mpfunc_ctx->reprojectModel;
+	int axis = meas->light.axis;
+	FLT out[sizeof(BaseStationCal) / sizeof(FLT)] = {0};
+	if (mpfunc_ctx->settings->use_quat_model) {
+		reprojectModel->reprojectAxisJacobCalFn[axis](out, &obj2world->quatPose, pt, &world2lh->quatPose, cal + axis);
+	} else {
+		reprojectModel->reprojectAxisAngleAxisJacobCalFn[axis](out, &obj2world->axisAnglePose, pt,
+															   &world2lh->axisAnglePose, cal + axis);
+	}
+	for (int j = 0; j < cal_size; j++) {
+		if (derivs[cal_idx + j]) {
+			derivs[cal_idx + j][meas_idx] = fix_infinity(out[j] / meas->variance);
+		}
+	}
+}
+
+/**
+ * d angle / d obj2world and d angle / d world2lh, 7 each, from pt_jac; d angle / d the sensor point in the lighthouse
+ * frame as the batch jacobian functions give it. Agrees with the model's generated pose jacobians; the rotations are
+ * chained in through the same unnormalized quaternion rotation the generated code differentiates.
+ */
+static void light_pose_jacobians(FLT *jac_obj, FLT *jac_lh, const FLT *pt_jac, const SurvivePose *obj2world,
+								 const FLT *pt, const SurvivePose *world2lh) {
+	LinmathPoint3d ptInWorld;
+	gen_quatrotatevector(ptInWorld, obj2world->Rot, pt);
+	add3d(ptInWorld, ptInWorld, obj2world->Pos);
+
+	FLT lh_rot_jac_pt[9], obj_rot_jac_q[12], lh_rot_jac_q[12];
+	gen_quatrotatevector_jac_pt(lh_rot_jac_pt, world2lh->Rot, ptInWorld);
+	gen_quatrotatevector_jac_q(obj_rot_jac_q, obj2world->Rot, pt);
+	gen_quatrotatevector_jac_q(lh_rot_jac_q, world2lh->Rot, ptInWorld);
+
+	for (int j = 0; j < 3; j++) {
+		jac_obj[j] = dotnd_strided(pt_jac, lh_rot_jac_pt + j, 3, 1, 3);
+		jac_lh[j] = pt_jac[j];
+	}
+	for (int j = 0; j < 4; j++) {
+		jac_obj[3 + j] = dotnd_strided(jac_obj, obj_rot_jac_q + j, 3, 1, 4);
+		jac_lh[3 + j] = dotnd_strided(pt_jac, lh_rot_jac_q + j, 3, 1, 4);
+	}
+}
+
 static inline void run_pair_measurement(survive_optimizer *mpfunc_ctx, size_t meas_idx,
 										const survive_optimizer_measurement *meas, const CnMat *ang_vel_jacb,
-										const LinmathDualPose *obj2world, const LinmathDualPose *obj2lh,
-										const LinmathDualPose *world2lh, const FLT *pt, FLT *deviates, FLT **derivs) {
+										const velocity_jac *vel_jac, const LinmathDualPose *obj2world,
+										const LinmathDualPose *obj2lh, const LinmathDualPose *world2lh,
+										const FLT *pt, const FLT *predicted, const FLT *predicted_jac, FLT *deviates,
+										FLT **derivs) {
 	const survive_reproject_model_t *reprojectModel = mpfunc_ctx->reprojectModel;
 	const int lh = meas->light.lh;
 	const struct BaseStationCal *cal = survive_optimizer_get_calibration(mpfunc_ctx, lh);
 
-	LinmathPoint3d sensorPtInLH;
-    ApplyDualPoseToPoint(mpfunc_ctx, sensorPtInLH, obj2lh, pt);
-
 	FLT out[2];
-	reprojectModel->reprojectXY(cal, sensorPtInLH, out);
 	assert(meas[0].light.axis == 0);
 	assert(meas[1].light.axis == 1);
+	if (predicted) {
+		out[0] = predicted[0];
+		out[1] = predicted[1];
+	} else {
+		LinmathPoint3d sensorPtInLH;
+		ApplyDualPoseToPoint(mpfunc_ctx, sensorPtInLH, obj2lh, pt);
+
+		reprojectModel->reprojectXY(cal, sensorPtInLH, out);
 #ifndef NDEBUG
-	if (reprojectModel->reprojectAxisFn[0]) {
-		/*FLT check[] = {reprojectModel->reprojectAxisangleFullXyFn[0](obj2lh, pt, world2lh, cal),
-					   reprojectModel->reprojectAxisangleFullXyFn[1](obj2lh, pt, world2lh, cal + 1)};
-					   */
-		FLT check[] = {reprojectModel->reprojectAxisFn[0](cal, sensorPtInLH),
-					   reprojectModel->reprojectAxisFn[1](cal, sensorPtInLH)};
-		for (int i = 0; i < 2; i++)
-			assert(fabs(check[i] - out[i]) < 1e-5);
-	}
+		if (reprojectModel->reprojectAxisFn[0]) {
+			/*FLT check[] = {reprojectModel->reprojectAxisangleFullXyFn[0](obj2lh, pt, world2lh, cal),
+						   reprojectModel->reprojectAxisangleFullXyFn[1](obj2lh, pt, world2lh, cal + 1)};
+						   */
+			FLT check[] = {reprojectModel->reprojectAxisFn[0](cal, sensorPtInLH),
+						   reprojectModel->reprojectAxisFn[1](cal, sensorPtInLH)};
+			for (int i = 0; i < 2; i++)
+				assert(fabs(check[i] - out[i]) < 1e-5);
+		}
 #endif
+	}
 
 	for (int i = 0; i < 2; i++) {
 		FLT correction = get_lighthouse_correction_for(mpfunc_ctx, meas->light.object, meas->light.lh, i);
@@ -498,6 +584,7 @@ static inline void run_pair_measurement(survive_optimizer *mpfunc_ctx, size_t me
 			needsJacLH |= derivs[jac_offset_lh+i] != 0;
 			needsJacObj |= derivs[jac_offset_obj+i] != 0;
 		}
+		bool needsJacVel = needs_derivs(derivs, vel_jac->idx, 6);
 
 		for(int i = 0;i < 2;i++) {
 			int p_idx = get_lighthouse_correction_idx_for(mpfunc_ctx, meas->light.object, meas->light.lh, i);
@@ -514,20 +601,36 @@ static inline void run_pair_measurement(survive_optimizer *mpfunc_ctx, size_t me
                 safe_world2lh.axisAnglePose.AxisAngleRot[0] = 1e-10;
         }
 
+		// The batch jacobians are only there without velocity and with the quat model; see can_batch_jacobians
+		FLT batch_jac_obj[7 * 2], batch_jac_lh[7 * 2];
+		if (predicted_jac && (needsJacObj || needsJacLH)) {
+			for (int i = 0; i < 2; i++) {
+				light_pose_jacobians(batch_jac_obj + i * 7, batch_jac_lh + i * 7, predicted_jac + i * 3,
+									 &obj2world->quatPose, pt, &world2lh->quatPose);
+			}
+		}
+
 		// d deviate / d Pose(t-)
 		// d Pose(t-) / d Pose(t)
-		if (needsJacObj) {
+		if (needsJacObj || needsJacVel) {
 			FLT jout[7 * 2] = {0};
-            if(mpfunc_ctx->settings->use_quat_model) {
+			if (predicted_jac) {
+				memcpy(jout, batch_jac_obj, sizeof(batch_jac_obj));
+			} else if (mpfunc_ctx->settings->use_quat_model) {
                 reprojectModel->reprojectFullJacObjPose(jout, &obj2world->quatPose, pt, &world2lh->quatPose, cal);
             } else {
                 reprojectModel->reprojectAxisAngleFullJacObjPose(jout, &obj2world->axisAnglePose, pt, &world2lh->axisAnglePose, cal);
             }
+			int ang_size = pose_size - 3;
+			if (needsJacVel) {
+				write_velocity_derivs(vel_jac, ang_size, jout, meas[0].variance, derivs, meas_idx);
+				write_velocity_derivs(vel_jac, ang_size, jout + pose_size, meas[1].variance, derivs, meas_idx + 1);
+			}
 			for (int i = 0; i < 2; i++) {
-				FLT tmp[6];
-				copy3d(tmp, jout + 3 + i * pose_size);
-				for (int j = 0; j < 3; j++) {
-					jout[3 + j + i * pose_size] = dotnd_strided(tmp, ang_vel_jacb->data + j * 1, 3, 1, 3);
+				FLT tmp[4];
+				memcpy(tmp, jout + 3 + i * pose_size, sizeof(FLT) * ang_size);
+				for (int j = 0; j < ang_size; j++) {
+					jout[3 + j + i * pose_size] = dotnd_strided(tmp, ang_vel_jacb->data + j * 1, ang_size, 1, ang_size);
 				}
 			}
 
@@ -547,7 +650,9 @@ static inline void run_pair_measurement(survive_optimizer *mpfunc_ctx, size_t me
 		// d deviate / d LH
 		if (needsJacLH) {
 			FLT out[7 * 2] = {0};
-            if(mpfunc_ctx->settings->use_quat_model) {
+			if (predicted_jac) {
+				memcpy(out, batch_jac_lh, sizeof(batch_jac_lh));
+			} else if (mpfunc_ctx->settings->use_quat_model) {
                 reprojectModel->reprojectFullJacLhPose(out, &obj2world->quatPose, pt, &world2lh->quatPose, cal);
             } else {
                 reprojectModel->reprojectAxisAngleFullJacLhPose(out, &obj2world->axisAnglePose, pt, &world2lh->axisAnglePose, cal);
@@ -559,22 +664,31 @@ static inline void run_pair_measurement(survive_optimizer *mpfunc_ctx, size_t me
 				}
 			}
 		}
+
+		for (int i = 0; i < 2; i++) {
+			write_calibration_derivs(mpfunc_ctx, &meas[i], obj2world, pt, world2lh, cal, derivs, meas_idx + i);
+		}
 	}
 }
 static void run_single_measurement(survive_optimizer *mpfunc_ctx, size_t meas_idx,
 								   const survive_optimizer_measurement *meas, const CnMat *ang_vel_jacb,
-								   const LinmathDualPose *obj2world, const LinmathDualPose *obj2lh,
-								   const LinmathDualPose *world2lh, const FLT *pt, FLT *deviates, FLT **derivs) {
+								   const velocity_jac *vel_jac, const LinmathDualPose *obj2world,
+								   const LinmathDualPose *obj2lh, const LinmathDualPose *world2lh, const FLT *pt,
+								   const FLT *predicted, const FLT *predicted_jac, FLT *deviates, FLT **derivs) {
 	const survive_reproject_model_t *reprojectModel = mpfunc_ctx->reprojectModel;
 	const int lh = meas->light.lh;
 
 	const struct BaseStationCal *cal = survive_optimizer_get_calibration(mpfunc_ctx, lh);
     int pose_size = mpfunc_ctx->settings->use_quat_model ? 7 : 6;
 
-	LinmathPoint3d sensorPtInLH;
-    ApplyDualPoseToPoint(mpfunc_ctx, sensorPtInLH, obj2lh, pt);
-
-	FLT out = reprojectModel->reprojectAxisFn[meas->light.axis](cal, sensorPtInLH);
+	FLT out;
+	if (predicted) {
+		out = *predicted;
+	} else {
+		LinmathPoint3d sensorPtInLH;
+		ApplyDualPoseToPoint(mpfunc_ctx, sensorPtInLH, obj2lh, pt);
+		out = reprojectModel->reprojectAxisFn[meas->light.axis](cal, sensorPtInLH);
+	}
 	FLT correction = get_lighthouse_correction_for(mpfunc_ctx, meas->light.object, meas->light.lh, meas->light.axis);
 	//SurviveObject * so = mpfunc_ctx->sos[meas->light.object];
 	//assert(so->lh_correction[meas->light.lh][meas->light.axis] == correction);
@@ -593,16 +707,26 @@ static void run_single_measurement(survive_optimizer *mpfunc_ctx, size_t meas_id
 			needsJacLH |= derivs[jac_offset_lh+i] != 0;
 			needsJacObj |= derivs[jac_offset_obj+i] != 0;
 		}
+		bool needsJacVel = needs_derivs(derivs, vel_jac->idx, 6);
 
 		int p_idx = get_lighthouse_correction_idx_for(mpfunc_ctx, meas->light.object, meas->light.lh, meas->light.axis);
 		if(p_idx > -1 && derivs[p_idx]) {
 			derivs[p_idx][meas_idx] = -1. / meas->variance;
 		}
 
+		// The batch jacobians are only there without velocity and with the quat model; see can_batch_jacobians
+		FLT batch_jac_obj[7], batch_jac_lh[7];
+		if (predicted_jac && (needsJacObj || needsJacLH)) {
+			light_pose_jacobians(batch_jac_obj, batch_jac_lh, predicted_jac, &obj2world->quatPose, pt,
+								 &world2lh->quatPose);
+		}
+
 		FLT out[7] = {0};
 		// d Deviate / d Pose[t - 1] * d Pose[t - 1] / d Pose[t]
-		if (needsJacObj) {
-		    if(mpfunc_ctx->settings->use_quat_model) {
+		if (needsJacObj || needsJacVel) {
+			if (predicted_jac) {
+				copynd(out, batch_jac_obj, 7);
+			} else if (mpfunc_ctx->settings->use_quat_model) {
                 reprojectModel->reprojectAxisJacobFn[meas->light.axis](out, &obj2world->quatPose, pt, &world2lh->quatPose,
                                                                                 cal + meas->light.axis);
 		    } else {
@@ -611,6 +735,9 @@ static void run_single_measurement(survive_optimizer *mpfunc_ctx, size_t meas_id
             }
 
             int ang_size = mpfunc_ctx->settings->use_quat_model ? 4 : 3;
+			if (needsJacVel) {
+				write_velocity_derivs(vel_jac, ang_size, out, meas->variance, derivs, meas_idx);
+			}
 			FLT tmp[4];
 			copynd(tmp, out + 3, ang_size);
 			for (int j = 0; j < ang_size; j++) {
@@ -625,7 +752,9 @@ static void run_single_measurement(survive_optimizer *mpfunc_ctx, size_t meas_id
 		}
 
 		if (needsJacLH) {
-            if(mpfunc_ctx->settings->use_quat_model) {
+			if (predicted_jac) {
+				copynd(out, batch_jac_lh, 7);
+			} else if (mpfunc_ctx->settings->use_quat_model) {
                 reprojectModel->reprojectAxisJacobLhPoseFn[meas->light.axis](out, &obj2world->quatPose, pt, &world2lh->quatPose,
                                                                                       cal + meas->light.axis);
             } else {
@@ -639,6 +768,8 @@ static void run_single_measurement(survive_optimizer *mpfunc_ctx, size_t meas_id
 				}
 			}
 		}
+
+		write_calibration_derivs(mpfunc_ctx, meas, obj2world, pt, world2lh, cal, derivs, meas_idx);
 	}
 }
 
@@ -820,21 +951,145 @@ static void handle_accel_meas(survive_optimizer *mpfunc_ctx, survive_optimizer_m
 	mpfunc_ctx->stats.object_up_error_cnt++;
 }
 
-static int mpfunc(int m, int n, FLT *p, FLT *deviates, FLT **derivs, void *private) {
-	survive_optimizer *mpfunc_ctx = private;
+// Scratch memory for the rest of the call; from the optimizer's workspace if it has one
+static void *scratch_alloc(survive_optimizer *optimizer, size_t size) {
+	return optimizer->workspace ? survive_optimizer_workspace_alloc(optimizer->workspace, size) : SV_MALLOC(size);
+}
+static void scratch_free(survive_optimizer *optimizer, void *ptr) {
+	if (optimizer->workspace == 0) {
+		free(ptr);
+	}
+}
 
-	assert(survive_optimizer_get_meas_size(mpfunc_ctx) == m);
-	assert(survive_optimizer_get_parameters_count(mpfunc_ctx) == n);
+static bool can_batch_reproject(const survive_optimizer *mpfunc_ctx) {
+	const survive_reproject_model_t *reprojectModel = mpfunc_ctx->reprojectModel;
+	// Velocity and scale corrections move the sensor points per measurement; those go through the per point path
+	return reprojectModel->reprojectAxisBatchFn[0] && reprojectModel->reprojectAxisBatchFn[1] &&
+		   mpfunc_ctx->disableVelocity && mpfunc_ctx->settings->optimize_scale_threshold < 0 &&
+		   mpfunc_ctx->settings->lh_scale_correction <= 0;
+}
 
-    mpfunc_ctx->stats.sensor_error = 0; mpfunc_ctx->stats.sensor_error_cnt = 0;
-    mpfunc_ctx->stats.object_up_error = 0; mpfunc_ctx->stats.object_up_error_cnt = 0;
-    mpfunc_ctx->stats.params_error = 0; mpfunc_ctx->stats.params_error_cnt = 0;
+// The batch jacobians are chained into the poses through the quaternion rotation; axis angle goes per point
+static bool can_batch_jacobians(const survive_optimizer *mpfunc_ctx) {
+	const survive_reproject_model_t *reprojectModel = mpfunc_ctx->reprojectModel;
+	return can_batch_reproject(mpfunc_ctx) && reprojectModel->reprojectAxisJacobBatchFn[0] &&
+		   reprojectModel->reprojectAxisJacobBatchFn[1] && mpfunc_ctx->settings->use_quat_model;
+}
 
-    mpfunc_ctx->parameters = p;
+/**
+ * Fills predicted[i] with the reprojected angle of every valid light measurement i, and if predicted_jac isn't null,
+ * predicted_jac[3 * i] with its derivative by the sensor point in the lighthouse frame. The sensor points are put in
+ * their lighthouse's frame the same way mpfunc does it, grouped by lighthouse and axis and then run through the
+ * model's batch functions. Returns false if there was nothing to do.
+ */
+static bool batch_reproject_light(survive_optimizer *mpfunc_ctx, FLT *predicted, FLT *predicted_jac) {
+	const survive_reproject_model_t *reprojectModel = mpfunc_ctx->reprojectModel;
+	LinmathDualPose *cameras = (LinmathDualPose *)survive_optimizer_get_camera(mpfunc_ctx);
+
+	size_t bucket_cnt[NUM_GEN2_LIGHTHOUSES * 2] = {0};
+	size_t light_cnt = 0;
+	for (int i = 0; i < mpfunc_ctx->measurementsCnt; i++) {
+		const survive_optimizer_measurement *meas = &mpfunc_ctx->measurements[i];
+		if (!meas->invalid && meas->meas_type == survive_optimizer_measurement_type_light) {
+			bucket_cnt[meas->light.lh * 2 + meas->light.axis]++;
+			light_cnt++;
+		}
+	}
+	if (light_cnt == 0) {
+		return false;
+	}
 
-	LinmathDualPose *cameras = (LinmathDualPose*)survive_optimizer_get_camera(mpfunc_ctx);
+	size_t bucket_start[NUM_GEN2_LIGHTHOUSES * 2 + 1] = {0};
+	for (int b = 0; b < NUM_GEN2_LIGHTHOUSES * 2; b++) {
+		bucket_start[b + 1] = bucket_start[b] + bucket_cnt[b];
+		bucket_cnt[b] = 0;
+	}
+
+	size_t jac_cnt = predicted_jac ? light_cnt * 3 : 0;
+	FLT *buffer = scratch_alloc(mpfunc_ctx, sizeof(FLT) * (light_cnt * 4 + jac_cnt) + sizeof(int) * light_cnt);
+	FLT *xs = buffer, *ys = xs + light_cnt, *zs = ys + light_cnt, *out = zs + light_cnt, *jac = out + light_cnt;
+	int *meas_for = (int *)(jac + jac_cnt);
+
+	int pose_idx = -1;
+	uint32_t obj2lh_valid = 0;
+	LinmathDualPose obj2world = {0};
+	LinmathDualPose obj2lh[NUM_GEN2_LIGHTHOUSES];
+	for (int i = 0; i < mpfunc_ctx->measurementsCnt; i++) {
+		const survive_optimizer_measurement *meas = &mpfunc_ctx->measurements[i];
+		if (meas->invalid || meas->meas_type != survive_optimizer_measurement_type_light) {
+			continue;
+		}
+
+		const int lh = meas->light.lh;
+		if (pose_idx != meas->light.object) {
+			pose_idx = meas->light.object;
+			assert(pose_idx < mpfunc_ctx->poseLength);
+			obj2world = *(LinmathDualPose *)(&survive_optimizer_get_pose(mpfunc_ctx)[pose_idx]);
+			if (mpfunc_ctx->settings->use_quat_model) {
+				quatnormalize(obj2world.quatPose.Rot, obj2world.quatPose.Rot);
+			}
+			obj2lh_valid = 0;
+		}
+		if ((obj2lh_valid & (1u << lh)) == 0) {
+			ApplyDualPoseToPose(mpfunc_ctx, &obj2lh[lh], &cameras[lh], &obj2world);
+			obj2lh_valid |= 1u << lh;
+		}
+
+		const FLT *sensor_points = survive_optimizer_get_sensors(mpfunc_ctx, meas->light.object);
+		LinmathPoint3d sensorPtInLH;
+		ApplyDualPoseToPoint(mpfunc_ctx, sensorPtInLH, &obj2lh[lh], &sensor_points[meas->light.sensor_idx * 3]);
+
+		int b = lh * 2 + meas->light.axis;
+		size_t slot = bucket_start[b] + bucket_cnt[b]++;
+		xs[slot] = sensorPtInLH[0];
+		ys[slot] = sensorPtInLH[1];
+		zs[slot] = sensorPtInLH[2];
+		meas_for[slot] = i;
+	}
+
+	for (int b = 0; b < NUM_GEN2_LIGHTHOUSES * 2; b++) {
+		size_t start = bucket_start[b];
+		if (bucket_cnt[b] == 0) {
+			continue;
+		}
+		const struct BaseStationCal *cal = survive_optimizer_get_calibration(mpfunc_ctx, b / 2);
+		if (predicted_jac) {
+			reprojectModel->reprojectAxisJacobBatchFn[b % 2](cal, xs + start, ys + start, zs + start, out + start,
+															  jac + start * 3, bucket_cnt[b]);
+		} else {
+			reprojectModel->reprojectAxisBatchFn[b % 2](cal, xs + start, ys + start, zs + start, out + start,
+														  bucket_cnt[b]);
+		}
+	}
+
+	for (size_t slot = 0; slot < light_cnt; slot++) {
+		predicted[meas_for[slot]] = out[slot];
+		if (predicted_jac) {
+			copy3d(predicted_jac + meas_for[slot] * 3, jac + slot * 3);
+		}
+	}
+
+	scratch_free(mpfunc_ctx, buffer);
+	return true;
+}
+
+// If the next two measurements are joined; handle the full pair. This lets us just calculate sensorPtInLH once
+static inline bool starts_light_pair(const survive_optimizer *mpfunc_ctx, int mea_block_idx, int block_end) {
+	const survive_optimizer_measurement *meas = &mpfunc_ctx->measurements[mea_block_idx];
+	return mea_block_idx + 1 < block_end && mpfunc_ctx->disableVelocity == true &&
+		   meas[1].meas_type == survive_optimizer_measurement_type_light && meas[0].light.axis == 0 &&
+		   meas[1].light.axis == 1 && meas[0].light.sensor_idx == meas[1].light.sensor_idx && !meas[1].invalid &&
+		   !mpfunc_ctx->settings->disallow_pair_calc;
+}
 
-	int start = survive_optimizer_get_camera_index(mpfunc_ctx);
+/**
+ * Evaluates the measurement blocks [block_start, block_end), the first of which starts at row meas_idx. Nothing
+ * carries over between calls, so any split of the measurements into ranges gives the same deviates and derivs.
+ */
+static void mpfunc_range(survive_optimizer *mpfunc_ctx, int block_start, int block_end, int meas_idx,
+						 const FLT *predicted, const FLT *predicted_jac, FLT *deviates, FLT **derivs) {
+	FLT *p = mpfunc_ctx->parameters;
+	LinmathDualPose *cameras = (LinmathDualPose*)survive_optimizer_get_camera(mpfunc_ctx);
 
 	int pose_idx = -1;
 	FLT calced_timecode = -1;
@@ -845,11 +1100,9 @@ static int mpfunc(int m, int n, FLT *p, FLT *deviates, FLT **derivs, void *priva
 	int pose_size = ang_size + 3;
 	CN_CREATE_STACK_MAT(ang_velocity_jac, ang_size, ang_size);
 	cn_set_diag_val(&ang_velocity_jac, 1);
+	velocity_jac vel_jac = {.idx = -1};
 
-	int meas_count = m;
-	int meas_idx = 0;
-
-	for (int mea_block_idx = 0; mea_block_idx < mpfunc_ctx->measurementsCnt; mea_block_idx++) {
+	for (int mea_block_idx = block_start; mea_block_idx < block_end; mea_block_idx++) {
 		survive_optimizer_measurement *meas = &mpfunc_ctx->measurements[mea_block_idx];
 
 		if (meas->invalid) {
@@ -875,11 +1128,7 @@ static int mpfunc(int m, int n, FLT *p, FLT *deviates, FLT **derivs, void *priva
 		case survive_optimizer_measurement_type_light: {
 			// If the next two measurements are joined; handle the full pair. This lets us just calculate
 			// sensorPtInLH once
-			const bool nextIsPair =
-				mea_block_idx + 1 < mpfunc_ctx->measurementsCnt && mpfunc_ctx->disableVelocity == true &&
-				meas[1].meas_type == survive_optimizer_measurement_type_light && meas[0].light.axis == 0 &&
-				meas[1].light.axis == 1 && meas[0].light.sensor_idx == meas[1].light.sensor_idx && !meas[1].invalid &&
-				!mpfunc_ctx->settings->disallow_pair_calc;
+			const bool nextIsPair = starts_light_pair(mpfunc_ctx, mea_block_idx, block_end);
 
 			const int lh = meas->light.lh;
 			const FLT *sensor_points = survive_optimizer_get_sensors(mpfunc_ctx, meas->light.object);
@@ -889,22 +1138,35 @@ static int mpfunc(int m, int n, FLT *p, FLT *deviates, FLT **derivs, void *priva
 			LinmathVec3d pt;
 			copy3d(pt, ptp);
 
-			// d a / d s = d a / d xyz * d xyz / d s
-			int scale_idx = -1;
+			// d a / d s = d a / d xyz * d xyz / d s; the scale is the sensor scale times (1 + the lh correction)
+			int scale_idx = -1, correction_idx = -1, pt_idx = -1;
+			FLT scale_param = 1, scale_correction = 1;
 			LinmathVec3d xyzjac_scale = {0};
+			FLT pt_jac[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
 			bool needsScaleJac = false;
+			if (mpfunc_ctx->ptsLength > 0) {
+				pt_idx = survive_optimizer_get_sensors_index(mpfunc_ctx) + meas->light.sensor_idx * 3;
+				needsScaleJac |= needs_derivs(derivs, pt_idx, 3);
+			}
 			if (mpfunc_ctx->settings->optimize_scale_threshold >= 0  || mpfunc_ctx->settings->lh_scale_correction > 0) {
-				scale_idx = survive_optimizer_get_sensor_scale_index(mpfunc_ctx) + meas->light.object;
-				FLT scale = (1 + get_lighthouse_correction_for(mpfunc_ctx, meas->light.object, meas->light.lh, 2));
+				int scale_start = survive_optimizer_get_sensor_scale_index(mpfunc_ctx);
+				scale_idx = scale_start >= 0 ? scale_start + meas->light.object : -1;
+				correction_idx =
+					get_lighthouse_correction_idx_for(mpfunc_ctx, meas->light.object, meas->light.lh, 2);
+				scale_correction = 1 + get_lighthouse_correction_for(mpfunc_ctx, meas->light.object, meas->light.lh, 2);
 				if(scale_idx >= 0) {
-					scale *= p[scale_idx];
+					scale_param = p[scale_idx];
 				}
+				FLT scale = scale_param * scale_correction;
 				SurvivePose imu2trackref = mpfunc_ctx->sos[meas->light.object]->imu2trackref;
-				needsScaleJac = derivs && scale_idx >= 0 && derivs[scale_idx];
+				needsScaleJac |= needs_derivs(derivs, scale_idx, 1) || needs_derivs(derivs, correction_idx, 1);
 				if (needsScaleJac) {
 					gen_scale_sensor_pt_jac_scale(xyzjac_scale, pt, &imu2trackref, scale);
 				}
 				if (scale != 1) {
+					if (pt_idx >= 0) {
+						gen_scale_sensor_pt_jac_sensor_pt(pt_jac, pt, &imu2trackref, scale);
+					}
 					gen_scale_sensor_pt(pt, pt, &imu2trackref, scale);
 				}
 			}
@@ -923,7 +1185,19 @@ static int mpfunc(int m, int n, FLT *p, FLT *deviates, FLT **derivs, void *priva
 				if (mpfunc_ctx->disableVelocity == false) {
 					LinmathDualPose dPose = obj2world;
 					FLT diff = mpfunc_ctx->timecode - meas->time;
-					SurviveVelocity *v = survive_optimizer_get_velocity(mpfunc_ctx);
+					SurviveVelocity *v = &survive_optimizer_get_velocity(mpfunc_ctx)[meas->light.object];
+
+					vel_jac.idx = survive_optimizer_get_velocity_index(mpfunc_ctx) + meas->light.object * 6;
+					vel_jac.dt = -diff;
+					if (!needs_derivs(derivs, vel_jac.idx, 6)) {
+						vel_jac.idx = -1;
+					} else if (mpfunc_ctx->settings->use_quat_model) {
+						gen_apply_ang_velocity_jac_axis_angle(vel_jac.rot, v->AxisAngleRot, -diff,
+															  obj2world.quatPose.Rot);
+					} else {
+						gen_apply_ang_velocity_aa_jac_axis_angle(vel_jac.rot, v->AxisAngleRot, -diff,
+																 obj2world.axisAnglePose.AxisAngleRot);
+					}
 
 					if (mpfunc_ctx->settings->use_quat_model) {
 						addscalednd(dPose.quatPose.Pos, obj2world.quatPose.Pos, v->Pos, -diff, 3);
@@ -974,18 +1248,34 @@ static int mpfunc(int m, int n, FLT *p, FLT *deviates, FLT **derivs, void *priva
 																				  &world2lh->axisAnglePose, cal + axis);
 					}
 					scale3d(ptJac, ptJac, 1. / meas[meas_idx_jac].variance);
-					derivs[scale_idx][meas_idx + meas_idx_jac] = fix_infinity(dot3d(xyzjac_scale, ptJac));
+					FLT d_scale = dot3d(xyzjac_scale, ptJac);
+					if (needs_derivs(derivs, scale_idx, 1)) {
+						derivs[scale_idx][meas_idx + meas_idx_jac] = fix_infinity(d_scale * scale_correction);
+					}
+					if (needs_derivs(derivs, correction_idx, 1)) {
+						derivs[correction_idx][meas_idx + meas_idx_jac] = fix_infinity(d_scale * scale_param);
+					}
+					for (int j = 0; j < 3 && pt_idx >= 0; j++) {
+						if (derivs[pt_idx + j]) {
+							FLT d_pt = dotnd_strided(ptJac, pt_jac + j, 3, 1, 3);
+							derivs[pt_idx + j][meas_idx + meas_idx_jac] = fix_infinity(d_pt);
+						}
+					}
 				}
 			}
 
 			if (nextIsPair) {
-				run_pair_measurement(mpfunc_ctx, meas_idx, meas, &ang_velocity_jac, &obj2world, &obj2lh[lh], world2lh,
-									 pt, deviates + meas_idx, derivs);
+				run_pair_measurement(mpfunc_ctx, meas_idx, meas, &ang_velocity_jac, &vel_jac, &obj2world, &obj2lh[lh],
+									 world2lh, pt, predicted ? predicted + mea_block_idx : 0,
+									 predicted_jac ? predicted_jac + mea_block_idx * 3 : 0, deviates + meas_idx,
+									 derivs);
 				meas_idx++;
 				mea_block_idx++;
 			} else {
-				run_single_measurement(mpfunc_ctx, meas_idx, meas, &ang_velocity_jac, &obj2world, &obj2lh[lh], world2lh,
-									   pt, deviates + meas_idx, derivs);
+				run_single_measurement(mpfunc_ctx, meas_idx, meas, &ang_velocity_jac, &vel_jac, &obj2world,
+									   &obj2lh[lh], world2lh, pt, predicted ? predicted + mea_block_idx : 0,
+									   predicted_jac ? predicted_jac + mea_block_idx * 3 : 0, deviates + meas_idx,
+									   derivs);
 			}
 
 			break;
@@ -1056,6 +1346,198 @@ static int mpfunc(int m, int n, FLT *p, FLT *deviates, FLT **derivs, void *priva
 		}
 		meas_idx += meas->size;
 	}
+}
+
+// Below this many measurement blocks per thread, handing the work out costs more than it saves
+#define MPFUNC_MIN_BLOCKS_PER_JOB 256
+
+typedef struct mpfunc_job {
+	// Copy of the optimizer so each job accumulates its own stats
+	survive_optimizer optimizer;
+	int block_start, block_end, meas_idx;
+} mpfunc_job;
+
+typedef struct mpfunc_jobs {
+	mpfunc_job *jobs;
+	const FLT *predicted, *predicted_jac;
+	FLT *deviates;
+	FLT **derivs;
+} mpfunc_jobs;
+
+static void mpfunc_run_job(void *user, int job_idx) {
+	mpfunc_jobs *jobs = user;
+	mpfunc_job *job = &jobs->jobs[job_idx];
+	mpfunc_range(&job->optimizer, job->block_start, job->block_end, job->meas_idx, jobs->predicted,
+				 jobs->predicted_jac, jobs->deviates, jobs->derivs);
+}
+
+/**
+ * Splits the measurements into contiguous runs evaluated on the optimizer's thread pool. Each job only
+ * writes its own rows of deviates and derivs, so those match the serial path bit for bit. The stats are summed per job
+ * and then across jobs, which changes the order of the additions, so the *_error sums can differ in the last bits.
+ * Returns false, having done nothing, if the problem is too small or the pool is unavailable.
+ */
+static bool mpfunc_parallel(survive_optimizer *mpfunc_ctx, const FLT *predicted, const FLT *predicted_jac,
+							FLT *deviates, FLT **derivs) {
+	struct survive_thread_pool *pool = mpfunc_ctx->thread_pool;
+	if (pool == 0 && mpfunc_ctx->sos && mpfunc_ctx->sos[0] && mpfunc_ctx->sos[0]->ctx) {
+		pool = mpfunc_ctx->sos[0]->ctx->private_members->optimizer_pool;
+	}
+	int block_cnt = (int)mpfunc_ctx->measurementsCnt;
+
+	int job_cnt = block_cnt / MPFUNC_MIN_BLOCKS_PER_JOB;
+	if (job_cnt > survive_thread_pool_thread_count(pool)) {
+		job_cnt = survive_thread_pool_thread_count(pool);
+	}
+	if (job_cnt <= 1) {
+		return false;
+	}
+
+	mpfunc_job *job_list = alloca(sizeof(mpfunc_job) * job_cnt);
+	int block = 0, meas_idx = 0;
+	for (int i = 0; i < job_cnt; i++) {
+		int block_end = i == job_cnt - 1 ? block_cnt : (int)((int64_t)block_cnt * (i + 1) / job_cnt);
+		if (block_end < block) {
+			block_end = block;
+		}
+		// Pairs are evaluated together; don't split one across jobs
+		const survive_optimizer_measurement *last = &mpfunc_ctx->measurements[block_end - 1];
+		if (block_end > block && block_end < block_cnt && !last->invalid &&
+			last->meas_type == survive_optimizer_measurement_type_light &&
+			starts_light_pair(mpfunc_ctx, block_end - 1, block_cnt)) {
+			block_end++;
+		}
+
+		// mpfunc has zeroed the stats which get summed below
+		mpfunc_job *job = &job_list[i];
+		job->optimizer = *mpfunc_ctx;
+		job->block_start = block;
+		job->block_end = block_end;
+		job->meas_idx = meas_idx;
+		for (; block < block_end; block++) {
+			meas_idx += mpfunc_ctx->measurements[block].size;
+		}
+	}
+
+	mpfunc_jobs jobs = {.jobs = job_list,
+						.predicted = predicted,
+						.predicted_jac = predicted_jac,
+						.deviates = deviates,
+						.derivs = derivs};
+	if (!survive_thread_pool_run(pool, mpfunc_run_job, &jobs, job_cnt)) {
+		return false;
+	}
+
+	for (int i = 0; i < job_cnt; i++) {
+		const survive_optimizer *job = &job_list[i].optimizer;
+		mpfunc_ctx->stats.sensor_error += job->stats.sensor_error;
+		mpfunc_ctx->stats.sensor_error_cnt += job->stats.sensor_error_cnt;
+		mpfunc_ctx->stats.object_up_error += job->stats.object_up_error;
+		mpfunc_ctx->stats.object_up_error_cnt += job->stats.object_up_error_cnt;
+		mpfunc_ctx->stats.params_error += job->stats.params_error;
+		mpfunc_ctx->stats.params_error_cnt += job->stats.params_error_cnt;
+	}
+	return true;
+}
+
+/*
+ * Maps a residual r, in sigmas, to f with f^2 / 2 = rho(r), and returns df / dr. Squaring the mapped deviates makes the
+ * solver minimize the robust cost directly; scaling the jacobian rows by df / dr reweights each linearization by the
+ * current residual, which is IRLS folded into every LM step.
+ */
+static FLT robust_deviate(int loss, FLT c, FLT r, FLT *df_dr) {
+	*df_dr = 1;
+	FLT a = fabs(r);
+	if (a == 0 || c <= 0) {
+		return r;
+	}
+
+	switch (loss) {
+	case survive_optimizer_robust_loss_huber: {
+		if (a <= c) {
+			return r;
+		}
+		FLT f = sqrt(2 * c * a - c * c);
+		*df_dr = c / f;
+		return copysign(f, r);
+	}
+	case survive_optimizer_robust_loss_cauchy: {
+		FLT u = r / c;
+		FLT f = c * sqrt(log1p(u * u));
+		if (f == 0) {
+			return r;
+		}
+		*df_dr = c * fabs(u) / ((1 + u * u) * f);
+		return copysign(f, r);
+	}
+	default:
+		return r;
+	}
+}
+
+static void apply_robust_loss(survive_optimizer *ctx, int n, FLT *deviates, FLT **derivs) {
+	int loss = ctx->settings->robust_loss;
+	FLT c = ctx->settings->robust_scale;
+	int meas_idx = 0;
+	for (int i = 0; i < ctx->measurementsCnt; i++) {
+		const survive_optimizer_measurement *meas = &ctx->measurements[i];
+		if (meas->meas_type == survive_optimizer_measurement_type_light && !meas->invalid && meas->variance > 0) {
+			// Light deviates are error / variance; the loss sees error / sigma and is scaled back, so robust_scale is in
+			// sigmas. The scale factors cancel in df / dr.
+			FLT sigma = sqrt(meas->variance);
+			FLT df_dr;
+			deviates[meas_idx] = robust_deviate(loss, c, deviates[meas_idx] * sigma, &df_dr) / sigma;
+			for (int j = 0; derivs && df_dr != 1 && j < n; j++) {
+				if (derivs[j]) {
+					derivs[j][meas_idx] *= df_dr;
+				}
+			}
+		}
+		meas_idx += meas->size;
+	}
+}
+
+// The plain residuals and their derivatives, before any robust loss or filtering
+static void mpfunc_residuals(survive_optimizer *mpfunc_ctx, FLT *p, FLT *deviates, FLT **derivs) {
+    mpfunc_ctx->stats.sensor_error = 0; mpfunc_ctx->stats.sensor_error_cnt = 0;
+    mpfunc_ctx->stats.object_up_error = 0; mpfunc_ctx->stats.object_up_error_cnt = 0;
+    mpfunc_ctx->stats.params_error = 0; mpfunc_ctx->stats.params_error_cnt = 0;
+
+    mpfunc_ctx->parameters = p;
+
+	size_t workspace_mark = mpfunc_ctx->workspace ? mpfunc_ctx->workspace->used : 0;
+	FLT *predicted = 0, *predicted_jac = 0;
+	if (can_batch_reproject(mpfunc_ctx)) {
+		size_t cnt = mpfunc_ctx->measurementsCnt;
+		bool with_jac = derivs && can_batch_jacobians(mpfunc_ctx);
+		predicted = scratch_alloc(mpfunc_ctx, sizeof(FLT) * cnt * (with_jac ? 4 : 1));
+		predicted_jac = with_jac ? predicted + cnt : 0;
+		if (!batch_reproject_light(mpfunc_ctx, predicted, predicted_jac)) {
+			scratch_free(mpfunc_ctx, predicted);
+			predicted = predicted_jac = 0;
+		}
+	}
+
+	if (!mpfunc_parallel(mpfunc_ctx, predicted, predicted_jac, deviates, derivs)) {
+		mpfunc_range(mpfunc_ctx, 0, (int)mpfunc_ctx->measurementsCnt, 0, predicted, predicted_jac, deviates, derivs);
+	}
+	scratch_free(mpfunc_ctx, predicted);
+	if (mpfunc_ctx->workspace) {
+		survive_optimizer_workspace_release(mpfunc_ctx->workspace, workspace_mark);
+	}
+}
+
+static int mpfunc(int m, int n, FLT *p, FLT *deviates, FLT **derivs, void *private) {
+	survive_optimizer *mpfunc_ctx = private;
+
+	assert(survive_optimizer_get_meas_size(mpfunc_ctx) == m);
+	assert(survive_optimizer_get_parameters_count(mpfunc_ctx) == n);
+
+	mpfunc_residuals(mpfunc_ctx, p, deviates, derivs);
+
+	if (mpfunc_ctx->settings->robust_loss != survive_optimizer_robust_loss_none) {
+		apply_robust_loss(mpfunc_ctx, n, deviates, derivs);
+	}
 
 	if (mpfunc_ctx->needsFiltering) {
 		assert(derivs == 0);
@@ -1119,28 +1601,38 @@ const char *survive_optimizer_error(int status) {
 	}
 }
 
-static SurviveContext *cachedCtx = 0;
-static mp_config cachedCfg = {0};
+static void survive_optimizer_read_cfg(SurviveContext *ctx, mp_config *cfg) {
+	*cfg = (mp_config){0};
+	cfg->maxiter = survive_configf(ctx, OPTIMIZER_MAXITER_TAG, SC_GET, 0);
+	cfg->maxfev = survive_configf(ctx, OPTIMIZER_MAXFEV_TAG, SC_GET, 0);
+	cfg->ftol = survive_configf(ctx, OPTIMIZER_FTOL_TAG, SC_GET, 0);
+	cfg->normtol = survive_configf(ctx, OPTIMIZER_NORMTOL_TAG, SC_GET, 0);
+	cfg->xtol = survive_configf(ctx, OPTIMIZER_XTOL_TAG, SC_GET, 0);
+	cfg->gtol = survive_configf(ctx, OPTIMIZER_GTOL_TAG, SC_GET, 0);
+	cfg->covtol = survive_configf(ctx, OPTIMIZER_COVTOL_TAG, SC_GET, 0);
+	cfg->epsfcn = survive_configf(ctx, OPTIMIZER_EPSFCN_TAG, SC_GET, 0);
+	cfg->stepfactor = survive_configf(ctx, OPTIMIZER_STEPFACTOR_TAG, SC_GET, 0);
+	cfg->douserscale = survive_configi(ctx, OPTIMIZER_DOUSERSCALE_TAG, SC_GET, 0);
+	cfg->nprint = survive_configi(ctx, OPTIMIZER_NPRINT_TAG, SC_GET, 0);
+}
 
-static mp_config *survive_optimizer_get_cfg(SurviveContext *ctx) {
-	if (ctx != cachedCtx) {
-		cachedCfg = (mp_config){0};
-		cachedCfg.maxiter = survive_configf(ctx, OPTIMIZER_MAXITER_TAG, SC_GET, 0);
-		cachedCfg.maxfev = survive_configf(ctx, OPTIMIZER_MAXFEV_TAG, SC_GET, 0);
-		cachedCfg.ftol = survive_configf(ctx, OPTIMIZER_FTOL_TAG, SC_GET, 0);
-		cachedCfg.normtol = survive_configf(ctx, OPTIMIZER_NORMTOL_TAG, SC_GET, 0);
-		cachedCfg.xtol = survive_configf(ctx, OPTIMIZER_XTOL_TAG, SC_GET, 0);
-		cachedCfg.gtol = survive_configf(ctx, OPTIMIZER_GTOL_TAG, SC_GET, 0);
-		cachedCfg.covtol = survive_configf(ctx, OPTIMIZER_COVTOL_TAG, SC_GET, 0);
-		cachedCfg.epsfcn = survive_configf(ctx, OPTIMIZER_EPSFCN_TAG, SC_GET, 0);
-		cachedCfg.stepfactor = survive_configf(ctx, OPTIMIZER_STEPFACTOR_TAG, SC_GET, 0);
-		cachedCfg.douserscale = survive_configi(ctx, OPTIMIZER_DOUSERSCALE_TAG, SC_GET, 0);
-		cachedCfg.nprint = survive_configi(ctx, OPTIMIZER_NPRINT_TAG, SC_GET, 0);
+// Copies the context's config into 'cfg'. It is read once per context; contexts put together by hand have no private
+// members and read it every time.
+static mp_config *survive_optimizer_get_cfg(SurviveContext *ctx, mp_config *cfg) {
+	struct SurviveContext_private *pctx = ctx ? ctx->private_members : 0;
+	if (pctx == 0) {
+		survive_optimizer_read_cfg(ctx, cfg);
+		return cfg;
+	}
 
-		cachedCtx = ctx;
+	survive_get_bsd_lock(ctx);
+	if (pctx->optimizer_cfg == 0) {
+		pctx->optimizer_cfg = SV_CALLOC(sizeof(mp_config));
+		survive_optimizer_read_cfg(ctx, pctx->optimizer_cfg);
 	}
-	cachedCfg.iterproc = 0;
-	return &cachedCfg;
+	*cfg = *pctx->optimizer_cfg;
+	survive_release_bsd_lock(ctx);
+	return cfg;
 }
 
 mp_config precise_cfg = {0};
@@ -1229,18 +1721,36 @@ SURVIVE_EXPORT void survive_optimizer_covariance_expand(survive_optimizer *optim
 		}
 	}
 }
+static void *mpfit_workspace_alloc(void *workspace, size_t size) {
+	return survive_optimizer_workspace_alloc(workspace, size);
+}
+
+// Has to be a macro for alloca to be scoped to survive_optimizer_run
+#define RUN_SCRATCH(size) (workspace ? survive_optimizer_workspace_alloc(workspace, size) : alloca(size))
+
 int survive_optimizer_run(survive_optimizer *optimizer, struct mp_result_struct *result, struct CnMat *R) {
 	SurviveContext *ctx = optimizer->sos[0] ? optimizer->sos[0]->ctx : 0;
 
+	mp_config ctx_cfg;
 	mp_config *cfg = optimizer->cfg;
 	if (cfg == 0)
-		cfg = survive_optimizer_get_cfg(ctx);
+		cfg = survive_optimizer_get_cfg(ctx, &ctx_cfg);
 
 	SurvivePose *poses = survive_optimizer_get_pose(optimizer);
 
+	survive_optimizer_workspace *workspace = optimizer->workspace;
+	size_t workspace_mark = workspace ? workspace->used : 0;
+	mp_config workspace_cfg;
+	if (workspace) {
+		workspace_cfg = *cfg;
+		workspace_cfg.alloc = mpfit_workspace_alloc;
+		workspace_cfg.alloc_user = workspace;
+		cfg = &workspace_cfg;
+	}
+
 	int nonfixed_quat_cnt = 0;
-	int *quat_idxs = alloca(sizeof(int) * (optimizer->poseLength + optimizer->cameraLength));
-	int *quat_free_idxs = alloca(sizeof(int) * (optimizer->poseLength + optimizer->cameraLength));
+	int *quat_idxs = RUN_SCRATCH(sizeof(int) * (optimizer->poseLength + optimizer->cameraLength));
+	int *quat_free_idxs = RUN_SCRATCH(sizeof(int) * (optimizer->poseLength + optimizer->cameraLength));
 	//int *quat_idxs = alloca(sizeof(int) * (optimizer->poseLength + optimizer->cameraLength));
 	int fixed_idxs = 0;
 	if(!optimizer->settings->use_quat_model) {
@@ -1284,8 +1794,10 @@ int survive_optimizer_run(survive_optimizer *optimizer, struct mp_result_struct
 
 	// MPFit runs on temporary storage; so parameters is manipulated in mpfunc. Save it and restore it here.
 	FLT *params = optimizer->parameters;
-	optimizer->needsFiltering = !optimizer->nofilter && !optimizer->settings->disable_filter;
-	FLT* deviates = alloca(survive_optimizer_get_meas_size(optimizer) * sizeof(FLT));
+	// A robust loss handles outliers within the solve, so there's nothing to drop before it
+	optimizer->needsFiltering = !optimizer->nofilter && !optimizer->settings->disable_filter &&
+								optimizer->settings->robust_loss == survive_optimizer_robust_loss_none;
+	FLT *deviates = RUN_SCRATCH(survive_optimizer_get_meas_size(optimizer) * sizeof(FLT));
 	mpfunc(survive_optimizer_get_meas_size(optimizer), survive_optimizer_get_parameters_count(optimizer), params, deviates, 0, optimizer);
 
 	survive_optimizer_parameter * lh_correction = survive_optimizer_get_start_parameter_info(optimizer, survive_optimizer_parameter_object_lighthouse_correction);
@@ -1337,10 +1849,46 @@ int survive_optimizer_run(survive_optimizer *optimizer, struct mp_result_struct
 	//CN_CREATE_STACK_MAT(J, nfree, meas_count);
 	//result->jac = J.data;
 
-	int rtn = mpfit(mpfunc, meas_count, survive_optimizer_get_parameters_count(optimizer), optimizer->parameters,
-					optimizer->mp_parameters_info, cfg, optimizer, result);
+	// The robust loss only shapes the solve; the norms it reports are compared against plain squared residuals
+	bool robust = optimizer->settings->robust_loss != survive_optimizer_robust_loss_none;
+	FLT *start_params = 0;
+	if (robust) {
+		start_params = RUN_SCRATCH(param_cnt * sizeof(FLT));
+		memcpy(start_params, optimizer->parameters, param_cnt * sizeof(FLT));
+	}
+
+	int rtn;
+	if (optimizer->settings->sparse_solver || optimizer->warm_start) {
+		// Each object pose is its own block; cameras and everything else are shared
+		int *param_block = RUN_SCRATCH(sizeof(int) * param_cnt);
+		for (int i = 0; i < param_cnt; i++) {
+			param_block[i] = -1;
+		}
+		survive_optimizer_parameter *pose_info =
+			survive_optimizer_get_start_parameter_info(optimizer, survive_optimizer_parameter_object_pose);
+		for (int i = 0; pose_info && i < optimizer->poseLength; i++) {
+			for (int j = 0; j < 7; j++) {
+				param_block[pose_info->p_idx + i * 7 + j] = i;
+			}
+		}
+		rtn = survive_optimizer_sparse_lm(mpfunc, meas_count, param_cnt, optimizer->parameters,
+										  optimizer->mp_parameters_info, cfg, optimizer, param_block,
+										  optimizer->warm_start, result);
+	} else {
+		rtn = mpfit(mpfunc, meas_count, param_cnt, optimizer->parameters, optimizer->mp_parameters_info, cfg,
+					optimizer, result);
+	}
 	optimizer->parameters = params;
 
+	if (robust) {
+		FLT *raw = RUN_SCRATCH(meas_count * sizeof(FLT));
+		mpfunc_residuals(optimizer, start_params, raw, 0);
+		result->orignorm = dotnd(raw, raw, meas_count);
+		// Last, so the stats are for the solution too
+		mpfunc_residuals(optimizer, params, raw, 0);
+		result->bestnorm = dotnd(raw, raw, meas_count);
+	}
+
 	FLT rchisqr = linmath_max(1, result->bestnorm / nfree);
 	if (ctx)
 		survive_recording_write_matrix(ctx->recptr, optimizer->sos[0], 10, "full_cov", &R_aa);
@@ -1446,6 +1994,9 @@ int survive_optimizer_run(survive_optimizer *optimizer, struct mp_result_struct
         }
     }
 
+	if (workspace) {
+		survive_optimizer_workspace_release(workspace, workspace_mark);
+	}
 	return rtn;
 }
 
@@ -1461,138 +2012,356 @@ void survive_optimizer_set_reproject_model(survive_optimizer *optimizer,
 #define gzclose fclose
 #endif
 
+int params_size(survive_optimizer *ctx, enum survive_optimizer_parameter_type type);
+
+// survive_optimizer_load hands back one of these; the settings the problem was dumped with live alongside it
+typedef struct survive_optimizer_loaded {
+	survive_optimizer opt;
+	survive_optimizer_settings settings;
+} survive_optimizer_loaded;
+
 void survive_optimizer_serialize(const survive_optimizer *opt, const char *fn) {
 	FILE *f = fopen(fn, "w");
 	if(f == 0)
 	  return;
 
-	if(opt->sos && opt->sos[0])
-		fprintf(f, "object       %s\n", opt->sos[0]->codename);
-
+	const survive_optimizer_settings *settings = opt->settings;
+	fprintf(f, "object       %s\n", opt->sos && opt->sos[0] ? opt->sos[0]->codename : "SV0");
 	fprintf(f, "model        %d\n", opt->reprojectModel != &survive_reproject_gen1_model);
 	fprintf(f, "poseLength   %d\n", opt->poseLength);
 	fprintf(f, "cameraLength %d\n", opt->cameraLength);
 	fprintf(f, "ptsLength    %d\n", opt->ptsLength);
+	fprintf(f, "disableVelocity %d\n", opt->disableVelocity);
+	fprintf(f, "nofilter     %d\n", opt->nofilter);
+	fprintf(f, "timecode     %+0.16f\n", opt->timecode);
+	fprintf(f, "objectUpVectorVariance %+0.16f\n", opt->objectUpVectorVariance);
+	fprintf(f, "settings     %d %d %+0.16f %+0.16f %d %+0.16f %+0.16f %+0.16f\n", settings->use_quat_model,
+			settings->disable_filter, settings->lh_scale_correction, settings->lh_offset_correction,
+			settings->disallow_pair_calc, settings->optimize_scale_threshold, settings->current_pos_bias,
+			settings->current_rot_bias);
+	fprintf(f, "robust       %d %+0.16f\n", settings->robust_loss, settings->robust_scale);
+
+	// Enough of each object to evaluate the problem without the context it came from
+	fprintf(f, "\n");
+	fprintf(f, "objects      %d\n", opt->poseLength);
+	fprintf(f, "\t#<codename> <sensor_ct> <sensor_scale> <sensor_scale_var> <imu2trackref>\n");
+	for (int i = 0; i < opt->poseLength; i++) {
+		const SurviveObject *so = opt->sos ? opt->sos[i] : 0;
+		int sensor_ct = so && so->sensor_locations ? so->sensor_ct : 0;
+		SurvivePose imu2trackref = so ? so->imu2trackref : (SurvivePose){.Rot = {1}};
+		fprintf(f, "\t%s %d %+0.16f %+0.16f", so ? so->codename : "SV0", sensor_ct, so ? so->sensor_scale : 1.,
+				so ? so->sensor_scale_var : 0.);
+		const FLT *imu2trackref_v = (const FLT *)&imu2trackref;
+		for (int j = 0; j < 7; j++) {
+			fprintf(f, " %+0.16f", imu2trackref_v[j]);
+		}
+		fprintf(f, "\n");
+		for (int j = 0; j < sensor_ct * 3; j++) {
+			fprintf(f, "%s%+0.16f%s", j % 3 ? " " : "\t\t", so->sensor_locations[j], j % 3 == 2 ? "\n" : "");
+		}
+	}
+
+	// Calibration that comes from the context rather than the parameters
+	bool cal_in_params = survive_optimizer_get_calibration_index(opt) >= 0;
+	int cal_cnt = cal_in_params || opt->sos == 0 || opt->sos[0] == 0 || opt->sos[0]->ctx == 0 ? 0 : opt->cameraLength;
+	fprintf(f, "\n");
+	fprintf(f, "calibration  %d\n", cal_cnt);
+	for (int lh = 0; lh < cal_cnt; lh++) {
+		const FLT *cal = (const FLT *)survive_basestation_cal(opt->sos[0]->ctx, lh, 0);
+		fprintf(f, "\t");
+		for (int j = 0; j < 2 * sizeof(BaseStationCal) / sizeof(FLT); j++) {
+			fprintf(f, " %+0.16f", cal[j]);
+		}
+		fprintf(f, "\n");
+	}
+
+	fprintf(f, "\n");
+	fprintf(f, "parameterBlocks %d\n", (int)opt->parameterBlockCnt);
+	fprintf(f, "\t#<type> <count>\n");
+	for (int i = 0; i < opt->parameterBlockCnt; i++) {
+		fprintf(f, "\t%d %d\n", opt->parameters_info[i].param_type, (int)opt->parameters_info[i].elem_size);
+	}
 
 	fprintf(f, "\n");
 	fprintf(f, "parameters   %d\n", survive_optimizer_get_parameters_count(opt));
-	fprintf(f, "#	          <name>:        <idx>      <fixed>             <value>            <min>            <max> "
-			   "<use_jacobian>\n");
+	fprintf(f, "#	          <name>:        <idx>      <fixed>             <value> <limited> <min> <limited> <max> "
+			   "<step> <use_jacobian>\n");
 	for (int i = 0; i < survive_optimizer_get_parameters_count(opt); i++) {
 		struct mp_par_struct *info = &opt->mp_parameters_info[i];
-		fprintf(f, "\t%16s:", opt->mp_parameters_info[i].parname);
+		fprintf(f, "\t%16s:", info->parname ? info->parname : "");
 		fprintf(f, " %12d", i);
 		fprintf(f, " %12d", info->fixed);
 		fprintf(f, " %+0.16f", opt->parameters[i]);
-		fprintf(f, " %+16.f %+16.f", info->limits[0], info->limits[1]);
+		fprintf(f, " %d %+0.16f %d %+0.16f", info->limited[0], info->limits[0], info->limited[1], info->limits[1]);
+		fprintf(f, " %+0.16f", info->step);
 		fprintf(f, " %14d\n", info->side);
 	}
 
 	fprintf(f, "\n");
 	fprintf(f, "measurementsCnt %ld\n", opt->measurementsCnt);
-	fprintf(f, "\t#<lh> <axis> <sensor_idx> <object_idx> <value> <variance>\n");
+	fprintf(f, "\t#<type> <invalid> <time> <variance> <type specific fields>\n");
 	for (int i = 0; i < opt->measurementsCnt; i++) {
 		survive_optimizer_measurement *meas = &opt->measurements[i];
-		fprintf(f, "\t%d", meas->light.lh);
-		fprintf(f, " %d", meas->light.axis);
-		fprintf(f, " %2d", meas->light.sensor_idx);
-		fprintf(f, " %d", meas->light.object);
-		fprintf(f, " %+0.16f", meas->light.value);
-		fprintf(f, " %+0.16f\n", meas->variance);
+		fprintf(f, "\t%d %d %+0.16f %+0.16f", meas->meas_type, meas->invalid, meas->time, meas->variance);
+		const FLT *vec = 0;
+		switch (meas->meas_type) {
+		case survive_optimizer_measurement_type_light:
+			fprintf(f, " %d %d %2d %d %+0.16f", meas->light.lh, meas->light.axis, meas->light.sensor_idx,
+					meas->light.object, meas->light.value);
+			break;
+		case survive_optimizer_measurement_type_object_accel:
+			fprintf(f, " %d", meas->pose_acc.object);
+			vec = meas->pose_acc.acc;
+			break;
+		case survive_optimizer_measurement_type_camera_accel:
+			fprintf(f, " %d", meas->camera_acc.camera);
+			vec = meas->camera_acc.acc;
+			break;
+		case survive_optimizer_measurement_type_camera_position:
+			fprintf(f, " %d", meas->camera_pos.camera);
+			vec = meas->camera_pos.pos;
+			break;
+		case survive_optimizer_measurement_type_fixed_rotation:
+			fprintf(f, " %d %d %+0.16f %+0.16f %+0.16f", meas->fixed_rotation.obj, meas->fixed_rotation.conjugate,
+					LINMATH_VEC3_EXPAND(meas->fixed_rotation.match_vec));
+			vec = meas->fixed_rotation.plane;
+			break;
+		case survive_optimizer_measurement_type_parameters_bias:
+			fprintf(f, " %d %+0.16f", meas->parameter_bias.parameter_index, meas->parameter_bias.expected_value);
+			break;
+		default:
+			break;
+		}
+		if (vec) {
+			fprintf(f, " %+0.16f %+0.16f %+0.16f", LINMATH_VEC3_EXPAND(vec));
+		}
+		fprintf(f, "\n");
 	}
 
 	fclose(f);
 }
 
-survive_optimizer *survive_optimizer_load(const char *fn) {
-	survive_optimizer *opt = calloc(sizeof(survive_optimizer), 1);
+#ifndef LINE_MAX
+#define LINE_MAX 2048
+#endif
+
+static bool read_vec3(FILE *f, FLT *v) { return fscanf(f, " " FLT_sformat " " FLT_sformat " " FLT_sformat, &v[0], &v[1], &v[2]) == 3; }
+
+static bool load_measurement(FILE *f, survive_optimizer *opt) {
+	int type = 0, invalid = 0;
+	FLT time = 0, variance = 0;
+	if (fscanf(f, " %d %d " FLT_sformat " " FLT_sformat, &type, &invalid, &time, &variance) != 4 ||
+		type <= survive_optimizer_measurement_type_none || type > survive_optimizer_measurement_type_camera_position ||
+		opt->measurementsCnt >= survive_optimizer_get_max_measurements_count(opt)) {
+		return false;
+	}
+
+	survive_optimizer_measurement *meas = survive_optimizer_emplace_meas(opt, type);
+	meas->invalid = invalid;
+	meas->time = time;
+	meas->variance = variance;
+
+	int a = 0, b = 0, c = 0;
+	switch (meas->meas_type) {
+	case survive_optimizer_measurement_type_light:
+		if (fscanf(f, " %d %d %d %d " FLT_sformat, &a, &b, &c, &meas->light.object, &meas->light.value) != 5)
+			return false;
+		meas->light.lh = a;
+		meas->light.axis = b;
+		meas->light.sensor_idx = c;
+		return true;
+	case survive_optimizer_measurement_type_object_accel:
+		return fscanf(f, " %d", &meas->pose_acc.object) == 1 && read_vec3(f, meas->pose_acc.acc);
+	case survive_optimizer_measurement_type_camera_accel:
+		return fscanf(f, " %d", &meas->camera_acc.camera) == 1 && read_vec3(f, meas->camera_acc.acc);
+	case survive_optimizer_measurement_type_camera_position:
+		return fscanf(f, " %d", &meas->camera_pos.camera) == 1 && read_vec3(f, meas->camera_pos.pos);
+	case survive_optimizer_measurement_type_fixed_rotation:
+		if (fscanf(f, " %d %d", &meas->fixed_rotation.obj, &a) != 2)
+			return false;
+		meas->fixed_rotation.conjugate = a;
+		return read_vec3(f, meas->fixed_rotation.match_vec) && read_vec3(f, meas->fixed_rotation.plane);
+	case survive_optimizer_measurement_type_parameters_bias:
+		return fscanf(f, " %d " FLT_sformat, &meas->parameter_bias.parameter_index,
+					  &meas->parameter_bias.expected_value) == 2;
+	default:
+		return false;
+	}
+}
+
+static SurviveObject *load_object(FILE *f) {
+	char codename[LINE_MAX] = {0};
+	int sensor_ct = 0;
+	SurviveObject *so = SV_CALLOC(sizeof(SurviveObject));
+	bool ok = fscanf(f, " %s %d " FLT_sformat " " FLT_sformat, codename, &sensor_ct, &so->sensor_scale,
+					 &so->sensor_scale_var) == 4;
+	FLT *imu2trackref = (FLT *)&so->imu2trackref;
+	for (int j = 0; ok && j < 7; j++) {
+		ok = fscanf(f, " " FLT_sformat, &imu2trackref[j]) == 1;
+	}
+	ok = ok && sensor_ct >= 0 && sensor_ct <= SENSORS_PER_OBJECT;
+
+	so->sensor_ct = ok ? sensor_ct : 0;
+	so->sensor_locations = SV_CALLOC(sizeof(FLT) * 3 * (so->sensor_ct + 1));
+	for (int j = 0; ok && j < so->sensor_ct; j++) {
+		ok = read_vec3(f, &so->sensor_locations[j * 3]);
+	}
+	memcpy(so->codename, codename, sizeof(so->codename) - 1);
+	so->head2trackref.Rot[0] = 1;
 
+	if (!ok) {
+		free(so->sensor_locations);
+		free(so);
+		return 0;
+	}
+	return so;
+}
+
+survive_optimizer *survive_optimizer_load(const char *fn) {
 	FILE *f = fopen(fn, "r");
 	if (f == 0)
 		return 0;
-	int read_count = 0;
 
-#ifndef LINE_MAX
-#define LINE_MAX 2048
-#endif
+	survive_optimizer_loaded *loaded = SV_CALLOC(sizeof(survive_optimizer_loaded));
+	survive_optimizer *opt = &loaded->opt;
+	survive_optimizer_settings *settings = &loaded->settings;
+	opt->settings = settings;
+
 	char buffer[LINE_MAX] = { 0 };
 	char device_name[LINE_MAX] = {0};
-	opt->poseLength = 1;
-	read_count = fscanf(f, "object       %s\n", device_name);
-	int model = 0;
-	read_count = fscanf(f, "model        %d\n", &model);
-	opt->reprojectModel = model == 0 ? &survive_reproject_gen1_model : &survive_reproject_gen2_model;
-	read_count = fscanf(f, "poseLength   %d\n", &opt->poseLength);
-	read_count = fscanf(f, "cameraLength %d\n", &opt->cameraLength);
-	read_count = fscanf(f, "ptsLength    %d\n", &opt->ptsLength);
-
-	int param_count;
-	read_count = fscanf(f, "parameters   %d\n", &param_count);
-	char *success = fgets(buffer, LINE_MAX, f); // fscanf(f, "\t#<name>: <fixed> <value> <min> <max> <use_jacobian>\n");
-	assert(success);
+	int model = 0, disableVelocity = 0, nofilter = 0, use_quat_model = 0, disable_filter = 0, disallow_pair_calc = 0;
+	FLT current_pos_bias = 0;
+	bool ok = fscanf(f, "object %s\n", device_name) == 1;
+	ok = ok && fscanf(f, "model %d\n", &model) == 1;
+	ok = ok && fscanf(f, "poseLength %d\n", &opt->poseLength) == 1;
+	ok = ok && fscanf(f, "cameraLength %d\n", &opt->cameraLength) == 1;
+	ok = ok && fscanf(f, "ptsLength %d\n", &opt->ptsLength) == 1;
+	ok = ok && fscanf(f, "disableVelocity %d\n", &disableVelocity) == 1;
+	ok = ok && fscanf(f, "nofilter %d\n", &nofilter) == 1;
+	ok = ok && fscanf(f, "timecode " FLT_sformat "\n", &opt->timecode) == 1;
+	ok = ok && fscanf(f, "objectUpVectorVariance " FLT_sformat "\n", &opt->objectUpVectorVariance) == 1;
+	ok = ok && fscanf(f, "settings %d %d " FLT_sformat " " FLT_sformat " %d " FLT_sformat " " FLT_sformat " " FLT_sformat "\n",
+					  &use_quat_model, &disable_filter, &settings->lh_scale_correction,
+					  &settings->lh_offset_correction, &disallow_pair_calc, &settings->optimize_scale_threshold,
+					  &current_pos_bias, &settings->current_rot_bias) == 8;
+	// Optional; older dumps go straight on to the objects, so the line is put back unless it is this one
+	long robust_line = ftell(f);
+	if (ok && (fgets(buffer, sizeof(buffer), f) == 0 ||
+			   sscanf(buffer, "robust %d " FLT_sformat, &settings->robust_loss, &settings->robust_scale) != 2)) {
+		settings->robust_loss = survive_optimizer_robust_loss_none;
+		fseek(f, robust_line, SEEK_SET);
+	}
+	ok = ok && opt->poseLength > 0 && opt->poseLength < 20 && opt->cameraLength >= 0 &&
+		 opt->cameraLength <= NUM_GEN2_LIGHTHOUSES && opt->ptsLength >= 0;
+	if (!ok) {
+		// Dumps from before the format carried the settings and object geometry can't be run
+		fprintf(stderr, "%s is not a serialized optimizer problem\n", fn);
+		fclose(f);
+		free(loaded);
+		return 0;
+	}
 
-	(void)read_count;
-	assert(param_count == survive_optimizer_get_parameters_count(opt));
+	opt->reprojectModel = model == 0 ? &survive_reproject_gen1_model : &survive_reproject_gen2_model;
+	opt->disableVelocity = disableVelocity;
+	opt->nofilter = nofilter;
+	settings->use_quat_model = use_quat_model;
+	settings->disable_filter = disable_filter;
+	settings->disallow_pair_calc = disallow_pair_calc;
 
+	// The bias measurements setup would add from the objects' current pose are in the dump
 	SURVIVE_OPTIMIZER_SETUP_HEAP_BUFFERS(*opt, 0);
+	settings->current_pos_bias = current_pos_bias;
+
+	int obj_cnt = 0;
+	ok = fscanf(f, " objects %d", &obj_cnt) == 1 && obj_cnt == opt->poseLength;
+	ok = ok && fgets(buffer, LINE_MAX, f) && fgets(buffer, LINE_MAX, f);
+	for (int i = 0; ok && i < obj_cnt; i++) {
+		opt->sos[i] = load_object(f);
+		ok = opt->sos[i] != 0;
+	}
+
+	int cal_cnt = 0;
+	ok = ok && fscanf(f, " calibration %d", &cal_cnt) == 1 && (cal_cnt == 0 || cal_cnt == opt->cameraLength);
+	FLT *cal = SV_CALLOC(sizeof(BaseStationCal) * 2 * (cal_cnt + 1));
+	for (int i = 0; ok && i < cal_cnt * 2 * sizeof(BaseStationCal) / sizeof(FLT); i++) {
+		ok = fscanf(f, " " FLT_sformat, &cal[i]) == 1;
+	}
+
+	// Setup already added the blocks every problem has; add the rest in the order they were dumped in
+	int block_cnt = 0;
+	ok = ok && fscanf(f, " parameterBlocks %d", &block_cnt) == 1;
+	ok = ok && fgets(buffer, LINE_MAX, f) && fgets(buffer, LINE_MAX, f);
+	for (int i = 0; ok && i < block_cnt; i++) {
+		int type = 0, cnt = 0;
+		ok = fscanf(f, " %d %d", &type, &cnt) == 2 && type > survive_optimizer_parameter_none &&
+			 type <= survive_optimizer_parameter_obj_points && cnt > 0;
+		if (ok && i >= opt->parameterBlockCnt) {
+			ok = survive_optimizer_get_start_index(opt, type) == -1 &&
+				 survive_optimizer_get_parameters_count(opt) + params_size(opt, type) * cnt <=
+					 survive_optimizer_get_max_parameters_count(opt);
+		}
+		if (ok && i >= opt->parameterBlockCnt) {
+			ok = survive_optimizer_emplace_params(opt, type, cnt) != 0;
+		} else if (ok) {
+			ok = opt->parameters_info[i].param_type == type && opt->parameters_info[i].elem_size == cnt;
+		}
+	}
+	if (ok && cal_cnt) {
+		survive_optimizer_parameter *cal_params =
+			survive_optimizer_emplace_params(opt, survive_optimizer_parameter_camera_parameters, cal_cnt);
+		memcpy(cal_params->p, cal, cal_params->size * sizeof(FLT));
+	}
+	free(cal);
+
+	int param_count = 0;
+	ok = ok && fscanf(f, " parameters %d", &param_count) == 1;
+	ok = ok && fgets(buffer, LINE_MAX, f) && fgets(buffer, LINE_MAX, f);
+	// Calibration from the context was appended after the dumped parameters; it stays fixed
+	ok = ok && param_count <= survive_optimizer_get_parameters_count(opt);
+	for (int i = 0; ok && i < param_count; i++) {
+		// The names are informational; the ones emplacing the blocks gave them are kept
+		int c = 0;
+		while ((c = fgetc(f)) != ':' && c != EOF)
+			;
 
-	for (int i = 0; i < survive_optimizer_get_parameters_count(opt); i++) {
 		struct mp_par_struct *info = &opt->mp_parameters_info[i];
-		read_count = fscanf(f, "\t");
-
-		char *b = calloc(128, 1);
-		opt->mp_parameters_info[i].parname = b;
-		char c = fgetc(f);
-		while (c != ':') {
-			*(b++) = c;
-			c = fgetc(f);
-		}
-		int idx;
-		read_count = fscanf(f, "%d ", &idx);
-		read_count = fscanf(f, " %d", &info->fixed);
-		read_count = fscanf(f, " " FLT_sformat, &opt->parameters[i]);
-		read_count = fscanf(f, " " FLT_sformat " " FLT_sformat, &info->limits[0], &info->limits[1]);
-		read_count = fscanf(f, " %d\n", &info->side);
-	}
-
-	read_count = fscanf(f, "\n");
-	read_count = fscanf(f, "measurementsCnt %lu\n", &opt->measurementsCnt);
-	read_count = fscanf(f, "\t#<lh> <axis> <sensor_idx> <object_idx> <value> <variance>\n");
-	for (int i = 0; i < opt->measurementsCnt; i++) {
-		survive_optimizer_measurement *meas = &opt->measurements[i];
-		read_count = fscanf(f, "\t%hhu", &meas->light.lh);
-		read_count = fscanf(f, " %hhu", &meas->light.axis);
-		read_count = fscanf(f, " %hhu", &meas->light.sensor_idx);
-		read_count = fscanf(f, " %d", &meas->light.object);
-		read_count = fscanf(f, " " FLT_sformat, &meas->light.value);
-		read_count = fscanf(f, " " FLT_sformat "\n", &meas->variance);
+		int idx = 0;
+		ok = fscanf(f, " %d %d " FLT_sformat " %d " FLT_sformat " %d " FLT_sformat " " FLT_sformat " %d", &idx,
+					&info->fixed, &opt->parameters[i], &info->limited[0], &info->limits[0], &info->limited[1],
+					&info->limits[1], &info->step, &info->side) == 9;
 	}
 
+	size_t meas_cnt = 0;
+	ok = ok && fscanf(f, " measurementsCnt %zu", &meas_cnt) == 1;
+	ok = ok && fgets(buffer, LINE_MAX, f) && fgets(buffer, LINE_MAX, f);
+	for (size_t i = 0; ok && i < meas_cnt; i++) {
+		ok = load_measurement(f, opt);
+	}
 	fclose(f);
 
-	SurviveObject *so = survive_create_device(0, "SLV", opt, "SV0", 0);
-	char filename[FILENAME_MAX] = {0};
-	snprintf(filename, FILENAME_MAX, "%s_config.json", device_name);
-	FILE *fp = fopen(filename, "r");
-	if (fp) {
-		fseek(fp, 0L, SEEK_END);
-		int len = ftell(fp);
-		fseek(fp, 0L, SEEK_SET);
-		if (len > 0) {
-			char *ct0conf = (char *)malloc(len);
-			size_t read_size = fread(ct0conf, 1, len, fp);
-			if (read_size != len) {
-				fprintf(stderr, "Could not read full full config file %s\n", filename);
-			}
-			survive_default_config_process(so, ct0conf, len);
-			fclose(fp);
-		}
+	if (!ok) {
+		fprintf(stderr, "%s is truncated or malformed\n", fn);
+		survive_optimizer_free_loaded(opt);
+		return 0;
 	}
-	opt->sos[0] = so;
-
 	return opt;
 }
 
+void survive_optimizer_free_loaded(survive_optimizer *opt) {
+	if (opt == 0) {
+		return;
+	}
+
+	for (int i = 0; i < opt->poseLength; i++) {
+		if (opt->sos[i]) {
+			free(opt->sos[i]->sensor_locations);
+			free(opt->sos[i]);
+		}
+	}
+	SURVIVE_OPTIMIZER_CLEANUP_HEAP_BUFFERS(*opt);
+	free(opt);
+}
+
 SURVIVE_EXPORT FLT survive_optimizer_current_norm(const survive_optimizer *opt) {
 	int m = opt->measurementsCnt;
 	int npar = survive_optimizer_get_parameters_count(opt);
@@ -1726,6 +2495,58 @@ SURVIVE_EXPORT void survive_optimizer_setup_buffers(survive_optimizer *ctx, FLT
 
 SURVIVE_EXPORT void *survive_optimizer_realloc(void *old_ptr, size_t size) { return realloc(old_ptr, size); }
 
+// An allocation that didn't fit in the block. Kept in a stack so releasing to a mark only frees the newer ones.
+struct survive_optimizer_workspace_overflow {
+	struct survive_optimizer_workspace_overflow *next;
+	size_t start; // ws->used when this was allocated
+	double data[];
+};
+
+void *survive_optimizer_workspace_alloc(survive_optimizer_workspace *ws, size_t size) {
+	size = (size + 15) & ~(size_t)15;
+	size_t start = ws->used;
+	ws->used += size;
+	if (ws->used > ws->high_water) {
+		ws->high_water = ws->used;
+	}
+	if (ws->used <= ws->size) {
+		return ws->buffer + start;
+	}
+
+	struct survive_optimizer_workspace_overflow *overflow =
+		SV_MALLOC(sizeof(struct survive_optimizer_workspace_overflow) + size);
+	overflow->start = start;
+	overflow->next = ws->overflow;
+	ws->overflow = overflow;
+	return overflow->data;
+}
+
+void survive_optimizer_workspace_release(survive_optimizer_workspace *ws, size_t mark) {
+	while (ws->overflow && ws->overflow->start >= mark) {
+		struct survive_optimizer_workspace_overflow *next = ws->overflow->next;
+		free(ws->overflow);
+		ws->overflow = next;
+	}
+	if (mark < ws->used) {
+		ws->used = mark;
+	}
+}
+
+void survive_optimizer_workspace_reset(survive_optimizer_workspace *ws) {
+	survive_optimizer_workspace_release(ws, 0);
+	if (ws->high_water > ws->size) {
+		free(ws->buffer);
+		ws->buffer = SV_MALLOC(ws->high_water);
+		ws->size = ws->high_water;
+	}
+}
+
+void survive_optimizer_workspace_free(survive_optimizer_workspace *ws) {
+	survive_optimizer_workspace_release(ws, 0);
+	free(ws->buffer);
+	*ws = (survive_optimizer_workspace){0};
+}
+
 int survive_optimizer_get_max_measurements_count(const survive_optimizer *ctx) {
 	int sensor_cnt = SENSORS_PER_OBJECT;
 	assert(ctx->poseLength > 0 && ctx->poseLength < 20);
@@ -1800,6 +2621,11 @@ survive_optimizer_emplace_params(survive_optimizer *ctx, enum survive_optimizer_
 	for(int i = 0;i < rtn->size;i++) {
 		rtn->pi[i].fixed = true;
 		rtn->pi[i].parname = params_name(type);
+		// There's no setup function for points to pass use_jacobian_function to; mpfunc always fills these in
+		if (type == survive_optimizer_parameter_obj_points && ctx->reprojectModel &&
+			ctx->reprojectModel->reprojectAxisJacobSensorPt[0]) {
+			setup_param_jacobian(&rtn->pi[i], 1, 0, 0);
+		}
 	}
 	rtn->p_idx = ctx->parametersCnt;
 	rtn->p = &ctx->parameters[ctx->parametersCnt];
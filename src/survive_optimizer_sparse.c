@@ -0,0 +1,789 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <survive_optimizer.h>
+
+#include "mpfit/mpfit.h"
+
+/*
+ * Levenberg-Marquardt for problems where most of the parameters come in small independent blocks -- one pose per
+ * scene in a global scene solve -- and the rest (lighthouse poses, calibration) are shared by everything.
+ *
+ * As long as no residual depends on two different blocks, the block part of JᵀJ is block diagonal. Each step
+ * eliminates the blocks with the Schur complement, so the only dense solve is over the shared parameters, and the
+ * normal equations are accumulated from the non-zeros of each row of J instead of a dense QR of all of J.
+ *
+ * If some residual does couple two blocks, everything is treated as shared; that is just dense LM on the normal
+ * equations.
+ */
+
+typedef struct sparse_entry {
+	int col; // free parameter index
+	FLT v;
+} sparse_entry;
+
+typedef struct sparse_lm {
+	mp_func funct;
+	void *private_data;
+	int m, npar, nfree;
+	const mp_par *pars;
+
+	int *ifree;		// free index -> parameter index
+	int *col_block; // free index -> block, or -1 for the shared set
+	int *col_local; // free index -> index into the eliminated set or the shared set
+
+	int block_cnt, elim_cnt, shared_cnt;
+	int *block_start; // block -> first eliminated index; block_cnt + 1 entries
+	int *elim_free, *shared_free;
+	bool dense;
+
+	// Dense column storage for the user function; the normal equations are built from the compressed rows
+	FLT *jac, **derivs;
+	int *row_start;
+	sparse_entry *entries;
+	size_t entries_cap;
+
+	FLT *g;		 // Jᵀr, by free index
+	FLT *diag;	 // Running max of the diagonal of JᵀJ, used to scale the damping
+	FLT *H_e;	 // Diagonal blocks of the eliminated set, packed back to back
+	int *h_off;	 // block -> offset into H_e
+	FLT *W;		 // elim_cnt x shared_cnt coupling
+	FLT *H_s;	 // shared_cnt x shared_cnt
+	FLT *Y, *y;	 // A_e^-1 W and A_e^-1 g_e
+	FLT *S, *scratch;
+	int max_block;
+
+	// mp_config's allocator; when set, nothing is freed here and the caller reclaims it all after the solve
+	void *(*alloc)(void *alloc_user, size_t size);
+	void *alloc_user;
+} sparse_lm;
+
+static void *lm_alloc(const sparse_lm *lm, size_t size) {
+	return lm->alloc ? lm->alloc(lm->alloc_user, size) : SV_MALLOC(size);
+}
+
+static void *lm_calloc(const sparse_lm *lm, size_t size) { return memset(lm_alloc(lm, size), 0, size); }
+
+static void lm_free(const sparse_lm *lm, void *ptr) {
+	if (lm->alloc == 0) {
+		free(ptr);
+	}
+}
+
+static bool cholesky(FLT *A, int n) {
+	for (int j = 0; j < n; j++) {
+		FLT d = A[j * n + j];
+		for (int k = 0; k < j; k++)
+			d -= A[j * n + k] * A[j * n + k];
+		if (!(d > 0))
+			return false;
+		d = sqrt(d);
+		A[j * n + j] = d;
+		for (int i = j + 1; i < n; i++) {
+			FLT v = A[i * n + j];
+			for (int k = 0; k < j; k++)
+				v -= A[i * n + k] * A[j * n + k];
+			A[i * n + j] = v / d;
+		}
+	}
+	return true;
+}
+
+// Solves L Lᵀ x = b in place, for L as written by cholesky
+static void cholesky_solve(const FLT *L, int n, FLT *b) {
+	for (int i = 0; i < n; i++) {
+		FLT v = b[i];
+		for (int k = 0; k < i; k++)
+			v -= L[i * n + k] * b[k];
+		b[i] = v / L[i * n + i];
+	}
+	for (int i = n - 1; i >= 0; i--) {
+		FLT v = b[i];
+		for (int k = i + 1; k < n; k++)
+			v -= L[k * n + i] * b[k];
+		b[i] = v / L[i * n + i];
+	}
+}
+
+/*
+ * Inverts the symmetric positive semi-definite A in place. Directions whose pivot falls below tol times the largest
+ * diagonal entry are treated as unconstrained and get zero rows and columns, same as mpfit's covariance. work needs
+ * room for 3n values.
+ */
+static void invert_psd(FLT *A, int n, FLT tol, FLT *work) {
+	FLT max_diag = 0;
+	for (int i = 0; i < n; i++)
+		if (A[i * n + i] > max_diag)
+			max_diag = A[i * n + i];
+
+	bool *singular = (bool *)(work + 2 * n);
+	for (int j = 0; j < n; j++) {
+		FLT d = A[j * n + j];
+		for (int k = 0; k < j; k++)
+			d -= A[j * n + k] * A[j * n + k];
+		singular[j] = !(d > tol * max_diag);
+		if (singular[j]) {
+			A[j * n + j] = 1;
+			for (int i = j + 1; i < n; i++)
+				A[i * n + j] = 0;
+			continue;
+		}
+		d = sqrt(d);
+		A[j * n + j] = d;
+		for (int i = j + 1; i < n; i++) {
+			FLT v = A[i * n + j];
+			for (int k = 0; k < j; k++)
+				v -= A[i * n + k] * A[j * n + k];
+			A[i * n + j] = v / d;
+		}
+	}
+
+	// Solve for A^-1 a column at a time; the strict upper triangle is free, but L's diagonal has to survive until the end
+	FLT *inv_diag = work + n;
+	for (int c = 0; c < n; c++) {
+		for (int i = 0; i < n; i++)
+			work[i] = i == c;
+		cholesky_solve(A, n, work);
+		for (int i = 0; i < c; i++)
+			A[i * n + c] = work[i];
+		inv_diag[c] = work[c];
+	}
+	for (int i = 0; i < n; i++) {
+		A[i * n + i] = inv_diag[i];
+		for (int j = 0; j < i; j++)
+			A[i * n + j] = A[j * n + i];
+	}
+	for (int j = 0; j < n; j++) {
+		if (singular[j]) {
+			for (int i = 0; i < n; i++)
+				A[i * n + j] = A[j * n + i] = 0;
+		}
+	}
+}
+
+static void layout(sparse_lm *lm, const int *param_block) {
+	lm_free(lm, lm->block_start);
+	lm_free(lm, lm->h_off);
+	lm_free(lm, lm->H_e);
+	lm_free(lm, lm->W);
+	lm_free(lm, lm->H_s);
+	lm_free(lm, lm->Y);
+	lm_free(lm, lm->S);
+
+	int max_id = -1;
+	for (int j = 0; j < lm->nfree; j++) {
+		int id = (lm->dense || param_block == 0) ? -1 : param_block[lm->ifree[j]];
+		if (id > max_id)
+			max_id = id;
+	}
+
+	// Compact the block ids in order of first appearance
+	int *block_map = lm_alloc(lm, sizeof(int) * (max_id + 2));
+	for (int i = 0; i <= max_id; i++)
+		block_map[i] = -1;
+	int *block_size = lm_calloc(lm, sizeof(int) * (lm->nfree + 1));
+	lm->block_cnt = lm->shared_cnt = 0;
+	for (int j = 0; j < lm->nfree; j++) {
+		int id = max_id < 0 ? -1 : param_block[lm->ifree[j]];
+		if (id < 0) {
+			lm->col_block[j] = -1;
+			lm->shared_free[lm->shared_cnt] = j;
+			lm->col_local[j] = lm->shared_cnt++;
+			continue;
+		}
+		if (block_map[id] < 0)
+			block_map[id] = lm->block_cnt++;
+		lm->col_block[j] = block_map[id];
+		lm->col_local[j] = block_size[block_map[id]]++;
+	}
+
+	lm->block_start = lm_alloc(lm, sizeof(int) * (lm->block_cnt + 1));
+	lm->h_off = lm_alloc(lm, sizeof(int) * (lm->block_cnt + 1));
+	lm->block_start[0] = lm->h_off[0] = 0;
+	lm->max_block = 0;
+	for (int b = 0; b < lm->block_cnt; b++) {
+		lm->block_start[b + 1] = lm->block_start[b] + block_size[b];
+		lm->h_off[b + 1] = lm->h_off[b] + block_size[b] * block_size[b];
+		if (block_size[b] > lm->max_block)
+			lm->max_block = block_size[b];
+	}
+	lm->elim_cnt = lm->block_start[lm->block_cnt];
+
+	for (int j = 0; j < lm->nfree; j++) {
+		if (lm->col_block[j] >= 0) {
+			lm->col_local[j] += lm->block_start[lm->col_block[j]];
+			lm->elim_free[lm->col_local[j]] = j;
+		}
+	}
+
+	lm->H_e = lm_alloc(lm, sizeof(FLT) * (lm->h_off[lm->block_cnt] + 1));
+	lm->W = lm_alloc(lm, sizeof(FLT) * (lm->elim_cnt * lm->shared_cnt + 1));
+	lm->Y = lm_alloc(lm, sizeof(FLT) * (lm->elim_cnt * lm->shared_cnt + 1));
+	lm->H_s = lm_alloc(lm, sizeof(FLT) * (lm->shared_cnt * lm->shared_cnt + 1));
+	lm->S = lm_alloc(lm, sizeof(FLT) * (lm->shared_cnt * lm->shared_cnt + 1));
+
+	lm_free(lm, block_size);
+	lm_free(lm, block_map);
+}
+
+static int evaluate(sparse_lm *lm, FLT *x, FLT *fvec, FLT **derivs, int *nfev) {
+	(*nfev)++;
+	// Like mpfit, start from zeros; the optimizer leaves the residuals of invalid measurements untouched
+	memset(fvec, 0, sizeof(FLT) * lm->m);
+	int rtn = lm->funct(lm->m, lm->npar, x, fvec, derivs, lm->private_data);
+	return rtn < 0 ? rtn : 0;
+}
+
+static FLT chi2(const FLT *fvec, int m) {
+	FLT rtn = 0;
+	for (int i = 0; i < m; i++)
+		rtn += fvec[i] * fvec[i];
+	return rtn;
+}
+
+/*
+ * Evaluates the residuals and Jacobian at x, then accumulates g = Jᵀr and the blocks of JᵀJ.
+ */
+static int linearize(sparse_lm *lm, const int *param_block, FLT *x, FLT *fvec, FLT *wa, FLT eps, int *nfev) {
+	int m = lm->m, nfree = lm->nfree;
+	const mp_par *pars = lm->pars;
+
+	memset(lm->jac, 0, sizeof(FLT) * m * nfree);
+	memset(lm->derivs, 0, sizeof(FLT *) * lm->npar);
+	bool numerical = false;
+	for (int j = 0; j < nfree; j++) {
+		if (pars && pars[lm->ifree[j]].side == 3) {
+			lm->derivs[lm->ifree[j]] = lm->jac + j * m;
+		} else {
+			numerical = true;
+		}
+	}
+
+	int rtn = evaluate(lm, x, fvec, lm->derivs, nfev);
+	if (rtn < 0)
+		return rtn;
+
+	for (int j = 0; j < nfree && numerical; j++) {
+		int p = lm->ifree[j];
+		int side = pars ? pars[p].side : 0;
+		if (side == 3)
+			continue;
+
+		FLT temp = x[p];
+		FLT h = eps * fabs(temp);
+		if (pars && pars[p].step > 0)
+			h = pars[p].step;
+		if (pars && pars[p].relstep > 0)
+			h = fabs(pars[p].relstep * temp);
+		if (h == 0)
+			h = eps;
+		if (side == -1 || (side == 0 && pars && pars[p].limited[1] && temp > pars[p].limits[1] - h))
+			h = -h;
+
+		FLT *col = lm->jac + j * m;
+		x[p] = temp + h;
+		rtn = evaluate(lm, x, wa, 0, nfev);
+		x[p] = temp;
+		if (rtn < 0)
+			return rtn;
+
+		if (side != 2) {
+			for (int i = 0; i < m; i++)
+				col[i] = (wa[i] - fvec[i]) / h;
+		} else {
+			for (int i = 0; i < m; i++)
+				col[i] = wa[i];
+			x[p] = temp - h;
+			rtn = evaluate(lm, x, wa, 0, nfev);
+			x[p] = temp;
+			if (rtn < 0)
+				return rtn;
+			for (int i = 0; i < m; i++)
+				col[i] = (col[i] - wa[i]) / (2 * h);
+		}
+	}
+
+	// Compress into rows
+	memset(lm->row_start, 0, sizeof(int) * (m + 1));
+	for (int j = 0; j < nfree; j++) {
+		const FLT *col = lm->jac + j * m;
+		for (int i = 0; i < m; i++)
+			lm->row_start[i + 1] += col[i] != 0;
+	}
+	for (int i = 0; i < m; i++)
+		lm->row_start[i + 1] += lm->row_start[i];
+	size_t nnz = lm->row_start[m];
+	if (nnz > lm->entries_cap) {
+		lm_free(lm, lm->entries);
+		lm->entries = lm_alloc(lm, sizeof(sparse_entry) * nnz);
+		lm->entries_cap = nnz;
+	}
+	int *fill = (int *)wa;
+	memcpy(fill, lm->row_start, sizeof(int) * m);
+	for (int j = 0; j < nfree; j++) {
+		const FLT *col = lm->jac + j * m;
+		for (int i = 0; i < m; i++) {
+			if (col[i] != 0)
+				lm->entries[fill[i]++] = (sparse_entry){.col = j, .v = col[i]};
+		}
+	}
+
+	if (!lm->dense) {
+		for (int i = 0; i < m && !lm->dense; i++) {
+			int block = -1;
+			for (int k = lm->row_start[i]; k < lm->row_start[i + 1]; k++) {
+				int b = lm->col_block[lm->entries[k].col];
+				if (b >= 0 && block >= 0 && b != block) {
+					lm->dense = true;
+					break;
+				}
+				if (b >= 0)
+					block = b;
+			}
+		}
+		if (lm->dense)
+			layout(lm, param_block);
+	}
+
+	int ns = lm->shared_cnt;
+	memset(lm->g, 0, sizeof(FLT) * nfree);
+	memset(lm->H_e, 0, sizeof(FLT) * lm->h_off[lm->block_cnt]);
+	memset(lm->W, 0, sizeof(FLT) * lm->elim_cnt * ns);
+	memset(lm->H_s, 0, sizeof(FLT) * ns * ns);
+
+	for (int i = 0; i < m; i++) {
+		const sparse_entry *row = lm->entries + lm->row_start[i];
+		int cnt = lm->row_start[i + 1] - lm->row_start[i];
+		for (int a = 0; a < cnt; a++) {
+			int ca = row[a].col;
+			FLT va = row[a].v;
+			lm->g[ca] += va * fvec[i];
+
+			int ba = lm->col_block[ca], la = lm->col_local[ca];
+			for (int b = 0; b < cnt; b++) {
+				int cb = row[b].col;
+				int bb = lm->col_block[cb], lb = lm->col_local[cb];
+				FLT v = va * row[b].v;
+				if (ba >= 0 && bb >= 0) {
+					int bs = lm->block_start[ba + 1] - lm->block_start[ba];
+					int off = lm->block_start[ba];
+					lm->H_e[lm->h_off[ba] + (la - off) * bs + (lb - off)] += v;
+				} else if (ba >= 0) {
+					lm->W[la * ns + lb] += v;
+				} else if (bb < 0) {
+					lm->H_s[la * ns + lb] += v;
+				}
+			}
+		}
+	}
+
+	for (int j = 0; j < nfree; j++) {
+		int b = lm->col_block[j], l = lm->col_local[j];
+		FLT d;
+		if (b >= 0) {
+			int bs = lm->block_start[b + 1] - lm->block_start[b];
+			int k = l - lm->block_start[b];
+			d = lm->H_e[lm->h_off[b] + k * bs + k];
+		} else {
+			d = lm->H_s[l * ns + l];
+		}
+		if (d > lm->diag[j])
+			lm->diag[j] = d;
+		// Parameters nothing depends on yet still need some damping
+		if (lm->diag[j] == 0)
+			lm->diag[j] = 1;
+	}
+	return 0;
+}
+
+// Solves (JᵀJ + lambda D) delta = -g through the Schur complement on the shared parameters
+static bool solve_step(sparse_lm *lm, FLT lambda, FLT *delta) {
+	int ns = lm->shared_cnt;
+	FLT *A = lm->scratch, *col = lm->scratch + lm->max_block * lm->max_block;
+
+	for (int b = 0; b < lm->block_cnt; b++) {
+		int start = lm->block_start[b], bs = lm->block_start[b + 1] - start;
+		memcpy(A, lm->H_e + lm->h_off[b], sizeof(FLT) * bs * bs);
+		for (int k = 0; k < bs; k++)
+			A[k * bs + k] += lambda * lm->diag[lm->elim_free[start + k]];
+		if (!cholesky(A, bs))
+			return false;
+
+		for (int k = 0; k < bs; k++)
+			lm->y[start + k] = lm->g[lm->elim_free[start + k]];
+		cholesky_solve(A, bs, lm->y + start);
+
+		for (int r = 0; r < ns; r++) {
+			for (int k = 0; k < bs; k++)
+				col[k] = lm->W[(start + k) * ns + r];
+			cholesky_solve(A, bs, col);
+			for (int k = 0; k < bs; k++)
+				lm->Y[(start + k) * ns + r] = col[k];
+		}
+	}
+
+	FLT *S = lm->S, *rhs = delta + lm->nfree;
+	memcpy(S, lm->H_s, sizeof(FLT) * ns * ns);
+	for (int r = 0; r < ns; r++) {
+		S[r * ns + r] += lambda * lm->diag[lm->shared_free[r]];
+		rhs[r] = -lm->g[lm->shared_free[r]];
+	}
+	for (int k = 0; k < lm->elim_cnt; k++) {
+		const FLT *w = lm->W + k * ns, *yk = lm->Y + k * ns;
+		for (int r1 = 0; r1 < ns; r1++) {
+			if (w[r1] == 0)
+				continue;
+			for (int r2 = 0; r2 < ns; r2++)
+				S[r1 * ns + r2] -= w[r1] * yk[r2];
+			rhs[r1] += w[r1] * lm->y[k];
+		}
+	}
+	if (!cholesky(S, ns))
+		return false;
+	cholesky_solve(S, ns, rhs);
+
+	for (int r = 0; r < ns; r++)
+		delta[lm->shared_free[r]] = rhs[r];
+	for (int k = 0; k < lm->elim_cnt; k++) {
+		FLT v = -lm->y[k];
+		for (int r = 0; r < ns; r++)
+			v -= lm->Y[k * ns + r] * rhs[r];
+		delta[lm->elim_free[k]] = v;
+	}
+	return true;
+}
+
+// Writes JᵀJ in free index order into H
+static void assemble_normal(const sparse_lm *lm, FLT *H) {
+	int n = lm->nfree, ns = lm->shared_cnt;
+	memset(H, 0, sizeof(FLT) * n * n);
+	for (int b = 0; b < lm->block_cnt; b++) {
+		int start = lm->block_start[b], bs = lm->block_start[b + 1] - start;
+		for (int i = 0; i < bs; i++) {
+			for (int j = 0; j < bs; j++)
+				H[lm->elim_free[start + i] * n + lm->elim_free[start + j]] = lm->H_e[lm->h_off[b] + i * bs + j];
+		}
+	}
+	for (int k = 0; k < lm->elim_cnt; k++) {
+		for (int r = 0; r < ns; r++) {
+			int a = lm->elim_free[k], s = lm->shared_free[r];
+			H[a * n + s] = H[s * n + a] = lm->W[k * ns + r];
+		}
+	}
+	for (int r1 = 0; r1 < ns; r1++) {
+		for (int r2 = 0; r2 < ns; r2++)
+			H[lm->shared_free[r1] * n + lm->shared_free[r2]] = lm->H_s[r1 * ns + r2];
+	}
+}
+
+static void sparse_lm_free(sparse_lm *lm) {
+	lm_free(lm, lm->ifree);
+	lm_free(lm, lm->col_block);
+	lm_free(lm, lm->col_local);
+	lm_free(lm, lm->elim_free);
+	lm_free(lm, lm->shared_free);
+	lm_free(lm, lm->block_start);
+	lm_free(lm, lm->h_off);
+	lm_free(lm, lm->jac);
+	lm_free(lm, lm->derivs);
+	lm_free(lm, lm->row_start);
+	lm_free(lm, lm->entries);
+	lm_free(lm, lm->g);
+	lm_free(lm, lm->diag);
+	lm_free(lm, lm->H_e);
+	lm_free(lm, lm->W);
+	lm_free(lm, lm->H_s);
+	lm_free(lm, lm->Y);
+	lm_free(lm, lm->y);
+	lm_free(lm, lm->S);
+	lm_free(lm, lm->scratch);
+}
+
+int survive_optimizer_sparse_lm(mp_func funct, int m, int npar, FLT *xall, mp_par *pars, mp_config *config,
+								void *private_data, const int *param_block, survive_optimizer_warm_start *warm_start,
+								mp_result *result) {
+	// Same defaults and overrides as mpfit
+	FLT ftol = 1e-10, xtol = 1e-10, gtol = 1e-10, normtol = 0, epsfcn = MP_MACHEP0, covtol = 1e-14;
+	int maxiter = 200, maxfev = 0, nofinitecheck = 0;
+	if (config) {
+		if (config->ftol > 0)
+			ftol = config->ftol;
+		if (config->xtol > 0)
+			xtol = config->xtol;
+		if (config->gtol > 0)
+			gtol = config->gtol;
+		if (config->epsfcn > 0)
+			epsfcn = config->epsfcn;
+		if (config->maxiter > 0)
+			maxiter = config->maxiter;
+		if (config->maxiter == MP_NO_ITER)
+			maxiter = 0;
+		if (config->covtol > 0)
+			covtol = config->covtol;
+		if (config->normtol > 0)
+			normtol = config->normtol;
+		nofinitecheck = config->nofinitecheck;
+		maxfev = config->maxfev;
+	}
+	FLT eps = sqrt(epsfcn > MP_MACHEP0 ? epsfcn : MP_MACHEP0);
+
+	if (funct == 0)
+		return MP_ERR_FUNC;
+	if (m <= 0 || xall == 0)
+		return MP_ERR_NPOINTS;
+	if (npar <= 0)
+		return MP_ERR_NFREE;
+
+	sparse_lm lm = {.funct = funct,
+					.private_data = private_data,
+					.m = m,
+					.npar = npar,
+					.pars = pars,
+					.alloc = config ? config->alloc : 0,
+					.alloc_user = config ? config->alloc_user : 0};
+	lm.ifree = lm_alloc(&lm, sizeof(int) * npar);
+	for (int i = 0; i < npar; i++) {
+		if (pars && pars[i].fixed)
+			continue;
+		if (pars && ((pars[i].limited[0] && xall[i] < pars[i].limits[0]) ||
+					 (pars[i].limited[1] && xall[i] > pars[i].limits[1]))) {
+			lm_free(&lm, lm.ifree);
+			return MP_ERR_INITBOUNDS;
+		}
+		lm.ifree[lm.nfree++] = i;
+	}
+	int nfree = lm.nfree;
+	if (nfree == 0) {
+		lm_free(&lm, lm.ifree);
+		return MP_ERR_NFREE;
+	}
+	if (m < nfree) {
+		lm_free(&lm, lm.ifree);
+		return MP_ERR_DOF;
+	}
+
+	lm.col_block = lm_alloc(&lm, sizeof(int) * nfree);
+	lm.col_local = lm_alloc(&lm, sizeof(int) * nfree);
+	lm.elim_free = lm_alloc(&lm, sizeof(int) * nfree);
+	lm.shared_free = lm_alloc(&lm, sizeof(int) * nfree);
+	lm.jac = lm_alloc(&lm, sizeof(FLT) * m * nfree);
+	lm.derivs = lm_alloc(&lm, sizeof(FLT *) * npar);
+	lm.row_start = lm_alloc(&lm, sizeof(int) * (m + 1));
+	lm.g = lm_alloc(&lm, sizeof(FLT) * nfree);
+	lm.diag = lm_calloc(&lm, sizeof(FLT) * nfree);
+	lm.y = lm_alloc(&lm, sizeof(FLT) * nfree);
+	layout(&lm, param_block);
+
+	FLT *x = lm_alloc(&lm, sizeof(FLT) * npar * 2);
+	FLT *x_new = x + npar;
+	FLT *fvec = lm_alloc(&lm, sizeof(FLT) * m * 3);
+	FLT *fvec_new = fvec + m, *wa = fvec + 2 * m;
+	// Two nfree vectors for the step plus the shared rhs; doubles as the covariance workspace
+	FLT *delta = lm_alloc(&lm, sizeof(FLT) * nfree * 3);
+	memcpy(x, xall, sizeof(FLT) * npar);
+
+	int nfev = 0, niter = 1, status = 0;
+	FLT lambda = 1e-3, nu = 2;
+
+	// The damping of the last accepted step; the tail of a converged solve is round off, and can run lambda way up
+	FLT accepted_lambda = 0;
+	bool warm = warm_start && warm_start->lambda > 0 && warm_start->nfree == nfree;
+	if (warm) {
+		// Every run ends a few steps further down; left alone lambda heads to 0 over a long track, and climbing back up
+		// after a rejected step costs an evaluation per doubling. Past this it is Gauss-Newton anyway.
+		lambda = warm_start->lambda > 1e-6 ? warm_start->lambda : 1e-6;
+		memcpy(lm.diag, warm_start->diag, sizeof(FLT) * nfree);
+	}
+
+	status = linearize(&lm, param_block, x, fvec, wa, eps, &nfev);
+	// The shared set can grow in the dense fallback; size the scratch space for the worst case
+	lm.scratch = lm_alloc(&lm, sizeof(FLT) * (nfree * nfree + nfree + 1));
+	FLT fnorm = chi2(fvec, m), orignorm = fnorm;
+	bool linearized = true;
+
+	while (status == 0) {
+		if (!nofinitecheck && !isfinite(fnorm)) {
+			status = MP_ERR_NAN;
+			break;
+		}
+
+		// Cosine of the angle between the residuals and any Jacobian column
+		FLT gnorm = 0;
+		for (int j = 0; j < nfree && fnorm > 0; j++) {
+			if (lm.diag[j] > 0) {
+				FLT c = fabs(lm.g[j]) / sqrt(lm.diag[j] * fnorm);
+				if (c > gnorm)
+					gnorm = c;
+			}
+		}
+		if (gnorm <= gtol) {
+			status = MP_OK_DIR;
+			break;
+		}
+		if (maxiter == 0) {
+			status = MP_MAXITER;
+			break;
+		}
+
+		bool accepted = false;
+		while (!accepted && status == 0) {
+			if (lambda > 1e16) {
+				status = MP_FTOL;
+				break;
+			}
+			if (!solve_step(&lm, lambda, delta)) {
+				lambda *= nu;
+				nu *= 2;
+				continue;
+			}
+
+			// Bounds are enforced by clamping; the model reduction below is for the step actually taken
+			memcpy(x_new, x, sizeof(FLT) * npar);
+			FLT xnorm = 0, dxnorm = 0, gdelta = 0;
+			for (int j = 0; j < nfree; j++) {
+				int p = lm.ifree[j];
+				FLT v = x[p] + delta[j];
+				if (pars && pars[p].limited[0] && v < pars[p].limits[0])
+					v = pars[p].limits[0];
+				if (pars && pars[p].limited[1] && v > pars[p].limits[1])
+					v = pars[p].limits[1];
+				x_new[p] = v;
+				delta[j] = v - x[p];
+
+				FLT d = sqrt(lm.diag[j]);
+				xnorm += d * x[p] * d * x[p];
+				dxnorm += d * delta[j] * d * delta[j];
+				gdelta += lm.g[j] * delta[j];
+			}
+			xnorm = sqrt(xnorm);
+			dxnorm = sqrt(dxnorm);
+
+			FLT jdelta = 0;
+			for (int i = 0; i < m; i++) {
+				FLT v = 0;
+				for (int k = lm.row_start[i]; k < lm.row_start[i + 1]; k++)
+					v += lm.entries[k].v * delta[lm.entries[k].col];
+				jdelta += v * v;
+			}
+			FLT predicted = -(2 * gdelta + jdelta);
+
+			if ((status = evaluate(&lm, x_new, fvec_new, 0, &nfev)) < 0)
+				break;
+			FLT fnorm_new = chi2(fvec_new, m);
+			FLT actual = isfinite(fnorm_new) ? fnorm - fnorm_new : -1;
+			FLT rho = predicted > 0 ? actual / predicted : -1;
+
+			if (rho > 0) {
+				accepted = true;
+				accepted_lambda = lambda;
+				FLT *t = x;
+				x = x_new;
+				x_new = t;
+				t = fvec;
+				fvec = fvec_new;
+				fvec_new = t;
+				FLT prev = fnorm;
+				fnorm = fnorm_new;
+				linearized = false;
+
+				FLT s = 2 * rho - 1;
+				FLT scale = 1 - s * s * s;
+				lambda *= scale > 1. / 3. ? scale : 1. / 3.;
+				nu = 2;
+
+				bool chi_ok = fabs(actual) <= ftol * prev && predicted <= ftol * prev;
+				bool par_ok = dxnorm <= xtol * xnorm;
+				if (chi_ok && par_ok)
+					status = MP_OK_BOTH;
+				else if (chi_ok)
+					status = MP_OK_CHI;
+				else if (par_ok)
+					status = MP_OK_PAR;
+				else if (normtol > 0 && fnorm < normtol)
+					status = MP_OK_NORM;
+			} else {
+				lambda *= nu;
+				nu *= 2;
+				if (predicted <= MP_MACHEP0 * fnorm)
+					status = MP_FTOL;
+				else if (dxnorm <= MP_MACHEP0 * xnorm)
+					status = MP_XTOL;
+			}
+
+			if (status == 0 && maxfev > 0 && nfev >= maxfev)
+				status = MP_MAXITER;
+		}
+
+		if (status != 0)
+			break;
+		if (++niter > maxiter) {
+			status = MP_MAXITER;
+			break;
+		}
+		status = linearize(&lm, param_block, x, fvec, wa, eps, &nfev);
+		linearized = status == 0;
+	}
+
+	if (status > 0) {
+		memcpy(xall, x, sizeof(FLT) * npar);
+	}
+
+	if (warm_start) {
+		// Failed solves don't say anything useful about the next one
+		bool keep = status > 0 && accepted_lambda > 0 && nfree <= SURVIVE_OPTIMIZER_WARM_START_MAX_FREE;
+		warm_start->warm_solves = keep && warm ? warm_start->warm_solves + 1 : 0;
+		warm_start->lambda = keep ? accepted_lambda : 0;
+		warm_start->nfree = keep ? nfree : 0;
+		if (keep)
+			memcpy(warm_start->diag, lm.diag, sizeof(FLT) * nfree);
+	}
+
+	if (result) {
+		result->bestnorm = fnorm;
+		result->orignorm = orignorm;
+		result->niter = niter;
+		result->nfev = nfev;
+		result->status = status;
+		result->npar = npar;
+		result->nfree = nfree;
+		result->npegged = 0;
+		result->nfunc = m;
+		result->nderivfail = 0;
+		strcpy(result->version, MPFIT_VERSION);
+
+		if (result->resid)
+			memcpy(result->resid, fvec, sizeof(FLT) * m);
+
+		if (status > 0 && (result->covar || result->xerror || result->covar_free) &&
+			(linearized || linearize(&lm, param_block, x, wa, fvec_new, eps, &nfev) == 0)) {
+			FLT *C = lm.scratch;
+			assemble_normal(&lm, C);
+			invert_psd(C, nfree, covtol, delta);
+
+			if (result->covar_free)
+				memcpy(result->covar_free, C, sizeof(FLT) * nfree * nfree);
+			if (result->covar) {
+				memset(result->covar, 0, sizeof(FLT) * npar * npar);
+				for (int j = 0; j < nfree; j++) {
+					for (int i = 0; i < nfree; i++)
+						result->covar[lm.ifree[j] * npar + lm.ifree[i]] = C[j * nfree + i];
+				}
+			}
+			if (result->xerror) {
+				memset(result->xerror, 0, sizeof(FLT) * npar);
+				for (int j = 0; j < nfree; j++) {
+					if (C[j * nfree + j] > 0)
+						result->xerror[lm.ifree[j]] = sqrt(C[j * nfree + j]);
+				}
+			}
+		}
+	}
+
+	lm_free(&lm, x < x_new ? x : x_new);
+	lm_free(&lm, fvec < fvec_new ? fvec : fvec_new);
+	lm_free(&lm, delta);
+	sparse_lm_free(&lm);
+	return status;
+}
@@ -0,0 +1,577 @@
+#include "survive_pipeline.h"
+#include "os_generic.h"
+#include "survive_config.h"
+#include "survive_internal.h"
+#include "survive_private.h"
+
+#include <string.h>
+
+STATIC_CONFIG_ITEM(PIPELINE, "pipeline", 'b',
+				   "Run light and imu processing for each device on worker threads instead of the driver thread", 0)
+STATIC_CONFIG_ITEM(PIPELINE_THREADS, "pipeline-threads", 'i',
+				   "Number of pipeline worker threads. 0 runs one worker per device.", 0)
+STATIC_CONFIG_ITEM(PIPELINE_QUEUE_SIZE, "pipeline-queue-size", 'i',
+				   "Events buffered per device before new events are dropped. Rounded up to a power of two.", 4096)
+
+// Max events processed per acquisition of the object lock; keeps the driver thread from waiting long on it.
+#define PIPELINE_BATCH_SIZE 64
+
+// Hooks invoked from a worker -- ie the default sync handler calling sweep_angle -- must run inline; queueing them
+// would put them behind events that come after them.
+static SURVIVE_THREAD_LOCAL bool on_pipeline_worker;
+
+// Marks objects whose queue was torn down; events for them are processed inline.
+static int pipeline_detached;
+
+enum survive_pipeline_event_type {
+	SURVIVE_PIPELINE_LIGHTCAP,
+	SURVIVE_PIPELINE_LIGHT,
+	SURVIVE_PIPELINE_ANGLE,
+	SURVIVE_PIPELINE_SYNC,
+	SURVIVE_PIPELINE_SWEEP,
+	SURVIVE_PIPELINE_SWEEP_ANGLE,
+	SURVIVE_PIPELINE_RAW_IMU,
+	SURVIVE_PIPELINE_IMU,
+};
+
+typedef struct survive_pipeline_event {
+	uint8_t type;
+	// survive_received_time on the driver thread; restored on the worker so it follows the event
+	survive_us received_us;
+	union {
+		LightcapElement lightcap;
+		struct {
+			int sensor_id, acode, timeinsweep;
+			survive_timecode timecode, length;
+			uint32_t lh;
+		} light;
+		struct {
+			int sensor_id, acode;
+			survive_timecode timecode;
+			FLT length, angle;
+			uint32_t lh;
+		} angle;
+		struct {
+			survive_channel channel;
+			survive_timecode timecode;
+			bool ootx, gen;
+		} sync;
+		struct {
+			survive_channel channel;
+			int sensor_id;
+			survive_timecode timecode;
+			bool half_clock_flag;
+		} sweep;
+		struct {
+			survive_channel channel;
+			int sensor_id;
+			survive_timecode timecode;
+			int8_t plane;
+			FLT angle;
+		} sweep_angle;
+		struct {
+			int mask;
+			FLT accelgyro[9];
+			survive_timecode timecode;
+			int id;
+		} imu;
+	} u;
+} survive_pipeline_event;
+
+typedef struct survive_pipeline_queue {
+	SurviveObject *so;
+	struct survive_pipeline_worker *worker;
+
+	survive_pipeline_event *events;
+	uint32_t mask;
+	// head is only written by the producer, tail only by the worker
+	volatile uint32_t head, tail;
+
+	// Guarded by the worker lock; set while the worker is draining this queue
+	bool busy;
+
+	volatile uint32_t dropped;
+	uint32_t processed, max_depth;
+} survive_pipeline_queue;
+
+typedef struct survive_pipeline_worker {
+	struct survive_pipeline *pipeline;
+	og_thread_t thread;
+
+	og_mutex_t lock;
+	og_cv_t wake, idle;
+	volatile uint32_t sleeping;
+	bool active;
+
+	survive_pipeline_queue **queues;
+	size_t queues_cnt;
+
+	uint32_t wakeups;
+} survive_pipeline_worker;
+
+struct survive_pipeline {
+	SurviveContext *ctx;
+
+	og_mutex_t lock;
+	volatile uint32_t closed;
+	uint32_t queue_size;
+
+	int thread_cnt;
+	survive_pipeline_worker **workers;
+	size_t workers_cnt;
+	size_t next_worker;
+
+	lightcap_process_func lightcap_fn;
+	light_process_func light_fn;
+	angle_process_func angle_fn;
+	sync_process_func sync_fn;
+	sweep_process_func sweep_fn;
+	sweep_angle_process_func sweep_angle_fn;
+	raw_imu_process_func raw_imu_fn;
+	imu_process_func imu_fn;
+	disconnect_process_func disconnect_fn;
+};
+
+static inline struct survive_pipeline *pipeline_get(SurviveContext *ctx) {
+	struct SurviveContext_private *pctx = ctx->private_members;
+	return pctx->pipeline;
+}
+
+static void pipeline_dispatch(struct survive_pipeline *self, SurviveObject *so, const survive_pipeline_event *ev) {
+	survive_set_received_time(ev->received_us);
+	switch (ev->type) {
+	case SURVIVE_PIPELINE_LIGHTCAP:
+		self->lightcap_fn(so, &ev->u.lightcap);
+		break;
+	case SURVIVE_PIPELINE_LIGHT:
+		self->light_fn(so, ev->u.light.sensor_id, ev->u.light.acode, ev->u.light.timeinsweep, ev->u.light.timecode,
+					   ev->u.light.length, ev->u.light.lh);
+		break;
+	case SURVIVE_PIPELINE_ANGLE:
+		self->angle_fn(so, ev->u.angle.sensor_id, ev->u.angle.acode, ev->u.angle.timecode, ev->u.angle.length,
+					   ev->u.angle.angle, ev->u.angle.lh);
+		break;
+	case SURVIVE_PIPELINE_SYNC:
+		self->sync_fn(so, ev->u.sync.channel, ev->u.sync.timecode, ev->u.sync.ootx, ev->u.sync.gen);
+		break;
+	case SURVIVE_PIPELINE_SWEEP:
+		self->sweep_fn(so, ev->u.sweep.channel, ev->u.sweep.sensor_id, ev->u.sweep.timecode,
+					   ev->u.sweep.half_clock_flag);
+		break;
+	case SURVIVE_PIPELINE_SWEEP_ANGLE:
+		self->sweep_angle_fn(so, ev->u.sweep_angle.channel, ev->u.sweep_angle.sensor_id, ev->u.sweep_angle.timecode,
+							 ev->u.sweep_angle.plane, ev->u.sweep_angle.angle);
+		break;
+	case SURVIVE_PIPELINE_RAW_IMU:
+		self->raw_imu_fn(so, ev->u.imu.mask, ev->u.imu.accelgyro, ev->u.imu.timecode, ev->u.imu.id);
+		break;
+	case SURVIVE_PIPELINE_IMU:
+		self->imu_fn(so, ev->u.imu.mask, ev->u.imu.accelgyro, ev->u.imu.timecode, ev->u.imu.id);
+		break;
+	}
+}
+
+static bool pipeline_drain(struct survive_pipeline *self, survive_pipeline_queue *q) {
+	uint32_t tail = q->tail;
+	uint32_t head = OGAtomicLoadU32(&q->head);
+	if (head == tail) {
+		return false;
+	}
+
+	if (head - tail > q->max_depth) {
+		q->max_depth = head - tail;
+	}
+
+	while (tail != head) {
+		uint32_t end = head - tail > PIPELINE_BATCH_SIZE ? tail + PIPELINE_BATCH_SIZE : head;
+
+		q->processed += end - tail;
+
+		survive_get_so_lock(q->so);
+		for (; tail != end; tail++) {
+			pipeline_dispatch(self, q->so, &q->events[tail & q->mask]);
+		}
+		survive_release_so_lock(q->so);
+
+		OGAtomicStoreU32(&q->tail, tail);
+	}
+	return true;
+}
+
+static bool pipeline_has_work(survive_pipeline_worker *w) {
+	for (size_t i = 0; i < w->queues_cnt; i++) {
+		survive_pipeline_queue *q = w->queues[i];
+		if (OGAtomicLoadU32(&q->head) != q->tail) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void *pipeline_worker_fn(void *_worker) {
+	survive_pipeline_worker *w = _worker;
+	on_pipeline_worker = true;
+
+	OGLockMutex(w->lock);
+	while (w->active) {
+		bool did_work = false;
+		for (size_t i = 0; i < w->queues_cnt; i++) {
+			survive_pipeline_queue *q = w->queues[i];
+			q->busy = true;
+			OGUnlockMutex(w->lock);
+
+			did_work |= pipeline_drain(w->pipeline, q);
+
+			OGLockMutex(w->lock);
+			q->busy = false;
+			OGBroadcastCond(w->idle);
+		}
+
+		if (!did_work) {
+			// Producers only signal when they see 'sleeping'; the fence pairs with the one in pipeline_push so either
+			// they see the flag or we see their event.
+			OGAtomicStoreU32(&w->sleeping, 1);
+			OGMemoryBarrier();
+			if (w->active && !pipeline_has_work(w)) {
+				OGWaitCondTimeout(w->wake, w->lock, 10);
+				w->wakeups++;
+			}
+			OGAtomicStoreU32(&w->sleeping, 0);
+		}
+	}
+	OGUnlockMutex(w->lock);
+	return 0;
+}
+
+static survive_pipeline_worker *pipeline_create_worker(struct survive_pipeline *self) {
+	survive_pipeline_worker *w = SV_CALLOC(sizeof(survive_pipeline_worker));
+	w->pipeline = self;
+	w->lock = OGCreateMutex();
+	w->wake = OGCreateConditionVariable();
+	w->idle = OGCreateConditionVariable();
+	w->active = true;
+	w->thread = OGCreateThread(pipeline_worker_fn, "pipeline worker", w);
+
+	self->workers = SV_REALLOC(self->workers, sizeof(survive_pipeline_worker *) * (self->workers_cnt + 1));
+	self->workers[self->workers_cnt++] = w;
+	return w;
+}
+
+static survive_pipeline_queue *pipeline_create_queue(struct survive_pipeline *self, SurviveObject *so) {
+	survive_pipeline_queue *q = SV_CALLOC(sizeof(survive_pipeline_queue));
+	q->so = so;
+	q->mask = self->queue_size - 1;
+	q->events = SV_CALLOC_N(self->queue_size, sizeof(survive_pipeline_event));
+
+	OGLockMutex(self->lock);
+	survive_pipeline_worker *w = 0;
+	if (self->thread_cnt <= 0) {
+		w = pipeline_create_worker(self);
+	} else {
+		w = self->workers[self->next_worker++ % self->workers_cnt];
+	}
+	q->worker = w;
+	OGUnlockMutex(self->lock);
+
+	OGLockMutex(w->lock);
+	w->queues = SV_REALLOC(w->queues, sizeof(survive_pipeline_queue *) * (w->queues_cnt + 1));
+	w->queues[w->queues_cnt++] = q;
+	OGUnlockMutex(w->lock);
+
+	SurviveContext *ctx = self->ctx;
+	SV_VERBOSE(10, "Pipeline queue for %s on worker %p", survive_colorize_codename(so), (void *)w);
+	return q;
+}
+
+static void pipeline_log_queue(struct survive_pipeline *self, survive_pipeline_queue *q) {
+	SurviveContext *ctx = self->ctx;
+	SV_VERBOSE(5, "Pipeline stats for %s:", survive_colorize_codename(q->so));
+	SV_VERBOSE(5, "\tProcessed   %u", q->processed);
+	SV_VERBOSE(5, "\tMax depth   %u", q->max_depth);
+	SV_VERBOSE(5, "\tDropped     %u", q->dropped);
+	if (q->dropped) {
+		SV_WARN("Pipeline dropped %u events for %s; consider raising pipeline-queue-size", q->dropped,
+				survive_colorize_codename(q->so));
+	}
+}
+
+// Removes the queue from its worker, waits for the worker to be done with it and processes whatever is left inline.
+static void pipeline_detach_queue(struct survive_pipeline *self, survive_pipeline_queue *q) {
+	survive_pipeline_worker *w = q->worker;
+	OGLockMutex(w->lock);
+	for (size_t i = 0; i < w->queues_cnt; i++) {
+		if (w->queues[i] == q) {
+			w->queues[i] = w->queues[--w->queues_cnt];
+			break;
+		}
+	}
+	while (q->busy) {
+		OGWaitCond(w->idle, w->lock);
+	}
+	OGUnlockMutex(w->lock);
+
+	bool was_on_worker = on_pipeline_worker;
+	on_pipeline_worker = true;
+	pipeline_drain(self, q);
+	on_pipeline_worker = was_on_worker;
+
+	pipeline_log_queue(self, q);
+
+	survive_get_so_lock(q->so);
+	*survive_object_plugin_data(q->so, survive_pipeline_install) = &pipeline_detached;
+	survive_release_so_lock(q->so);
+	free(q->events);
+	free(q);
+}
+
+static survive_pipeline_queue *pipeline_queue_for(struct survive_pipeline *self, SurviveObject *so) {
+	if (on_pipeline_worker || OGAtomicLoadU32(&self->closed)) {
+		return 0;
+	}
+
+	// Workers look up plugin data for this object while holding its lock, and adding an entry can reallocate the list,
+	// so even a plain lookup has to be done under it.
+	survive_get_so_lock(so);
+	SurvivePluginData *slot = survive_object_plugin_data(so, survive_pipeline_install);
+	if (*slot == 0) {
+		*slot = pipeline_create_queue(self, so);
+	}
+	survive_pipeline_queue *q = *slot == &pipeline_detached ? 0 : *slot;
+	survive_release_so_lock(so);
+	return q;
+}
+
+static void pipeline_push(survive_pipeline_queue *q, const survive_pipeline_event *ev) {
+	uint32_t head = q->head;
+	if (head - OGAtomicLoadU32(&q->tail) > q->mask) {
+		OGAtomicAddU32(&q->dropped, 1);
+		return;
+	}
+
+	q->events[head & q->mask] = *ev;
+	q->events[head & q->mask].received_us = survive_received_time();
+	OGAtomicStoreU32(&q->head, head + 1);
+
+	OGMemoryBarrier();
+	survive_pipeline_worker *w = q->worker;
+	if (OGAtomicLoadU32(&w->sleeping)) {
+		OGLockMutex(w->lock);
+		OGSignalCond(w->wake);
+		OGUnlockMutex(w->lock);
+	}
+}
+
+static void pipeline_lightcap(SurviveObject *so, const LightcapElement *le) {
+	struct survive_pipeline *self = pipeline_get(so->ctx);
+	survive_pipeline_queue *q = le ? pipeline_queue_for(self, so) : 0;
+	if (q == 0) {
+		self->lightcap_fn(so, le);
+		return;
+	}
+	survive_pipeline_event ev = {.type = SURVIVE_PIPELINE_LIGHTCAP, .u.lightcap = *le};
+	pipeline_push(q, &ev);
+}
+
+static void pipeline_light(SurviveObject *so, int sensor_id, int acode, int timeinsweep, survive_timecode timecode,
+						   survive_timecode length, uint32_t lh) {
+	struct survive_pipeline *self = pipeline_get(so->ctx);
+	survive_pipeline_queue *q = pipeline_queue_for(self, so);
+	if (q == 0) {
+		self->light_fn(so, sensor_id, acode, timeinsweep, timecode, length, lh);
+		return;
+	}
+	survive_pipeline_event ev = {.type = SURVIVE_PIPELINE_LIGHT,
+								 .u.light = {.sensor_id = sensor_id,
+											 .acode = acode,
+											 .timeinsweep = timeinsweep,
+											 .timecode = timecode,
+											 .length = length,
+											 .lh = lh}};
+	pipeline_push(q, &ev);
+}
+
+static void pipeline_angle(SurviveObject *so, int sensor_id, int acode, survive_timecode timecode, FLT length,
+						   FLT angle, uint32_t lh) {
+	struct survive_pipeline *self = pipeline_get(so->ctx);
+	survive_pipeline_queue *q = pipeline_queue_for(self, so);
+	if (q == 0) {
+		self->angle_fn(so, sensor_id, acode, timecode, length, angle, lh);
+		return;
+	}
+	survive_pipeline_event ev = {
+		.type = SURVIVE_PIPELINE_ANGLE,
+		.u.angle = {
+			.sensor_id = sensor_id, .acode = acode, .timecode = timecode, .length = length, .angle = angle, .lh = lh}};
+	pipeline_push(q, &ev);
+}
+
+static void pipeline_sync(SurviveObject *so, survive_channel channel, survive_timecode timecode, bool ootx, bool gen) {
+	struct survive_pipeline *self = pipeline_get(so->ctx);
+	survive_pipeline_queue *q = pipeline_queue_for(self, so);
+	if (q == 0) {
+		self->sync_fn(so, channel, timecode, ootx, gen);
+		return;
+	}
+	survive_pipeline_event ev = {.type = SURVIVE_PIPELINE_SYNC,
+								 .u.sync = {.channel = channel, .timecode = timecode, .ootx = ootx, .gen = gen}};
+	pipeline_push(q, &ev);
+}
+
+static void pipeline_sweep(SurviveObject *so, survive_channel channel, int sensor_id, survive_timecode timecode,
+						   bool half_clock_flag) {
+	struct survive_pipeline *self = pipeline_get(so->ctx);
+	survive_pipeline_queue *q = pipeline_queue_for(self, so);
+	if (q == 0) {
+		self->sweep_fn(so, channel, sensor_id, timecode, half_clock_flag);
+		return;
+	}
+	survive_pipeline_event ev = {
+		.type = SURVIVE_PIPELINE_SWEEP,
+		.u.sweep = {
+			.channel = channel, .sensor_id = sensor_id, .timecode = timecode, .half_clock_flag = half_clock_flag}};
+	pipeline_push(q, &ev);
+}
+
+static void pipeline_sweep_angle(SurviveObject *so, survive_channel channel, int sensor_id, survive_timecode timecode,
+								 int8_t plane, FLT angle) {
+	struct survive_pipeline *self = pipeline_get(so->ctx);
+	survive_pipeline_queue *q = pipeline_queue_for(self, so);
+	if (q == 0) {
+		self->sweep_angle_fn(so, channel, sensor_id, timecode, plane, angle);
+		return;
+	}
+	survive_pipeline_event ev = {
+		.type = SURVIVE_PIPELINE_SWEEP_ANGLE,
+		.u.sweep_angle = {
+			.channel = channel, .sensor_id = sensor_id, .timecode = timecode, .plane = plane, .angle = angle}};
+	pipeline_push(q, &ev);
+}
+
+static void pipeline_fill_imu(survive_pipeline_event *ev, int mask, const FLT *accelgyro, survive_timecode timecode,
+							  int id) {
+	ev->u.imu.mask = mask;
+	// Consumers read up to 9 values (acc, gyro, mag) regardless of mask
+	memcpy(ev->u.imu.accelgyro, accelgyro, sizeof(ev->u.imu.accelgyro));
+	ev->u.imu.timecode = timecode;
+	ev->u.imu.id = id;
+}
+
+static void pipeline_raw_imu(SurviveObject *so, int mask, const FLT *accelgyro, survive_timecode timecode, int id) {
+	struct survive_pipeline *self = pipeline_get(so->ctx);
+	survive_pipeline_queue *q = pipeline_queue_for(self, so);
+	if (q == 0) {
+		self->raw_imu_fn(so, mask, accelgyro, timecode, id);
+		return;
+	}
+	survive_pipeline_event ev = {.type = SURVIVE_PIPELINE_RAW_IMU};
+	pipeline_fill_imu(&ev, mask, accelgyro, timecode, id);
+	pipeline_push(q, &ev);
+}
+
+static void pipeline_imu(SurviveObject *so, int mask, const FLT *accelgyro, survive_timecode timecode, int id) {
+	struct survive_pipeline *self = pipeline_get(so->ctx);
+	survive_pipeline_queue *q = pipeline_queue_for(self, so);
+	if (q == 0) {
+		self->imu_fn(so, mask, accelgyro, timecode, id);
+		return;
+	}
+	survive_pipeline_event ev = {.type = SURVIVE_PIPELINE_IMU};
+	pipeline_fill_imu(&ev, mask, accelgyro, timecode, id);
+	pipeline_push(q, &ev);
+}
+
+static void pipeline_disconnect(SurviveObject *so) {
+	struct survive_pipeline *self = pipeline_get(so->ctx);
+	if (!OGAtomicLoadU32(&self->closed)) {
+		survive_get_so_lock(so);
+		survive_pipeline_queue *q = *survive_object_plugin_data(so, survive_pipeline_install);
+		survive_release_so_lock(so);
+		if (q && q != (survive_pipeline_queue *)&pipeline_detached) {
+			pipeline_detach_queue(self, q);
+		}
+	}
+	self->disconnect_fn(so);
+}
+
+void survive_pipeline_install(SurviveContext *ctx) {
+	struct SurviveContext_private *pctx = ctx->private_members;
+	if (pctx->pipeline || !survive_configi(ctx, PIPELINE_TAG, SC_GET, 0)) {
+		return;
+	}
+
+	struct survive_pipeline *self = SV_CALLOC(sizeof(struct survive_pipeline));
+	self->ctx = ctx;
+	self->lock = OGCreateMutex();
+	self->thread_cnt = survive_configi(ctx, PIPELINE_THREADS_TAG, SC_GET, 0);
+
+	int32_t queue_size = survive_configi(ctx, PIPELINE_QUEUE_SIZE_TAG, SC_GET, 4096);
+	self->queue_size = 16;
+	while (self->queue_size < queue_size && self->queue_size < (1u << 24)) {
+		self->queue_size <<= 1;
+	}
+
+	for (int i = 0; i < self->thread_cnt; i++) {
+		pipeline_create_worker(self);
+	}
+
+	pctx->pipeline = self;
+
+	self->lightcap_fn = survive_install_lightcap_fn(ctx, pipeline_lightcap);
+	self->light_fn = survive_install_light_fn(ctx, pipeline_light);
+	self->angle_fn = survive_install_angle_fn(ctx, pipeline_angle);
+	self->sync_fn = survive_install_sync_fn(ctx, pipeline_sync);
+	self->sweep_fn = survive_install_sweep_fn(ctx, pipeline_sweep);
+	self->sweep_angle_fn = survive_install_sweep_angle_fn(ctx, pipeline_sweep_angle);
+	self->raw_imu_fn = survive_install_raw_imu_fn(ctx, pipeline_raw_imu);
+	self->imu_fn = survive_install_imu_fn(ctx, pipeline_imu);
+	self->disconnect_fn = survive_install_disconnect_fn(ctx, pipeline_disconnect);
+
+	SV_INFO("Event pipeline enabled with %s%d workers (queue size %u)", self->thread_cnt <= 0 ? "per device " : "",
+			self->thread_cnt <= 0 ? 0 : self->thread_cnt, self->queue_size);
+}
+
+void survive_pipeline_close(SurviveContext *ctx) {
+	struct survive_pipeline *self = pipeline_get(ctx);
+	if (self == 0 || OGAtomicLoadU32(&self->closed)) {
+		return;
+	}
+
+	for (size_t i = 0; i < self->workers_cnt; i++) {
+		survive_pipeline_worker *w = self->workers[i];
+		while (w->queues_cnt) {
+			pipeline_detach_queue(self, w->queues[0]);
+		}
+
+		OGLockMutex(w->lock);
+		w->active = false;
+		OGSignalCond(w->wake);
+		OGUnlockMutex(w->lock);
+		OGJoinThread(w->thread);
+
+		SV_VERBOSE(5, "Pipeline worker %d woke %u times", (int)i, w->wakeups);
+
+		OGDeleteConditionVariable(w->wake);
+		OGDeleteConditionVariable(w->idle);
+		OGDeleteMutex(w->lock);
+		free(w->queues);
+		free(w);
+	}
+	free(self->workers);
+	self->workers = 0;
+	self->workers_cnt = 0;
+
+	OGAtomicStoreU32(&self->closed, 1);
+}
+
+void survive_pipeline_free(SurviveContext *ctx) {
+	struct SurviveContext_private *pctx = ctx->private_members;
+	struct survive_pipeline *self = pctx->pipeline;
+	if (self == 0) {
+		return;
+	}
+
+	survive_pipeline_close(ctx);
+	OGDeleteMutex(self->lock);
+	free(self);
+	pctx->pipeline = 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "survive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Optional sharded event pipeline. When enabled with the 'pipeline' config option, the raw light and imu hooks
+ * (lightcap, light, angle, sync, sweep, sweep_angle, raw_imu, imu) no longer run inline on the driver thread. Each
+ * object gets a single producer / single consumer queue and a worker thread drains it while holding that object's
+ * lock, so disambiguation, activations, kalman integration and posers for different objects run concurrently.
+ *
+ * Each object is expected to have exactly one producing thread, which is the case for all of the in tree drivers.
+ */
+struct survive_pipeline;
+
+/**
+ * Wraps the currently installed light and imu hooks. Called at the end of survive_startup so any hooks installed by
+ * drivers or the user run on the worker threads too.
+ */
+void survive_pipeline_install(SurviveContext *ctx);
+
+/**
+ * Processes everything still queued, stops the worker threads and logs per object stats. Hooks keep working after
+ * this, they just run inline again.
+ */
+void survive_pipeline_close(SurviveContext *ctx);
+void survive_pipeline_free(SurviveContext *ctx);
+
+#ifdef __cplusplus
+}
+#endif
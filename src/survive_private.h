@@ -7,6 +7,20 @@ struct SurviveExternalPose {
 
 struct SurviveContext_private {
 	og_sema_t poll_sema;
+	og_mutex_t bsd_lock;
+	bool object_locks;
+	struct survive_pipeline *pipeline;
+	// Worker threads for 'optimizer-threads'; null when it is 1
+	struct survive_thread_pool *optimizer_pool;
+	// IMU samples integrated together across objects for 'kalman-imu-batch'; null when it is off
+	struct SurviveKalmanTrackerIMUBatch *imu_batch;
+	// 'report-in-imu', read once at init
+	bool report_in_imu;
+	// survive_optimizer's defaults for problems that don't set their own cfg; read on first use under bsd_lock
+	struct mp_config_struct *optimizer_cfg;
+	// survive_context_plugin_data entries; guarded by bsd_lock
+	SurvivePluginPair *PluginDataEntries;
+	size_t PluginDataEntries_cnt, PluginDataEntries_space;
 	survive_run_time_fn runTimeFn;
 	void *runTimeFnUser;
 	double lastRunTime;
@@ -16,4 +30,10 @@ struct SurviveContext_private {
 
 	struct SurviveExternalPose ExternalPoses[16];
 	SurvivePose external2world;
-};
\ No newline at end of file
+};
+
+// Contexts put together by hand, like the tests', have no private members; those look the setting up every time
+static inline bool survive_report_in_imu(SurviveContext *ctx) {
+	struct SurviveContext_private *pctx = ctx->private_members;
+	return pctx ? pctx->report_in_imu : survive_configi(ctx, "report-in-imu", SC_GET, 0);
+}
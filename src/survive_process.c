@@ -22,10 +22,7 @@ void survive_default_button_process(SurviveObject *so, enum SurviveInputEvent ev
 STATIC_CONFIG_ITEM(REPORT_IN_IMU, "report-in-imu", 'b', "Debug option to output poses in IMU space.", 0)
 STATIC_CONFIG_ITEM(USE_EXTERNAL_LH, "use-external-lighthouse", 'b', "Use external lighthouse if available", 0)
 void survive_default_imupose_process(SurviveObject *so, survive_long_timecode timecode, const SurvivePose *imu2world) {
-	static int report_in_imu = -1;
-	if (report_in_imu == -1) {
-		report_in_imu = survive_configi(so->ctx, REPORT_IN_IMU_TAG, SC_GET, 0);
-	}
+	bool report_in_imu = survive_report_in_imu(so->ctx);
 
 	SurvivePose head2world;
 	so->OutPoseIMU = *imu2world;
@@ -177,16 +174,19 @@ void survive_default_external_pose_process(SurviveContext *ctx, const char *name
 }
 
 void survive_default_ootx_received_process(struct SurviveContext *ctx, uint8_t bsd_idx) {
+	survive_get_bsd_lock(ctx);
 	config_set_lighthouse(ctx->lh_config, &ctx->bsd[bsd_idx], bsd_idx);
 	survive_kalman_lighthouse_ootx(ctx->bsd[bsd_idx].tracker);
 
 	survive_recording_write_to_output(ctx->recptr, "LH_UP %d " Point3_format "\n", ctx->bsd[bsd_idx].mode,
 									  LINMATH_VEC3_EXPAND(ctx->bsd[bsd_idx].accel));
+	survive_release_bsd_lock(ctx);
 	config_save(ctx);
 }
 
 void survive_default_raw_lighthouse_pose_process(SurviveContext *ctx, uint8_t lighthouse,
 											 const SurvivePose *lighthouse_pose) {
+	survive_get_bsd_lock(ctx);
 	bool notSet = ctx->bsd[lighthouse].PositionSet == 0;
 	if (lighthouse_pose) {
 		for (int i = 0; i < 3; i++)
@@ -239,14 +239,17 @@ void survive_default_raw_lighthouse_pose_process(SurviveContext *ctx, uint8_t li
 	SurvivePose external_pose = ctx->bsd[lighthouse].Pose;
 	external_pose.Pos[2] -= ctx->floor_offset;
 	calculate_external2world(ctx);
+	survive_release_bsd_lock(ctx);
 
 	SURVIVE_INVOKE_HOOK(lighthouse_pose, ctx, lighthouse, &external_pose);
 }
 
 SURVIVE_EXPORT FLT survive_get_floor_offset(const SurviveContext* ctx) { return ctx->floor_offset; }
 SURVIVE_EXPORT void survive_set_floor_offset(SurviveContext* ctx, FLT floor_offset_meters) {
+	survive_get_bsd_lock(ctx);
 	ctx->floor_offset = floor_offset_meters;
 	calculate_external2world(ctx);
+	survive_release_bsd_lock(ctx);
 	survive_configf(ctx, "floor-offset", SC_OVERRIDE | SC_SETCONFIG, floor_offset_meters);
 	config_save(ctx);
 }
@@ -371,7 +374,7 @@ void survive_default_set_imu_scale_modes(SurviveObject *so, int gyro_scale_mode,
 void survive_default_imu_process(SurviveObject *so, int mask, const FLT *accelgyromag, uint32_t timecode, int id) {
 	survive_long_timecode longTimecode = SurviveSensorActivations_long_timecode_imu(&so->activations, timecode);
 	PoserDataIMU imu = {
-		.hdr = {.pt = POSERDATA_IMU, .timecode = longTimecode},
+		.hdr = {.pt = POSERDATA_IMU, .timecode = longTimecode, .received_us = survive_received_time()},
 		.datamask = mask,
 		.accel = {accelgyromag[0], accelgyromag[1], accelgyromag[2]},
 		.gyro = {accelgyromag[3], accelgyromag[4], accelgyromag[5]},
@@ -384,7 +387,7 @@ void survive_default_imu_process(SurviveObject *so, int mask, const FLT *accelgy
 
 	SV_VERBOSE(300, "%s %s %x (%7.3f): " Point6_format, survive_colorize(so->codename), survive_colorize("IMU"),
 			   timecode, longTimecode / 48000000., LINMATH_VEC3_EXPAND(imu.accel), LINMATH_VEC3_EXPAND(imu.gyro))
-	survive_kalman_tracker_integrate_imu(so->tracker, &imu);
+	survive_kalman_tracker_queue_imu(so->tracker, &imu);
 	SURVIVE_POSER_INVOKE(so, &imu);
 
 	survive_recording_imu_process(so, mask, accelgyromag, timecode, id);
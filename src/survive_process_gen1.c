@@ -40,6 +40,7 @@ void survive_default_light_process(SurviveObject *so, int sensor_id, int acode,
 						{
 							.pt = POSERDATA_SYNC,
 							.timecode = SurviveSensorActivations_long_timecode_light(&so->activations, timecode),
+							.received_us = survive_received_time(),
 						},
 					.sensor_id = sensor_id,
 					.angle = 0,
@@ -105,6 +106,7 @@ void survive_default_angle_process(SurviveObject *so, int sensor_id, int acode,
 					{
 						.pt = POSERDATA_LIGHT,
 						.timecode = SurviveSensorActivations_long_timecode_light(&so->activations, timecode),
+						.received_us = survive_received_time(),
 					},
 				.sensor_id = sensor_id,
 				.angle = angle,
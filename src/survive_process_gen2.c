@@ -157,6 +157,7 @@ void survive_ootx_free_decoder_context(struct SurviveContext *ctx, int bsd_idx)
 void survive_ootx_behavior(SurviveObject *so, int8_t bsd_idx, int8_t lh_version, int ootx) {
 	struct SurviveContext *ctx = so->ctx;
 	if (ctx->bsd[bsd_idx].OOTXChecked == false) {
+		survive_get_bsd_lock(ctx);
 		ootx_decoder_context *decoderContext = ctx->bsd[bsd_idx].ootx_data;
 
 		if (decoderContext == 0) {
@@ -184,6 +185,7 @@ void survive_ootx_behavior(SurviveObject *so, int8_t bsd_idx, int8_t lh_version,
 				// survive_ootx_free_decoder_context(ctx, bsd_idx);
 			}
 		}
+		survive_release_bsd_lock(ctx);
 	}
 }
 
@@ -253,6 +255,7 @@ SURVIVE_EXPORT void survive_default_sync_process(SurviveObject *so, survive_chan
 									{
 										.pt = POSERDATA_SYNC_GEN2,
 										.timecode = SurviveSensorActivations_long_timecode_light(&so->activations, timecode),
+										.received_us = survive_received_time(),
 									},
 								.lh = bsd_idx,
 							}};
@@ -398,6 +401,7 @@ SURVIVE_EXPORT void survive_default_sweep_angle_process(SurviveObject *so, survi
 					{
 						.pt = POSERDATA_LIGHT_GEN2,
 						.timecode = SurviveSensorActivations_long_timecode_light(&so->activations, timecode),
+						.received_us = survive_received_time(),
 					},
 				.sensor_id = sensor_id,
 				.angle = angle,
@@ -17,6 +17,7 @@
 #include <inttypes.h>
 
 #include "survive_recording.h"
+#include "survive_recording_binary.h"
 
 #include "survive_config.h"
 #include "survive_default_devices.h"
@@ -27,6 +28,12 @@
 
 #include "survive_gz.h"
 
+#ifdef SURVIVE_HEX_FLOATS
+#define FLT_PRINTF "%0.6a "
+#else
+#define FLT_PRINTF "%0.6f "
+#endif
+
 typedef struct SurviveRecordingData {
 	SurviveContext *ctx;
 	bool alwaysWriteStdOut;
@@ -36,6 +43,13 @@ typedef struct SurviveRecordingData {
 	bool writeAngle;
 	int writeDataMatrix;
 	gzFile output_file;
+	struct survive_binary_writer *binary;
+
+	// When set, the hooks only serialize into a buffer and a background thread owns output_file and binary
+	struct survive_recording_async *async;
+
+	// Devices can record concurrently when 'object-locks' is set; lines must not interleave.
+	og_mutex_t write_lock;
 } SurviveRecordingData;
 
 // clang-format off
@@ -50,8 +64,293 @@ END_STRUCT_CONFIG_SECTION(SurviveRecordingData)
 
 	STATIC_CONFIG_ITEM(RECORD, "record", 's', "File to record to if you wish to make a recording.", "")
 	STATIC_CONFIG_ITEM(RECORD_STDOUT, "record-stdout", 'b', "Whether or not to dump recording data to stdout", 0)
+	STATIC_CONFIG_ITEM(RECORD_BINARY, "record-binary", 's',
+					   "File to write a binary recording to. Can be used alongside or instead of 'record'.", "")
+	STATIC_CONFIG_ITEM(RECORD_BINARY_COMPRESS, "record-binary-compress", 'b',
+					   "Whether or not to zlib compress binary recording blocks", 1)
+	STATIC_CONFIG_ITEM(RECORD_BINARY_BLOCK_SIZE, "record-binary-block-size", 'i',
+					   "Approximate size in bytes of each binary recording block", 65536)
+	STATIC_CONFIG_ITEM(RECORD_BINARY_KEYFRAME_INTERVAL, "record-binary-keyframe-interval", 'f',
+					   "Maximum seconds between seek points in binary recordings", 1.)
+	STATIC_CONFIG_ITEM(RECORD_ASYNC, "record-async", 'b',
+					   "Buffer recording data and compress / write it from a background thread", 0)
+	STATIC_CONFIG_ITEM(RECORD_ASYNC_BUFFER_SIZE, "record-async-buffer-size", 'i',
+					   "Size in bytes of the async recording buffer. Rounded up to a power of two.", 4 * 1024 * 1024)
+	STATIC_CONFIG_ITEM(RECORD_ASYNC_DROP, "record-async-drop", 'b',
+					   "When the async recording buffer is full, drop and count events instead of blocking the caller",
+					   0)
+
+enum recording_chunk_target {
+	RECORDING_CHUNK_TEXT,
+	RECORDING_CHUNK_BINARY,
+	RECORDING_CHUNK_BINARY_CONFIG,
+};
+
+// Header for every entry in the async buffer. Binary chunks carry the device name, null terminated, before the payload.
+typedef struct recording_chunk {
+	uint32_t size;
+	uint16_t target;
+	uint16_t type;
+	double time;
+} recording_chunk;
+
+/**
+ * Byte ring between the recording hooks and the writer thread. Producers are already serialized by write_lock, so
+ * this is single producer / single consumer and neither side takes a lock unless the ring is full or the writer is
+ * asleep.
+ */
+typedef struct survive_recording_async {
+	og_thread_t thread;
+	og_mutex_t signal_lock;
+	og_cv_t data_cv, space_cv;
+	volatile uint32_t stop;
+	bool drop_on_overflow;
+
+	uint8_t *buffer;
+	uint64_t capacity;
+	volatile uint64_t head, tail;
+
+	// Producer side stats, guarded by write_lock
+	uint64_t chunks, bytes, dropped_chunks, dropped_bytes, blocked_cnt, blocked_us, max_used;
+} survive_recording_async;
+
+static void async_copy_in(survive_recording_async *async, uint64_t pos, const void *data, size_t len) {
+	if (len == 0) {
+		return;
+	}
+	size_t offset = pos & (async->capacity - 1);
+	size_t first = async->capacity - offset < len ? async->capacity - offset : len;
+	memcpy(async->buffer + offset, data, first);
+	memcpy(async->buffer, (const uint8_t *)data + first, len - first);
+}
+
+static void async_copy_out(const survive_recording_async *async, uint64_t pos, void *data, size_t len) {
+	size_t offset = pos & (async->capacity - 1);
+	size_t first = async->capacity - offset < len ? async->capacity - offset : len;
+	memcpy(data, async->buffer + offset, first);
+	memcpy((uint8_t *)data + first, async->buffer, len - first);
+}
+
+// Must be called with write_lock held
+static void async_push(survive_recording_async *async, recording_chunk chunk, const void *a, size_t a_len,
+					   const void *b, size_t b_len) {
+	chunk.size = a_len + b_len;
+	uint64_t needed = sizeof(chunk) + chunk.size;
+	uint64_t head = async->head;
+
+	if (head - OGAtomicLoadU64(&async->tail) + needed > async->capacity) {
+		if (async->drop_on_overflow || needed > async->capacity) {
+			async->dropped_chunks++;
+			async->dropped_bytes += needed;
+			return;
+		}
+
+		uint64_t start = OGGetAbsoluteTimeUS();
+		async->blocked_cnt++;
+		OGLockMutex(async->signal_lock);
+		while (head - OGAtomicLoadU64(&async->tail) + needed > async->capacity) {
+			OGBroadcastCond(async->data_cv);
+			OGWaitCondTimeout(async->space_cv, async->signal_lock, 10);
+		}
+		OGUnlockMutex(async->signal_lock);
+		async->blocked_us += OGGetAbsoluteTimeUS() - start;
+	}
+
+	async_copy_in(async, head, &chunk, sizeof(chunk));
+	async_copy_in(async, head + sizeof(chunk), a, a_len);
+	async_copy_in(async, head + sizeof(chunk) + a_len, b, b_len);
+	OGAtomicStoreU64(&async->head, head + needed);
+
+	async->chunks++;
+	async->bytes += needed;
+
+	// The writer polls, so only nudge it once there is a meaningful amount of data waiting
+	uint64_t used = head + needed - OGAtomicLoadU64(&async->tail);
+	if (used > async->max_used) {
+		async->max_used = used;
+	}
+	if (used >= async->capacity / 4 && used - needed < async->capacity / 4) {
+		OGLockMutex(async->signal_lock);
+		OGBroadcastCond(async->data_cv);
+		OGUnlockMutex(async->signal_lock);
+	}
+}
+
+static void async_push_text(SurviveRecordingData *recordingData, const char *text, size_t len) {
+	OGLockMutex(recordingData->write_lock);
+	async_push(recordingData->async, (recording_chunk){.target = RECORDING_CHUNK_TEXT}, text, len, 0, 0);
+	OGUnlockMutex(recordingData->write_lock);
+}
+
+static void async_vprintf(SurviveRecordingData *recordingData, bool preamble, double ts, const char *format,
+						  va_list args) {
+	if (!recordingData->output_file && !recordingData->alwaysWriteStdOut) {
+		return;
+	}
+
+	char buffer[512];
+	int prefix = preamble ? snprintf(buffer, sizeof(buffer), FLT_PRINTF, ts) : 0;
+
+	va_list copy;
+	va_copy(copy, args);
+	int len = vsnprintf(buffer + prefix, sizeof(buffer) - prefix, format, copy);
+	va_end(copy);
+	if (len < 0) {
+		return;
+	}
+
+	if (prefix + len < sizeof(buffer)) {
+		async_push_text(recordingData, buffer, prefix + len);
+		return;
+	}
+
+	char *large = SV_MALLOC(prefix + len + 1);
+	memcpy(large, buffer, prefix);
+	vsnprintf(large + prefix, len + 1, format, args);
+	async_push_text(recordingData, large, prefix + len);
+	free(large);
+}
+
+static void recording_write_chunk(SurviveRecordingData *recordingData, const recording_chunk *chunk,
+								  const uint8_t *data) {
+	if (chunk->target == RECORDING_CHUNK_TEXT) {
+		if (recordingData->output_file) {
+			gzwrite(recordingData->output_file, data, chunk->size);
+		}
+		if (recordingData->alwaysWriteStdOut) {
+			fwrite(data, 1, chunk->size, stdout);
+		}
+		return;
+	}
+
+	if (recordingData->binary == 0) {
+		return;
+	}
+
+	const char *dev = (const char *)data;
+	size_t dev_len = strnlen(dev, chunk->size);
+	if (dev_len == chunk->size) {
+		return;
+	}
+	const uint8_t *payload = data + dev_len + 1;
+	size_t payload_size = chunk->size - dev_len - 1;
+
+	if (chunk->target == RECORDING_CHUNK_BINARY_CONFIG) {
+		survive_binary_writer_write_config(recordingData->binary, dev, chunk->time, (const char *)payload,
+										   payload_size);
+	} else {
+		survive_binary_writer_write(recordingData->binary, chunk->type, dev_len ? dev : 0, chunk->time, payload,
+									payload_size);
+	}
+}
+
+static void *recording_writer_thread(void *user) {
+	SurviveRecordingData *recordingData = user;
+	survive_recording_async *async = recordingData->async;
+
+	uint8_t *scratch = 0;
+	size_t scratch_size = 0;
+	uint64_t tail = async->tail;
+
+	for (;;) {
+		uint64_t head = OGAtomicLoadU64(&async->head);
+		if (head == tail) {
+			if (OGAtomicLoadU32(&async->stop)) {
+				break;
+			}
+
+			OGLockMutex(async->signal_lock);
+			if (OGAtomicLoadU64(&async->head) == tail && !OGAtomicLoadU32(&async->stop)) {
+				OGWaitCondTimeout(async->data_cv, async->signal_lock, 50);
+			}
+			OGUnlockMutex(async->signal_lock);
+			continue;
+		}
+
+		while (tail != head) {
+			recording_chunk chunk;
+			async_copy_out(async, tail, &chunk, sizeof(chunk));
+			if (chunk.size > scratch_size) {
+				scratch_size = chunk.size;
+				scratch = SV_REALLOC(scratch, scratch_size);
+			}
+			async_copy_out(async, tail + sizeof(chunk), scratch, chunk.size);
+			recording_write_chunk(recordingData, &chunk, scratch);
+
+			tail += sizeof(chunk) + chunk.size;
+			OGAtomicStoreU64(&async->tail, tail);
+		}
+
+		OGLockMutex(async->signal_lock);
+		OGBroadcastCond(async->space_cv);
+		OGUnlockMutex(async->signal_lock);
+	}
+
+	free(scratch);
+	return 0;
+}
+
+static void recording_start_async(SurviveRecordingData *recordingData) {
+	SurviveContext *ctx = recordingData->ctx;
+	survive_recording_async *async = SV_CALLOC(sizeof(survive_recording_async));
+
+	uint64_t requested = survive_configi(ctx, RECORD_ASYNC_BUFFER_SIZE_TAG, SC_GET, 4 * 1024 * 1024);
+	async->capacity = 4096;
+	while (async->capacity < requested && async->capacity < (1u << 30)) {
+		async->capacity <<= 1;
+	}
+	async->buffer = SV_MALLOC(async->capacity);
+	async->drop_on_overflow = survive_configi(ctx, RECORD_ASYNC_DROP_TAG, SC_GET, 0);
+	async->signal_lock = OGCreateMutex();
+	async->data_cv = OGCreateConditionVariable();
+	async->space_cv = OGCreateConditionVariable();
+
+	recordingData->async = async;
+	async->thread = OGCreateThread(recording_writer_thread, "recording", recordingData);
+
+	SV_INFO("Recording asynchronously with a %" PRIu64 " byte buffer; %s when full", async->capacity,
+			async->drop_on_overflow ? "dropping" : "blocking");
+}
+
+static void recording_stop_async(SurviveRecordingData *recordingData) {
+	survive_recording_async *async = recordingData->async;
+	if (async == 0) {
+		return;
+	}
+
+	OGLockMutex(async->signal_lock);
+	OGAtomicStoreU32(&async->stop, 1);
+	OGBroadcastCond(async->data_cv);
+	OGUnlockMutex(async->signal_lock);
+	OGJoinThread(async->thread);
+
+	SurviveContext *ctx = recordingData->ctx;
+	SV_INFO("Async recording wrote %" PRIu64 " events (%.1f MB); peak buffer use %.1f%%", async->chunks,
+			async->bytes / (1024. * 1024.), 100. * async->max_used / async->capacity);
+	if (async->dropped_chunks) {
+		SV_WARN("Async recording dropped %" PRIu64 " events (%" PRIu64 " bytes) because the buffer was full",
+				async->dropped_chunks, async->dropped_bytes);
+	}
+	if (async->blocked_cnt) {
+		SV_WARN("Async recording blocked callers %" PRIu64 " times for %.1fms total", async->blocked_cnt,
+				async->blocked_us / 1000.);
+	}
+
+	OGDeleteConditionVariable(async->data_cv);
+	OGDeleteConditionVariable(async->space_cv);
+	OGDeleteMutex(async->signal_lock);
+	free(async->buffer);
+	free(async);
+	recordingData->async = 0;
+}
 
 	static void write_to_output_raw(SurviveRecordingData *recordingData, const char *string, int len) {
+		if (recordingData->async) {
+			async_push_text(recordingData, string, len);
+			return;
+		}
+
+		OGLockMutex(recordingData->write_lock);
 		if (recordingData->output_file) {
 			gzwrite(recordingData->output_file, string, len);
 		}
@@ -59,13 +358,50 @@ END_STRUCT_CONFIG_SECTION(SurviveRecordingData)
 		if (recordingData->alwaysWriteStdOut) {
 			fwrite(string, 1, len, stdout);
 		}
+		OGUnlockMutex(recordingData->write_lock);
 }
 
-#ifdef SURVIVE_HEX_FLOATS
-#define FLT_PRINTF "%0.6a "
-#else
-#define FLT_PRINTF "%0.6f "
-#endif
+static void write_binary(SurviveRecordingData *recordingData, enum survive_binary_record_type type, const char *dev,
+						 const void *payload, size_t size) {
+	if (!recordingData || !recordingData->binary) {
+		return;
+	}
+
+	double ts = survive_run_time(recordingData->ctx);
+	OGLockMutex(recordingData->write_lock);
+	if (recordingData->async) {
+		async_push(recordingData->async,
+				   (recording_chunk){.target = RECORDING_CHUNK_BINARY, .type = type, .time = ts}, dev ? dev : "",
+				   dev ? strlen(dev) + 1 : 1, payload, size);
+	} else {
+		survive_binary_writer_write(recordingData->binary, type, dev, ts, payload, size);
+	}
+	OGUnlockMutex(recordingData->write_lock);
+}
+
+static void write_binary_pose(SurviveRecordingData *recordingData, enum survive_binary_record_type type,
+							  const char *dev, const SurvivePose *pose) {
+	survive_binary_pose record = {
+		.pose = {pose->Pos[0], pose->Pos[1], pose->Pos[2], pose->Rot[0], pose->Rot[1], pose->Rot[2], pose->Rot[3]}};
+	write_binary(recordingData, type, dev, &record, sizeof(record));
+}
+
+static void write_binary_velocity(SurviveRecordingData *recordingData, enum survive_binary_record_type type,
+								  const char *dev, const SurviveVelocity *velocity) {
+	survive_binary_velocity record = {.velocity = {velocity->Pos[0], velocity->Pos[1], velocity->Pos[2],
+												   velocity->AxisAngleRot[0], velocity->AxisAngleRot[1],
+												   velocity->AxisAngleRot[2]}};
+	write_binary(recordingData, type, dev, &record, sizeof(record));
+}
+
+static void write_binary_imu(SurviveRecordingData *recordingData, enum survive_binary_record_type type,
+							 const char *dev, int mask, const FLT *accelgyro, uint32_t timecode, int id) {
+	survive_binary_imu record = {.mask = mask, .id = id, .timecode = timecode};
+	for (int i = 0; i < 9; i++) {
+		record.accelgyro[i] = accelgyro[i];
+	}
+	write_binary(recordingData, type, dev, &record, sizeof(record));
+}
 
 SURVIVE_EXPORT void survive_recording_write_matrix(struct SurviveRecordingData *recordingData, const SurviveObject *so,
 												   int lvl, const char *name, const CnMat *M) {
@@ -73,12 +409,14 @@ SURVIVE_EXPORT void survive_recording_write_matrix(struct SurviveRecordingData *
 		return;
 	}
 
+	OGLockMutex(recordingData->write_lock);
 	survive_recording_write_to_output(recordingData, "%s DATA_MATRIX %s %d %d ", so ? so->codename : "g", name, M->rows,
 									  M->cols);
 	for (int i = 0; i < M->rows * M->cols; i++) {
 		survive_recording_write_to_output_nopreamble(recordingData, "%f ", M->data[i]);
 	}
 	survive_recording_write_to_output_nopreamble(recordingData, "\n");
+	OGUnlockMutex(recordingData->write_lock);
 }
 void survive_recording_write_to_output(struct SurviveRecordingData *recordingData, const char *format, ...) {
 	if (!recordingData) {
@@ -87,6 +425,15 @@ void survive_recording_write_to_output(struct SurviveRecordingData *recordingDat
 
 	double ts = survive_run_time(recordingData->ctx);
 
+	if (recordingData->async) {
+		va_list args;
+		va_start(args, format);
+		async_vprintf(recordingData, true, ts, format, args);
+		va_end(args);
+		return;
+	}
+
+	OGLockMutex(recordingData->write_lock);
 	if (recordingData->output_file) {
 		va_list args;
 		va_start(args, format);
@@ -103,6 +450,7 @@ void survive_recording_write_to_output(struct SurviveRecordingData *recordingDat
 		vfprintf(stdout, format, args);
 		va_end(args);
 	}
+	OGUnlockMutex(recordingData->write_lock);
 }
 
 void survive_recording_write_to_output_nopreamble(struct SurviveRecordingData *recordingData, const char *format, ...) {
@@ -110,6 +458,15 @@ void survive_recording_write_to_output_nopreamble(struct SurviveRecordingData *r
 		return;
 	}
 
+	if (recordingData->async) {
+		va_list args;
+		va_start(args, format);
+		async_vprintf(recordingData, false, 0, format, args);
+		va_end(args);
+		return;
+	}
+
+	OGLockMutex(recordingData->write_lock);
 	if (recordingData->output_file) {
 		va_list args;
 		va_start(args, format);
@@ -124,10 +481,12 @@ void survive_recording_write_to_output_nopreamble(struct SurviveRecordingData *r
 		vfprintf(stdout, format, args);
 		va_end(args);
 	}
+	OGUnlockMutex(recordingData->write_lock);
 }
 void survive_recording_disconnect_process(struct SurviveObject *so) {
 	SurviveRecordingData *recordingData = so->ctx ? so->ctx->recptr : 0;
 	survive_recording_write_to_output(recordingData, "%s DISCONNECT\r\n", so->codename);
+	write_binary(recordingData, SURVIVE_BINARY_RECORD_DISCONNECT, so->codename, 0, 0);
 }
 
 void survive_recording_config_process(SurviveObject *so, char *ct0conf, int len) {
@@ -141,10 +500,19 @@ void survive_recording_config_process(SurviveObject *so, char *ct0conf, int len)
 		if (buffer[i] == '\n' || buffer[i] == '\r')
 			buffer[i] = ' ';
 
+	OGLockMutex(recordingData->write_lock);
 	survive_recording_write_to_output(recordingData, "%s CONFIG ", so->codename);
 	write_to_output_raw(recordingData, buffer, len);
 
 	write_to_output_raw(recordingData, "\r\n", 2);
+	if (recordingData->binary && recordingData->async) {
+		async_push(recordingData->async,
+				   (recording_chunk){.target = RECORDING_CHUNK_BINARY_CONFIG, .time = survive_run_time(so->ctx)},
+				   so->codename, strlen(so->codename) + 1, buffer, len);
+	} else if (recordingData->binary) {
+		survive_binary_writer_write_config(recordingData->binary, so->codename, survive_run_time(so->ctx), buffer, len);
+	}
+	OGUnlockMutex(recordingData->write_lock);
 
 	free(buffer);
 }
@@ -160,6 +528,13 @@ void survive_recording_lighthouse_process(SurviveContext *ctx, uint8_t lighthous
 		"%d LH_POSE " FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF " %u\r\n", mode,
 		lh_pose->Pos[0], lh_pose->Pos[1], lh_pose->Pos[2], lh_pose->Rot[0], lh_pose->Rot[1], lh_pose->Rot[2],
 		lh_pose->Rot[3], ctx->bsd[lighthouse].BaseStationID);
+
+	survive_binary_lh_pose record = {.pose = {lh_pose->Pos[0], lh_pose->Pos[1], lh_pose->Pos[2], lh_pose->Rot[0],
+											  lh_pose->Rot[1], lh_pose->Rot[2], lh_pose->Rot[3]},
+									 .bsd_id = ctx->bsd[lighthouse].BaseStationID,
+									 .lighthouse = lighthouse,
+									 .mode = mode};
+	write_binary(recordingData, SURVIVE_BINARY_RECORD_LH_POSE, 0, &record, sizeof(record));
 }
 void survive_recording_velocity_process(SurviveObject *so, uint8_t lighthouse, const SurviveVelocity *pose) {
 	SurviveRecordingData *recordingData = so->ctx->recptr;
@@ -170,6 +545,7 @@ void survive_recording_velocity_process(SurviveObject *so, uint8_t lighthouse, c
 		recordingData, "%s VELOCITY " FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF "\r\n",
 		so->codename, pose->Pos[0], pose->Pos[1], pose->Pos[2], pose->AxisAngleRot[0], pose->AxisAngleRot[1],
 		pose->AxisAngleRot[2]);
+	write_binary_velocity(recordingData, SURVIVE_BINARY_RECORD_VELOCITY, so->codename, pose);
 }
 void survive_recording_raw_pose_process(SurviveObject *so, uint8_t lighthouse, const SurvivePose *pose) {
 	SurviveRecordingData *recordingData = so->ctx->recptr;
@@ -179,6 +555,7 @@ void survive_recording_raw_pose_process(SurviveObject *so, uint8_t lighthouse, c
 	survive_recording_write_to_output(
 		recordingData, "%s POSE " FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF "\r\n",
 		so->codename, pose->Pos[0], pose->Pos[1], pose->Pos[2], pose->Rot[0], pose->Rot[1], pose->Rot[2], pose->Rot[3]);
+	write_binary_pose(recordingData, SURVIVE_BINARY_RECORD_POSE, so->codename, pose);
 }
 
 void survive_recording_external_velocity_process(SurviveContext *ctx, const char *name, const SurviveVelocity *pose) {
@@ -190,6 +567,7 @@ void survive_recording_external_velocity_process(SurviveContext *ctx, const char
 		recordingData, "%s EXTERNAL_VELOCITY " FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF "\r\n",
 		name, pose->Pos[0], pose->Pos[1], pose->Pos[2], pose->AxisAngleRot[0], pose->AxisAngleRot[1],
 		pose->AxisAngleRot[2]);
+	write_binary_velocity(recordingData, SURVIVE_BINARY_RECORD_EXTERNAL_VELOCITY, name, pose);
 }
 
 void survive_recording_external_pose_process(SurviveContext *ctx, const char *name, const SurvivePose *pose) {
@@ -201,6 +579,7 @@ void survive_recording_external_pose_process(SurviveContext *ctx, const char *na
 		recordingData,
 		"%s EXTERNAL_POSE " FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF FLT_PRINTF "\n", name,
 		pose->Pos[0], pose->Pos[1], pose->Pos[2], pose->Rot[0], pose->Rot[1], pose->Rot[2], pose->Rot[3]);
+	write_binary_pose(recordingData, SURVIVE_BINARY_RECORD_EXTERNAL_POSE, name, pose);
 }
 
 void survive_recording_info_process(SurviveContext *ctx, const char *fault) {
@@ -221,6 +600,9 @@ void survive_recording_sync_process(SurviveObject *so, survive_channel channel,
 	}
 
 	survive_recording_write_to_output(recordingData, SYNC_PRINTF, SYNC_PRINTF_ARGS);
+
+	survive_binary_sync record = {.timecode = timecode, .channel = channel, .ootx = ootx, .gen = gen};
+	write_binary(recordingData, SURVIVE_BINARY_RECORD_SYNC, dev, &record, sizeof(record));
 }
 
 void survive_recording_sweep_angle_process(SurviveObject *so, survive_channel channel, int sensor_id,
@@ -232,6 +614,10 @@ void survive_recording_sweep_angle_process(SurviveObject *so, survive_channel ch
 
 	const char *dev = so->codename;
 	survive_recording_write_to_output(recordingData, SWEEP_ANGLE_PRINTF, SWEEP_ANGLE_PRINTF_ARGS);
+
+	survive_binary_sweep_angle record = {
+		.angle = angle, .timecode = timecode, .sensor_id = sensor_id, .channel = channel, .plane = plane};
+	write_binary(recordingData, SURVIVE_BINARY_RECORD_SWEEP_ANGLE, dev, &record, sizeof(record));
 }
 
 void survive_recording_sweep_process(SurviveObject *so, survive_channel channel, int sensor_id,
@@ -247,6 +633,9 @@ void survive_recording_sweep_process(SurviveObject *so, survive_channel channel,
 
 	const char *dev = so->codename;
 	survive_recording_write_to_output(recordingData, SWEEP_PRINTF, SWEEP_PRINTF_ARGS);
+
+	survive_binary_sweep record = {.timecode = timecode, .sensor_id = sensor_id, .channel = channel, .flag = flag};
+	write_binary(recordingData, SURVIVE_BINARY_RECORD_SWEEP, dev, &record, sizeof(record));
 }
 
 void survive_recording_button_process(SurviveObject *so, enum SurviveInputEvent eventType, enum SurviveButton buttonId,
@@ -259,6 +648,9 @@ void survive_recording_button_process(SurviveObject *so, enum SurviveInputEvent
 
 	const char *dev = so->codename;
 	survive_recording_write_to_output(recordingData, "%s BUTTON %u %u\r\n", dev, eventType, buttonId);
+
+	survive_binary_button record = {.event_type = eventType, .button_id = buttonId};
+	write_binary(recordingData, SURVIVE_BINARY_RECORD_BUTTON, dev, &record, sizeof(record));
 }
 void survive_recording_angle_process(struct SurviveObject *so, int sensor_id, int acode, uint32_t timecode, FLT length,
 									 FLT angle, uint32_t lh) {
@@ -269,6 +661,10 @@ void survive_recording_angle_process(struct SurviveObject *so, int sensor_id, in
 
 	survive_recording_write_to_output(recordingData, "%s A %d %d %u " FLT_PRINTF FLT_PRINTF "%u\r\n", so->codename,
 									  sensor_id, acode, timecode, length, angle, lh);
+
+	survive_binary_angle record = {
+		.length = length, .angle = angle, .sensor_id = sensor_id, .acode = acode, .timecode = timecode, .lh = lh};
+	write_binary(recordingData, SURVIVE_BINARY_RECORD_ANGLE, so->codename, &record, sizeof(record));
 }
 
 void survive_recording_lightcap(SurviveObject *so, LightcapElement *le) {
@@ -279,6 +675,10 @@ void survive_recording_lightcap(SurviveObject *so, LightcapElement *le) {
 	if (recordingData->writeRawLight) {
 		survive_recording_write_to_output(recordingData, "%s C %d %u %u\r\n", so->codename, le->sensor_id,
 										  le->timestamp, le->length);
+
+		survive_binary_lightcap record = {
+			.timestamp = le->timestamp, .length = le->length, .sensor_id = le->sensor_id};
+		write_binary(recordingData, SURVIVE_BINARY_RECORD_LIGHTCAP, so->codename, &record, sizeof(record));
 	}
 }
 
@@ -291,7 +691,15 @@ void survive_recording_light_process(struct SurviveObject *so, int sensor_id, in
 	if (!recordingData->writeAngle) {
 	  return;
 	}
-	
+
+	survive_binary_light record = {.sensor_id = sensor_id,
+								   .acode = acode,
+								   .timeinsweep = timeinsweep,
+								   .timecode = timecode,
+								   .length = length,
+								   .lh = lh};
+	write_binary(recordingData, SURVIVE_BINARY_RECORD_LIGHT, so->codename, &record, sizeof(record));
+
 	if (acode == -1) {
 		survive_recording_write_to_output(recordingData, "%s S %d %d %d %u %u %u\r\n", so->codename, sensor_id, acode,
 										  timeinsweep, timecode, length, lh);
@@ -337,6 +745,9 @@ void survive_recording_imu_scales(struct SurviveObject *so, int gyro_scale_mode,
                                       "%s IMU_SCALES %d %d\r\n",
                                       so->codename, gyro_scale_mode, acc_scale_mode);
 
+	survive_binary_imu_scales record = {.gyro_scale_mode = gyro_scale_mode, .acc_scale_mode = acc_scale_mode};
+	write_binary(recordingData, SURVIVE_BINARY_RECORD_IMU_SCALES, so->codename, &record, sizeof(record));
+
 }
 void survive_recording_imu_process(struct SurviveObject *so, int mask, const FLT *accelgyro, uint32_t timecode,
 								   int id) {
@@ -354,6 +765,7 @@ void survive_recording_imu_process(struct SurviveObject *so, int mask, const FLT
 									  so->codename, mask, timecode, accelgyro[0], accelgyro[1], accelgyro[2],
 									  accelgyro[3], accelgyro[4], accelgyro[5], accelgyro[6], accelgyro[7],
 									  accelgyro[8], id);
+	write_binary_imu(recordingData, SURVIVE_BINARY_RECORD_IMU, so->codename, mask, accelgyro, timecode, id);
 }
 
 void survive_recording_raw_imu_process(struct SurviveObject *so, int mask, const FLT *accelgyro, uint32_t timecode,
@@ -372,12 +784,18 @@ void survive_recording_raw_imu_process(struct SurviveObject *so, int mask, const
 									  so->codename, mask, timecode, accelgyro[0], accelgyro[1], accelgyro[2],
 									  accelgyro[3], accelgyro[4], accelgyro[5], accelgyro[6], accelgyro[7],
 									  accelgyro[8], id);
+	write_binary_imu(recordingData, SURVIVE_BINARY_RECORD_RAW_IMU, so->codename, mask, accelgyro, timecode, id);
 }
 
 void survive_destroy_recording(SurviveContext *ctx) {
 	if (ctx->recptr) {
 		SurviveRecordingData_detach_config(ctx, ctx->recptr);
-		gzclose(ctx->recptr->output_file);
+		recording_stop_async(ctx->recptr);
+		if (ctx->recptr->output_file) {
+			gzclose(ctx->recptr->output_file);
+		}
+		survive_binary_writer_close(ctx->recptr->binary);
+		OGDeleteMutex(ctx->recptr->write_lock);
 		free(ctx->recptr);
 		ctx->recptr = 0;
 	}
@@ -393,10 +811,12 @@ void survive_record_config(SurviveContext *ctx, const char *tag, uint8_t type, c
 void survive_install_recording(SurviveContext *ctx) {
 	const char *dataout_file = survive_configs(ctx, "record", SC_GET, "");
 	int record_to_stdout = survive_configi(ctx, "record-stdout", SC_GET, 0);
+	const char *binary_file = survive_configs(ctx, RECORD_BINARY_TAG, SC_GET, "");
 
-	if (strlen(dataout_file) > 0 || record_to_stdout) {
+	if (strlen(dataout_file) > 0 || record_to_stdout || strlen(binary_file) > 0) {
 		ctx->recptr = SV_CALLOC(sizeof(struct SurviveRecordingData));
 		ctx->recptr->ctx = ctx;
+		ctx->recptr->write_lock = OGCreateMutex();
 		SurviveRecordingData_attach_config(ctx, ctx->recptr);
 		if (strlen(dataout_file) > 0) {
 			if (strstr(dataout_file, ".pcap")) {
@@ -415,6 +835,8 @@ void survive_install_recording(SurviveContext *ctx) {
 				ctx->recptr->output_file = gzopen(dataout_file, useCompression ? "w6F" : "wT");
 				if (ctx->recptr->output_file == 0) {
 					SV_INFO("Could not open %s for writing", dataout_file);
+					SurviveRecordingData_detach_config(ctx, ctx->recptr);
+					OGDeleteMutex(ctx->recptr->write_lock);
 					free(ctx->recptr);
 					ctx->recptr = 0;
 					return;
@@ -423,10 +845,26 @@ void survive_install_recording(SurviveContext *ctx) {
 			}
 		}
 
+		if (strlen(binary_file) > 0) {
+			bool compress = survive_configi(ctx, RECORD_BINARY_COMPRESS_TAG, SC_GET, 1);
+			ctx->recptr->binary = survive_binary_writer_open(
+				ctx, binary_file, compress, survive_configi(ctx, RECORD_BINARY_BLOCK_SIZE_TAG, SC_GET, 65536),
+				survive_configf(ctx, RECORD_BINARY_KEYFRAME_INTERVAL_TAG, SC_GET, 1.));
+			if (ctx->recptr->binary) {
+				SV_INFO("Binary recording to '%s' Compression: %d", binary_file, compress);
+			} else {
+				SV_WARN("Could not open %s for writing", binary_file);
+			}
+		}
+
 		ctx->recptr->alwaysWriteStdOut = record_to_stdout;
 		if (record_to_stdout) {
 			SV_INFO("Recording to stdout");
 		}
+
+		if (survive_configi(ctx, RECORD_ASYNC_TAG, SC_GET, 0)) {
+			recording_start_async(ctx->recptr);
+		}
 	}
 
 	survive_config_iterate(ctx, survive_record_config, ctx->recptr);
@@ -0,0 +1,787 @@
+#include "survive_recording_binary.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef NOZLIB
+#include <zlib.h>
+#endif
+
+#define ALIGN8(x) (((x) + 7) & ~(size_t)7)
+
+// Latest record of each kind needed to restore playback state part way through a file
+typedef struct binary_state {
+	survive_binary_state_ref *refs;
+	size_t cnt;
+} binary_state;
+
+static void binary_state_update(binary_state *state, const survive_binary_record *record, uint64_t block_offset,
+								uint32_t record_offset) {
+	uint16_t key = record->device;
+	switch (record->type) {
+	case SURVIVE_BINARY_RECORD_CONFIG:
+	case SURVIVE_BINARY_RECORD_IMU_SCALES:
+		break;
+	case SURVIVE_BINARY_RECORD_LH_POSE:
+		key = ((const survive_binary_lh_pose *)survive_binary_record_payload(record))->lighthouse;
+		break;
+	default:
+		return;
+	}
+
+	survive_binary_state_ref ref = {
+		.block_offset = block_offset, .record_offset = record_offset, .type = record->type, .key = key};
+	for (size_t i = 0; i < state->cnt; i++) {
+		if (state->refs[i].type == ref.type && state->refs[i].key == ref.key) {
+			state->refs[i] = ref;
+			return;
+		}
+	}
+
+	state->refs = SV_REALLOC(state->refs, sizeof(survive_binary_state_ref) * (state->cnt + 1));
+	state->refs[state->cnt++] = ref;
+}
+
+typedef struct binary_keyframes {
+	survive_binary_keyframe *keyframes;
+	size_t keyframe_cnt;
+	survive_binary_state_ref *snapshots;
+	size_t snapshot_cnt;
+} binary_keyframes;
+
+static void binary_keyframes_add(binary_keyframes *index, const binary_state *state, double time,
+								 uint64_t block_offset) {
+	index->keyframes = SV_REALLOC(index->keyframes, sizeof(survive_binary_keyframe) * (index->keyframe_cnt + 1));
+	index->keyframes[index->keyframe_cnt++] = (survive_binary_keyframe){
+		.time = time, .block_offset = block_offset, .state_begin = index->snapshot_cnt, .state_count = state->cnt};
+
+	if (state->cnt) {
+		index->snapshots =
+			SV_REALLOC(index->snapshots, sizeof(survive_binary_state_ref) * (index->snapshot_cnt + state->cnt));
+		memcpy(index->snapshots + index->snapshot_cnt, state->refs, sizeof(survive_binary_state_ref) * state->cnt);
+		index->snapshot_cnt += state->cnt;
+	}
+}
+
+static void binary_keyframes_free(binary_keyframes *index) {
+	free(index->keyframes);
+	free(index->snapshots);
+	memset(index, 0, sizeof(*index));
+}
+
+typedef struct survive_binary_writer {
+	SurviveContext *ctx;
+	FILE *file;
+	uint64_t file_offset;
+	bool compress;
+	double keyframe_interval;
+
+	uint8_t *block;
+	size_t block_used, block_capacity, block_size;
+	uint32_t record_count;
+	double first_time, last_time;
+
+	uint8_t *compressed;
+	size_t compressed_capacity;
+
+	char **devices;
+	size_t device_count;
+	size_t last_device;
+
+	binary_state state;
+	binary_keyframes index;
+} survive_binary_writer;
+
+static void writer_write_block(survive_binary_writer *writer, survive_binary_block_header *header,
+							   const void *stored) {
+	static const uint8_t padding[8] = {0};
+	size_t padded = ALIGN8(header->stored_size);
+	fwrite(header, sizeof(*header), 1, writer->file);
+	fwrite(stored, 1, header->stored_size, writer->file);
+	fwrite(padding, 1, padded - header->stored_size, writer->file);
+	writer->file_offset += sizeof(*header) + padded;
+}
+
+static void writer_flush_block(survive_binary_writer *writer) {
+	if (writer->block_used == 0) {
+		return;
+	}
+
+	survive_binary_block_header header = {.magic = SURVIVE_BINARY_BLOCK_MAGIC,
+										  .compression = SURVIVE_BINARY_COMPRESSION_NONE,
+										  .stored_size = writer->block_used,
+										  .raw_size = writer->block_used,
+										  .record_count = writer->record_count,
+										  .first_time = writer->first_time,
+										  .last_time = writer->last_time};
+	const uint8_t *stored = writer->block;
+
+#ifndef NOZLIB
+	if (writer->compress) {
+		uLongf compressed_size = compressBound(writer->block_used);
+		if (compressed_size > writer->compressed_capacity) {
+			writer->compressed = SV_REALLOC(writer->compressed, compressed_size);
+			writer->compressed_capacity = compressed_size;
+		}
+		if (compress2(writer->compressed, &compressed_size, writer->block, writer->block_used, 1) == Z_OK &&
+			compressed_size < writer->block_used) {
+			header.compression = SURVIVE_BINARY_COMPRESSION_ZLIB;
+			header.stored_size = compressed_size;
+			stored = writer->compressed;
+		}
+	}
+#endif
+
+	writer_write_block(writer, &header, stored);
+
+	writer->block_used = 0;
+	writer->record_count = 0;
+}
+
+static survive_binary_record *writer_reserve(survive_binary_writer *writer, enum survive_binary_record_type type,
+											 uint16_t device, double time, size_t payload_size) {
+	size_t size = ALIGN8(sizeof(survive_binary_record) + payload_size);
+	if (writer->block_used &&
+		(writer->block_used + size > writer->block_size || time - writer->first_time >= writer->keyframe_interval)) {
+		writer_flush_block(writer);
+	}
+
+	// Oversized records, ie configs, get a block to themselves
+	if (writer->block_used + size > writer->block_capacity) {
+		writer->block_capacity = writer->block_used + size;
+		writer->block = SV_REALLOC(writer->block, writer->block_capacity);
+	}
+
+	if (writer->record_count == 0) {
+		writer->first_time = time;
+		binary_keyframes_add(&writer->index, &writer->state, time, writer->file_offset);
+	}
+	writer->last_time = time;
+	writer->record_count++;
+
+	survive_binary_record *rtn = (survive_binary_record *)(writer->block + writer->block_used);
+	memset(rtn, 0, size);
+	*rtn = (survive_binary_record){.type = type, .device = device, .size = size, .time = time};
+	writer->block_used += size;
+	return rtn;
+}
+
+static void writer_commit(survive_binary_writer *writer, const survive_binary_record *record) {
+	binary_state_update(&writer->state, record, writer->file_offset, (const uint8_t *)record - writer->block);
+}
+
+static uint16_t writer_device_index(survive_binary_writer *writer, const char *device, double time) {
+	if (device == 0) {
+		return SURVIVE_BINARY_NO_DEVICE;
+	}
+
+	// Consecutive records are usually from the same device
+	if (writer->last_device < writer->device_count && strcmp(writer->devices[writer->last_device], device) == 0) {
+		return writer->last_device;
+	}
+
+	for (size_t i = 0; i < writer->device_count; i++) {
+		if (strcmp(writer->devices[i], device) == 0) {
+			return writer->last_device = i;
+		}
+	}
+
+	if (writer->device_count >= SURVIVE_BINARY_NO_DEVICE) {
+		SurviveContext *ctx = writer->ctx;
+		SV_WARN("Binary recording device table is full; dropping records for %s", device);
+		return SURVIVE_BINARY_NO_DEVICE;
+	}
+
+	size_t len = strlen(device);
+	writer->devices = SV_REALLOC(writer->devices, sizeof(char *) * (writer->device_count + 1));
+	writer->devices[writer->device_count] = SV_MALLOC(len + 1);
+	memcpy(writer->devices[writer->device_count], device, len + 1);
+
+	survive_binary_record *record =
+		writer_reserve(writer, SURVIVE_BINARY_RECORD_DEVICE, writer->device_count, time, len + 1);
+	memcpy(record + 1, device, len + 1);
+
+	return writer->last_device = writer->device_count++;
+}
+
+survive_binary_writer *survive_binary_writer_open(SurviveContext *ctx, const char *path, bool compress,
+												  size_t block_size, double keyframe_interval) {
+	FILE *f = fopen(path, "wb");
+	if (f == 0) {
+		return 0;
+	}
+
+	survive_binary_file_header header = {.magic = SURVIVE_BINARY_MAGIC,
+										 .version = SURVIVE_BINARY_VERSION,
+										 .byte_order = SURVIVE_BINARY_BYTE_ORDER};
+	fwrite(&header, sizeof(header), 1, f);
+
+	survive_binary_writer *writer = SV_CALLOC(sizeof(survive_binary_writer));
+	writer->ctx = ctx;
+	writer->file = f;
+	writer->file_offset = sizeof(header);
+#ifndef NOZLIB
+	writer->compress = compress;
+#else
+	if (compress) {
+		SV_WARN("Binary recording compression requires zlib; writing uncompressed blocks");
+	}
+#endif
+	writer->keyframe_interval = keyframe_interval > 0 ? keyframe_interval : 1;
+	writer->block_size = block_size < 1024 ? 1024 : block_size;
+	writer->block_capacity = writer->block_size;
+	writer->block = SV_MALLOC(writer->block_capacity);
+	return writer;
+}
+
+void survive_binary_writer_write(survive_binary_writer *writer, enum survive_binary_record_type type,
+								 const char *device, double time, const void *payload, size_t payload_size) {
+	uint16_t idx = writer_device_index(writer, device, time);
+	if (device && idx == SURVIVE_BINARY_NO_DEVICE) {
+		return;
+	}
+
+	survive_binary_record *record = writer_reserve(writer, type, idx, time, payload_size);
+	memcpy(record + 1, payload, payload_size);
+	writer_commit(writer, record);
+}
+
+void survive_binary_writer_write_config(survive_binary_writer *writer, const char *device, double time,
+										const char *config, size_t length) {
+	uint16_t idx = writer_device_index(writer, device, time);
+	survive_binary_record *record =
+		writer_reserve(writer, SURVIVE_BINARY_RECORD_CONFIG, idx, time, sizeof(survive_binary_config) + length + 1);
+	survive_binary_config *payload = (survive_binary_config *)(record + 1);
+	payload->length = length;
+	memcpy(payload + 1, config, length);
+	writer_commit(writer, record);
+}
+
+void survive_binary_writer_flush(survive_binary_writer *writer) {
+	writer_flush_block(writer);
+	fflush(writer->file);
+}
+
+static void writer_write_index(survive_binary_writer *writer) {
+	size_t names_size = 0;
+	for (size_t i = 0; i < writer->device_count; i++) {
+		names_size += strlen(writer->devices[i]) + 1;
+	}
+
+	survive_binary_index_header index = {.keyframe_count = writer->index.keyframe_cnt,
+										 .snapshot_count = writer->index.snapshot_cnt,
+										 .device_count = writer->device_count,
+										 .names_size = ALIGN8(names_size)};
+	size_t size = sizeof(index) + index.names_size + sizeof(survive_binary_keyframe) * index.keyframe_count +
+				  sizeof(survive_binary_state_ref) * index.snapshot_count;
+
+	uint8_t *buffer = SV_CALLOC(size);
+	uint8_t *p = buffer;
+	memcpy(p, &index, sizeof(index));
+	p += sizeof(index);
+	for (size_t i = 0; i < writer->device_count; i++) {
+		size_t len = strlen(writer->devices[i]) + 1;
+		memcpy(p, writer->devices[i], len);
+		p += len;
+	}
+	p = buffer + sizeof(index) + index.names_size;
+	memcpy(p, writer->index.keyframes, sizeof(survive_binary_keyframe) * index.keyframe_count);
+	p += sizeof(survive_binary_keyframe) * index.keyframe_count;
+	memcpy(p, writer->index.snapshots, sizeof(survive_binary_state_ref) * index.snapshot_count);
+
+	survive_binary_index_footer footer = {
+		.index_offset = writer->file_offset, .magic = SURVIVE_BINARY_INDEX_MAGIC, .version = SURVIVE_BINARY_VERSION};
+	survive_binary_block_header header = {.magic = SURVIVE_BINARY_INDEX_MAGIC,
+										  .compression = SURVIVE_BINARY_COMPRESSION_NONE,
+										  .stored_size = size,
+										  .raw_size = size};
+	writer_write_block(writer, &header, buffer);
+	fwrite(&footer, sizeof(footer), 1, writer->file);
+	free(buffer);
+}
+
+void survive_binary_writer_close(survive_binary_writer *writer) {
+	if (writer == 0) {
+		return;
+	}
+
+	writer_flush_block(writer);
+	writer_write_index(writer);
+	fclose(writer->file);
+
+	for (size_t i = 0; i < writer->device_count; i++) {
+		free(writer->devices[i]);
+	}
+	free(writer->devices);
+	free(writer->block);
+	free(writer->compressed);
+	free(writer->state.refs);
+	binary_keyframes_free(&writer->index);
+	free(writer);
+}
+
+typedef struct binary_block_view {
+	const uint8_t *begin, *end;
+	uint8_t *scratch;
+	size_t scratch_capacity;
+	uint64_t offset;
+} binary_block_view;
+
+typedef struct survive_binary_reader {
+	SurviveContext *ctx;
+
+	const uint8_t *data;
+	size_t size;
+	// Where the blocks end; the start of the index block if there is one
+	size_t blocks_end;
+#ifdef _WIN32
+	HANDLE file, mapping;
+#endif
+
+	size_t next_block;
+	const uint8_t *cursor;
+	binary_block_view block;
+
+	char **devices;
+	size_t device_count;
+
+	// Points into the mapping when the file has an index, otherwise into 'built_index'
+	const survive_binary_keyframe *keyframes;
+	size_t keyframe_cnt;
+	const survive_binary_state_ref *snapshots;
+	size_t snapshot_cnt;
+	binary_keyframes built_index;
+
+	// State records still to be returned after a seek
+	survive_binary_state_ref *pending_state;
+	size_t pending_state_cnt, pending_state_idx;
+	binary_block_view state_block;
+} survive_binary_reader;
+
+bool survive_binary_recording_detect(const char *path) {
+	FILE *f = fopen(path, "rb");
+	if (f == 0) {
+		return false;
+	}
+
+	char magic[8] = {0};
+	bool rtn = fread(magic, 1, sizeof(magic), f) == sizeof(magic) && memcmp(magic, SURVIVE_BINARY_MAGIC, 8) == 0;
+	fclose(f);
+	return rtn;
+}
+
+static bool reader_map(survive_binary_reader *reader, const char *path) {
+#ifdef _WIN32
+	reader->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (reader->file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(reader->file, &size) || size.QuadPart == 0) {
+		CloseHandle(reader->file);
+		return false;
+	}
+
+	reader->mapping = CreateFileMappingA(reader->file, 0, PAGE_READONLY, 0, 0, 0);
+	reader->data = reader->mapping ? MapViewOfFile(reader->mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+	if (reader->data == 0) {
+		if (reader->mapping) {
+			CloseHandle(reader->mapping);
+		}
+		CloseHandle(reader->file);
+		return false;
+	}
+	reader->size = size.QuadPart;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	void *data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+	reader->data = data;
+	reader->size = st.st_size;
+#endif
+	return true;
+}
+
+static void reader_unmap(survive_binary_reader *reader) {
+#ifdef _WIN32
+	UnmapViewOfFile(reader->data);
+	CloseHandle(reader->mapping);
+	CloseHandle(reader->file);
+#else
+	munmap((void *)reader->data, reader->size);
+#endif
+}
+
+static void reader_set_device(survive_binary_reader *reader, uint16_t device, const char *name, size_t max_len) {
+	if (device >= reader->device_count) {
+		reader->devices = SV_REALLOC(reader->devices, sizeof(char *) * (device + 1));
+		memset(reader->devices + reader->device_count, 0, sizeof(char *) * (device + 1 - reader->device_count));
+		reader->device_count = device + 1;
+	}
+
+	size_t len = strnlen(name, max_len);
+	free(reader->devices[device]);
+	reader->devices[device] = SV_MALLOC(len + 1);
+	memcpy(reader->devices[device], name, len);
+	reader->devices[device][len] = 0;
+}
+
+static void reader_load_index(survive_binary_reader *reader) {
+	if (reader->size < sizeof(survive_binary_file_header) + sizeof(survive_binary_index_footer)) {
+		return;
+	}
+
+	const survive_binary_index_footer *footer =
+		(const survive_binary_index_footer *)(reader->data + reader->size - sizeof(survive_binary_index_footer));
+	if (footer->magic != SURVIVE_BINARY_INDEX_MAGIC || footer->index_offset % 8 != 0 ||
+		footer->index_offset + sizeof(survive_binary_block_header) + sizeof(survive_binary_index_header) >
+			reader->size - sizeof(*footer)) {
+		return;
+	}
+
+	const survive_binary_block_header *header =
+		(const survive_binary_block_header *)(reader->data + footer->index_offset);
+	const survive_binary_index_header *index = (const survive_binary_index_header *)(header + 1);
+	size_t size = sizeof(*index) + (size_t)index->names_size +
+				  sizeof(survive_binary_keyframe) * (size_t)index->keyframe_count +
+				  sizeof(survive_binary_state_ref) * (size_t)index->snapshot_count;
+	if (header->magic != SURVIVE_BINARY_INDEX_MAGIC || header->compression != SURVIVE_BINARY_COMPRESSION_NONE ||
+		header->stored_size != size || (const uint8_t *)index + size > (const uint8_t *)footer ||
+		index->names_size % 8 != 0) {
+		return;
+	}
+
+	const char *names = (const char *)(index + 1);
+	const char *name = names;
+	for (uint32_t i = 0; i < index->device_count && name < names + index->names_size; i++) {
+		reader_set_device(reader, i, name, names + index->names_size - name);
+		name += strlen(reader->devices[i]) + 1;
+	}
+
+	reader->keyframes = (const survive_binary_keyframe *)(names + index->names_size);
+	reader->keyframe_cnt = index->keyframe_count;
+	reader->snapshots = (const survive_binary_state_ref *)(reader->keyframes + reader->keyframe_cnt);
+	reader->snapshot_cnt = index->snapshot_count;
+	reader->blocks_end = footer->index_offset;
+}
+
+survive_binary_reader *survive_binary_reader_open(SurviveContext *ctx, const char *path) {
+	survive_binary_reader *reader = SV_CALLOC(sizeof(survive_binary_reader));
+	reader->ctx = ctx;
+
+	if (!reader_map(reader, path)) {
+		free(reader);
+		return 0;
+	}
+
+	const survive_binary_file_header *header = (const survive_binary_file_header *)reader->data;
+	if (reader->size < sizeof(*header) || memcmp(header->magic, SURVIVE_BINARY_MAGIC, 8) != 0) {
+		SV_WARN("%s is not a binary recording", path);
+		goto fail;
+	}
+	if (header->byte_order != SURVIVE_BINARY_BYTE_ORDER) {
+		SV_WARN("Binary recording %s was written on a machine with a different byte order", path);
+		goto fail;
+	}
+	if (header->version > SURVIVE_BINARY_VERSION) {
+		SV_WARN("Binary recording %s is version %u; only version %d and older are supported", path, header->version,
+				SURVIVE_BINARY_VERSION);
+		goto fail;
+	}
+
+	reader->next_block = sizeof(*header);
+	reader->blocks_end = reader->size;
+	reader_load_index(reader);
+	return reader;
+
+fail:
+	reader_unmap(reader);
+	free(reader);
+	return 0;
+}
+
+void survive_binary_reader_close(survive_binary_reader *reader) {
+	if (reader == 0) {
+		return;
+	}
+
+	reader_unmap(reader);
+	for (size_t i = 0; i < reader->device_count; i++) {
+		free(reader->devices[i]);
+	}
+	free(reader->devices);
+	free(reader->block.scratch);
+	free(reader->state_block.scratch);
+	free(reader->pending_state);
+	binary_keyframes_free(&reader->built_index);
+	free(reader);
+}
+
+/**
+ * Points 'view' at the records of the block at 'offset', decompressing into the view's scratch buffer if needed.
+ * @return The offset of the following block, or 0 if there is no valid block at 'offset'
+ */
+static size_t reader_decode_block(survive_binary_reader *reader, size_t offset, binary_block_view *view,
+								  const survive_binary_block_header **header_out) {
+	SurviveContext *ctx = reader->ctx;
+	if (offset + sizeof(survive_binary_block_header) > reader->blocks_end) {
+		return 0;
+	}
+
+	const survive_binary_block_header *header = (const survive_binary_block_header *)(reader->data + offset);
+	const uint8_t *stored = (const uint8_t *)(header + 1);
+	if (header->magic == SURVIVE_BINARY_INDEX_MAGIC) {
+		return 0;
+	}
+	if (header->magic != SURVIVE_BINARY_BLOCK_MAGIC || stored + header->stored_size > reader->data + reader->blocks_end) {
+		SV_WARN("Binary recording is truncated or corrupt at offset %zu; stopping", offset);
+		return 0;
+	}
+
+	if (header_out) {
+		*header_out = header;
+	}
+	size_t next = offset + sizeof(*header) + ALIGN8(header->stored_size);
+	if (view->offset == offset && view->begin) {
+		return next;
+	}
+
+	switch (header->compression) {
+	case SURVIVE_BINARY_COMPRESSION_NONE:
+		view->begin = stored;
+		view->end = stored + header->stored_size;
+		break;
+#ifndef NOZLIB
+	case SURVIVE_BINARY_COMPRESSION_ZLIB: {
+		if (header->raw_size > view->scratch_capacity) {
+			view->scratch = SV_REALLOC(view->scratch, header->raw_size);
+			view->scratch_capacity = header->raw_size;
+		}
+		uLongf raw_size = header->raw_size;
+		if (uncompress(view->scratch, &raw_size, stored, header->stored_size) != Z_OK ||
+			raw_size != header->raw_size) {
+			SV_WARN("Could not decompress binary recording block at offset %zu; stopping", offset);
+			view->begin = 0;
+			return 0;
+		}
+		view->begin = view->scratch;
+		view->end = view->scratch + raw_size;
+		break;
+	}
+#endif
+	default:
+		SV_WARN("Binary recording uses unsupported compression %u", header->compression);
+		view->begin = 0;
+		return 0;
+	}
+
+	view->offset = offset;
+	return next;
+}
+
+// Smallest payload each record type is written with; types not listed only need their header
+static const size_t record_payload_sizes[] = {
+	[SURVIVE_BINARY_RECORD_CONFIG] = sizeof(survive_binary_config),
+	[SURVIVE_BINARY_RECORD_SYNC] = sizeof(survive_binary_sync),
+	[SURVIVE_BINARY_RECORD_SWEEP] = sizeof(survive_binary_sweep),
+	[SURVIVE_BINARY_RECORD_SWEEP_ANGLE] = sizeof(survive_binary_sweep_angle),
+	[SURVIVE_BINARY_RECORD_LIGHT] = sizeof(survive_binary_light),
+	[SURVIVE_BINARY_RECORD_LIGHTCAP] = sizeof(survive_binary_lightcap),
+	[SURVIVE_BINARY_RECORD_ANGLE] = sizeof(survive_binary_angle),
+	[SURVIVE_BINARY_RECORD_IMU] = sizeof(survive_binary_imu),
+	[SURVIVE_BINARY_RECORD_RAW_IMU] = sizeof(survive_binary_imu),
+	[SURVIVE_BINARY_RECORD_IMU_SCALES] = sizeof(survive_binary_imu_scales),
+	[SURVIVE_BINARY_RECORD_BUTTON] = sizeof(survive_binary_button),
+	[SURVIVE_BINARY_RECORD_POSE] = sizeof(survive_binary_pose),
+	[SURVIVE_BINARY_RECORD_VELOCITY] = sizeof(survive_binary_velocity),
+	[SURVIVE_BINARY_RECORD_EXTERNAL_POSE] = sizeof(survive_binary_pose),
+	[SURVIVE_BINARY_RECORD_EXTERNAL_VELOCITY] = sizeof(survive_binary_velocity),
+	[SURVIVE_BINARY_RECORD_LH_POSE] = sizeof(survive_binary_lh_pose),
+};
+
+// Everything handed out by the reader has passed this, so consumers can read the fixed payload for its type
+static const survive_binary_record *reader_record_at(const survive_binary_reader *reader,
+													 const binary_block_view *view, const uint8_t *p) {
+	const survive_binary_record *record = (const survive_binary_record *)p;
+	if (p + sizeof(*record) > view->end || record->size < sizeof(*record) || p + record->size > view->end) {
+		return 0;
+	}
+
+	size_t payload_size = record->size - sizeof(*record);
+	if (record->type < SURVIVE_ARRAY_SIZE(record_payload_sizes) && payload_size < record_payload_sizes[record->type]) {
+		return 0;
+	}
+	if (record->type == SURVIVE_BINARY_RECORD_CONFIG) {
+		const survive_binary_config *config = survive_binary_record_payload(record);
+		if (config->length > payload_size - sizeof(*config)) {
+			return 0;
+		}
+	}
+	return record;
+}
+
+static const survive_binary_record *reader_next_state(survive_binary_reader *reader) {
+	while (reader->pending_state_idx < reader->pending_state_cnt) {
+		const survive_binary_state_ref *ref = &reader->pending_state[reader->pending_state_idx++];
+		if (reader_decode_block(reader, ref->block_offset, &reader->state_block, 0) == 0) {
+			continue;
+		}
+
+		const survive_binary_record *record =
+			reader_record_at(reader, &reader->state_block, reader->state_block.begin + ref->record_offset);
+		if (record && record->type == ref->type) {
+			return record;
+		}
+	}
+	return 0;
+}
+
+const survive_binary_record *survive_binary_reader_next(survive_binary_reader *reader) {
+	if (reader->pending_state_idx < reader->pending_state_cnt) {
+		const survive_binary_record *record = reader_next_state(reader);
+		if (record) {
+			return record;
+		}
+	}
+
+	for (;;) {
+		if (reader->cursor == 0 || reader->cursor == reader->block.end) {
+			size_t next = reader_decode_block(reader, reader->next_block, &reader->block, 0);
+			if (next == 0) {
+				reader->cursor = 0;
+				reader->next_block = reader->blocks_end;
+				return 0;
+			}
+			reader->next_block = next;
+			reader->cursor = reader->block.begin;
+			continue;
+		}
+
+		const survive_binary_record *record = reader_record_at(reader, &reader->block, reader->cursor);
+		if (record == 0) {
+			SurviveContext *ctx = reader->ctx;
+			SV_WARN("Malformed record in binary recording; skipping the rest of the block");
+			reader->cursor = reader->block.end;
+			continue;
+		}
+		reader->cursor += record->size;
+
+		if (record->type == SURVIVE_BINARY_RECORD_DEVICE) {
+			reader_set_device(reader, record->device, survive_binary_record_payload(record),
+							  record->size - sizeof(*record));
+			continue;
+		}
+		return record;
+	}
+}
+
+// Same keyframes the writer produces, rebuilt by decoding every block. Used for files which were never closed.
+static void reader_build_index(survive_binary_reader *reader) {
+	binary_state state = {0};
+	binary_block_view view = {0};
+
+	size_t offset = sizeof(survive_binary_file_header);
+	const survive_binary_block_header *header = 0;
+	size_t next;
+	while ((next = reader_decode_block(reader, offset, &view, &header)) != 0) {
+		binary_keyframes_add(&reader->built_index, &state, header->first_time, offset);
+
+		for (const uint8_t *p = view.begin; p < view.end;) {
+			const survive_binary_record *record = reader_record_at(reader, &view, p);
+			if (record == 0) {
+				break;
+			}
+			if (record->type == SURVIVE_BINARY_RECORD_DEVICE) {
+				reader_set_device(reader, record->device, survive_binary_record_payload(record),
+								  record->size - sizeof(*record));
+			}
+			binary_state_update(&state, record, offset, p - view.begin);
+			p += record->size;
+		}
+		offset = next;
+	}
+
+	free(state.refs);
+	free(view.scratch);
+
+	reader->keyframes = reader->built_index.keyframes;
+	reader->keyframe_cnt = reader->built_index.keyframe_cnt;
+	reader->snapshots = reader->built_index.snapshots;
+	reader->snapshot_cnt = reader->built_index.snapshot_cnt;
+}
+
+static int state_ref_cmp(const void *_a, const void *_b) {
+	const survive_binary_state_ref *a = _a, *b = _b;
+	if (a->block_offset != b->block_offset) {
+		return a->block_offset < b->block_offset ? -1 : 1;
+	}
+	return (a->record_offset > b->record_offset) - (a->record_offset < b->record_offset);
+}
+
+bool survive_binary_reader_seek(survive_binary_reader *reader, double time) {
+	if (reader->keyframes == 0) {
+		reader_build_index(reader);
+	}
+	if (reader->keyframe_cnt == 0) {
+		return false;
+	}
+
+	// Last keyframe at or before 'time'
+	size_t lo = 0, hi = reader->keyframe_cnt;
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (reader->keyframes[mid].time <= time) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	const survive_binary_keyframe *keyframe = &reader->keyframes[lo];
+
+	size_t state_count = keyframe->state_begin + keyframe->state_count <= reader->snapshot_cnt ? keyframe->state_count : 0;
+	reader->pending_state = SV_REALLOC(reader->pending_state, sizeof(survive_binary_state_ref) * (state_count + 1));
+	memcpy(reader->pending_state, reader->snapshots + keyframe->state_begin,
+		   sizeof(survive_binary_state_ref) * state_count);
+	qsort(reader->pending_state, state_count, sizeof(survive_binary_state_ref), state_ref_cmp);
+	reader->pending_state_cnt = state_count;
+	reader->pending_state_idx = 0;
+
+	reader->next_block = keyframe->block_offset;
+	reader->cursor = 0;
+	return true;
+}
+
+const char *survive_binary_reader_device_name(const survive_binary_reader *reader, uint16_t device) {
+	if (device >= reader->device_count) {
+		return 0;
+	}
+	return reader->devices[device];
+}
+
+size_t survive_binary_reader_device_count(const survive_binary_reader *reader) { return reader->device_count; }
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "survive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Binary recording format. Meant for long captures where the text format's size and per line sscanf during playback
+ * get in the way.
+ *
+ * A file is a survive_binary_file_header followed by blocks. Each block is a survive_binary_block_header and then
+ * 'stored_size' bytes, padded to 8 bytes, which are either the raw records or a zlib stream of them. Records are a
+ * survive_binary_record followed by a fixed size payload for their type; 'size' always covers the whole record so
+ * readers can skip types they don't know about. Everything is 8 byte aligned so uncompressed blocks can be read
+ * straight out of a memory mapping.
+ *
+ * Device names are stored once; a SURVIVE_BINARY_RECORD_DEVICE record assigns a name to an index before the first
+ * record which uses it. All values are in host byte order and floating point values are always doubles.
+ *
+ * A block never spans more than the writer's keyframe interval, and every block start is a keyframe: a seek target
+ * paired with a snapshot of the state records (device configs, imu scales, lighthouse poses) in effect at that point.
+ * On close the writer appends an index block -- keyframes, snapshots and the device table -- and a
+ * survive_binary_index_footer pointing at it. Files without one, ie from a crash, are indexed by scanning the blocks.
+ */
+#define SURVIVE_BINARY_MAGIC "SVBINREC"
+#define SURVIVE_BINARY_VERSION 1
+#define SURVIVE_BINARY_BYTE_ORDER 0x01020304u
+#define SURVIVE_BINARY_BLOCK_MAGIC 0x4b4c4253u // "SBLK"
+#define SURVIVE_BINARY_INDEX_MAGIC 0x58444953u // "SIDX"
+#define SURVIVE_BINARY_NO_DEVICE 0xffffu
+
+enum survive_binary_compression {
+	SURVIVE_BINARY_COMPRESSION_NONE = 0,
+	SURVIVE_BINARY_COMPRESSION_ZLIB = 1,
+};
+
+enum survive_binary_record_type {
+	SURVIVE_BINARY_RECORD_DEVICE = 1,
+	SURVIVE_BINARY_RECORD_CONFIG,
+	SURVIVE_BINARY_RECORD_DISCONNECT,
+	SURVIVE_BINARY_RECORD_SYNC,
+	SURVIVE_BINARY_RECORD_SWEEP,
+	SURVIVE_BINARY_RECORD_SWEEP_ANGLE,
+	SURVIVE_BINARY_RECORD_LIGHT,
+	SURVIVE_BINARY_RECORD_LIGHTCAP,
+	SURVIVE_BINARY_RECORD_ANGLE,
+	SURVIVE_BINARY_RECORD_IMU,
+	SURVIVE_BINARY_RECORD_RAW_IMU,
+	SURVIVE_BINARY_RECORD_IMU_SCALES,
+	SURVIVE_BINARY_RECORD_BUTTON,
+	SURVIVE_BINARY_RECORD_POSE,
+	SURVIVE_BINARY_RECORD_VELOCITY,
+	SURVIVE_BINARY_RECORD_EXTERNAL_POSE,
+	SURVIVE_BINARY_RECORD_EXTERNAL_VELOCITY,
+	SURVIVE_BINARY_RECORD_LH_POSE,
+};
+
+typedef struct survive_binary_file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+} survive_binary_file_header;
+
+typedef struct survive_binary_block_header {
+	uint32_t magic;
+	uint32_t compression;
+	uint32_t stored_size;
+	uint32_t raw_size;
+	uint32_t record_count;
+	uint32_t reserved;
+	double first_time, last_time;
+} survive_binary_block_header;
+
+typedef struct survive_binary_record {
+	uint16_t type;
+	uint16_t device;
+	uint32_t size;
+	double time;
+} survive_binary_record;
+
+typedef struct survive_binary_sync {
+	uint32_t timecode;
+	uint8_t channel, ootx, gen;
+} survive_binary_sync;
+
+typedef struct survive_binary_sweep {
+	uint32_t timecode;
+	int32_t sensor_id;
+	uint8_t channel, flag;
+} survive_binary_sweep;
+
+typedef struct survive_binary_sweep_angle {
+	double angle;
+	uint32_t timecode;
+	int32_t sensor_id;
+	uint8_t channel;
+	int8_t plane;
+} survive_binary_sweep_angle;
+
+typedef struct survive_binary_light {
+	int32_t sensor_id, acode, timeinsweep;
+	uint32_t timecode, length, lh;
+} survive_binary_light;
+
+typedef struct survive_binary_lightcap {
+	uint32_t timestamp;
+	uint16_t length;
+	uint8_t sensor_id;
+} survive_binary_lightcap;
+
+typedef struct survive_binary_angle {
+	double length, angle;
+	int32_t sensor_id, acode;
+	uint32_t timecode, lh;
+} survive_binary_angle;
+
+typedef struct survive_binary_imu {
+	double accelgyro[9];
+	int32_t mask, id;
+	uint32_t timecode;
+} survive_binary_imu;
+
+typedef struct survive_binary_imu_scales {
+	int32_t gyro_scale_mode, acc_scale_mode;
+} survive_binary_imu_scales;
+
+typedef struct survive_binary_button {
+	uint32_t event_type, button_id;
+} survive_binary_button;
+
+typedef struct survive_binary_pose {
+	double pose[7];
+} survive_binary_pose;
+
+typedef struct survive_binary_velocity {
+	double velocity[6];
+} survive_binary_velocity;
+
+typedef struct survive_binary_lh_pose {
+	double pose[7];
+	uint32_t bsd_id;
+	uint8_t lighthouse;
+	int8_t mode;
+} survive_binary_lh_pose;
+
+// Payload of SURVIVE_BINARY_RECORD_CONFIG; 'length' bytes of config json follow
+typedef struct survive_binary_config {
+	uint32_t length;
+} survive_binary_config;
+
+// Location of a record; offsets are into the file for the block and into the uncompressed block for the record
+typedef struct survive_binary_state_ref {
+	uint64_t block_offset;
+	uint32_t record_offset;
+	uint16_t type;
+	uint16_t key; // Device index, or lighthouse for SURVIVE_BINARY_RECORD_LH_POSE
+} survive_binary_state_ref;
+
+typedef struct survive_binary_keyframe {
+	double time;
+	uint64_t block_offset;
+	// Range in the snapshot table of state records in effect before this block
+	uint32_t state_begin, state_count;
+} survive_binary_keyframe;
+
+/**
+ * Payload of the index block. Followed by 'names_size' bytes of null separated device names (padded to 8),
+ * 'keyframe_count' survive_binary_keyframe and 'snapshot_count' survive_binary_state_ref.
+ */
+typedef struct survive_binary_index_header {
+	uint32_t keyframe_count, snapshot_count, device_count, names_size;
+} survive_binary_index_header;
+
+typedef struct survive_binary_index_footer {
+	uint64_t index_offset;
+	uint32_t magic;
+	uint32_t version;
+} survive_binary_index_footer;
+
+static inline const void *survive_binary_record_payload(const survive_binary_record *record) { return record + 1; }
+
+struct survive_binary_writer;
+
+/**
+ * Opens 'path' for writing. Records are buffered into blocks of roughly 'block_size' bytes, and a new block is started
+ * at least every 'keyframe_interval' seconds of recording time. Not thread safe; callers serialize access.
+ */
+SURVIVE_EXPORT struct survive_binary_writer *survive_binary_writer_open(SurviveContext *ctx, const char *path,
+																		 bool compress, size_t block_size,
+																		 double keyframe_interval);
+/**
+ * Appends a record. 'device' may be null for records which aren't tied to a device.
+ */
+SURVIVE_EXPORT void survive_binary_writer_write(struct survive_binary_writer *writer, enum survive_binary_record_type type,
+												const char *device, double time, const void *payload,
+												size_t payload_size);
+SURVIVE_EXPORT void survive_binary_writer_write_config(struct survive_binary_writer *writer, const char *device,
+													   double time, const char *config, size_t length);
+SURVIVE_EXPORT void survive_binary_writer_flush(struct survive_binary_writer *writer);
+SURVIVE_EXPORT void survive_binary_writer_close(struct survive_binary_writer *writer);
+
+struct survive_binary_reader;
+
+/**
+ * @return true if 'path' starts with the binary recording magic
+ */
+SURVIVE_EXPORT bool survive_binary_recording_detect(const char *path);
+
+/**
+ * Memory maps 'path' for reading. Returns null if it can't be opened or isn't a compatible binary recording.
+ */
+SURVIVE_EXPORT struct survive_binary_reader *survive_binary_reader_open(SurviveContext *ctx, const char *path);
+SURVIVE_EXPORT void survive_binary_reader_close(struct survive_binary_reader *reader);
+
+/**
+ * Returns the next record, or null at the end of the file. The record points into the mapping or an internal block
+ * buffer and stays valid until the next call. Device records are consumed internally.
+ */
+SURVIVE_EXPORT const survive_binary_record *survive_binary_reader_next(struct survive_binary_reader *reader);
+
+/**
+ * Moves to the last keyframe at or before 'time'. The following calls to survive_binary_reader_next first return the
+ * keyframe's state records in their original order -- with their original, earlier, times -- and then every record
+ * from the keyframe on. Builds the index by scanning the file if it has none.
+ *
+ * @return false if the file has no blocks to seek to
+ */
+SURVIVE_EXPORT bool survive_binary_reader_seek(struct survive_binary_reader *reader, double time);
+
+/**
+ * @return The name for a device index, or null if the index hasn't been defined yet
+ */
+SURVIVE_EXPORT const char *survive_binary_reader_device_name(const struct survive_binary_reader *reader,
+															 uint16_t device);
+SURVIVE_EXPORT size_t survive_binary_reader_device_count(const struct survive_binary_reader *reader);
+
+#ifdef __cplusplus
+}
+#endif
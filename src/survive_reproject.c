@@ -6,6 +6,7 @@
 #include <survive_reproject_gen2.h>
 
 #include "force_O3.h"
+#include "survive_reproject_batch.h"
 
 #ifdef BUILD_LH1_SUPPORT
 #include "generated/survive_reproject.generated.h"
@@ -48,6 +49,127 @@ FLT survive_reproject_axis_y(const BaseStationCal *bcal, LinmathVec3d const ptIn
 	return survive_reproject_axis_y_inline(bcal, ptInLh);
 }
 
+// Same math as survive_reproject_axis, with the algebra done in SIMD lanes
+static void survive_reproject_axis_batch(const BaseStationCal *bcal, const FLT *axis_value, const FLT *other_axis_value,
+										 const FLT *z, FLT *out, size_t n, bool invert_axis_value) {
+	FLT asin_arg[SURVIVE_REPROJECT_BATCH_CHUNK];
+	for (size_t start = 0; start < n; start += SURVIVE_REPROJECT_BATCH_CHUNK) {
+		size_t cnt = n - start < SURVIVE_REPROJECT_BATCH_CHUNK ? n - start : SURVIVE_REPROJECT_BATCH_CHUNK;
+		survive_reproject_gen1_batch_prep(axis_value + start, other_axis_value + start, z + start, bcal->tilt,
+										  asin_arg, cnt);
+
+		for (size_t i = 0; i < cnt; i++) {
+			FLT Z = -z[start + i];
+			FLT ang = (FLT)M_PI_2 - (invert_axis_value ? -1.f : 1.f) * (FLT_ATAN2(axis_value[start + i], Z));
+			ang -= bcal->phase;
+			ang -= FLT_ASIN(asin_arg[i]);
+			ang -= FLT_COS(bcal->gibpha + ang) * bcal->gibmag;
+			FLT other_ang = FLT_ATAN2(other_axis_value[start + i], Z);
+			ang += bcal->curve * other_ang * other_ang;
+			out[start + i] = ang - (FLT)M_PI / 2.f;
+		}
+	}
+}
+
+void survive_reproject_axis_x_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y, const FLT *z, FLT *out,
+									size_t n) {
+	survive_reproject_axis_batch(&bcal[0], x, y, z, out, n, false);
+}
+
+void survive_reproject_axis_y_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y, const FLT *z, FLT *out,
+									size_t n) {
+	survive_reproject_axis_batch(&bcal[1], y, x, z, out, n, true);
+}
+
+/**
+ * survive_reproject_axis_batch plus d angle / d (axis_value, other_axis_value, z) for each point, n x 3 into jac. The
+ * angles come out identical to the batch function's.
+ */
+static void survive_reproject_axis_jac_batch(const BaseStationCal *bcal, const FLT *axis_value,
+											 const FLT *other_axis_value, const FLT *z, FLT *out, FLT *jac, size_t n,
+											 bool invert_axis_value) {
+	const FLT sign = invert_axis_value ? -1.f : 1.f;
+	FLT asin_arg[SURVIVE_REPROJECT_BATCH_CHUNK];
+	for (size_t start = 0; start < n; start += SURVIVE_REPROJECT_BATCH_CHUNK) {
+		size_t cnt = n - start < SURVIVE_REPROJECT_BATCH_CHUNK ? n - start : SURVIVE_REPROJECT_BATCH_CHUNK;
+		survive_reproject_gen1_batch_prep(axis_value + start, other_axis_value + start, z + start, bcal->tilt,
+										  asin_arg, cnt);
+
+		for (size_t i = 0; i < cnt; i++) {
+			const FLT A = axis_value[start + i], O = other_axis_value[start + i], Z = -z[start + i];
+			const FLT AZ2 = A * A + Z * Z, OZ2 = O * O + Z * Z;
+
+			FLT ang = (FLT)M_PI_2 - sign * (FLT_ATAN2(A, Z));
+			ang -= bcal->phase;
+			ang -= FLT_ASIN(asin_arg[i]);
+			FLT gibAng = bcal->gibpha + ang;
+			ang -= FLT_COS(gibAng) * bcal->gibmag;
+			FLT other_ang = FLT_ATAN2(O, Z);
+			ang += bcal->curve * other_ang * other_ang;
+			out[start + i] = ang - (FLT)M_PI / 2.f;
+
+			// Partials in (A, O, Z); a clamped asin argument is flat
+			FLT dAsinScale = fabs(asin_arg[i]) < 1 ? bcal->tilt / FLT_SQRT(1 - asin_arg[i] * asin_arg[i]) : 0;
+			FLT mag = FLT_SQRT(AZ2);
+			const FLT dAng[3] = {-sign * Z / AZ2 + dAsinScale * O * A / (AZ2 * mag), -dAsinScale / mag,
+								 sign * A / AZ2 + dAsinScale * O * Z / (AZ2 * mag)};
+			FLT gibScale = 1 + FLT_SIN(gibAng) * bcal->gibmag;
+			FLT curveScale = 2 * bcal->curve * other_ang;
+			const FLT dOut[3] = {dAng[0] * gibScale, dAng[1] * gibScale + curveScale * Z / OZ2,
+								 dAng[2] * gibScale - curveScale * O / OZ2};
+
+			FLT *j = jac + (start + i) * 3;
+			j[invert_axis_value ? 1 : 0] = dOut[0];
+			j[invert_axis_value ? 0 : 1] = dOut[1];
+			j[2] = -dOut[2];
+		}
+	}
+}
+
+void survive_reproject_axis_x_jac_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y, const FLT *z, FLT *out,
+										FLT *jac, size_t n) {
+	survive_reproject_axis_jac_batch(&bcal[0], x, y, z, out, jac, n, false);
+}
+
+void survive_reproject_axis_y_jac_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y, const FLT *z, FLT *out,
+										FLT *jac, size_t n) {
+	survive_reproject_axis_jac_batch(&bcal[1], y, x, z, out, jac, n, true);
+}
+
+// survive_reproject_axis_batch in float32, for the tracking loop
+static void survive_reproject_axis_batch_f32(const BaseStationCal *bcal, const float *axis_value,
+											 const float *other_axis_value, const float *z, float *out, size_t n,
+											 bool invert_axis_value) {
+	const float phase = bcal->phase, curve = bcal->curve, gibPhase = bcal->gibpha, gibMag = bcal->gibmag;
+	float asin_arg[SURVIVE_REPROJECT_BATCH_CHUNK];
+	for (size_t start = 0; start < n; start += SURVIVE_REPROJECT_BATCH_CHUNK) {
+		size_t cnt = n - start < SURVIVE_REPROJECT_BATCH_CHUNK ? n - start : SURVIVE_REPROJECT_BATCH_CHUNK;
+		survive_reproject_gen1_batch_prep_f32(axis_value + start, other_axis_value + start, z + start,
+											  (float)bcal->tilt, asin_arg, cnt);
+
+		for (size_t i = 0; i < cnt; i++) {
+			float Z = -z[start + i];
+			float ang = (float)M_PI_2 - (invert_axis_value ? -1.f : 1.f) * atan2f(axis_value[start + i], Z);
+			ang -= phase;
+			ang -= asinf(asin_arg[i]);
+			ang -= cosf(gibPhase + ang) * gibMag;
+			float other_ang = atan2f(other_axis_value[start + i], Z);
+			ang += curve * other_ang * other_ang;
+			out[start + i] = ang - (float)M_PI / 2.f;
+		}
+	}
+}
+
+void survive_reproject_axis_x_batch_f32(const BaseStationCal *bcal, const float *x, const float *y, const float *z,
+										float *out, size_t n) {
+	survive_reproject_axis_batch_f32(&bcal[0], x, y, z, out, n, false);
+}
+
+void survive_reproject_axis_y_batch_f32(const BaseStationCal *bcal, const float *x, const float *y, const float *z,
+										float *out, size_t n) {
+	survive_reproject_axis_batch_f32(&bcal[1], y, x, z, out, n, true);
+}
+
 void survive_reproject_xy(const BaseStationCal *bcal, LinmathVec3d const ptInLh, SurviveAngleReading out) {
 	out[0] = survive_reproject_axis_x_inline(bcal, ptInLh);
 	out[1] = survive_reproject_axis_y_inline(bcal, ptInLh);
@@ -105,6 +227,8 @@ SURVIVE_EXPORT const survive_reproject_model_t* survive_reproject_model(SurviveC
 const survive_reproject_model_t SURVIVE_EXPORT survive_reproject_gen1_model = {
 #ifdef BUILD_LH1_SUPPORT
 	.reprojectAxisFn = {survive_reproject_axis_x, survive_reproject_axis_y},
+	.reprojectAxisBatchFn = {survive_reproject_axis_x_batch, survive_reproject_axis_y_batch},
+	.reprojectAxisBatchF32Fn = {survive_reproject_axis_x_batch_f32, survive_reproject_axis_y_batch_f32},
 	.reprojectXY = survive_reproject_xy,
 	.reprojectAxisFullFn = {gen_reproject_axis_x, gen_reproject_axis_y},
 
@@ -134,7 +258,11 @@ const survive_reproject_model_t SURVIVE_EXPORT survive_reproject_gen1_model = {
 		{
 			gen_reproject_axis_x_jac_sensor_pt_axis_angle,
 			gen_reproject_axis_y_jac_sensor_pt_axis_angle,
-		}
+		},
+	.reprojectAxisJacobCalFn = {gen_reproject_axis_x_jac_bsc0, gen_reproject_axis_y_jac_bsc1},
+	.reprojectAxisAngleAxisJacobCalFn = {gen_reproject_axis_x_jac_bsc0_axis_angle,
+										 gen_reproject_axis_y_jac_bsc1_axis_angle},
+	.reprojectAxisJacobBatchFn = {survive_reproject_axis_x_jac_batch, survive_reproject_axis_y_jac_batch},
 #else
 	0
 #endif
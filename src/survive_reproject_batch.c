@@ -0,0 +1,265 @@
+#include "survive_reproject_batch.h"
+
+#include <math.h>
+
+#include "force_O3.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#if defined(__x86_64__) || defined(__i386__)
+#define SURVIVE_REPROJECT_AVX2 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define SURVIVE_REPROJECT_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
+// The FLT vector paths are written for double precision FLT; the float32 ones work either way
+#if !defined(CN_USE_FLOAT)
+#define SURVIVE_REPROJECT_FLT_SIMD 1
+#endif
+
+static void gen1_prep_scalar(const FLT *axis_value, const FLT *other, const FLT *z, FLT tilt, FLT *asin_arg,
+							 size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		FLT Z = -z[i];
+		FLT mag = FLT_SQRT(axis_value[i] * axis_value[i] + Z * Z);
+		asin_arg[i] = linmath_enforce_range(tilt * other[i] / mag, -1, 1);
+	}
+}
+
+static void gen2_prep_scalar(const FLT *x, const FLT *y, const FLT *z, FLT tanA, FLT cosA, FLT *asin_arg,
+							 FLT *mod_asin_arg, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		FLT X = x[i], Y = y[i], Z = -z[i];
+		FLT normXZ = FLT_SQRT(X * X + Z * Z);
+		asin_arg[i] = tanA * Y / normXZ;
+		FLT normXYZ = FLT_SQRT(X * X + Y * Y + Z * Z);
+		mod_asin_arg[i] = linmath_enforce_range(Y / normXYZ / cosA, -1, 1);
+	}
+}
+
+static void gen1_prep_f32_scalar(const float *axis_value, const float *other, const float *z, float tilt,
+								 float *asin_arg, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		float Z = -z[i];
+		float mag = sqrtf(axis_value[i] * axis_value[i] + Z * Z);
+		float v = tilt * other[i] / mag;
+		asin_arg[i] = v < -1.f ? -1.f : (v > 1.f ? 1.f : v);
+	}
+}
+
+static void gen2_prep_f32_scalar(const float *x, const float *y, const float *z, float tanA, float cosA,
+								 float *asin_arg, float *mod_asin_arg, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		float X = x[i], Y = y[i], Z = -z[i];
+		float normXZ = sqrtf(X * X + Z * Z);
+		asin_arg[i] = tanA * Y / normXZ;
+		float normXYZ = sqrtf(X * X + Y * Y + Z * Z);
+		float v = Y / normXYZ / cosA;
+		mod_asin_arg[i] = v < -1.f ? -1.f : (v > 1.f ? 1.f : v);
+	}
+}
+
+/*
+ * Operations are kept in the same order as the scalar code so every path gives bit identical results. max/min take the
+ * bound first so NaNs pass through like they do in linmath_enforce_range.
+ */
+#ifdef SURVIVE_REPROJECT_AVX2
+// Built for AVX2 regardless of the compiler flags; only called after checking the CPU supports it
+#define AVX2_FN __attribute__((target("avx2")))
+
+#ifdef SURVIVE_REPROJECT_FLT_SIMD
+AVX2_FN static void gen1_prep_avx2(const FLT *axis_value, const FLT *other, const FLT *z, FLT tilt, FLT *asin_arg,
+								   size_t n) {
+	const __m256d vtilt = _mm256_set1_pd(tilt), lo = _mm256_set1_pd(-1), hi = _mm256_set1_pd(1);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d a = _mm256_loadu_pd(axis_value + i), Z = _mm256_loadu_pd(z + i);
+		__m256d mag = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(Z, Z)));
+		__m256d v = _mm256_div_pd(_mm256_mul_pd(vtilt, _mm256_loadu_pd(other + i)), mag);
+		_mm256_storeu_pd(asin_arg + i, _mm256_min_pd(hi, _mm256_max_pd(lo, v)));
+	}
+	gen1_prep_scalar(axis_value + i, other + i, z + i, tilt, asin_arg + i, n - i);
+}
+
+AVX2_FN static void gen2_prep_avx2(const FLT *x, const FLT *y, const FLT *z, FLT tanA, FLT cosA, FLT *asin_arg,
+								   FLT *mod_asin_arg, size_t n) {
+	const __m256d vtan = _mm256_set1_pd(tanA), vcos = _mm256_set1_pd(cosA);
+	const __m256d lo = _mm256_set1_pd(-1), hi = _mm256_set1_pd(1);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d X = _mm256_loadu_pd(x + i), Y = _mm256_loadu_pd(y + i), Z = _mm256_loadu_pd(z + i);
+		__m256d XX = _mm256_mul_pd(X, X), ZZ = _mm256_mul_pd(Z, Z);
+		__m256d normXZ = _mm256_sqrt_pd(_mm256_add_pd(XX, ZZ));
+		_mm256_storeu_pd(asin_arg + i, _mm256_div_pd(_mm256_mul_pd(vtan, Y), normXZ));
+
+		__m256d normXYZ = _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(XX, _mm256_mul_pd(Y, Y)), ZZ));
+		__m256d v = _mm256_div_pd(_mm256_div_pd(Y, normXYZ), vcos);
+		_mm256_storeu_pd(mod_asin_arg + i, _mm256_min_pd(hi, _mm256_max_pd(lo, v)));
+	}
+	gen2_prep_scalar(x + i, y + i, z + i, tanA, cosA, asin_arg + i, mod_asin_arg + i, n - i);
+}
+#endif
+
+AVX2_FN static void gen1_prep_f32_avx2(const float *axis_value, const float *other, const float *z, float tilt,
+									   float *asin_arg, size_t n) {
+	const __m256 vtilt = _mm256_set1_ps(tilt), lo = _mm256_set1_ps(-1), hi = _mm256_set1_ps(1);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 a = _mm256_loadu_ps(axis_value + i), Z = _mm256_loadu_ps(z + i);
+		__m256 mag = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(Z, Z)));
+		__m256 v = _mm256_div_ps(_mm256_mul_ps(vtilt, _mm256_loadu_ps(other + i)), mag);
+		_mm256_storeu_ps(asin_arg + i, _mm256_min_ps(hi, _mm256_max_ps(lo, v)));
+	}
+	gen1_prep_f32_scalar(axis_value + i, other + i, z + i, tilt, asin_arg + i, n - i);
+}
+
+AVX2_FN static void gen2_prep_f32_avx2(const float *x, const float *y, const float *z, float tanA, float cosA,
+									   float *asin_arg, float *mod_asin_arg, size_t n) {
+	const __m256 vtan = _mm256_set1_ps(tanA), vcos = _mm256_set1_ps(cosA);
+	const __m256 lo = _mm256_set1_ps(-1), hi = _mm256_set1_ps(1);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 X = _mm256_loadu_ps(x + i), Y = _mm256_loadu_ps(y + i), Z = _mm256_loadu_ps(z + i);
+		__m256 XX = _mm256_mul_ps(X, X), ZZ = _mm256_mul_ps(Z, Z);
+		__m256 normXZ = _mm256_sqrt_ps(_mm256_add_ps(XX, ZZ));
+		_mm256_storeu_ps(asin_arg + i, _mm256_div_ps(_mm256_mul_ps(vtan, Y), normXZ));
+
+		__m256 normXYZ = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(XX, _mm256_mul_ps(Y, Y)), ZZ));
+		__m256 v = _mm256_div_ps(_mm256_div_ps(Y, normXYZ), vcos);
+		_mm256_storeu_ps(mod_asin_arg + i, _mm256_min_ps(hi, _mm256_max_ps(lo, v)));
+	}
+	gen2_prep_f32_scalar(x + i, y + i, z + i, tanA, cosA, asin_arg + i, mod_asin_arg + i, n - i);
+}
+
+static bool has_avx2(void) {
+	static int supported = -1;
+	if (supported == -1) {
+		__builtin_cpu_init();
+		supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+	}
+	return supported;
+}
+#endif
+
+#ifdef SURVIVE_REPROJECT_NEON
+#ifdef SURVIVE_REPROJECT_FLT_SIMD
+static void gen1_prep_neon(const FLT *axis_value, const FLT *other, const FLT *z, FLT tilt, FLT *asin_arg, size_t n) {
+	const float64x2_t vtilt = vdupq_n_f64(tilt), lo = vdupq_n_f64(-1), hi = vdupq_n_f64(1);
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		float64x2_t a = vld1q_f64(axis_value + i), Z = vld1q_f64(z + i);
+		float64x2_t mag = vsqrtq_f64(vaddq_f64(vmulq_f64(a, a), vmulq_f64(Z, Z)));
+		float64x2_t v = vdivq_f64(vmulq_f64(vtilt, vld1q_f64(other + i)), mag);
+		vst1q_f64(asin_arg + i, vminq_f64(hi, vmaxq_f64(lo, v)));
+	}
+	gen1_prep_scalar(axis_value + i, other + i, z + i, tilt, asin_arg + i, n - i);
+}
+
+static void gen2_prep_neon(const FLT *x, const FLT *y, const FLT *z, FLT tanA, FLT cosA, FLT *asin_arg,
+						   FLT *mod_asin_arg, size_t n) {
+	const float64x2_t vtan = vdupq_n_f64(tanA), vcos = vdupq_n_f64(cosA);
+	const float64x2_t lo = vdupq_n_f64(-1), hi = vdupq_n_f64(1);
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		float64x2_t X = vld1q_f64(x + i), Y = vld1q_f64(y + i), Z = vld1q_f64(z + i);
+		float64x2_t XX = vmulq_f64(X, X), ZZ = vmulq_f64(Z, Z);
+		float64x2_t normXZ = vsqrtq_f64(vaddq_f64(XX, ZZ));
+		vst1q_f64(asin_arg + i, vdivq_f64(vmulq_f64(vtan, Y), normXZ));
+
+		float64x2_t normXYZ = vsqrtq_f64(vaddq_f64(vaddq_f64(XX, vmulq_f64(Y, Y)), ZZ));
+		float64x2_t v = vdivq_f64(vdivq_f64(Y, normXYZ), vcos);
+		vst1q_f64(mod_asin_arg + i, vminq_f64(hi, vmaxq_f64(lo, v)));
+	}
+	gen2_prep_scalar(x + i, y + i, z + i, tanA, cosA, asin_arg + i, mod_asin_arg + i, n - i);
+}
+#endif
+
+static void gen1_prep_f32_neon(const float *axis_value, const float *other, const float *z, float tilt,
+							   float *asin_arg, size_t n) {
+	const float32x4_t vtilt = vdupq_n_f32(tilt), lo = vdupq_n_f32(-1), hi = vdupq_n_f32(1);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t a = vld1q_f32(axis_value + i), Z = vld1q_f32(z + i);
+		float32x4_t mag = vsqrtq_f32(vaddq_f32(vmulq_f32(a, a), vmulq_f32(Z, Z)));
+		float32x4_t v = vdivq_f32(vmulq_f32(vtilt, vld1q_f32(other + i)), mag);
+		vst1q_f32(asin_arg + i, vminq_f32(hi, vmaxq_f32(lo, v)));
+	}
+	gen1_prep_f32_scalar(axis_value + i, other + i, z + i, tilt, asin_arg + i, n - i);
+}
+
+static void gen2_prep_f32_neon(const float *x, const float *y, const float *z, float tanA, float cosA,
+							   float *asin_arg, float *mod_asin_arg, size_t n) {
+	const float32x4_t vtan = vdupq_n_f32(tanA), vcos = vdupq_n_f32(cosA);
+	const float32x4_t lo = vdupq_n_f32(-1), hi = vdupq_n_f32(1);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t X = vld1q_f32(x + i), Y = vld1q_f32(y + i), Z = vld1q_f32(z + i);
+		float32x4_t XX = vmulq_f32(X, X), ZZ = vmulq_f32(Z, Z);
+		float32x4_t normXZ = vsqrtq_f32(vaddq_f32(XX, ZZ));
+		vst1q_f32(asin_arg + i, vdivq_f32(vmulq_f32(vtan, Y), normXZ));
+
+		float32x4_t normXYZ = vsqrtq_f32(vaddq_f32(vaddq_f32(XX, vmulq_f32(Y, Y)), ZZ));
+		float32x4_t v = vdivq_f32(vdivq_f32(Y, normXYZ), vcos);
+		vst1q_f32(mod_asin_arg + i, vminq_f32(hi, vmaxq_f32(lo, v)));
+	}
+	gen2_prep_f32_scalar(x + i, y + i, z + i, tanA, cosA, asin_arg + i, mod_asin_arg + i, n - i);
+}
+#endif
+
+void survive_reproject_gen1_batch_prep(const FLT *axis_value, const FLT *other, const FLT *z, FLT tilt, FLT *asin_arg,
+									   size_t n) {
+#if defined(SURVIVE_REPROJECT_FLT_SIMD) && defined(SURVIVE_REPROJECT_AVX2)
+	if (has_avx2()) {
+		gen1_prep_avx2(axis_value, other, z, tilt, asin_arg, n);
+		return;
+	}
+#elif defined(SURVIVE_REPROJECT_FLT_SIMD) && defined(SURVIVE_REPROJECT_NEON)
+	gen1_prep_neon(axis_value, other, z, tilt, asin_arg, n);
+	return;
+#endif
+	gen1_prep_scalar(axis_value, other, z, tilt, asin_arg, n);
+}
+
+void survive_reproject_gen2_batch_prep(const FLT *x, const FLT *y, const FLT *z, FLT tanA, FLT cosA, FLT *asin_arg,
+									   FLT *mod_asin_arg, size_t n) {
+#if defined(SURVIVE_REPROJECT_FLT_SIMD) && defined(SURVIVE_REPROJECT_AVX2)
+	if (has_avx2()) {
+		gen2_prep_avx2(x, y, z, tanA, cosA, asin_arg, mod_asin_arg, n);
+		return;
+	}
+#elif defined(SURVIVE_REPROJECT_FLT_SIMD) && defined(SURVIVE_REPROJECT_NEON)
+	gen2_prep_neon(x, y, z, tanA, cosA, asin_arg, mod_asin_arg, n);
+	return;
+#endif
+	gen2_prep_scalar(x, y, z, tanA, cosA, asin_arg, mod_asin_arg, n);
+}
+
+void survive_reproject_gen1_batch_prep_f32(const float *axis_value, const float *other, const float *z, float tilt,
+										   float *asin_arg, size_t n) {
+#if defined(SURVIVE_REPROJECT_AVX2)
+	if (has_avx2()) {
+		gen1_prep_f32_avx2(axis_value, other, z, tilt, asin_arg, n);
+		return;
+	}
+#elif defined(SURVIVE_REPROJECT_NEON)
+	gen1_prep_f32_neon(axis_value, other, z, tilt, asin_arg, n);
+	return;
+#endif
+	gen1_prep_f32_scalar(axis_value, other, z, tilt, asin_arg, n);
+}
+
+void survive_reproject_gen2_batch_prep_f32(const float *x, const float *y, const float *z, float tanA, float cosA,
+										   float *asin_arg, float *mod_asin_arg, size_t n) {
+#if defined(SURVIVE_REPROJECT_AVX2)
+	if (has_avx2()) {
+		gen2_prep_f32_avx2(x, y, z, tanA, cosA, asin_arg, mod_asin_arg, n);
+		return;
+	}
+#elif defined(SURVIVE_REPROJECT_NEON)
+	gen2_prep_f32_neon(x, y, z, tanA, cosA, asin_arg, mod_asin_arg, n);
+	return;
+#endif
+	gen2_prep_f32_scalar(x, y, z, tanA, cosA, asin_arg, mod_asin_arg, n);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "survive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The algebraic front half of the gen1 / gen2 reprojection for a run of points in the lighthouse frame; everything up
+ * to the first transcendental call. These have AVX2 and NEON versions; the callers finish each point with scalar
+ * atan2 / asin / sin.
+ *
+ * gen1: asin_arg[i] = clamp(tilt * other[i] / |(axis_value[i], z[i])|)
+ */
+void survive_reproject_gen1_batch_prep(const FLT *axis_value, const FLT *other, const FLT *z, FLT tilt, FLT *asin_arg,
+									   size_t n);
+
+/**
+ * gen2: asin_arg[i] = tanA * y[i] / |(x[i], z[i])|, unclamped;
+ *       mod_asin_arg[i] = clamp(y[i] / |(x[i], y[i], z[i])| / cosA)
+ */
+void survive_reproject_gen2_batch_prep(const FLT *x, const FLT *y, const FLT *z, FLT tanA, FLT cosA, FLT *asin_arg,
+									   FLT *mod_asin_arg, size_t n);
+
+/**
+ * float32 versions of the above for the real time paths, vectorized whether or not FLT is double; AVX2 does eight
+ * points a step and NEON four.
+ */
+void survive_reproject_gen1_batch_prep_f32(const float *axis_value, const float *other, const float *z, float tilt,
+										   float *asin_arg, size_t n);
+void survive_reproject_gen2_batch_prep_f32(const float *x, const float *y, const float *z, float tanA, float cosA,
+										   float *asin_arg, float *mod_asin_arg, size_t n);
+
+// Points per call to the prep kernels; the batch reprojection functions work through their input in chunks this big
+#define SURVIVE_REPROJECT_BATCH_CHUNK 64
+
+#ifdef __cplusplus
+}
+#endif
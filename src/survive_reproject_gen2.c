@@ -7,6 +7,7 @@
 #include "force_O3.h"
 
 #include "generated/survive_reproject.generated.h"
+#include "survive_reproject_batch.h"
 
 /***
 	 Using plane equation:
@@ -118,6 +119,193 @@ FLT survive_reproject_axis_y_gen2(const BaseStationCal *bcal, LinmathVec3d const
 	return survive_reproject_axis_y_gen2_inline(bcal, ptInLh);
 }
 
+static inline void calc_cal_series_f32(float s, float *m, float *a) {
+	const float f[6] = {-8.0108022e-06f, 0.0028679863f, 5.3685255000000001e-06f, 0.0076069798000000001f};
+
+	*m = f[0], *a = 0;
+	for (int i = 1; i < 6; i++) {
+		*a = *a * s + *m;
+		*m = *m * s + f[i];
+	}
+}
+
+static inline float enforce_range_f32(float v, float lo, float hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+// survive_reproject_axis_gen2_batch in float32, for the tracking loop. The per-calibration trig is still done in FLT.
+static void survive_reproject_axis_gen2_batch_f32(const BaseStationCal *bcal, const float *x, const float *y,
+												  const float *z, float *out, size_t n, bool axis) {
+	const FLT Ydeg = bcal->tilt + (axis ? -1 : 1) * LINMATHPI / 6.;
+	const float tanA = FLT_TAN(Ydeg);
+	const float sinYdeg = FLT_SIN(Ydeg);
+	const float cosYdeg = FLT_COS(Ydeg);
+	const float ogeePhase = bcal->ogeephase, ogeeMag = bcal->ogeemag, curve = bcal->curve;
+	const float gibPhase = bcal->gibpha, gibMag = bcal->gibmag, phase = bcal->phase;
+
+	float asinArg[SURVIVE_REPROJECT_BATCH_CHUNK], modAsinArg[SURVIVE_REPROJECT_BATCH_CHUNK];
+	for (size_t start = 0; start < n; start += SURVIVE_REPROJECT_BATCH_CHUNK) {
+		size_t cnt = n - start < SURVIVE_REPROJECT_BATCH_CHUNK ? n - start : SURVIVE_REPROJECT_BATCH_CHUNK;
+		survive_reproject_gen2_batch_prep_f32(x + start, y + start, z + start, tanA, cosYdeg, asinArg, modAsinArg,
+											  cnt);
+
+		for (size_t i = 0; i < cnt; i++) {
+			float B = atan2f(-z[start + i], x[start + i]);
+
+			float asinArg_sanitized = enforce_range_f32(asinArg[i], -1, 1);
+			float sinPart = sinf(B - asinf(asinArg_sanitized) + ogeePhase) * ogeeMag;
+
+			float mod, acc;
+			calc_cal_series_f32(asinf(modAsinArg[i]), &mod, &acc);
+
+			float BcalCurved = sinPart + curve;
+			float asinArg2 =
+				enforce_range_f32(asinArg[i] + mod * BcalCurved / (cosYdeg - acc * BcalCurved * sinYdeg), -1, 1);
+
+			float asinOut2 = asinf(asinArg2);
+			float sinOut2 = sinf(B - asinOut2 + gibPhase);
+
+			out[start + i] = B - asinOut2 + sinOut2 * gibMag - phase - (float)LINMATHPI_2;
+		}
+	}
+}
+
+// Same math as survive_reproject_axis_gen2, with the per-calibration trig hoisted and the algebra done in SIMD lanes
+static void survive_reproject_axis_gen2_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y, const FLT *z,
+											  FLT *out, size_t n, bool axis) {
+	const FLT Ydeg = bcal->tilt + (axis ? -1 : 1) * LINMATHPI / 6.;
+	const FLT tanA = FLT_TAN(Ydeg);
+	const FLT sinYdeg = FLT_SIN(Ydeg);
+	const FLT cosYdeg = FLT_COS(Ydeg);
+
+	FLT asinArg[SURVIVE_REPROJECT_BATCH_CHUNK], modAsinArg[SURVIVE_REPROJECT_BATCH_CHUNK];
+	for (size_t start = 0; start < n; start += SURVIVE_REPROJECT_BATCH_CHUNK) {
+		size_t cnt = n - start < SURVIVE_REPROJECT_BATCH_CHUNK ? n - start : SURVIVE_REPROJECT_BATCH_CHUNK;
+		survive_reproject_gen2_batch_prep(x + start, y + start, z + start, tanA, cosYdeg, asinArg, modAsinArg, cnt);
+
+		for (size_t i = 0; i < cnt; i++) {
+			FLT B = atan2(-z[start + i], x[start + i]);
+
+			FLT asinArg_sanitized = linmath_enforce_range(asinArg[i], -1, 1);
+			FLT sinPart = FLT_SIN(B - FLT_ASIN(asinArg_sanitized) + bcal->ogeephase) * bcal->ogeemag;
+
+			FLT mod, acc;
+			calc_cal_series(FLT_ASIN(modAsinArg[i]), &mod, &acc);
+
+			FLT BcalCurved = sinPart + bcal->curve;
+			FLT asinArg2 = linmath_enforce_range(
+				asinArg[i] + mod * BcalCurved / (cosYdeg - acc * BcalCurved * sinYdeg), -1, 1);
+
+			FLT asinOut2 = FLT_ASIN(asinArg2);
+			FLT sinOut2 = sin(B - asinOut2 + bcal->gibpha);
+
+			out[start + i] = B - asinOut2 + sinOut2 * bcal->gibmag - bcal->phase - LINMATHPI_2;
+		}
+	}
+}
+
+// d asin(arg) / d arg, taking a clamped argument as flat
+static inline FLT asin_deriv(FLT arg) { return fabs(arg) < 1 ? 1. / FLT_SQRT(1 - arg * arg) : 0; }
+
+/**
+ * survive_reproject_axis_gen2_batch plus d angle / d (x, y, z) for each point, n x 3 into jac. The angles come out
+ * identical to the batch function's. Differentiating by hand in the lighthouse frame means the trig is shared with the
+ * angle and the per-calibration trig is done once a call; callers chain in the poses themselves.
+ */
+static void survive_reproject_axis_gen2_jac_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y, const FLT *z,
+												  FLT *out, FLT *jac, size_t n, bool axis) {
+	const FLT f[6] = {-8.0108022e-06, 0.0028679863, 5.3685255000000001e-06, 0.0076069798000000001};
+	const FLT Ydeg = bcal->tilt + (axis ? -1 : 1) * LINMATHPI / 6.;
+	const FLT tanA = FLT_TAN(Ydeg);
+	const FLT sinYdeg = FLT_SIN(Ydeg);
+	const FLT cosYdeg = FLT_COS(Ydeg);
+
+	FLT asinArg[SURVIVE_REPROJECT_BATCH_CHUNK], modAsinArg[SURVIVE_REPROJECT_BATCH_CHUNK];
+	for (size_t start = 0; start < n; start += SURVIVE_REPROJECT_BATCH_CHUNK) {
+		size_t cnt = n - start < SURVIVE_REPROJECT_BATCH_CHUNK ? n - start : SURVIVE_REPROJECT_BATCH_CHUNK;
+		survive_reproject_gen2_batch_prep(x + start, y + start, z + start, tanA, cosYdeg, asinArg, modAsinArg, cnt);
+
+		for (size_t i = 0; i < cnt; i++) {
+			// Same flip as survive_reproject_axis_x_gen2; the z partial gets negated on the way out
+			const FLT X = x[start + i], Y = y[start + i], Z = -z[start + i];
+			const FLT XZ2 = X * X + Z * Z, XYZ2 = XZ2 + Y * Y;
+			const FLT normXZ = FLT_SQRT(XZ2), normXYZ = FLT_SQRT(XYZ2);
+
+			FLT B = atan2(Z, X);
+			const FLT dB[3] = {-Z / XZ2, 0, X / XZ2};
+
+			const FLT dAsinArgScale = tanA / (XZ2 * normXZ);
+			const FLT dAsinArg[3] = {-dAsinArgScale * Y * X, tanA / normXZ, -dAsinArgScale * Y * Z};
+
+			FLT asinArg_sanitized = linmath_enforce_range(asinArg[i], -1, 1);
+			FLT ogeeAng = B - FLT_ASIN(asinArg_sanitized) + bcal->ogeephase;
+			FLT sinPart = FLT_SIN(ogeeAng) * bcal->ogeemag;
+			FLT dSinPartScale = FLT_COS(ogeeAng) * bcal->ogeemag, dAsin = asin_deriv(asinArg_sanitized);
+
+			FLT asinOut = FLT_ASIN(modAsinArg[i]);
+			FLT dAsinOutScale = asin_deriv(modAsinArg[i]) / (XYZ2 * normXYZ * cosYdeg);
+			const FLT dAsinOut[3] = {-dAsinOutScale * Y * X, dAsinOutScale * XZ2, -dAsinOutScale * Y * Z};
+
+			// calc_cal_series, carrying d / d asinOut along
+			FLT mod = f[0], acc = 0, dMod = 0, dAcc = 0;
+			for (int j = 1; j < 6; j++) {
+				dAcc = dAcc * asinOut + acc + dMod;
+				acc = acc * asinOut + mod;
+				dMod = dMod * asinOut + mod;
+				mod = mod * asinOut + f[j];
+			}
+
+			FLT BcalCurved = sinPart + bcal->curve;
+			FLT denom = cosYdeg - acc * BcalCurved * sinYdeg;
+			FLT asinArg2 = linmath_enforce_range(asinArg[i] + mod * BcalCurved / denom, -1, 1);
+
+			FLT asinOut2 = FLT_ASIN(asinArg2);
+			FLT gibAng = B - asinOut2 + bcal->gibpha;
+			FLT sinOut2 = sin(gibAng);
+
+			out[start + i] = B - asinOut2 + sinOut2 * bcal->gibmag - bcal->phase - LINMATHPI_2;
+
+			FLT dAsinOut2Scale = asin_deriv(asinArg2), dGibScale = 1 + FLT_COS(gibAng) * bcal->gibmag;
+			for (int k = 0; k < 3; k++) {
+				FLT dBcalCurved = dSinPartScale * (dB[k] - dAsin * dAsinArg[k]);
+				FLT dDenom = -sinYdeg * (dAcc * dAsinOut[k] * BcalCurved + acc * dBcalCurved);
+				FLT dNum = dMod * dAsinOut[k] * BcalCurved + mod * dBcalCurved;
+				FLT dAsinArg2 = dAsinArg[k] + (dNum * denom - mod * BcalCurved * dDenom) / (denom * denom);
+				FLT d = (dB[k] - dAsinOut2Scale * dAsinArg2) * dGibScale;
+				jac[(start + i) * 3 + k] = k == 2 ? -d : d;
+			}
+		}
+	}
+}
+
+void survive_reproject_axis_x_gen2_jac_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y, const FLT *z,
+											 FLT *out, FLT *jac, size_t n) {
+	survive_reproject_axis_gen2_jac_batch(&bcal[0], x, y, z, out, jac, n, 0);
+}
+
+void survive_reproject_axis_y_gen2_jac_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y, const FLT *z,
+											 FLT *out, FLT *jac, size_t n) {
+	survive_reproject_axis_gen2_jac_batch(&bcal[1], x, y, z, out, jac, n, 1);
+}
+
+void survive_reproject_axis_x_gen2_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y, const FLT *z, FLT *out,
+										 size_t n) {
+	survive_reproject_axis_gen2_batch(&bcal[0], x, y, z, out, n, 0);
+}
+
+void survive_reproject_axis_y_gen2_batch(const BaseStationCal *bcal, const FLT *x, const FLT *y, const FLT *z, FLT *out,
+										 size_t n) {
+	survive_reproject_axis_gen2_batch(&bcal[1], x, y, z, out, n, 1);
+}
+
+void survive_reproject_axis_x_gen2_batch_f32(const BaseStationCal *bcal, const float *x, const float *y, const float *z,
+											 float *out, size_t n) {
+	survive_reproject_axis_gen2_batch_f32(&bcal[0], x, y, z, out, n, 0);
+}
+
+void survive_reproject_axis_y_gen2_batch_f32(const BaseStationCal *bcal, const float *x, const float *y, const float *z,
+											 float *out, size_t n) {
+	survive_reproject_axis_gen2_batch_f32(&bcal[1], x, y, z, out, n, 1);
+}
+
 void survive_reproject_xy_gen2(const BaseStationCal *bcal, LinmathVec3d const ptInLh, SurviveAngleReading out) {
 	out[0] = survive_reproject_axis_x_gen2_inline(bcal, ptInLh);
 	out[1] = survive_reproject_axis_y_gen2_inline(bcal, ptInLh);
@@ -156,6 +344,8 @@ void survive_reproject_full_gen2(const BaseStationCal *bcal, const SurvivePose *
 
 const survive_reproject_model_t survive_reproject_gen2_model = {
 	.reprojectAxisFn = {survive_reproject_axis_x_gen2, survive_reproject_axis_y_gen2},
+	.reprojectAxisBatchFn = {survive_reproject_axis_x_gen2_batch, survive_reproject_axis_y_gen2_batch},
+	.reprojectAxisBatchF32Fn = {survive_reproject_axis_x_gen2_batch_f32, survive_reproject_axis_y_gen2_batch_f32},
 	.reprojectXY = survive_reproject_xy_gen2,
 	.reprojectAxisFullFn = {gen_reproject_axis_x_gen2, gen_reproject_axis_y_gen2},
 
@@ -184,4 +374,9 @@ const survive_reproject_model_t survive_reproject_gen2_model = {
 	.reprojectAxisAngleAxisJacobSensorPt = {
 		gen_reproject_axis_x_gen2_jac_sensor_pt_axis_angle,
 		gen_reproject_axis_y_gen2_jac_sensor_pt_axis_angle,
-	}};
+	},
+	.reprojectAxisJacobCalFn = {gen_reproject_axis_x_gen2_jac_bsc0, gen_reproject_axis_y_gen2_jac_bsc1},
+	.reprojectAxisAngleAxisJacobCalFn = {gen_reproject_axis_x_gen2_jac_bsc0_axis_angle,
+										 gen_reproject_axis_y_gen2_jac_bsc1_axis_angle},
+	.reprojectAxisJacobBatchFn = {survive_reproject_axis_x_gen2_jac_batch, survive_reproject_axis_y_gen2_jac_batch},
+};
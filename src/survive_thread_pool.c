@@ -0,0 +1,121 @@
+#include "survive_thread_pool.h"
+#include "os_generic.h"
+
+#include <stdlib.h>
+
+struct survive_thread_pool {
+	og_mutex_t lock;
+	og_cv_t work_available, work_done;
+
+	og_thread_t *threads;
+	int worker_cnt;
+	bool quit;
+
+	// The current run; all guarded by 'lock'
+	bool busy;
+	survive_thread_pool_fn fn;
+	void *user;
+	int job_cnt, next_job, unfinished;
+};
+
+// Called, and returns, with the lock held
+static void run_jobs(struct survive_thread_pool *pool) {
+	while (pool->next_job < pool->job_cnt) {
+		int job = pool->next_job++;
+		survive_thread_pool_fn fn = pool->fn;
+		void *user = pool->user;
+
+		OGUnlockMutex(pool->lock);
+		fn(user, job);
+		OGLockMutex(pool->lock);
+
+		if (--pool->unfinished == 0) {
+			OGBroadcastCond(pool->work_done);
+		}
+	}
+}
+
+static void *worker_thread(void *param) {
+	struct survive_thread_pool *pool = param;
+	OGLockMutex(pool->lock);
+	while (!pool->quit) {
+		run_jobs(pool);
+		OGWaitCond(pool->work_available, pool->lock);
+	}
+	OGUnlockMutex(pool->lock);
+	return 0;
+}
+
+struct survive_thread_pool *survive_thread_pool_create(int thread_cnt) {
+	if (thread_cnt <= 1) {
+		return 0;
+	}
+
+	struct survive_thread_pool *pool = SV_CALLOC(sizeof(struct survive_thread_pool));
+	pool->lock = OGCreateMutex();
+	pool->work_available = OGCreateConditionVariable();
+	pool->work_done = OGCreateConditionVariable();
+
+	// The thread calling survive_thread_pool_run does its share of the jobs
+	pool->worker_cnt = thread_cnt - 1;
+	pool->threads = SV_CALLOC(sizeof(og_thread_t) * pool->worker_cnt);
+	for (int i = 0; i < pool->worker_cnt; i++) {
+		pool->threads[i] = OGCreateThread(worker_thread, "thread pool", pool);
+	}
+	return pool;
+}
+
+int survive_thread_pool_thread_count(const struct survive_thread_pool *pool) {
+	return pool ? pool->worker_cnt + 1 : 1;
+}
+
+bool survive_thread_pool_run(struct survive_thread_pool *pool, survive_thread_pool_fn fn, void *user, int job_cnt) {
+	if (pool == 0) {
+		return false;
+	}
+
+	OGLockMutex(pool->lock);
+	if (pool->busy) {
+		OGUnlockMutex(pool->lock);
+		return false;
+	}
+
+	pool->busy = true;
+	pool->fn = fn;
+	pool->user = user;
+	pool->job_cnt = job_cnt;
+	pool->next_job = 0;
+	pool->unfinished = job_cnt;
+	OGBroadcastCond(pool->work_available);
+
+	run_jobs(pool);
+	while (pool->unfinished > 0) {
+		OGWaitCond(pool->work_done, pool->lock);
+	}
+
+	pool->job_cnt = pool->next_job = 0;
+	pool->busy = false;
+	OGUnlockMutex(pool->lock);
+	return true;
+}
+
+void survive_thread_pool_free(struct survive_thread_pool *pool) {
+	if (pool == 0) {
+		return;
+	}
+
+	OGLockMutex(pool->lock);
+	pool->quit = true;
+	OGBroadcastCond(pool->work_available);
+	OGUnlockMutex(pool->lock);
+
+	for (int i = 0; i < pool->worker_cnt; i++) {
+		OGJoinThread(pool->threads[i]);
+	}
+
+	OGDeleteConditionVariable(pool->work_available);
+	OGDeleteConditionVariable(pool->work_done);
+	OGDeleteMutex(pool->lock);
+	free(pool->threads);
+	free(pool);
+}
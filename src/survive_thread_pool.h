@@ -0,0 +1,36 @@
+#pragma once
+
+#include "survive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Fixed set of worker threads for splitting one computation into independent jobs; ie the optimizer's cost function
+ * over runs of measurements. The threads live as long as the pool and sleep between runs.
+ */
+struct survive_thread_pool;
+
+typedef void (*survive_thread_pool_fn)(void *user, int job);
+
+/**
+ * @param thread_cnt Threads doing work during a run, counting the caller of survive_thread_pool_run. Returns null if
+ * that is 1 or less.
+ */
+SURVIVE_EXPORT struct survive_thread_pool *survive_thread_pool_create(int thread_cnt);
+SURVIVE_EXPORT int survive_thread_pool_thread_count(const struct survive_thread_pool *pool);
+
+/**
+ * Calls fn(user, job) for each job in [0, job_cnt) across the workers and the calling thread, and returns once they
+ * have all finished. The pool runs one set of jobs at a time; if it is already busy on another thread this does
+ * nothing and returns false so the caller can do the work itself.
+ */
+SURVIVE_EXPORT bool survive_thread_pool_run(struct survive_thread_pool *pool, survive_thread_pool_fn fn, void *user,
+											 int job_cnt);
+
+SURVIVE_EXPORT void survive_thread_pool_free(struct survive_thread_pool *pool);
+
+#ifdef __cplusplus
+}
+#endif
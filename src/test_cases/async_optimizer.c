@@ -0,0 +1,167 @@
+#include "../survive_async_optimizer.h"
+#include "os_generic.h"
+#include "survive_reproject.h"
+#include "test_case.h"
+
+#define ASYNC_TEST_OBJECTS 3
+#define ASYNC_TEST_SUBMISSIONS 20
+
+static survive_optimizer_settings settings = {
+	.optimize_scale_threshold = -1,
+};
+
+static FLT points[] = {-.1, -.1, 0, -.1, +.1, 0, +.1, -.1, 0, +.1, +.1, 0, 0, 0, .1, 0, 0, -.1};
+
+typedef struct async_test_problem {
+	int object;
+	SurvivePose truth;
+} async_test_problem;
+
+typedef struct async_test_object {
+	uint64_t last_submitted_seq, last_completed_seq;
+	int completions;
+	bool out_of_order, inaccurate;
+} async_test_object;
+
+static async_test_object objects[ASYNC_TEST_OBJECTS];
+
+// One object pose seen by a fixed lighthouse; a slightly different pose each submission
+static void setup_problem(survive_optimizer *opt, const SurvivePose *truth) {
+	// Buffers are reused; drop whatever the last problem in this one left behind
+	SURVIVE_OPTIMIZER_CLEANUP_HEAP_BUFFERS(*opt);
+	*opt = (survive_optimizer){0};
+
+	opt->settings = &settings;
+	opt->reprojectModel = &survive_reproject_gen1_model;
+	opt->poseLength = 1;
+	opt->cameraLength = 1;
+	opt->objectUpVectorVariance = -1;
+	opt->disableVelocity = true;
+	opt->cfg = survive_optimizer_precise_config();
+	size_t points_cnt = SURVIVE_ARRAY_SIZE(points) / 3;
+	opt->ptsLength = points_cnt;
+	SURVIVE_OPTIMIZER_SETUP_HEAP_BUFFERS(*opt, 0);
+
+	SurvivePose lh_pose = {.Pos = {0, 0, -5}, .Rot = {1}};
+	SurvivePose ilh = InvertPoseRtn(&lh_pose);
+	SurvivePose start = {.Rot = {1}};
+	survive_optimizer_setup_pose(opt, &start, false, 1);
+	survive_optimizer_setup_camera(opt, 0, &ilh, true, 1);
+	survive_optimizer_parameter *pt_params =
+		survive_optimizer_emplace_params(opt, survive_optimizer_parameter_obj_points, points_cnt);
+	memcpy(pt_params->p, points, sizeof(points));
+	survive_optimizer_parameter *bsd_params =
+		survive_optimizer_emplace_params(opt, survive_optimizer_parameter_camera_parameters, 1);
+	memset(bsd_params->p, 0, bsd_params->size * sizeof(FLT));
+
+	BaseStationCal bcal[2] = {0};
+	for (int axis = 0; axis < 2; axis++) {
+		for (int j = 0; j < points_cnt; j++) {
+			survive_optimizer_measurement *meas =
+				survive_optimizer_emplace_meas(opt, survive_optimizer_measurement_type_light);
+			meas->variance = 1e-4;
+			meas->light.sensor_idx = j;
+			meas->light.axis = axis;
+
+			FLT out[2];
+			survive_reproject_full(bcal, &lh_pose, truth, &points[j * 3], out);
+			meas->light.value = out[axis];
+		}
+	}
+}
+
+static void async_cb(survive_async_optimizer_buffer *buffer, int return_code, struct mp_result_struct *result) {
+	// Runs holding the object's lock
+	const async_test_problem *problem = buffer->user;
+	async_test_object *obj = &objects[problem->object];
+	obj->completions++;
+	obj->out_of_order |= obj->completions > 1 && buffer->seq <= obj->last_completed_seq;
+	obj->last_completed_seq = buffer->seq;
+
+	SurvivePose *pose = survive_optimizer_get_pose(&buffer->optimizer);
+	obj->inaccurate |= return_code <= 0 || dist3d(pose->Pos, problem->truth.Pos) > 1e-4;
+}
+
+TEST(AsyncOptimizer, Pool) {
+	SurviveObject sos[ASYNC_TEST_OBJECTS] = {0};
+	for (int i = 0; i < ASYNC_TEST_OBJECTS; i++) {
+		sos[i].object_lock = OGCreateMutex();
+	}
+
+	survive_async_optimizer *pool =
+		survive_async_optimizer_init_pool(calloc(1, sizeof(survive_async_optimizer)), async_cb, 8, 2);
+	for (int n = 0; n < ASYNC_TEST_SUBMISSIONS; n++) {
+		for (int i = 0; i < ASYNC_TEST_OBJECTS; i++) {
+			survive_async_optimizer_buffer *buffer = survive_async_optimizer_alloc_optimizer(pool);
+			ASSERT_EQ(buffer != 0, true);
+			if (buffer->user == 0) {
+				buffer->user = malloc(sizeof(async_test_problem));
+			}
+			async_test_problem *problem = buffer->user;
+			problem->object = i;
+			problem->truth = (SurvivePose){.Pos = {.01 * n, .02 * i, 0}, .Rot = {1}};
+			buffer->so = &sos[i];
+			setup_problem(&buffer->optimizer, &problem->truth);
+
+			survive_async_optimizer_run(pool, buffer);
+			objects[i].last_submitted_seq = buffer->seq;
+		}
+	}
+
+	// Everything either runs or is replaced by a newer problem for the same object
+	survive_async_optimizer_wait(pool, 0);
+
+	ASSERT_EQ(pool->submitted, ASYNC_TEST_OBJECTS * ASYNC_TEST_SUBMISSIONS);
+	ASSERT_EQ(pool->completed + pool->coalesced, pool->submitted);
+	// At most one problem per object waits, so there is always a buffer to hand out
+	ASSERT_EQ(pool->dropped, 0);
+	ASSERT_EQ(pool->queue_depth, 0);
+	ASSERT_GE(ASYNC_TEST_OBJECTS, pool->max_queue_depth);
+
+	for (int i = 0; i < ASYNC_TEST_OBJECTS; i++) {
+		ASSERT_EQ(objects[i].out_of_order, false);
+		ASSERT_EQ(objects[i].inaccurate, false);
+		// The newest problem always runs
+		ASSERT_EQ(objects[i].last_completed_seq, objects[i].last_submitted_seq);
+	}
+
+	survive_async_free(pool);
+	for (int i = 0; i < ASYNC_TEST_OBJECTS; i++) {
+		OGDeleteMutex(sos[i].object_lock);
+	}
+	return 0;
+}
+
+TEST(AsyncOptimizer, ObjectBuffers) {
+	SurviveObject sos[2] = {0};
+	survive_async_optimizer *pool =
+		survive_async_optimizer_init_pool(calloc(1, sizeof(survive_async_optimizer)), async_cb, 0, 1);
+	survive_async_optimizer_add_object(pool, &sos[0], 2);
+	survive_async_optimizer_add_object(pool, &sos[1], 2);
+	ASSERT_EQ(pool->buffer_cnt, 4);
+
+	// No shared buffers to hand out
+	ASSERT_EQ(survive_async_optimizer_alloc_optimizer(pool) == 0, true);
+
+	// One object filling all of its buffers doesn't take any from the other
+	survive_async_optimizer_buffer *a = survive_async_optimizer_alloc_object_optimizer(pool, &sos[0]);
+	survive_async_optimizer_buffer *b = survive_async_optimizer_alloc_object_optimizer(pool, &sos[0]);
+	ASSERT_EQ(a != 0 && b != 0, true);
+	ASSERT_EQ(a->so == &sos[0] && b->so == &sos[0], true);
+	ASSERT_EQ(survive_async_optimizer_alloc_object_optimizer(pool, &sos[0]) == 0, true);
+
+	survive_async_optimizer_buffer *c = survive_async_optimizer_alloc_object_optimizer(pool, &sos[1]);
+	ASSERT_EQ(c != 0, true);
+	ASSERT_EQ(c->so == &sos[1], true);
+
+	survive_async_optimizer_cancel(pool, a);
+	survive_async_optimizer_cancel(pool, b);
+	survive_async_optimizer_cancel(pool, c);
+
+	survive_async_optimizer_remove_object(pool, &sos[0]);
+	ASSERT_EQ(pool->buffer_cnt, 2);
+	ASSERT_EQ(survive_async_optimizer_alloc_object_optimizer(pool, &sos[0]) == 0, true);
+
+	survive_async_free(pool);
+	return 0;
+}
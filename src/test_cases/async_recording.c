@@ -0,0 +1,103 @@
+#include "../survive_recording_binary.h"
+#include "string.h"
+#include "test_case.h"
+
+// Enough poses to wrap the smallest async buffer many times over, so the writer has to block the caller
+#define ASYNC_RECORDING_TEST_POSES 2000
+
+static const char *test_device(int i) { return i % 3 ? "ext0" : "ext1"; }
+
+static survive_binary_pose test_pose(int i) {
+	survive_binary_pose pose = {.pose = {i, -i, .5 * i, 1, 0, 0, 0}};
+	return pose;
+}
+
+static int write_input(const char *path) {
+	struct survive_binary_writer *writer = survive_binary_writer_open(0, path, false, 4096, 1.);
+	if (writer == 0) {
+		return -1;
+	}
+	for (int i = 0; i < ASYNC_RECORDING_TEST_POSES; i++) {
+		survive_binary_pose pose = test_pose(i);
+		survive_binary_writer_write(writer, SURVIVE_BINARY_RECORD_EXTERNAL_POSE, test_device(i), i * 1e-3, &pose,
+									sizeof(pose));
+	}
+	survive_binary_writer_close(writer);
+	return 0;
+}
+
+// Plays 'input' back while recording it; survive_close has to flush whatever the writer thread hasn't gotten to yet
+static int record(const char *input, const char *output, const char *config, bool async) {
+	char *argv[] = {"",
+					"--configfile",
+					(char *)config,
+					"--playback",
+					(char *)input,
+					"--playback-factor",
+					"0",
+					"--playback-replay-external-pose",
+					"--no-threaded-posers",
+					"--record-binary",
+					(char *)output,
+					async ? "--record-async" : "--no-record-async",
+					"--record-async-buffer-size",
+					"4096"};
+
+	SurviveContext *ctx = survive_init_internal(SURVIVE_ARRAY_SIZE(argv), argv, 0, 0);
+	if (ctx == 0) {
+		return -1;
+	}
+	int r = survive_startup(ctx);
+	while (r == 0 && (r = survive_poll(ctx)) == 0) {
+	}
+	survive_close(ctx);
+	return 0;
+}
+
+static int check_output(const char *output) {
+	struct survive_binary_reader *reader = survive_binary_reader_open(0, output);
+	if (reader == 0) {
+		return -1;
+	}
+
+	int cnt = 0;
+	const survive_binary_record *record;
+	while ((record = survive_binary_reader_next(reader))) {
+		if (record->type != SURVIVE_BINARY_RECORD_EXTERNAL_POSE) {
+			continue;
+		}
+		ASSERT_GT(ASYNC_RECORDING_TEST_POSES, cnt);
+		ASSERT_EQ(strcmp(survive_binary_reader_device_name(reader, record->device), test_device(cnt)), 0);
+
+		survive_binary_pose expected = test_pose(cnt);
+		const survive_binary_pose *actual = survive_binary_record_payload(record);
+		ASSERT_DOUBLE_ARRAY_EQ(7, expected.pose, actual->pose);
+		cnt++;
+	}
+	ASSERT_EQ(cnt, ASYNC_RECORDING_TEST_POSES);
+
+	survive_binary_reader_close(reader);
+	return 0;
+}
+
+TEST(AsyncRecording, MatchesPlayback) {
+	char input[1024], output[1024], config[1024];
+	survive_test_temp_path(input, sizeof(input), "test_async_recording_in.svb");
+	survive_test_temp_path(config, sizeof(config), "test_async_recording.json");
+	int rtn = write_input(input);
+	ASSERT_EQ(rtn, 0);
+
+	for (int async = 0; async < 2; async++) {
+		survive_test_temp_path(output, sizeof(output),
+							   async ? "test_async_recording_async.svb" : "test_async_recording_sync.svb");
+		rtn = record(input, output, config, async);
+		ASSERT_EQ(rtn, 0);
+		rtn = check_output(output);
+		ASSERT_EQ(rtn, 0);
+		remove(output);
+	}
+
+	remove(input);
+	remove(config);
+	return 0;
+}
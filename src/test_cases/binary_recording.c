@@ -0,0 +1,180 @@
+#include "../survive_recording_binary.h"
+#include "string.h"
+#include "test_case.h"
+
+static int write_and_read_back(bool compress) {
+	char path[1024];
+	survive_test_temp_path(path, sizeof(path), compress ? "test_binary_recording_z.svb" : "test_binary_recording.svb");
+	const char *config = "{\"test\": 1}";
+
+	struct survive_binary_writer *writer = survive_binary_writer_open(0, path, compress, 1024, 1.);
+	if (writer == 0) {
+		return -1;
+	}
+
+	survive_binary_writer_write_config(writer, "TS0", 0.5, config, strlen(config));
+	for (int i = 0; i < 1000; i++) {
+		survive_binary_sync sync = {.timecode = i, .channel = i % 16, .ootx = i & 1};
+		survive_binary_writer_write(writer, SURVIVE_BINARY_RECORD_SYNC, i % 2 ? "TS1" : "TS0", 1. + i, &sync,
+									sizeof(sync));
+	}
+	survive_binary_pose pose = {.pose = {1, 2, 3, 1, 0, 0, 0}};
+	survive_binary_writer_write(writer, SURVIVE_BINARY_RECORD_EXTERNAL_POSE, "external", 2000., &pose, sizeof(pose));
+	survive_binary_writer_close(writer);
+
+	ASSERT_EQ(survive_binary_recording_detect(path), true);
+
+	struct survive_binary_reader *reader = survive_binary_reader_open(0, path);
+	if (reader == 0) {
+		return -1;
+	}
+
+	const survive_binary_record *record = survive_binary_reader_next(reader);
+	ASSERT_EQ(record != 0, true);
+	ASSERT_EQ(record->type, SURVIVE_BINARY_RECORD_CONFIG);
+	ASSERT_EQ(strcmp(survive_binary_reader_device_name(reader, record->device), "TS0"), 0);
+	const survive_binary_config *cfg = survive_binary_record_payload(record);
+	ASSERT_EQ(cfg->length, strlen(config));
+	ASSERT_EQ(memcmp(cfg + 1, config, cfg->length), 0);
+
+	for (int i = 0; i < 1000; i++) {
+		record = survive_binary_reader_next(reader);
+		ASSERT_EQ(record != 0, true);
+		ASSERT_EQ(record->type, SURVIVE_BINARY_RECORD_SYNC);
+		ASSERT_DOUBLE_EQ(record->time, 1. + i);
+		const char *device = i % 2 ? "TS1" : "TS0";
+		ASSERT_EQ(strcmp(survive_binary_reader_device_name(reader, record->device), device), 0);
+
+		const survive_binary_sync *sync = survive_binary_record_payload(record);
+		int channel = i % 16;
+		ASSERT_EQ(sync->timecode, i);
+		ASSERT_EQ(sync->channel, channel);
+		ASSERT_EQ(sync->ootx, i & 1);
+	}
+
+	record = survive_binary_reader_next(reader);
+	ASSERT_EQ(record != 0, true);
+	ASSERT_EQ(record->type, SURVIVE_BINARY_RECORD_EXTERNAL_POSE);
+	const survive_binary_pose *read_pose = survive_binary_record_payload(record);
+	ASSERT_DOUBLE_ARRAY_EQ(7, read_pose->pose, pose.pose);
+
+	ASSERT_EQ(survive_binary_reader_next(reader) == 0, true);
+	ASSERT_EQ(survive_binary_reader_device_count(reader), 3);
+	survive_binary_reader_close(reader);
+	remove(path);
+	return 0;
+}
+
+static int seek_and_check(const char *path, double time) {
+	struct survive_binary_reader *reader = survive_binary_reader_open(0, path);
+	if (reader == 0) {
+		return -1;
+	}
+	ASSERT_EQ(survive_binary_reader_seek(reader, time), true);
+
+	// State comes first: the latest config for each device, in file order
+	const survive_binary_record *record = survive_binary_reader_next(reader);
+	ASSERT_EQ(record->type, SURVIVE_BINARY_RECORD_CONFIG);
+	ASSERT_EQ(strcmp(survive_binary_reader_device_name(reader, record->device), "TS1"), 0);
+	record = survive_binary_reader_next(reader);
+	ASSERT_EQ(record->type, SURVIVE_BINARY_RECORD_CONFIG);
+	ASSERT_EQ(strcmp(survive_binary_reader_device_name(reader, record->device), "TS0"), 0);
+	const survive_binary_config *cfg = survive_binary_record_payload(record);
+	ASSERT_EQ(memcmp(cfg + 1, "second", cfg->length), 0);
+
+	record = survive_binary_reader_next(reader);
+	ASSERT_EQ(record->type, SURVIVE_BINARY_RECORD_SYNC);
+	ASSERT_GE(time, record->time);
+	ASSERT_GT(record->time, time - 1.);
+
+	double last_time = record->time;
+	while ((record = survive_binary_reader_next(reader))) {
+		ASSERT_EQ(record->type, SURVIVE_BINARY_RECORD_SYNC);
+		ASSERT_DOUBLE_EQ(record->time, last_time + .1);
+		last_time = record->time;
+	}
+	ASSERT_DOUBLE_EQ(last_time, 99.9);
+
+	survive_binary_reader_close(reader);
+	return 0;
+}
+
+TEST(BinaryRecording, Seek) {
+	char path[1024], unindexed_path[1024];
+	survive_test_temp_path(path, sizeof(path), "test_binary_recording_seek.svb");
+	survive_test_temp_path(unindexed_path, sizeof(unindexed_path), "test_binary_recording_seek_unindexed.svb");
+
+	struct survive_binary_writer *writer = survive_binary_writer_open(0, path, true, 65536, 1.);
+	survive_binary_writer_write_config(writer, "TS0", 0, "first", 5);
+	survive_binary_writer_write_config(writer, "TS1", 0, "other", 5);
+	for (int i = 0; i < 1000; i++) {
+		if (i == 200) {
+			survive_binary_writer_write_config(writer, "TS0", i * .1, "second", 6);
+		}
+		survive_binary_sync sync = {.timecode = i};
+		survive_binary_writer_write(writer, SURVIVE_BINARY_RECORD_SYNC, "TS0", i * .1, &sync, sizeof(sync));
+	}
+	survive_binary_writer_close(writer);
+
+	ASSERT_SUCCESS(seek_and_check(path, 50.05));
+
+	// Simulate a recording which was never closed by cutting off the index
+	FILE *f = fopen(path, "rb");
+	survive_binary_index_footer footer;
+	fseek(f, -(long)sizeof(footer), SEEK_END);
+	ASSERT_EQ(fread(&footer, sizeof(footer), 1, f), 1);
+	ASSERT_EQ(footer.magic, SURVIVE_BINARY_INDEX_MAGIC);
+
+	char *data = malloc(footer.index_offset);
+	fseek(f, 0, SEEK_SET);
+	ASSERT_EQ(fread(data, 1, footer.index_offset, f), footer.index_offset);
+	fclose(f);
+	f = fopen(unindexed_path, "wb");
+	fwrite(data, 1, footer.index_offset, f);
+	fclose(f);
+	free(data);
+
+	ASSERT_SUCCESS(seek_and_check(unindexed_path, 50.05));
+	remove(path);
+	remove(unindexed_path);
+	return 0;
+}
+
+TEST(BinaryRecording, RoundTrip) { return write_and_read_back(false); }
+
+TEST(BinaryRecording, RoundTripCompressed) { return write_and_read_back(true); }
+
+// A record too short for its type's payload is dropped, along with the rest of its block, rather than read past
+TEST(BinaryRecording, ShortRecord) {
+	char path[1024];
+	survive_test_temp_path(path, sizeof(path), "test_binary_recording_short.svb");
+
+	struct survive_binary_writer *writer = survive_binary_writer_open(0, path, false, 1024, 1.);
+	survive_binary_writer_write_config(writer, "TS0", 0, "config", 6);
+	survive_binary_writer_flush(writer);
+	uint32_t timecode = 5;
+	survive_binary_writer_write(writer, SURVIVE_BINARY_RECORD_IMU, "TS0", .1, &timecode, sizeof(timecode));
+	survive_binary_sync sync = {.timecode = 1};
+	survive_binary_writer_write(writer, SURVIVE_BINARY_RECORD_SYNC, "TS0", .2, &sync, sizeof(sync));
+	survive_binary_writer_flush(writer);
+	sync.timecode = 2;
+	survive_binary_writer_write(writer, SURVIVE_BINARY_RECORD_SYNC, "TS0", .3, &sync, sizeof(sync));
+	survive_binary_writer_close(writer);
+
+	struct survive_binary_reader *reader = survive_binary_reader_open(0, path);
+	if (reader == 0) {
+		return -1;
+	}
+
+	const survive_binary_record *record = survive_binary_reader_next(reader);
+	ASSERT_EQ(record->type, SURVIVE_BINARY_RECORD_CONFIG);
+	record = survive_binary_reader_next(reader);
+	ASSERT_EQ(record->type, SURVIVE_BINARY_RECORD_SYNC);
+	const survive_binary_sync *read_sync = survive_binary_record_payload(record);
+	ASSERT_EQ(read_sync->timecode, 2);
+	ASSERT_EQ(survive_binary_reader_next(reader) == 0, true);
+
+	survive_binary_reader_close(reader);
+	remove(path);
+	return 0;
+}
@@ -0,0 +1,62 @@
+#include "../survive_latency.h"
+#include "string.h"
+#include "test_case.h"
+
+TEST(HookLatency, Buckets) {
+	// Every value lands in a bucket which contains it, and buckets only get coarser as they go up
+	uint64_t last_width = 1;
+	for (uint64_t v = 0; v < ((uint64_t)1 << SURVIVE_LATENCY_MAX_BITS); v = v * 9 / 8 + 1) {
+		size_t bucket = survive_latency_bucket(v);
+		uint64_t lower = survive_latency_bucket_lower(bucket), width = survive_latency_bucket_width(bucket);
+		ASSERT_GT(SURVIVE_LATENCY_BUCKETS, bucket);
+		ASSERT_GE(v, lower);
+		ASSERT_GT(lower + width, v);
+		ASSERT_GE(width, last_width);
+		ASSERT_GE(v > 16 ? v : 16, width * SURVIVE_LATENCY_SUB_BUCKETS);
+		last_width = width;
+	}
+
+	ASSERT_EQ(survive_latency_bucket(15), 15);
+	ASSERT_EQ(survive_latency_bucket(16), 16);
+	ASSERT_EQ(survive_latency_bucket(32), 32);
+	ASSERT_EQ(survive_latency_bucket(UINT64_MAX), SURVIVE_LATENCY_BUCKETS - 1);
+	return 0;
+}
+
+TEST(HookLatency, Percentiles) {
+	survive_latency_histogram *h = calloc(1, sizeof(survive_latency_histogram));
+	ASSERT_EQ(survive_latency_histogram_percentile(h, 50), 0);
+
+	for (uint64_t v = 1; v <= 10000; v++) {
+		survive_latency_histogram_add(h, v * 100);
+	}
+	ASSERT_EQ(h->count, 10000);
+	ASSERT_EQ(h->max_ticks, 1000000);
+
+	FLT percentiles[] = {1, 50, 90, 99, 99.9};
+	for (int i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+		double expected = percentiles[i] * 10000;
+		double actual = survive_latency_histogram_percentile(h, percentiles[i]);
+		ASSERT_GE(actual, expected * (1 - 1. / SURVIVE_LATENCY_SUB_BUCKETS));
+		ASSERT_GE(expected * (1 + 1. / SURVIVE_LATENCY_SUB_BUCKETS), actual);
+	}
+	ASSERT_EQ(survive_latency_histogram_percentile(h, 100), 1000000);
+
+	survive_latency_histogram *merged = calloc(1, sizeof(survive_latency_histogram));
+	survive_latency_histogram_merge(merged, h);
+	survive_latency_histogram_merge(merged, h);
+	ASSERT_EQ(merged->count, 20000);
+	ASSERT_EQ(survive_latency_histogram_percentile(merged, 50), survive_latency_histogram_percentile(h, 50));
+
+	free(merged);
+	free(h);
+	return 0;
+}
+
+TEST(HookLatency, Names) {
+	ASSERT_EQ(survive_hook_id("sync"), SURVIVE_HOOK_ID_sync);
+	ASSERT_EQ(strcmp(survive_hook_name(SURVIVE_HOOK_ID_external_pose), "external_pose"), 0);
+	ASSERT_EQ(survive_hook_id("not_a_hook"), -1);
+	ASSERT_GT(survive_timestamp_ticks_period(), 0.);
+	return 0;
+}
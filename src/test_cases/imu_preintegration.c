@@ -0,0 +1,63 @@
+#include "../survive_kalman_tracker.h"
+#include "test_case.h"
+
+static void spinning_imu_gyro(FLT t, LinmathVec3d gyro) {
+	gyro[0] = 3 * sin(5 * t);
+	gyro[1] = 2 * cos(3 * t);
+	gyro[2] = 4;
+}
+
+// Gravity seen by an IMU spinning at a changing rate; folded together it should read as gravity in the frame at the
+// samples' mean time
+TEST(Kalman, IMUPreintegration) {
+	const LinmathVec3d up = {0, 0, 1};
+	const FLT dt = 1e-3;
+	const int sample_cnt = 20, substeps = 100;
+
+	LinmathQuat rot = {1}, mean_rot = {1};
+	SurviveIMUPreintegration pi = {0};
+	for (int i = 0; i < sample_cnt; i++) {
+		FLT t = i * dt;
+		for (int s = 0; i > 0 && s < substeps; s++) {
+			LinmathAxisAngle step;
+			spinning_imu_gyro(t - dt + (s + .5) * dt / substeps, step);
+			scale3d(step, step, dt / substeps);
+
+			LinmathQuat q;
+			quatfromaxisanglemag(q, step);
+			quatrotateabout(rot, rot, q);
+			quatnormalize(rot, rot);
+
+			// Samples are at 0 through 19ms, so the mean time is halfway into the 11th
+			if (i == sample_cnt / 2 && s == substeps / 2 - 1) {
+				quatcopy(mean_rot, rot);
+			}
+		}
+
+		PoserDataIMU imu = {.hdr = {.timecode = i * 1000}};
+		LinmathQuat world2imu;
+		quatgetreciprocal(world2imu, rot);
+		quatrotatevector(imu.accel, world2imu, up);
+		spinning_imu_gyro(t, imu.gyro);
+
+		survive_imu_preintegration_add(&pi, &imu, t);
+	}
+
+	PoserDataIMU out;
+	ASSERT_EQ(survive_imu_preintegration_finish(&pi, &out), sample_cnt);
+	ASSERT_EQ(pi.cnt, 0);
+	ASSERT_EQ(out.hdr.timecode, (sample_cnt - 1) * 1000 / 2);
+
+	LinmathVec3d expected, newest;
+	LinmathQuat world2imu;
+	quatgetreciprocal(world2imu, mean_rot);
+	quatrotatevector(expected, world2imu, up);
+	quatgetreciprocal(world2imu, rot);
+	quatrotatevector(newest, world2imu, up);
+
+	// The frame at the mean time comes from a steady gyro over the window, so it is close but not exact
+	ASSERT_GT(2e-3, dist3d(expected, out.accel));
+	// Read in the newest frame, the average would be half a window behind
+	ASSERT_GT(dist3d(newest, out.accel), 1e-2);
+	return 0;
+}
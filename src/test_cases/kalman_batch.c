@@ -0,0 +1,81 @@
+#include "../survive_kalman_batch.h"
+#include "test_case.h"
+
+#define KALMAN_BATCH_TEST_MAX_N 19
+
+static FLT random_value() { return rand() / (FLT)RAND_MAX - .5; }
+
+// F * P * F^T + Q, one matrix at a time
+static void naive_propagate(size_t n, FLT *out, const FLT *F, const FLT *P, const FLT *Q) {
+	FLT FP[KALMAN_BATCH_TEST_MAX_N * KALMAN_BATCH_TEST_MAX_N] = {0};
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < n; j++) {
+			for (size_t k = 0; k < n; k++) {
+				FP[i * n + j] += F[i * n + k] * P[k * n + j];
+			}
+		}
+	}
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < n; j++) {
+			out[i * n + j] = Q[i * n + j];
+			for (size_t k = 0; k < n; k++) {
+				out[i * n + j] += FP[i * n + k] * F[j * n + k];
+			}
+		}
+	}
+}
+
+static int check_propagate(size_t n, size_t lane_cnt) {
+	static FLT F[SURVIVE_KALMAN_BATCH_SIZE(KALMAN_BATCH_TEST_MAX_N)], Q[SURVIVE_KALMAN_BATCH_SIZE(KALMAN_BATCH_TEST_MAX_N)],
+		P[SURVIVE_KALMAN_BATCH_SIZE(KALMAN_BATCH_TEST_MAX_N)], scratch[SURVIVE_KALMAN_BATCH_SIZE(KALMAN_BATCH_TEST_MAX_N)];
+	FLT lane_F[SURVIVE_KALMAN_BATCH_LANES][KALMAN_BATCH_TEST_MAX_N * KALMAN_BATCH_TEST_MAX_N];
+	FLT lane_Q[SURVIVE_KALMAN_BATCH_LANES][KALMAN_BATCH_TEST_MAX_N * KALMAN_BATCH_TEST_MAX_N];
+	FLT lane_P[SURVIVE_KALMAN_BATCH_LANES][KALMAN_BATCH_TEST_MAX_N * KALMAN_BATCH_TEST_MAX_N];
+	memset(F, 0, sizeof(F));
+	memset(Q, 0, sizeof(Q));
+	memset(P, 0, sizeof(P));
+
+	for (size_t lane = 0; lane < lane_cnt; lane++) {
+		// P and Q symmetric like a covariance; F anything
+		for (size_t i = 0; i < n; i++) {
+			for (size_t j = 0; j < n; j++) {
+				lane_F[lane][i * n + j] = (i == j) + random_value();
+			}
+			for (size_t j = i; j < n; j++) {
+				lane_P[lane][i * n + j] = lane_P[lane][j * n + i] = (i == j) * n + random_value();
+				lane_Q[lane][i * n + j] = lane_Q[lane][j * n + i] = (i == j) * 1e-3 + 1e-4 * random_value();
+			}
+		}
+		survive_kalman_batch_pack(n, lane, F, lane_F[lane]);
+		survive_kalman_batch_pack(n, lane, Q, lane_Q[lane]);
+		survive_kalman_batch_pack(n, lane, P, lane_P[lane]);
+	}
+
+	survive_kalman_batch_propagate(n, P, F, Q, scratch);
+
+	for (size_t lane = 0; lane < SURVIVE_KALMAN_BATCH_LANES; lane++) {
+		FLT expected[KALMAN_BATCH_TEST_MAX_N * KALMAN_BATCH_TEST_MAX_N] = {0};
+		FLT actual[KALMAN_BATCH_TEST_MAX_N * KALMAN_BATCH_TEST_MAX_N];
+		if (lane < lane_cnt) {
+			naive_propagate(n, expected, lane_F[lane], lane_P[lane], lane_Q[lane]);
+		}
+		survive_kalman_batch_unpack(n, lane, actual, P);
+		ASSERT_DOUBLE_ARRAY_EQ((int)(n * n), expected, actual);
+	}
+	return 0;
+}
+
+TEST(KalmanBatch, Propagate) {
+	// The last case is model sized, with unused lanes
+	const size_t cases[][2] = {{1, 1}, {6, SURVIVE_KALMAN_BATCH_LANES}, {KALMAN_BATCH_TEST_MAX_N, 3}};
+
+	srand(42);
+	for (size_t i = 0; i < SURVIVE_ARRAY_SIZE(cases); i++) {
+		int rtn = check_propagate(cases[i][0], cases[i][1]);
+		if (rtn) {
+			fprintf(stderr, "Propagate failed for n=%d with %d lanes\n", (int)cases[i][0], (int)cases[i][1]);
+			return rtn;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,80 @@
+#include "../survive_default_devices.h"
+#include "../survive_kalman_tracker.h"
+#include "test_case.h"
+#include <math.h>
+
+static SurvivePose moving_pose(FLT t) {
+	SurvivePose pose = {.Pos = {sin(t), cos(t), .1 * t}};
+	LinmathAxisAngle aa = {.1 * t, .2 * t, 0};
+	quatfromaxisanglemag(pose.Rot, aa);
+	return pose;
+}
+
+static void integrate_observation(SurviveObject *so, int i) {
+	const survive_long_timecode dt = 2400000; // 50ms
+	PoserDataLightGen2 pd = {0};
+	pd.common.hdr.timecode = (i + 1) * dt;
+
+	SurvivePose pose = moving_pose(pd.common.hdr.timecode / (FLT)so->timebase_hz);
+	FLT variance[7] = {1e-4, 1e-4, 1e-4, 1e-5, 1e-5, 1e-5, 1e-5};
+	CN_CREATE_STACK_MAT(R, 7, 7);
+	cn_set_diag(&R, variance);
+	survive_kalman_tracker_integrate_observation(&pd.common.hdr, so->tracker, &pose, &R);
+	CN_FREE_STACK_MAT(R);
+}
+
+static SurviveObject *create_tracked_object(SurviveContext *ctx, const char *codename) {
+	SurviveObject *so = survive_create_device(ctx, "TST", 0, codename, 0);
+	so->timebase_hz = 48000000;
+	survive_kalman_tracker_set_history_length(so->tracker, 16);
+	return so;
+}
+
+// A pose that shows up late gets re-run into the filter, which has to land where it would have in order
+TEST(Kalman, OutOfOrderObservation) {
+	SurviveContext *ctx = SV_CALLOC(sizeof(SurviveContext));
+#define SURVIVE_HOOK_PROCESS_DEF(hook) survive_install_##hook##_fn(ctx, 0);
+#define SURVIVE_HOOK_FEEDBACK_DEF(hook) survive_install_##hook##_fn(ctx, 0);
+#include "survive_hooks.h"
+	ctx->log_target = stderr;
+
+	SurviveObject *in_order = create_tracked_object(ctx, "TS0");
+	SurviveObject *late = create_tracked_object(ctx, "TS1");
+
+	const int cnt = 12, late_idx = 5;
+	for (int i = 0; i < cnt; i++) {
+		integrate_observation(in_order, i);
+	}
+
+	// Held back until it is 200ms old; anything under 100ms is just clamped to the filter time
+	for (int i = 0; i < cnt; i++) {
+		if (i != late_idx) {
+			integrate_observation(late, i);
+		}
+		if (i == late_idx + 4) {
+			integrate_observation(late, late_idx);
+		}
+	}
+
+	ASSERT_EQ(in_order->tracker->stats.oosm_inserted, 0);
+	ASSERT_EQ(late->tracker->stats.oosm_inserted, 1);
+	ASSERT_EQ(late->tracker->stats.late_light_dropped, 0);
+	ASSERT_EQ(late->tracker->stats.obs_count, in_order->tracker->stats.obs_count);
+
+	const SurviveKalmanTracker *expected = in_order->tracker, *actual = late->tracker;
+	ASSERT_DOUBLE_EQ(expected->model.t, actual->model.t);
+	ASSERT_DOUBLE_ARRAY_EQ(expected->model.state_cnt, cn_as_const_vector(&expected->model.state),
+						   cn_as_const_vector(&actual->model.state));
+	ASSERT_DOUBLE_ARRAY_EQ(expected->model.P.rows * expected->model.P.cols, cn_as_const_vector(&expected->model.P),
+						   cn_as_const_vector(&actual->model.P));
+
+	// Without a history the same late pose is dropped
+	survive_kalman_tracker_set_history_length(late->tracker, 0);
+	integrate_observation(late, late_idx);
+	ASSERT_EQ(late->tracker->stats.late_light_dropped, 1);
+
+	survive_destroy_device(in_order);
+	survive_destroy_device(late);
+	free(ctx);
+	return 0;
+}
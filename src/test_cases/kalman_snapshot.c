@@ -0,0 +1,65 @@
+#include "../survive_default_devices.h"
+#include "../survive_kalman_tracker.h"
+#include "test_case.h"
+#include <math.h>
+#include <string.h>
+
+static FLT trace3(const FLT *m) { return m[0] + m[4] + m[8]; }
+
+// The snapshot is extrapolated without the tracker; at the filter's time it has to agree with the tracker itself
+TEST(Kalman, PredictSnapshot) {
+	SurviveContext *ctx = SV_CALLOC(sizeof(SurviveContext));
+#define SURVIVE_HOOK_PROCESS_DEF(hook) survive_install_##hook##_fn(ctx, 0);
+#define SURVIVE_HOOK_FEEDBACK_DEF(hook) survive_install_##hook##_fn(ctx, 0);
+#include "survive_hooks.h"
+	ctx->log_target = stderr;
+
+	SurviveObject *so = survive_create_device(ctx, "TST", 0, "TS0", 0);
+	so->timebase_hz = 48000000;
+	so->head2imu = LinmathPose_Identity;
+
+	SurviveKalmanTrackerSnapshot snapshot;
+	ASSERT_EQ(survive_kalman_tracker_read_snapshot(so->tracker, &snapshot), false);
+
+	FLT variance[7] = {1e-4, 1e-4, 1e-4, 1e-5, 1e-5, 1e-5, 1e-5};
+	CN_CREATE_STACK_MAT(R, 7, 7);
+	cn_set_diag(&R, variance);
+	for (int i = 1; i <= 10; i++) {
+		PoserDataLightGen2 pd = {0};
+		pd.common.hdr.timecode = i * 2400000;
+		FLT t = pd.common.hdr.timecode / (FLT)so->timebase_hz;
+
+		SurvivePose pose = {.Pos = {.5 * t, 1, -.2 * t}};
+		LinmathAxisAngle aa = {0, .3 * t, 0};
+		quatfromaxisanglemag(pose.Rot, aa);
+		survive_kalman_tracker_integrate_observation(&pd.common.hdr, so->tracker, &pose, &R);
+	}
+	CN_FREE_STACK_MAT(R);
+
+	ASSERT_EQ(survive_kalman_tracker_read_snapshot(so->tracker, &snapshot), true);
+	ASSERT_DOUBLE_EQ(snapshot.t, so->tracker->model.t);
+
+	SurvivePose expected = {0}, actual;
+	FLT cov[9];
+	survive_kalman_tracker_predict(so->tracker, snapshot.t, &expected);
+	survive_kalman_tracker_predict_snapshot(&snapshot, snapshot.t, &actual, 0, cov);
+	const FLT *expected_v = (const FLT *)&expected, *actual_v = (const FLT *)&actual;
+	ASSERT_DOUBLE_ARRAY_EQ(7, expected_v, actual_v);
+
+	// Extrapolating further out only gets less certain
+	FLT last_cov[9];
+	memcpy(last_cov, cov, sizeof(cov));
+	ASSERT_GT(trace3(cov), 0.);
+	for (FLT dt = .01; dt < 1; dt *= 4) {
+		survive_kalman_tracker_predict_snapshot(&snapshot, snapshot.t + dt, &actual, 0, cov);
+		for (int i = 0; i < 3; i++) {
+			ASSERT_GE(cov[i * 4], last_cov[i * 4]);
+		}
+		ASSERT_GT(trace3(cov), trace3(last_cov));
+		memcpy(last_cov, cov, sizeof(cov));
+	}
+
+	survive_destroy_device(so);
+	free(ctx);
+	return 0;
+}
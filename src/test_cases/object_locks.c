@@ -0,0 +1,46 @@
+#include "../survive_default_devices.h"
+#include "../survive_recording_binary.h"
+#include "test_case.h"
+
+static int write_input(const char *path) {
+	struct survive_binary_writer *writer = survive_binary_writer_open(0, path, false, 4096, 1.);
+	if (writer == 0) {
+		return -1;
+	}
+	survive_binary_pose pose = {.pose = {0, 0, 0, 1, 0, 0, 0}};
+	survive_binary_writer_write(writer, SURVIVE_BINARY_RECORD_EXTERNAL_POSE, "ext0", 0, &pose, sizeof(pose));
+	survive_binary_writer_close(writer);
+	return 0;
+}
+
+// A threaded poser hands the object lock back while it joins its thread on disassociate, so survive_close has to be
+// holding it when it disassociates everything
+TEST(ObjectLocks, CloseWithThreadedPoser) {
+	char input[1024], config[1024];
+	survive_test_temp_path(input, sizeof(input), "test_object_locks_in.svb");
+	survive_test_temp_path(config, sizeof(config), "test_object_locks.json");
+	int rtn = write_input(input);
+	ASSERT_EQ(rtn, 0);
+
+	char *argv[] = {"",		  "--configfile",		 config,	 "--playback", input, "--playback-factor",
+					"1",	  "--threaded-posers", "1",		   "--object-locks", "1"};
+	SurviveContext *ctx = survive_init_internal(SURVIVE_ARRAY_SIZE(argv), argv, 0, 0);
+	ASSERT_EQ(ctx != 0, true);
+
+	int r = survive_startup(ctx);
+	ASSERT_EQ(r, 0);
+
+	SurviveObject *so = survive_create_device(ctx, "TST", 0, "TS0", 0);
+	ASSERT_EQ(so != 0, true);
+	ASSERT_EQ(so->object_lock != 0, true);
+	ASSERT_EQ(*survive_object_plugin_data(so, survive_threaded_poser_fn) != 0, true);
+	survive_add_object(ctx, so);
+
+	while (r == 0 && (r = survive_poll(ctx)) == 0) {
+	}
+	survive_close(ctx);
+
+	remove(input);
+	remove(config);
+	return 0;
+}
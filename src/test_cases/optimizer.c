@@ -1,17 +1,18 @@
 #include "survive.h"
 
 #include "../generated/kalman_kinematics.gen.h"
+#include "../survive_thread_pool.h"
 #include "survive_optimizer.h"
+#include "survive_reproject_gen2.h"
 #include "test_case.h"
 
 survive_optimizer_settings settings = {
 	.optimize_scale_threshold = -1,
 };
 
-static SurvivePose run(survive_optimizer* mpfitctx, SurviveKalmanModel* mdl, const FLT* points, size_t points_cnt, mp_result* result, CnMat* R, const SurviveVelocity* vel) {
-	mpfitctx->ptsLength = points_cnt;
-	SURVIVE_OPTIMIZER_SETUP_STACK_BUFFERS(*mpfitctx, 0);
-
+// Fills in a problem whose buffers are already set up; mdl is advanced to the last measurement's time
+static void setup_problem(survive_optimizer *mpfitctx, SurviveKalmanModel *mdl, const FLT *points, size_t points_cnt,
+						  const SurviveVelocity *vel) {
 	quatnormalize(mdl->Pose.Rot, mdl->Pose.Rot);
 	SurvivePose lh_pose = {
 		.Pos = { 0, 0, -5 },
@@ -57,6 +58,13 @@ static SurvivePose run(survive_optimizer* mpfitctx, SurviveKalmanModel* mdl, con
 		}
 	}
 	mpfitctx->timecode = t;
+}
+
+static SurvivePose run(survive_optimizer* mpfitctx, SurviveKalmanModel* mdl, const FLT* points, size_t points_cnt, mp_result* result, CnMat* R, const SurviveVelocity* vel) {
+	mpfitctx->ptsLength = points_cnt;
+	SURVIVE_OPTIMIZER_SETUP_STACK_BUFFERS(*mpfitctx, 0);
+	setup_problem(mpfitctx, mdl, points, points_cnt, vel);
+
 	SurvivePose *opt_pose = survive_optimizer_get_pose(mpfitctx);
 	//*opt_pose = mdl.Pose;
 
@@ -230,3 +238,568 @@ TEST(Optimizer, SimpleUnderspecced) {
 
 	return  0;
 }
+
+TEST(Optimizer, SimpleSparse) {
+	survive_optimizer mpfitctx = default_optimizer();
+	settings.sparse_solver = true;
+
+	SurviveKalmanModel mdl = {.Pose = {.Rot = {1, 1, 1, 1}},
+							  .Velocity = {.Pos = {0, 0, .1}, .AxisAngleRot = {0, 0, .1}},
+							  .IMUBias = {
+								  .IMUCorrection = {1},
+								  .AccScale = 1,
+							  }};
+	CN_CREATE_STACK_MAT(R, 7, 7);
+
+	mp_result results = {0};
+	SurvivePose output = run(&mpfitctx, &mdl, points, SURVIVE_ARRAY_SIZE(points) / 3, &results, &R, 0);
+	settings.sparse_solver = false;
+
+	ASSERT_GT(results.status, 0);
+	assert(results.bestnorm < 1e1);
+	assert(verify_R(&R, &mdl.Pose, &output));
+
+	return 0;
+}
+
+#define SPARSE_TEST_BLOCKS 8
+#define SPARSE_TEST_SAMPLES 10
+
+// y = a_b * exp(-s0 * t) + c_b + s1 * t for each block b; block parameters are a_b, c_b and s0, s1 are shared
+static int sparse_test_func(int m, int n, FLT *p, FLT *deviates, FLT **derivs, void *user) {
+	const FLT *truth = user;
+	const FLT *s = p + 2 * SPARSE_TEST_BLOCKS;
+	for (int b = 0; b < SPARSE_TEST_BLOCKS; b++) {
+		for (int i = 0; i < SPARSE_TEST_SAMPLES; i++) {
+			int idx = b * SPARSE_TEST_SAMPLES + i;
+			FLT t = i * .3;
+			FLT e = exp(-s[0] * t);
+			FLT model = p[b * 2] * e + p[b * 2 + 1] + s[1] * t;
+			FLT expected = truth[b * 2] * exp(-truth[2 * SPARSE_TEST_BLOCKS] * t) + truth[b * 2 + 1] +
+						   truth[2 * SPARSE_TEST_BLOCKS + 1] * t + .01 * sin(idx * 1.7);
+			deviates[idx] = model - expected;
+			if (derivs && derivs[b * 2])
+				derivs[b * 2][idx] = e;
+			if (derivs && derivs[2 * SPARSE_TEST_BLOCKS])
+				derivs[2 * SPARSE_TEST_BLOCKS][idx] = -t * p[b * 2] * e;
+		}
+	}
+	return 0;
+}
+
+TEST(Optimizer, SparseMatchesMpfit) {
+	const int npar = 2 * SPARSE_TEST_BLOCKS + 2, m = SPARSE_TEST_BLOCKS * SPARSE_TEST_SAMPLES;
+	FLT truth[2 * SPARSE_TEST_BLOCKS + 2], start[2 * SPARSE_TEST_BLOCKS + 2];
+	int param_block[2 * SPARSE_TEST_BLOCKS + 2];
+	mp_par pars[2 * SPARSE_TEST_BLOCKS + 2] = {0};
+	for (int i = 0; i < npar; i++) {
+		truth[i] = 1 + .25 * i;
+		start[i] = truth[i] + (i % 2 ? .3 : -.2);
+		param_block[i] = i < 2 * SPARSE_TEST_BLOCKS ? i / 2 : -1;
+		// Mix analytic and numerical derivatives
+		pars[i].side = (i % 2 == 0) ? 3 : 0;
+	}
+	truth[2 * SPARSE_TEST_BLOCKS] = .5;
+	start[2 * SPARSE_TEST_BLOCKS] = .7;
+	pars[3].fixed = 1;
+	start[3] = truth[3];
+
+	mp_config cfg = {.maxiter = 100, .ftol = 1e-12, .xtol = 1e-12};
+
+	FLT dense_x[2 * SPARSE_TEST_BLOCKS + 2], sparse_x[2 * SPARSE_TEST_BLOCKS + 2];
+	FLT dense_covar[(2 * SPARSE_TEST_BLOCKS + 2) * (2 * SPARSE_TEST_BLOCKS + 2)];
+	FLT sparse_covar[(2 * SPARSE_TEST_BLOCKS + 2) * (2 * SPARSE_TEST_BLOCKS + 2)];
+	memcpy(dense_x, start, sizeof(start));
+	memcpy(sparse_x, start, sizeof(start));
+
+	mp_result dense = {.covar = dense_covar}, sparse = {.covar = sparse_covar};
+	int dense_status = mpfit(sparse_test_func, m, npar, dense_x, pars, &cfg, truth, &dense);
+	int sparse_status =
+		survive_optimizer_sparse_lm(sparse_test_func, m, npar, sparse_x, pars, &cfg, truth, param_block, 0, &sparse);
+	ASSERT_GT(dense_status, 0);
+	ASSERT_GT(sparse_status, 0);
+
+	ASSERT_EQ(sparse.nfree, npar - 1);
+	ASSERT_DOUBLE_EQ(sparse_x[3], truth[3]);
+	ASSERT_GE(dense.bestnorm * 1.0001 + 1e-12, sparse.bestnorm);
+	for (int i = 0; i < npar; i++) {
+		ASSERT_GE(1e-5, fabs(dense_x[i] - sparse_x[i]));
+	}
+	for (int i = 0; i < npar * npar; i++) {
+		ASSERT_GE(1e-4 * (1 + fabs(dense_covar[i])), fabs(dense_covar[i] - sparse_covar[i]));
+	}
+
+	// A residual tying two blocks together has to be handled by falling back to a dense solve
+	param_block[2 * SPARSE_TEST_BLOCKS] = 0;
+	memcpy(sparse_x, start, sizeof(start));
+	sparse_status =
+		survive_optimizer_sparse_lm(sparse_test_func, m, npar, sparse_x, pars, &cfg, truth, param_block, 0, 0);
+	ASSERT_GT(sparse_status, 0);
+	for (int i = 0; i < npar; i++) {
+		ASSERT_GE(1e-5, fabs(dense_x[i] - sparse_x[i]));
+	}
+	return 0;
+}
+
+#define THREADED_TEST_POINTS 600
+
+static int run_threaded_comparison(bool disableVelocity) {
+	static FLT pts[THREADED_TEST_POINTS * 3];
+	srand(1234);
+	for (int i = 0; i < THREADED_TEST_POINTS * 3; i++) {
+		pts[i] = .2 * rand() / (FLT)RAND_MAX - .1;
+	}
+
+	const SurviveKalmanModel start = {.Pose = {.Rot = {1, 1, 1, 1}},
+									  .Velocity = {.Pos = {0, 0, .1}, .AxisAngleRot = {0, 0, .1}},
+									  .IMUBias = {
+										  .IMUCorrection = {1},
+										  .AccScale = 1,
+									  }};
+
+	struct survive_thread_pool *pool = survive_thread_pool_create(4);
+	SurvivePose outputs[2];
+	mp_result results[2] = {0};
+	FLT R_data[2][49] = {0};
+	for (int threaded = 0; threaded < 2; threaded++) {
+		survive_optimizer mpfitctx = default_optimizer();
+		mpfitctx.disableVelocity = disableVelocity;
+		mpfitctx.thread_pool = threaded ? pool : 0;
+
+		SurviveKalmanModel mdl = start;
+		CnMat R = cnMat(7, 7, R_data[threaded]);
+		outputs[threaded] = run(&mpfitctx, &mdl, pts, THREADED_TEST_POINTS, &results[threaded], &R, 0);
+	}
+	survive_thread_pool_free(pool);
+
+	// Every residual and jacobian entry is computed the same way either way, so the solves match exactly. The summed
+	// error stats don't feed the solve and aren't compared; their addition order differs.
+	ASSERT_EQ(results[0].nfev, results[1].nfev);
+	ASSERT_EQ(results[0].bestnorm, results[1].bestnorm);
+	const FLT *serial = &outputs[0].Pos[0], *threaded = &outputs[1].Pos[0];
+	for (int i = 0; i < 7; i++) {
+		ASSERT_EQ(serial[i], threaded[i]);
+	}
+	for (int i = 0; i < 49; i++) {
+		ASSERT_EQ(R_data[0][i], R_data[1][i]);
+	}
+	return 0;
+}
+
+TEST(Optimizer, ThreadedMatchesSerial) {
+	int rtn = run_threaded_comparison(true);
+	if (rtn)
+		return rtn;
+	return run_threaded_comparison(false);
+}
+
+#define WARM_START_TEST_RUNS 6
+
+TEST(Optimizer, WarmStart) {
+	settings.sparse_solver = true;
+
+	int iterations[2] = {0};
+	SurvivePose outputs[2][WARM_START_TEST_RUNS];
+	survive_optimizer_warm_start warm_start = {0};
+	for (int warm = 0; warm < 2; warm++) {
+		SurviveKalmanModel mdl = {.Pose = {.Rot = {1, 1, 1, 1}},
+								  .Velocity = {.Pos = {0, 0, .1}, .AxisAngleRot = {0, 0, .1}},
+								  .IMUBias = {
+									  .IMUCorrection = {1},
+									  .AccScale = 1,
+								  }};
+
+		// Each run starts at the last one's answer, a little behind where the object has moved to
+		for (int i = 0; i < WARM_START_TEST_RUNS; i++) {
+			survive_optimizer mpfitctx = default_optimizer();
+			mpfitctx.warm_start = warm ? &warm_start : 0;
+
+			mp_result results = {0};
+			outputs[warm][i] = run(&mpfitctx, &mdl, points, SURVIVE_ARRAY_SIZE(points) / 3, &results, 0, 0);
+			ASSERT_GT(results.status, 0);
+			iterations[warm] += results.niter;
+			mdl.Pose = outputs[warm][i];
+		}
+	}
+	settings.sparse_solver = false;
+
+	ASSERT_EQ(warm_start.warm_solves, WARM_START_TEST_RUNS - 1);
+	ASSERT_GE(iterations[0], iterations[1]);
+	for (int i = 0; i < WARM_START_TEST_RUNS; i++) {
+		const FLT *cold = &outputs[0][i].Pos[0], *warm = &outputs[1][i].Pos[0];
+		for (int j = 0; j < 7; j++) {
+			ASSERT_GE(1e-6, fabs(cold[j] - warm[j]));
+		}
+	}
+	return 0;
+}
+
+static int run_workspace_comparison(bool sparse) {
+	settings.sparse_solver = sparse;
+	survive_optimizer_workspace workspace = {0};
+	SurvivePose outputs[3];
+	for (int i = 0; i < 3; i++) {
+		survive_optimizer mpfitctx = default_optimizer();
+		mpfitctx.workspace = i ? &workspace : 0;
+		survive_optimizer_workspace_reset(&workspace);
+
+		SurviveKalmanModel mdl = {.Pose = {.Rot = {1, 1, 1, 1}},
+								  .Velocity = {.Pos = {0, 0, .1}, .AxisAngleRot = {0, 0, .1}},
+								  .IMUBias = {
+									  .IMUCorrection = {1},
+									  .AccScale = 1,
+								  }};
+		CN_CREATE_STACK_MAT(R, 7, 7);
+		mp_result results = {0};
+		outputs[i] = run(&mpfitctx, &mdl, points, SURVIVE_ARRAY_SIZE(points) / 3, &results, &R, 0);
+		ASSERT_GT(results.status, 0);
+
+		// Everything is handed back at the end of the run
+		ASSERT_EQ(workspace.used, 0);
+		ASSERT_EQ(workspace.overflow, 0);
+	}
+
+	settings.sparse_solver = false;
+
+	// The first run with it overflowed; the second fit in what the reset grew it to
+	ASSERT_GT(workspace.size, 0);
+	ASSERT_GE(workspace.size, workspace.high_water);
+	survive_optimizer_workspace_free(&workspace);
+
+	for (int i = 1; i < 3; i++) {
+		const FLT *expected = &outputs[0].Pos[0], *actual = &outputs[i].Pos[0];
+		for (int j = 0; j < 7; j++) {
+			ASSERT_EQ(expected[j], actual[j]);
+		}
+	}
+	return 0;
+}
+
+// The sparse backend, which warm starts use, takes its buffers from the workspace the same as mpfit
+TEST(Optimizer, Workspace) {
+	int rtn = run_workspace_comparison(false);
+	if (rtn)
+		return rtn;
+	return run_workspace_comparison(true);
+}
+
+#define VELOCITY_TEST_STEPS 6
+
+// Pose and velocity both free, seen over several time steps; analytic is zero to use finite differences for the velocity
+static SurviveVelocity run_free_velocity(bool analytic, mp_result *result) {
+	survive_optimizer mpfitctx = default_optimizer();
+	mpfitctx.disableVelocity = false;
+	mpfitctx.ptsLength = SURVIVE_ARRAY_SIZE(points) / 3;
+	SURVIVE_OPTIMIZER_SETUP_STACK_BUFFERS(mpfitctx, 0);
+
+	SurviveKalmanModel mdl = {.Pose = {.Pos = {.1, .2, .3}, .Rot = {1, .1, .2, .3}},
+							  .Velocity = {.Pos = {.1, -.2, .3}, .AxisAngleRot = {.2, .3, -.1}}};
+	quatnormalize(mdl.Pose.Rot, mdl.Pose.Rot);
+	SurvivePose lh_pose = {.Pos = {0, 0, -5}, .Rot = {1}};
+	SurvivePose ilh = InvertPoseRtn(&lh_pose);
+	BaseStationCal bcal[2] = {0};
+
+	survive_optimizer_setup_pose(&mpfitctx, &mdl.Pose, false, 1);
+	survive_optimizer_setup_camera(&mpfitctx, 0, &ilh, true, 1);
+	survive_optimizer_parameter *pt_params = survive_optimizer_emplace_params(
+		&mpfitctx, survive_optimizer_parameter_obj_points, SURVIVE_ARRAY_SIZE(points) / 3);
+	memcpy(pt_params->p, points, sizeof(points));
+	survive_optimizer_parameter *bsd_params =
+		survive_optimizer_emplace_params(&mpfitctx, survive_optimizer_parameter_camera_parameters, 1);
+	memset(bsd_params->p, 0, bsd_params->size * sizeof(FLT));
+
+	int v_idx = survive_optimizer_get_velocity_index(&mpfitctx);
+	for (int i = 0; i < 6; i++) {
+		mpfitctx.mp_parameters_info[v_idx + i].fixed = false;
+		if (!analytic) {
+			mpfitctx.mp_parameters_info[v_idx + i].side = 0;
+		}
+	}
+
+	// The pose is solved for at the last step's time
+	FLT t = 0;
+	SurvivePose truth = mdl.Pose;
+	for (int i = 0; i < VELOCITY_TEST_STEPS; i++) {
+		t += .05;
+		SurviveKalmanModel tmp = {0};
+		SurviveKalmanModelPredict(&tmp, .05, &mdl);
+		mdl = tmp;
+		quatnormalize(mdl.Pose.Rot, mdl.Pose.Rot);
+		truth = mdl.Pose;
+		for (int j = 0; j < SURVIVE_ARRAY_SIZE(points) / 3; j++) {
+			for (int axis = 0; axis < 2; axis++) {
+				survive_optimizer_measurement *meas =
+					survive_optimizer_emplace_meas(&mpfitctx, survive_optimizer_measurement_type_light);
+				meas->variance = 1e-4;
+				meas->time = t;
+				meas->light.sensor_idx = j;
+				meas->light.axis = axis;
+
+				FLT out[2];
+				survive_reproject_full(bcal, &lh_pose, &mdl.Pose, &points[j * 3], out);
+				meas->light.value = out[axis];
+			}
+		}
+	}
+	mpfitctx.timecode = t;
+	*survive_optimizer_get_pose(&mpfitctx) = truth;
+
+	survive_optimizer_run(&mpfitctx, result, 0);
+	return *survive_optimizer_get_velocity(&mpfitctx);
+}
+
+TEST(Optimizer, AnalyticVelocity) {
+	mp_result results[2] = {0};
+	SurviveVelocity velocities[2];
+	for (int analytic = 0; analytic < 2; analytic++) {
+		velocities[analytic] = run_free_velocity(analytic, &results[analytic]);
+		ASSERT_GT(results[analytic].status, 0);
+	}
+
+	// Same answer without the extra evaluations finite differences take for the six velocity terms
+	const FLT *numeric = &velocities[0].Pos[0], *analytic = &velocities[1].Pos[0];
+	for (int i = 0; i < 6; i++) {
+		ASSERT_GE(1e-4, fabs(numeric[i] - analytic[i]));
+	}
+	ASSERT_GT(results[0].nfev, results[1].nfev);
+	return 0;
+}
+
+/**
+ * Solves with calibration and sensor points free and, if scaled, the sensor scale and lighthouse correction axis 2 too,
+ * all with use_jacobian_function = -1 so mpfit checks each analytic derivative against a two sided finite difference.
+ * The object pose stays fixed; it's the other tests that lean on its derivatives.
+ */
+static void run_deriv_debug(const survive_reproject_model_t *model, bool use_quat_model, bool scaled,
+							mp_result *result) {
+	survive_optimizer_settings debug_settings = {
+		.use_quat_model = use_quat_model,
+		.lh_scale_correction = scaled ? 1e-4 : 0,
+		.optimize_scale_threshold = scaled ? 0 : -1,
+	};
+
+	SurvivePose pose = {.Pos = {.1, .2, .3}, .Rot = {1, .1, .2, .3}};
+	quatnormalize(pose.Rot, pose.Rot);
+	SurvivePose lh_pose = {.Pos = {0, 0, -5}, .Rot = {1}};
+	BaseStationCal bcal[2] = {{.phase = .01, .tilt = .02, .curve = .03, .gibpha = .4, .gibmag = .01, .ogeephase = .5,
+							   .ogeemag = .02},
+							  {.phase = -.01, .tilt = -.01, .curve = .02, .gibpha = -.3, .gibmag = .02,
+							   .ogeephase = -.4, .ogeemag = .03}};
+
+	SurviveContext *ctx = SV_CALLOC(sizeof(SurviveContext));
+#define SURVIVE_HOOK_PROCESS_DEF(hook) survive_install_##hook##_fn(ctx, 0);
+#define SURVIVE_HOOK_FEEDBACK_DEF(hook) survive_install_##hook##_fn(ctx, 0);
+#include "survive_hooks.h"
+	ctx->log_target = stderr;
+	ctx->bsd[0].Pose = InvertPoseRtn(&lh_pose);
+	memcpy(ctx->bsd[0].fcal, bcal, sizeof(bcal));
+
+	// Off of 1 so the sensor points go through the scaled path
+	SurviveObject *so = SV_CALLOC(sizeof(SurviveObject));
+	so->ctx = ctx;
+	so->imu2trackref = LinmathPose_Identity;
+	so->sensor_scale = scaled ? 1.01 : 1;
+	so->sensor_scale_var = 1e-2;
+	so->lh_correction[0][2] = scaled ? .01 : 0;
+	so->lh_correction_variance[0][2] = 1e-4;
+
+	survive_optimizer mpfitctx = default_optimizer();
+	mpfitctx.settings = &debug_settings;
+	mpfitctx.reprojectModel = model;
+	mpfitctx.ptsLength = SURVIVE_ARRAY_SIZE(points) / 3;
+	SURVIVE_OPTIMIZER_SETUP_STACK_BUFFERS(mpfitctx, so);
+
+	// The correction block has to be there before the pose setup fills it in
+	survive_optimizer_parameter *lh_correction =
+		scaled ? survive_optimizer_emplace_params(&mpfitctx, survive_optimizer_parameter_object_lighthouse_correction, 1)
+			   : 0;
+	survive_optimizer_setup_pose(&mpfitctx, &pose, true, -1);
+	if (lh_correction) {
+		lh_correction->pi[2].fixed = false;
+	}
+
+	// Points have no setup function to pass use_jacobian_function to
+	survive_optimizer_parameter *pt_params =
+		survive_optimizer_emplace_params(&mpfitctx, survive_optimizer_parameter_obj_points, mpfitctx.ptsLength);
+	memcpy(pt_params->p, points, sizeof(points));
+	for (int i = 0; i < pt_params->size; i++) {
+		pt_params->pi[i].fixed = false;
+		pt_params->pi[i].side = 2;
+		pt_params->pi[i].deriv_debug = 1;
+		pt_params->pi[i].deriv_abstol = pt_params->pi[i].deriv_reltol = 1e-4;
+	}
+
+	survive_optimizer_parameter *cal_params =
+		survive_optimizer_emplace_params(&mpfitctx, survive_optimizer_parameter_camera_parameters, 1);
+	survive_optimizer_setup_cameras(&mpfitctx, ctx, true, -1, false);
+	for (int i = 0; i < cal_params->size; i++) {
+		cal_params->pi[i].fixed = false;
+	}
+
+	for (int j = 0; j < mpfitctx.ptsLength; j++) {
+		for (int axis = 0; axis < 2; axis++) {
+			survive_optimizer_measurement *meas =
+				survive_optimizer_emplace_meas(&mpfitctx, survive_optimizer_measurement_type_light);
+			meas->variance = 1e-4;
+			meas->light.sensor_idx = j;
+			meas->light.axis = axis;
+			meas->light.value = model->reprojectAxisFullFn[axis](&pose, &points[j * 3], &lh_pose, &bcal[axis]);
+		}
+	}
+
+	// The lighthouse correction update reads the covariance
+	int param_cnt = survive_optimizer_get_parameters_count(&mpfitctx);
+	CN_CREATE_STACK_MAT(R, param_cnt, param_cnt);
+	survive_optimizer_run(&mpfitctx, result, &R);
+	CN_FREE_STACK_MAT(R);
+
+	free(so);
+	free(ctx);
+}
+
+TEST(Optimizer, DerivDebug) {
+	const survive_reproject_model_t *models[] = {&survive_reproject_gen1_model, &survive_reproject_gen2_model};
+	for (int i = 0; i < SURVIVE_ARRAY_SIZE(models); i++) {
+		for (int use_quat_model = 0; use_quat_model < 2; use_quat_model++) {
+			for (int scaled = 0; scaled < 2; scaled++) {
+				mp_result result = {0};
+				run_deriv_debug(models[i], use_quat_model, scaled, &result);
+				ASSERT_GT(result.status, 0);
+				ASSERT_EQ(result.nderivfail, 0);
+			}
+		}
+	}
+	return 0;
+}
+
+TEST(Optimizer, SerializeRoundTrip) {
+	const char *fn = "optimizer_round_trip.opt";
+	survive_optimizer mpfitctx = default_optimizer();
+	mpfitctx.disableVelocity = false;
+	mpfitctx.ptsLength = SURVIVE_ARRAY_SIZE(points) / 3;
+	SURVIVE_OPTIMIZER_SETUP_STACK_BUFFERS(mpfitctx, 0);
+
+	SurviveKalmanModel mdl = {.Pose = {.Rot = {1, 1, 1, 1}},
+							  .Velocity = {.Pos = {0, 0, .1}, .AxisAngleRot = {0, 0, .1}},
+							  .IMUBias = {
+								  .IMUCorrection = {1},
+								  .AccScale = 1,
+							  }};
+	setup_problem(&mpfitctx, &mdl, points, SURVIVE_ARRAY_SIZE(points) / 3, 0);
+	survive_optimizer_serialize(&mpfitctx, fn);
+
+	survive_optimizer *loaded = survive_optimizer_load(fn);
+	remove(fn);
+	ASSERT_EQ(loaded != 0, true);
+	loaded->cfg = mpfitctx.cfg;
+
+	ASSERT_EQ(loaded->parameterBlockCnt, mpfitctx.parameterBlockCnt);
+	ASSERT_EQ(survive_optimizer_get_parameters_count(loaded), survive_optimizer_get_parameters_count(&mpfitctx));
+	ASSERT_EQ(loaded->measurementsCnt, mpfitctx.measurementsCnt);
+	for (int i = 0; i < survive_optimizer_get_parameters_count(loaded); i++) {
+		ASSERT_EQ(loaded->mp_parameters_info[i].fixed, mpfitctx.mp_parameters_info[i].fixed);
+		ASSERT_EQ(loaded->mp_parameters_info[i].side, mpfitctx.mp_parameters_info[i].side);
+	}
+
+	// The text keeps 16 decimal places, so the solves agree to about that
+	mp_result results[2] = {0};
+	survive_optimizer_run(&mpfitctx, &results[0], 0);
+	survive_optimizer_run(loaded, &results[1], 0);
+	ASSERT_EQ(results[0].niter, results[1].niter);
+	const FLT *expected = &survive_optimizer_get_pose(&mpfitctx)->Pos[0];
+	const FLT *actual = &survive_optimizer_get_pose(loaded)->Pos[0];
+	for (int i = 0; i < 7; i++) {
+		ASSERT_GE(1e-9, fabs(expected[i] - actual[i]));
+	}
+
+	survive_optimizer_free_loaded(loaded);
+	return 0;
+}
+
+// Dumps from before the robust loss was serialized have no line for it
+TEST(Optimizer, LoadWithoutRobustLoss) {
+	char fn[1024], old_fn[1024];
+	survive_test_temp_path(fn, sizeof(fn), "optimizer_no_robust.opt");
+	survive_test_temp_path(old_fn, sizeof(old_fn), "optimizer_no_robust_old.opt");
+	survive_optimizer mpfitctx = default_optimizer();
+	mpfitctx.ptsLength = SURVIVE_ARRAY_SIZE(points) / 3;
+	SURVIVE_OPTIMIZER_SETUP_STACK_BUFFERS(mpfitctx, 0);
+
+	SurviveKalmanModel mdl = {.Pose = {.Rot = {1, 1, 1, 1}},
+							  .IMUBias = {
+								  .IMUCorrection = {1},
+								  .AccScale = 1,
+							  }};
+	setup_problem(&mpfitctx, &mdl, points, SURVIVE_ARRAY_SIZE(points) / 3, 0);
+	settings.robust_loss = survive_optimizer_robust_loss_cauchy;
+	survive_optimizer_serialize(&mpfitctx, fn);
+	settings.robust_loss = survive_optimizer_robust_loss_none;
+
+	FILE *in = fopen(fn, "r"), *out = fopen(old_fn, "w");
+	ASSERT_EQ(in != 0 && out != 0, true);
+	char line[1024];
+	while (fgets(line, sizeof(line), in)) {
+		if (strncmp(line, "robust", 6) != 0) {
+			fputs(line, out);
+		}
+	}
+	fclose(in);
+	fclose(out);
+
+	survive_optimizer *loaded = survive_optimizer_load(fn);
+	ASSERT_EQ(loaded != 0, true);
+	ASSERT_EQ(loaded->settings->robust_loss, survive_optimizer_robust_loss_cauchy);
+	survive_optimizer_free_loaded(loaded);
+
+	loaded = survive_optimizer_load(old_fn);
+	remove(fn);
+	remove(old_fn);
+	ASSERT_EQ(loaded != 0, true);
+	ASSERT_EQ(loaded->settings->robust_loss, survive_optimizer_robust_loss_none);
+	ASSERT_EQ(loaded->parameterBlockCnt, mpfitctx.parameterBlockCnt);
+	ASSERT_EQ(loaded->measurementsCnt, mpfitctx.measurementsCnt);
+	survive_optimizer_free_loaded(loaded);
+	return 0;
+}
+
+static FLT run_with_outlier(int robust_loss, mp_result *result) {
+	survive_optimizer mpfitctx = default_optimizer();
+	mpfitctx.ptsLength = SURVIVE_ARRAY_SIZE(points) / 3;
+	SURVIVE_OPTIMIZER_SETUP_STACK_BUFFERS(mpfitctx, 0);
+
+	SurviveKalmanModel mdl = {.Pose = {.Rot = {1, 1, 1, 1}},
+							  .IMUBias = {
+								  .IMUCorrection = {1},
+								  .AccScale = 1,
+							  }};
+	setup_problem(&mpfitctx, &mdl, points, SURVIVE_ARRAY_SIZE(points) / 3, 0);
+	// Lighthouse-like noise of 1e-4 rad, so this reflection is 500 sigma off
+	for (int i = 0; i < mpfitctx.measurementsCnt; i++) {
+		mpfitctx.measurements[i].variance = 1e-8;
+	}
+	mpfitctx.measurements[3].light.value += .05;
+
+	settings.robust_loss = robust_loss;
+	settings.robust_scale = 2;
+	survive_optimizer_run(&mpfitctx, result, 0);
+	settings.robust_loss = survive_optimizer_robust_loss_none;
+
+	return dist3d(survive_optimizer_get_pose(&mpfitctx)->Pos, mdl.Pose.Pos);
+}
+
+TEST(Optimizer, RobustLoss) {
+	mp_result results[3] = {0};
+	FLT plain_error = run_with_outlier(survive_optimizer_robust_loss_none, &results[0]);
+	FLT huber_error = run_with_outlier(survive_optimizer_robust_loss_huber, &results[1]);
+	FLT cauchy_error = run_with_outlier(survive_optimizer_robust_loss_cauchy, &results[2]);
+	// Least squares gets dragged most of a meter; both robust losses stay within a millimeter in one solve
+	ASSERT_GE(plain_error, .1);
+	ASSERT_GE(1e-3, huber_error);
+	ASSERT_GE(1e-4, cauchy_error);
+
+	// The norms are plain squared residuals either way, so least squares has the smallest one
+	for (int i = 1; i < 3; i++) {
+		ASSERT_GE(results[i].bestnorm, results[0].bestnorm);
+	}
+	return 0;
+}
@@ -0,0 +1,422 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <math.h>
+#include <os_generic.h>
+#include <survive.h>
+
+/**
+ * Replays many recordings concurrently in one process, each in its own SurviveContext at playback-factor 0, and writes
+ * a JSON summary of wall time, throughput and pose error against the 'replay_' poses embedded in the recordings.
+ *
+ * A run fails on the same error bounds test_replays holds a single recording to: poses along the way, the final poses
+ * and the solved lighthouse poses all have to stay close to the recording's.
+ *
+ * Usage: replay_batch [--jobs N] [--summary out.json] [--keep-lh] files... [-- extra libsurvive arguments]
+ */
+
+#ifdef USE_FLOAT
+static const FLT max_pos_error = .08, max_rot_error = .005;
+#else
+static const FLT max_pos_error = .08, max_rot_error = .001;
+#endif
+
+#define REPLAY_MAX_TRUTHS 32
+
+typedef struct replay_truth {
+	char name[32];
+	SurvivePose pose;
+} replay_truth;
+
+typedef struct replay_stats {
+	size_t cnt;
+	double pos_sum, pos_sq_sum, pos_max;
+	double rot_sum, rot_max;
+} replay_stats;
+
+typedef struct replay_run {
+	const char *filename;
+	int extra_argc;
+	char **extra_argv;
+	bool keep_lh;
+
+	int status;
+	double wall_time, recording_time;
+	uint64_t events;
+	replay_stats stats;
+	// Ground truth and solved poses that were out of bounds
+	int mismatched;
+
+	// Latest ground truth pose per object, for the final check
+	replay_truth truths[REPLAY_MAX_TRUTHS];
+	size_t truths_cnt;
+
+	external_pose_process_func external_pose_fn;
+} replay_run;
+
+// Same measures as test_replays: 1 - |w| of the rotation between the poses, and the distance between them
+static void pose_error(FLT *err, const SurvivePose *a, const SurvivePose *b) {
+	if (quatiszero(a->Rot) && quatiszero(b->Rot)) {
+		err[0] = err[1] = 0;
+		return;
+	}
+
+	SurvivePose iB = InvertPoseRtn(b), nearId;
+	ApplyPoseToPose(&nearId, a, &iB);
+	err[0] = 1 - fabs(nearId.Rot[0]);
+	err[1] = norm3d(nearId.Pos);
+}
+
+static bool check_pose(replay_run *run, const char *name, const SurvivePose *pose, const SurvivePose *truth,
+					   FLT pos_bound, FLT rot_bound) {
+	FLT err[2];
+	pose_error(err, pose, truth);
+	if (err[1] > pos_bound || err[0] > rot_bound) {
+		fprintf(stderr, "[%s] %s deviates too much -- rot: %f pos: %f\n", run->filename, name, err[0], err[1]);
+		return false;
+	}
+	return true;
+}
+
+static replay_truth *find_truth(replay_run *run, const char *name) {
+	for (size_t i = 0; i < run->truths_cnt; i++) {
+		if (strcmp(run->truths[i].name, name) == 0) {
+			return &run->truths[i];
+		}
+	}
+	if (run->truths_cnt >= REPLAY_MAX_TRUTHS) {
+		return 0;
+	}
+	replay_truth *truth = &run->truths[run->truths_cnt++];
+	strncpy(truth->name, name, sizeof(truth->name) - 1);
+	return truth;
+}
+
+static void stats_add(replay_stats *stats, double pos_err, double rot_err) {
+	stats->cnt++;
+	stats->pos_sum += pos_err;
+	stats->pos_sq_sum += pos_err * pos_err;
+	stats->rot_sum += rot_err;
+	if (pos_err > stats->pos_max)
+		stats->pos_max = pos_err;
+	if (rot_err > stats->rot_max)
+		stats->rot_max = rot_err;
+}
+
+static void stats_merge(replay_stats *total, const replay_stats *stats) {
+	total->cnt += stats->cnt;
+	total->pos_sum += stats->pos_sum;
+	total->pos_sq_sum += stats->pos_sq_sum;
+	total->rot_sum += stats->rot_sum;
+	if (stats->pos_max > total->pos_max)
+		total->pos_max = stats->pos_max;
+	if (stats->rot_max > total->rot_max)
+		total->rot_max = stats->rot_max;
+}
+
+static void external_pose_fn(SurviveContext *ctx, const char *name, const SurvivePose *pose) {
+	replay_run *run = ctx->user_ptr;
+	if (run->external_pose_fn) {
+		run->external_pose_fn(ctx, name, pose);
+	}
+
+	if (strncmp(name, "replay_", strlen("replay_")) != 0 || quatiszero(pose->Rot)) {
+		return;
+	}
+
+	SurviveObject *so = survive_get_so_by_name(ctx, name + strlen("replay_"));
+	if (so == 0) {
+		return;
+	}
+
+	replay_truth *truth = find_truth(run, so->codename);
+	if (truth) {
+		truth->pose = *pose;
+	}
+
+	if (quatiszero(so->OutPose.Rot)) {
+		return;
+	}
+
+	SurvivePose inv = InvertPoseRtn(pose), delta;
+	ApplyPoseToPose(&delta, &so->OutPose, &inv);
+	FLT w = fabs(delta.Rot[0]) > 1 ? 1 : fabs(delta.Rot[0]);
+	stats_add(&run->stats, norm3d(delta.Pos), 2 * acos(w));
+
+	// Along the way the bounds are looser, as in test_replays
+	if (run->mismatched == 0 &&
+		!check_pose(run, so->codename, &so->OutPose, pose, max_pos_error * 10., max_rot_error * 10.)) {
+		run->mismatched++;
+	}
+}
+
+// The final object poses and the solved lighthouses, checked like test_replays does
+static void check_final(replay_run *run, SurviveContext *ctx, const SurvivePose *originalLH,
+						const bool *originalHasOOTX, const bool *originalHasPosition) {
+	for (size_t i = 0; i < run->truths_cnt; i++) {
+		SurviveObject *so = survive_get_so_by_name(ctx, run->truths[i].name);
+		if (so && !quatiszero(run->truths[i].pose.Rot) &&
+			!check_pose(run, so->codename, &so->OutPose, &run->truths[i].pose, max_pos_error, max_rot_error)) {
+			run->mismatched++;
+		}
+	}
+
+	SurvivePose currentLH[NUM_GEN2_LIGHTHOUSES] = {0};
+	for (int i = 0; i < ctx->activeLighthouses; i++) {
+		currentLH[i] = ctx->bsd[i].Pose;
+	}
+
+	SurvivePose original2current;
+	KabschPoses(&original2current, originalLH, currentLH, NUM_GEN2_LIGHTHOUSES);
+	for (int i = 0; i < ctx->activeLighthouses; i++) {
+		SurvivePose pose = originalLH[i];
+		ApplyPoseToPose(&pose, &original2current, &pose);
+
+		FLT err[2] = {0};
+		if (!quatiszero(pose.Rot) && !quatiszero(ctx->bsd[i].Pose.Rot)) {
+			pose_error(err, &pose, &ctx->bsd[i].Pose);
+		}
+		if (!quatiszero(pose.Rot) && ctx->bsd[i].PositionSet == 0) {
+			err[0] = INFINITY;
+		}
+
+		if (err[1] > max_pos_error || err[0] > max_rot_error) {
+			fprintf(stderr, "[%s] LH%d deviates too much -- rot: %f pos: %f\n", run->filename, i, err[0], err[1]);
+			run->mismatched++;
+		}
+
+		if ((!ctx->bsd[i].OOTXSet && originalHasOOTX[i]) || (!ctx->bsd[i].PositionSet && originalHasPosition[i])) {
+			fprintf(stderr, "[%s] LH%d was not solved for either ootx or position: %d %d\n", run->filename, i,
+					ctx->bsd[i].OOTXSet, ctx->bsd[i].PositionSet);
+			run->mismatched++;
+		}
+	}
+}
+
+// Many contexts share stderr; only pass through problems, tagged with the file they came from
+static void log_fn(SurviveContext *ctx, SurviveLogLevel logLevel, const char *fault) {
+	if (logLevel == SURVIVE_LOG_LEVEL_INFO) {
+		return;
+	}
+	replay_run *run = ctx->user_ptr;
+	fprintf(stderr, "[%s] %s\n", run ? run->filename : "?", fault);
+}
+
+static void replay(replay_run *run) {
+	char configPath[FILENAME_MAX] = {0};
+	snprintf(configPath, sizeof(configPath), "%s.json", run->filename);
+
+	char *argv[] = {
+		"",
+		"--init-configfile",
+		configPath,
+		"--no-gss-auto-floor-height",
+		"--no-gss-threaded",
+		"--playback-replay-pose",
+		"--playback",
+		(char *)run->filename,
+		"--playback-factor",
+		"0",
+		"--no-threaded-posers",
+	};
+	int argc = sizeof(argv) / sizeof(argv[0]);
+
+	int total_argc = argc + run->extra_argc;
+	char **total_argv = SV_CALLOC(sizeof(char *) * total_argc);
+	memcpy(total_argv, argv, sizeof(argv));
+	memcpy(total_argv + argc, run->extra_argv, sizeof(char *) * run->extra_argc);
+
+	double start = OGGetAbsoluteTimeUS() / 1e6;
+	SurviveContext *ctx = survive_init_internal(total_argc, total_argv, run, log_fn);
+	free(total_argv);
+	if (ctx == 0) {
+		run->status = -1;
+		return;
+	}
+
+	run->external_pose_fn = survive_install_external_pose_fn(ctx, external_pose_fn);
+
+	SurvivePose originalLH[NUM_GEN2_LIGHTHOUSES] = {0};
+	bool originalHasOOTX[NUM_GEN2_LIGHTHOUSES] = {0};
+	bool originalHasPosition[NUM_GEN2_LIGHTHOUSES] = {0};
+	for (int i = 0; i < ctx->activeLighthouses; i++) {
+		originalLH[i] = ctx->bsd[i].Pose;
+		originalHasOOTX[i] = ctx->bsd[i].OOTXSet;
+		originalHasPosition[i] = ctx->bsd[i].PositionSet;
+	}
+
+	if (!run->keep_lh) {
+		uint32_t ref_lh = 0;
+		for (int i = 0; i < ctx->activeLighthouses; i++) {
+			if (fabs(ctx->bsd[i].Pose.Pos[0]) < 1e-10) {
+				ref_lh = ctx->bsd[i].BaseStationID;
+			}
+		}
+		survive_reset_lighthouse_positions(ctx);
+		for (int i = 0; i < ctx->activeLighthouses; i++) {
+			ctx->bsd[i].PositionSet = 0;
+			ctx->bsd[i].Pose = (SurvivePose){0};
+		}
+		survive_configi(ctx, "reference-basestation", SC_SET, ref_lh);
+	}
+
+	int r = survive_startup(ctx);
+	while (r == 0 && (r = survive_poll(ctx)) == 0) {
+	}
+	run->wall_time = OGGetAbsoluteTimeUS() / 1e6 - start;
+	run->recording_time = survive_run_time(ctx);
+
+	// One count per input event; derived hooks (angle, imu from raw_imu, ...) aren't counted again
+	run->events = (uint64_t)ctx->sync_call_cnt + ctx->sweep_angle_call_cnt + ctx->light_call_cnt + ctx->imu_call_cnt;
+	run->status = ctx->currentError;
+
+	check_final(run, ctx, originalLH, originalHasOOTX, originalHasPosition);
+	char *mismatch_flag = getenv("LIBSURVIVE_IGNORE_MISMATCH_TESTS");
+	if (run->status == 0 && run->mismatched > 0 && (mismatch_flag == 0 || strcmp(mismatch_flag, "1") != 0)) {
+		run->status = -2;
+	}
+
+	survive_close(ctx);
+}
+
+static replay_run *runs;
+static size_t run_cnt;
+static volatile uint32_t next_run;
+
+static void *worker(void *user) {
+	for (;;) {
+		uint32_t idx = OGAtomicAddU32(&next_run, 1) - 1;
+		if (idx >= run_cnt) {
+			return 0;
+		}
+		replay(&runs[idx]);
+		fprintf(stderr, "%s: %s in %.2fs\n", runs[idx].filename, runs[idx].status == 0 ? "done" : "FAILED",
+				runs[idx].wall_time);
+	}
+}
+
+static void write_stats(FILE *f, const replay_stats *stats) {
+	double n = stats->cnt ? stats->cnt : 1;
+	fprintf(f,
+			"\"pose_samples\": %zu, \"pos_error_mean\": %f, \"pos_error_rms\": %f, \"pos_error_max\": %f, "
+			"\"rot_error_mean\": %f, \"rot_error_max\": %f",
+			stats->cnt, stats->pos_sum / n, sqrt(stats->pos_sq_sum / n), stats->pos_max, stats->rot_sum / n,
+			stats->rot_max);
+}
+
+static void write_json_string(FILE *f, const char *s) {
+	fputc('"', f);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			fputc('\\', f);
+		}
+		fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+static void write_summary(FILE *f, double wall_time, int jobs) {
+	replay_stats total = {0};
+	uint64_t events = 0;
+	int failed = 0;
+
+	fprintf(f, "{\n  \"files\": [\n");
+	for (size_t i = 0; i < run_cnt; i++) {
+		const replay_run *run = &runs[i];
+		fprintf(f, "    {\"file\": ");
+		write_json_string(f, run->filename);
+		fprintf(f,
+				", \"status\": %d, \"wall_time_s\": %f, \"recording_time_s\": %f, \"events\": %" PRIu64
+				", \"events_per_s\": %f, \"speedup\": %f, \"mismatched\": %d, ",
+				run->status, run->wall_time, run->recording_time, run->events,
+				run->wall_time > 0 ? run->events / run->wall_time : 0,
+				run->wall_time > 0 ? run->recording_time / run->wall_time : 0, run->mismatched);
+		write_stats(f, &run->stats);
+		fprintf(f, "}%s\n", i + 1 < run_cnt ? "," : "");
+
+		stats_merge(&total, &run->stats);
+		events += run->events;
+		failed += run->status != 0;
+	}
+	fprintf(f,
+			"  ],\n  \"total\": {\"files\": %zu, \"failed\": %d, \"jobs\": %d, \"wall_time_s\": %f, \"events\": %" PRIu64
+			", \"events_per_s\": %f, ",
+			run_cnt, failed, jobs, wall_time, events, wall_time > 0 ? events / wall_time : 0);
+	write_stats(f, &total);
+	fprintf(f, "}\n}\n");
+}
+
+int main(int argc, char **argv) {
+	int jobs = 0;
+	const char *summary_path = 0;
+	bool keep_lh = false;
+	int extra_argc = 0;
+	char **extra_argv = 0;
+
+	runs = SV_CALLOC(sizeof(replay_run) * argc);
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+			jobs = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--summary") == 0 && i + 1 < argc) {
+			summary_path = argv[++i];
+		} else if (strcmp(argv[i], "--keep-lh") == 0) {
+			keep_lh = true;
+		} else if (strcmp(argv[i], "--") == 0) {
+			extra_argc = argc - i - 1;
+			extra_argv = argv + i + 1;
+			break;
+		} else {
+			runs[run_cnt++].filename = argv[i];
+		}
+	}
+
+	if (run_cnt == 0) {
+		fprintf(stderr, "Usage: %s [--jobs N] [--summary out.json] [--keep-lh] files... [-- libsurvive args]\n",
+				argv[0]);
+		return -1;
+	}
+
+	for (size_t i = 0; i < run_cnt; i++) {
+		runs[i].extra_argc = extra_argc;
+		runs[i].extra_argv = extra_argv;
+		runs[i].keep_lh = keep_lh;
+	}
+
+	if (jobs <= 0) {
+		jobs = 4;
+	}
+	if (jobs > run_cnt) {
+		jobs = run_cnt;
+	}
+
+	double start = OGGetAbsoluteTimeUS() / 1e6;
+	og_thread_t *threads = SV_CALLOC(sizeof(og_thread_t) * jobs);
+	for (int i = 0; i < jobs; i++) {
+		threads[i] = OGCreateThread(worker, "replay", 0);
+	}
+	for (int i = 0; i < jobs; i++) {
+		OGJoinThread(threads[i]);
+	}
+	double wall_time = OGGetAbsoluteTimeUS() / 1e6 - start;
+
+	FILE *f = summary_path ? fopen(summary_path, "w") : stdout;
+	if (f == 0) {
+		fprintf(stderr, "Could not open %s\n", summary_path);
+		f = stdout;
+	}
+	write_summary(f, wall_time, jobs);
+	if (f != stdout) {
+		fclose(f);
+	}
+
+	int failed = 0;
+	for (size_t i = 0; i < run_cnt; i++) {
+		failed += runs[i].status != 0;
+	}
+
+	free(threads);
+	free(runs);
+	return failed;
+}
@@ -106,3 +106,186 @@ TEST(Reproject, Extents_gen2) {
 
 	return 0;
 }
+
+static FLT rand_range(FLT lo, FLT hi) { return lo + (hi - lo) * rand() / (FLT)RAND_MAX; }
+
+static int check_batch(const BaseStationCal *cal, survive_reproject_axis_fn_t fns[2],
+					   survive_reproject_axis_batch_fn_t batch_fns[2]) {
+	// Not a multiple of the vector width, and more than one chunk
+	enum { N = 151 };
+	FLT x[N], y[N], z[N], out[N];
+	for (int i = 0; i < N; i++) {
+		x[i] = rand_range(-2, 2);
+		y[i] = rand_range(-2, 2);
+		z[i] = rand_range(-5, -.1);
+	}
+
+	for (int axis = 0; axis < 2; axis++) {
+		batch_fns[axis](cal, x, y, z, out, N);
+		for (int i = 0; i < N; i++) {
+			LinmathPoint3d pt = {x[i], y[i], z[i]};
+			ASSERT_DOUBLE_EQ(out[i], fns[axis](cal, pt));
+		}
+	}
+	return 0;
+}
+
+TEST(Reproject, Batch) {
+	srand(42);
+	for (int trial = 0; trial < 10; trial++) {
+		BaseStationCal cal[2] = {0};
+		for (int axis = 0; axis < 2; axis++) {
+			cal[axis].phase = rand_range(-.05, .05);
+			cal[axis].tilt = rand_range(-.05, .05);
+			cal[axis].curve = rand_range(-.05, .05);
+			cal[axis].gibpha = rand_range(-3, 3);
+			cal[axis].gibmag = rand_range(-.01, .01);
+			cal[axis].ogeephase = rand_range(-3, 3);
+			cal[axis].ogeemag = rand_range(-.1, .1);
+		}
+
+		survive_reproject_axis_fn_t gen1[2] = {survive_reproject_axis_x, survive_reproject_axis_y};
+		survive_reproject_axis_batch_fn_t gen1_batch[2] = {survive_reproject_axis_x_batch,
+															survive_reproject_axis_y_batch};
+		int rtn = check_batch(cal, gen1, gen1_batch);
+		if (rtn)
+			return rtn;
+
+		survive_reproject_axis_fn_t gen2[2] = {survive_reproject_axis_x_gen2, survive_reproject_axis_y_gen2};
+		survive_reproject_axis_batch_fn_t gen2_batch[2] = {survive_reproject_axis_x_gen2_batch,
+															survive_reproject_axis_y_gen2_batch};
+		rtn = check_batch(cal, gen2, gen2_batch);
+		if (rtn)
+			return rtn;
+	}
+
+	return 0;
+}
+
+static int check_jacob_batch(const BaseStationCal *cal, survive_reproject_axis_fn_t fns[2],
+							 survive_reproject_axis_batch_fn_t batch_fns[2],
+							 survive_reproject_axis_jacob_batch_fn_t jacob_fns[2]) {
+	// Kept inside the field of view, where none of the asin arguments clamp
+	enum { N = 151 };
+	FLT x[N], y[N], z[N], out[N], expected[N], jac[N * 3];
+	for (int i = 0; i < N; i++) {
+		x[i] = rand_range(-1, 1);
+		y[i] = rand_range(-1, 1);
+		z[i] = rand_range(-5, -1);
+	}
+
+	for (int axis = 0; axis < 2; axis++) {
+		jacob_fns[axis](cal, x, y, z, out, jac, N);
+		batch_fns[axis](cal, x, y, z, expected, N);
+		for (int i = 0; i < N; i++) {
+			ASSERT_DOUBLE_EQ(out[i], expected[i]);
+			for (int j = 0; j < 3; j++) {
+				const FLT h = 1e-6;
+				LinmathPoint3d hi = {x[i], y[i], z[i]}, lo = {x[i], y[i], z[i]};
+				hi[j] += h;
+				lo[j] -= h;
+				FLT numeric = (fns[axis](cal, hi) - fns[axis](cal, lo)) / (2 * h);
+				ASSERT_GT(1e-6, fabs(numeric - jac[i * 3 + j]));
+			}
+		}
+	}
+	return 0;
+}
+
+TEST(Reproject, JacobBatch) {
+	srand(42);
+	for (int trial = 0; trial < 10; trial++) {
+		BaseStationCal cal[2] = {0};
+		for (int axis = 0; axis < 2; axis++) {
+			cal[axis].phase = rand_range(-.05, .05);
+			cal[axis].tilt = rand_range(-.05, .05);
+			cal[axis].curve = rand_range(-.05, .05);
+			cal[axis].gibpha = rand_range(-3, 3);
+			cal[axis].gibmag = rand_range(-.01, .01);
+			cal[axis].ogeephase = rand_range(-3, 3);
+			cal[axis].ogeemag = rand_range(-.1, .1);
+		}
+
+		survive_reproject_axis_fn_t gen1[2] = {survive_reproject_axis_x, survive_reproject_axis_y};
+		survive_reproject_axis_batch_fn_t gen1_batch[2] = {survive_reproject_axis_x_batch,
+															survive_reproject_axis_y_batch};
+		survive_reproject_axis_jacob_batch_fn_t gen1_jacob[2] = {survive_reproject_axis_x_jac_batch,
+																  survive_reproject_axis_y_jac_batch};
+		int rtn = check_jacob_batch(cal, gen1, gen1_batch, gen1_jacob);
+		if (rtn)
+			return rtn;
+
+		survive_reproject_axis_fn_t gen2[2] = {survive_reproject_axis_x_gen2, survive_reproject_axis_y_gen2};
+		survive_reproject_axis_batch_fn_t gen2_batch[2] = {survive_reproject_axis_x_gen2_batch,
+															survive_reproject_axis_y_gen2_batch};
+		survive_reproject_axis_jacob_batch_fn_t gen2_jacob[2] = {survive_reproject_axis_x_gen2_jac_batch,
+																  survive_reproject_axis_y_gen2_jac_batch};
+		rtn = check_jacob_batch(cal, gen2, gen2_batch, gen2_jacob);
+		if (rtn)
+			return rtn;
+	}
+
+	return 0;
+}
+
+// Worst float32 error against the FLT batch
+static int check_batch_f32(const BaseStationCal *cal, survive_reproject_axis_batch_fn_t batch_fns[2],
+						   survive_reproject_axis_batch_f32_fn_t f32_fns[2], FLT *max_err) {
+	enum { N = 151 };
+	FLT x[N], y[N], z[N], out[N];
+	float xf[N], yf[N], zf[N], outf[N];
+	for (int i = 0; i < N; i++) {
+		xf[i] = x[i] = (float)rand_range(-2, 2);
+		yf[i] = y[i] = (float)rand_range(-2, 2);
+		zf[i] = z[i] = (float)rand_range(-5, -.1);
+	}
+
+	for (int axis = 0; axis < 2; axis++) {
+		batch_fns[axis](cal, x, y, z, out, N);
+		f32_fns[axis](cal, xf, yf, zf, outf, N);
+
+		for (int i = 0; i < N; i++) {
+			ASSERT_EQ(isnan(outf[i]), false);
+			*max_err = linmath_max(*max_err, fabs(outf[i] - out[i]));
+		}
+	}
+	return 0;
+}
+
+TEST(Reproject, BatchF32) {
+	srand(42);
+	FLT max_err[2] = {0};
+	for (int trial = 0; trial < 10; trial++) {
+		BaseStationCal cal[2] = {0};
+		for (int axis = 0; axis < 2; axis++) {
+			cal[axis].phase = rand_range(-.05, .05);
+			cal[axis].tilt = rand_range(-.05, .05);
+			cal[axis].curve = rand_range(-.05, .05);
+			cal[axis].gibpha = rand_range(-3, 3);
+			cal[axis].gibmag = rand_range(-.01, .01);
+			cal[axis].ogeephase = rand_range(-3, 3);
+			cal[axis].ogeemag = rand_range(-.1, .1);
+		}
+
+		survive_reproject_axis_batch_fn_t gen1[2] = {survive_reproject_axis_x_batch, survive_reproject_axis_y_batch};
+		survive_reproject_axis_batch_f32_fn_t gen1_f32[2] = {survive_reproject_axis_x_batch_f32,
+															 survive_reproject_axis_y_batch_f32};
+		int rtn = check_batch_f32(cal, gen1, gen1_f32, &max_err[0]);
+		if (rtn)
+			return rtn;
+
+		survive_reproject_axis_batch_fn_t gen2[2] = {survive_reproject_axis_x_gen2_batch,
+													 survive_reproject_axis_y_gen2_batch};
+		survive_reproject_axis_batch_f32_fn_t gen2_f32[2] = {survive_reproject_axis_x_gen2_batch_f32,
+															 survive_reproject_axis_y_gen2_batch_f32};
+		rtn = check_batch_f32(cal, gen2, gen2_f32, &max_err[1]);
+		if (rtn)
+			return rtn;
+	}
+
+	for (int gen = 0; gen < 2; gen++) {
+		// Light measurement noise is on the order of 1e-4 rad
+		ASSERT_GT(1e-5, max_err[gen]);
+	}
+	return 0;
+}
@@ -0,0 +1,220 @@
+#define SURVIVE_ENABLE_FULL_API
+#include "../survive_default_devices.h"
+#include "../survive_recording_binary.h"
+#include "os_generic.h"
+#include "survive_api.h"
+#include "test_case.h"
+
+#define SIMPLE_API_TEST_POSES 20000
+#define SIMPLE_API_TEST_PRODUCERS 2
+#define SIMPLE_API_TEST_CONSUMERS 2
+
+static int write_input(const char *path) {
+	struct survive_binary_writer *writer = survive_binary_writer_open(0, path, false, 4096, 1.);
+	if (writer == 0) {
+		return -1;
+	}
+	survive_binary_pose pose = {.pose = {0, 0, 0, 1, 0, 0, 0}};
+	survive_binary_writer_write(writer, SURVIVE_BINARY_RECORD_EXTERNAL_POSE, "ext0", 0, &pose, sizeof(pose));
+	survive_binary_writer_close(writer);
+	return 0;
+}
+
+static SurviveSimpleContext *simple_init(const char *input, const char *config) {
+	char *argv[] = {"", "--configfile", (char *)config, "--playback", (char *)input, "--no-threaded-posers"};
+	return survive_simple_init(SURVIVE_ARRAY_SIZE(argv), argv);
+}
+
+static SurviveObject *add_device(SurviveContext *ctx, const char *name) {
+	SurviveObject *so = survive_create_device(ctx, "TST", 0, name, 0);
+	if (so) {
+		survive_add_object(ctx, so);
+	}
+	return so;
+}
+
+// Every pose written has Pos = {i, -i, 2i}, so a reader can tell a torn copy from a whole one
+static SurvivePose test_pose(int i) {
+	SurvivePose pose = {.Pos = {i, -i, 2 * i}, .Rot = {1, 0, 0, 0}};
+	return pose;
+}
+
+static bool pose_is_whole(const SurvivePose *pose) {
+	return pose->Pos[1] == -pose->Pos[0] && pose->Pos[2] == 2 * pose->Pos[0];
+}
+
+struct producer {
+	SurviveObject *so;
+	SurviveSimpleContext *actx;
+	volatile bool done;
+};
+
+// Stands in for a poser thread; the pose hook is called without any of the simple API locks held
+static void *pose_producer(void *user) {
+	struct producer *p = user;
+	SurviveContext *ctx = p->so->ctx;
+	for (int i = 1; i <= SIMPLE_API_TEST_POSES; i++) {
+		SurvivePose pose = test_pose(i);
+		ctx->poseproc(p->so, i, &pose);
+	}
+	p->done = true;
+	return 0;
+}
+
+// External objects get created by the hook, which races the snapshot walk over the object list
+static void *external_producer(void *user) {
+	struct producer *p = user;
+	SurviveContext *ctx = survive_simple_get_ctx(p->actx);
+	for (int i = 1; i <= SIMPLE_API_TEST_POSES; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "ext%d", i % 16);
+		SurvivePose pose = test_pose(i);
+		ctx->external_poseproc(ctx, name, &pose);
+	}
+	p->done = true;
+	return 0;
+}
+
+TEST(SimpleApi, SnapshotsAreWhole) {
+	char input[1024], config[1024];
+	survive_test_temp_path(input, sizeof(input), "test_simple_api_snapshot_in.svb");
+	survive_test_temp_path(config, sizeof(config), "test_simple_api_snapshot.json");
+	int rtn = write_input(input);
+	ASSERT_EQ(rtn, 0);
+
+	SurviveSimpleContext *actx = simple_init(input, config);
+	ASSERT_EQ(actx != 0, true);
+	SurviveContext *ctx = survive_simple_get_ctx(actx);
+
+	struct producer tracked = {.so = add_device(ctx, "TS0"), .actx = actx};
+	ASSERT_EQ(tracked.so != 0, true);
+	const SurviveSimpleObject *sao = survive_simple_get_object(actx, "TS0");
+	ASSERT_EQ(sao != 0, true);
+
+	struct producer external = {.actx = actx};
+	og_thread_t threads[] = {OGCreateThread(pose_producer, "pose producer", &tracked),
+							 OGCreateThread(external_producer, "external producer", &external)};
+
+	FLT last = 0;
+	size_t updated = 0;
+	SurviveSimplePoseSnapshot snapshots[64];
+	while (!tracked.done || !external.done) {
+		SurviveSimplePoseSnapshot snapshot;
+		if (survive_simple_object_get_pose_snapshot(sao, &snapshot)) {
+			ASSERT_EQ(pose_is_whole(&snapshot.pose), true);
+			ASSERT_GE(snapshot.pose.Pos[0], last);
+			last = snapshot.pose.Pos[0];
+		}
+
+		size_t cnt = survive_simple_get_pose_snapshots(actx, snapshots, SURVIVE_ARRAY_SIZE(snapshots));
+		for (size_t i = 0; i < cnt; i++) {
+			if (snapshots[i].object == sao) {
+				ASSERT_EQ(pose_is_whole(&snapshots[i].pose), true);
+			}
+		}
+
+		while (survive_simple_get_next_updated(actx)) {
+			updated++;
+		}
+	}
+
+	for (int i = 0; i < SURVIVE_ARRAY_SIZE(threads); i++) {
+		OGJoinThread(threads[i]);
+	}
+
+	SurviveSimplePoseSnapshot snapshot;
+	ASSERT_EQ(survive_simple_object_get_pose_snapshot(sao, &snapshot), true);
+	ASSERT_EQ(snapshot.pose.Pos[0], SIMPLE_API_TEST_POSES);
+	ASSERT_GT(updated, 0);
+
+	survive_simple_close(actx);
+	remove(input);
+	remove(config);
+	return 0;
+}
+
+struct consumer {
+	SurviveSimpleEventConsumer *consumer;
+	const SurviveSimpleObject *objects[SIMPLE_API_TEST_PRODUCERS];
+	size_t received, dropped;
+	int error;
+};
+
+// Every published pose is either received or counted as dropped, and what is received is whole and in order per object
+static void *pose_consumer(void *user) {
+	struct consumer *c = user;
+	FLT last[SIMPLE_API_TEST_PRODUCERS] = {0};
+	size_t total = SIMPLE_API_TEST_PRODUCERS * SIMPLE_API_TEST_POSES;
+
+	while (c->received + survive_simple_event_consumer_dropped(c->consumer) < total) {
+		SurviveSimpleEvent event;
+		if (survive_simple_event_consumer_next(c->consumer, &event) != SurviveSimpleEventType_PoseUpdateEvent) {
+			OGUSleep(1);
+			continue;
+		}
+
+		const SurviveSimplePoseUpdatedEvent *pose_event = survive_simple_get_pose_updated_event(&event);
+		int idx = 0;
+		while (idx < SIMPLE_API_TEST_PRODUCERS && c->objects[idx] != pose_event->object) {
+			idx++;
+		}
+		if (idx == SIMPLE_API_TEST_PRODUCERS || !pose_is_whole(&pose_event->pose) ||
+			pose_event->pose.Pos[0] <= last[idx]) {
+			c->error = -1;
+			break;
+		}
+		last[idx] = pose_event->pose.Pos[0];
+		c->received++;
+	}
+
+	c->dropped = survive_simple_event_consumer_dropped(c->consumer);
+	return 0;
+}
+
+TEST(SimpleApi, EventConsumersSeeEveryPose) {
+	char input[1024], config[1024];
+	survive_test_temp_path(input, sizeof(input), "test_simple_api_events_in.svb");
+	survive_test_temp_path(config, sizeof(config), "test_simple_api_events.json");
+	int rtn = write_input(input);
+	ASSERT_EQ(rtn, 0);
+
+	SurviveSimpleContext *actx = simple_init(input, config);
+	ASSERT_EQ(actx != 0, true);
+	SurviveContext *ctx = survive_simple_get_ctx(actx);
+
+	struct producer producers[SIMPLE_API_TEST_PRODUCERS] = {0};
+	struct consumer consumers[SIMPLE_API_TEST_CONSUMERS] = {0};
+	for (int i = 0; i < SIMPLE_API_TEST_PRODUCERS; i++) {
+		char name[8];
+		snprintf(name, sizeof(name), "TS%d", i);
+		producers[i] = (struct producer){.so = add_device(ctx, name), .actx = actx};
+		ASSERT_EQ(producers[i].so != 0, true);
+		for (int j = 0; j < SIMPLE_API_TEST_CONSUMERS; j++) {
+			consumers[j].objects[i] = survive_simple_get_object(actx, name);
+		}
+	}
+
+	og_thread_t threads[SIMPLE_API_TEST_PRODUCERS + SIMPLE_API_TEST_CONSUMERS];
+	for (int j = 0; j < SIMPLE_API_TEST_CONSUMERS; j++) {
+		consumers[j].consumer = survive_simple_event_consumer_create(actx);
+		threads[j] = OGCreateThread(pose_consumer, "pose consumer", &consumers[j]);
+	}
+	for (int i = 0; i < SIMPLE_API_TEST_PRODUCERS; i++) {
+		threads[SIMPLE_API_TEST_CONSUMERS + i] = OGCreateThread(pose_producer, "pose producer", &producers[i]);
+	}
+	for (int i = 0; i < SURVIVE_ARRAY_SIZE(threads); i++) {
+		OGJoinThread(threads[i]);
+	}
+
+	for (int j = 0; j < SIMPLE_API_TEST_CONSUMERS; j++) {
+		ASSERT_EQ(consumers[j].error, 0);
+		ASSERT_EQ(consumers[j].received + consumers[j].dropped, SIMPLE_API_TEST_PRODUCERS * SIMPLE_API_TEST_POSES);
+		ASSERT_GT(consumers[j].received, 0);
+		survive_simple_event_consumer_destroy(consumers[j].consumer);
+	}
+
+	survive_simple_close(actx);
+	remove(input);
+	remove(config);
+	return 0;
+}
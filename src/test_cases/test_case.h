@@ -1,9 +1,26 @@
 #include "../survive_str.h"
 #include "math.h"
+#include <stdlib.h>
 #include "survive.h"
 
 static inline int survive_test_assert() { return -1; }
 
+// Scratch files go in the temp directory, so test runs don't leave them behind in the build tree
+static inline void survive_test_temp_path(char *path, size_t size, const char *name) {
+	const char *dir = getenv("TMPDIR");
+	if (dir == 0) {
+		dir = getenv("TEMP");
+	}
+	if (dir == 0) {
+#ifdef _WIN32
+		dir = ".";
+#else
+		dir = "/tmp";
+#endif
+	}
+	snprintf(path, size, "%s/%s", dir, name);
+}
+
 #define ASSERT_SUCCESS(x)                                                                                              \
 	{                                                                                                                  \
 		int error = (x);                                                                                               \
@@ -27,19 +44,19 @@ static inline int survive_test_assert() { return -1; }
 
 #define ASSERT_EQ(val1, val2)                                                                                          \
 	if ((val1) != (val2)) {                                                                                            \
-		fprintf(stderr, "Assert failed: " #val1 " == " #val2 ": %ld != %ld\n", (long)val1, (long)val2);                \
+		fprintf(stderr, "Assert failed: " #val1 " == " #val2 ": %ld != %ld\n", (long)(val1), (long)(val2));            \
 		return survive_test_assert();                                                                                  \
 	}
 
 #define ASSERT_GE(val1, val2)                                                                                          \
 	if ((val1) < (val2)) {                                                                                             \
-		fprintf(stderr, "Assert failed: " #val1 " < " #val2 ": %f < %f\n", val1, val2);                                \
+		fprintf(stderr, "Assert failed: " #val1 " < " #val2 ": %f < %f\n", (double)(val1), (double)(val2));            \
 		return survive_test_assert();                                                                                  \
 	}
 
 #define ASSERT_GT(val1, val2)                                                                                          \
 	if ((val1) <= (val2)) {                                                                                            \
-		fprintf(stderr, "Assert failed: " #val1 " <= " #val2 ": %f <= %f\n", val1, val2);                              \
+		fprintf(stderr, "Assert failed: " #val1 " <= " #val2 ": %f <= %f\n", (double)(val1), (double)(val2));          \
 		return survive_test_assert();                                                                                  \
 	}
 
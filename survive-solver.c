@@ -104,5 +104,6 @@ int main(int argc, char **argv) {
 		printf("LH %2d: " SurvivePose_format "\n", i, SURVIVE_POSE_EXPAND(camera[i]));
 	}
 
+	survive_optimizer_free_loaded(mpctx);
 	return 0;
 }
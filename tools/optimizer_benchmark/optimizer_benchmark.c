@@ -0,0 +1,339 @@
+// Runs a corpus of serialized optimizer problems -- see survive_optimizer_serialize and the 'serialize-lh-mpfit' and
+// 'serialize-gss-mpfit' options -- through each solver configuration and reports iterations, function evaluations,
+// wall time and final error. With --baseline, results are compared against an earlier --csv and regressions fail the
+// run. The small synthetic problems in corpus/ are run once as a smoke test.
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <libsurvive/survive.h>
+#include <libsurvive/survive_optimizer.h>
+#include <mpfit/mpfit.h>
+#include <os_generic.h>
+
+#include "../../src/survive_thread_pool.h"
+
+typedef struct benchmark_config {
+	const char *name;
+	bool sparse;
+	// Finite differences for every parameter that has an analytic jacobian
+	bool numeric_jacobians;
+	bool quat_model;
+	bool threaded;
+} benchmark_config;
+
+static const benchmark_config configs[] = {
+	{.name = "mpfit"},
+	{.name = "mpfit-numeric", .numeric_jacobians = true},
+	{.name = "mpfit-quat", .quat_model = true},
+	{.name = "mpfit-threaded", .threaded = true},
+	{.name = "sparse", .sparse = true},
+	{.name = "sparse-threaded", .sparse = true, .threaded = true},
+};
+#define CONFIG_CNT (sizeof(configs) / sizeof(configs[0]))
+
+typedef struct benchmark_result {
+	char problem[256];
+	char config[32];
+	int runs;
+	double median_ms;
+	double mean_iterations;
+	double mean_fevals;
+	double final_error;
+	int failures;
+} benchmark_result;
+
+typedef struct benchmark_options {
+	int runs;
+	int threads;
+	const char *csv;
+	const char *baseline;
+	double tolerance;
+	const char *only_config;
+} benchmark_options;
+
+static int compare_str(const void *a, const void *b) { return strcmp(*(char *const *)a, *(char *const *)b); }
+static int compare_double(const void *a, const void *b) {
+	double d = *(const double *)a - *(const double *)b;
+	return (d > 0) - (d < 0);
+}
+
+static bool has_suffix(const char *s, const char *suffix) {
+	size_t n = strlen(s), m = strlen(suffix);
+	return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+// Every .opt file under each argument, sorted; arguments that are files are taken as is
+static char **collect_problems(int argc, char **argv, size_t *cnt) {
+	char **rtn = 0;
+	*cnt = 0;
+	for (int i = 0; i < argc; i++) {
+		struct stat st;
+		if (stat(argv[i], &st) != 0) {
+			fprintf(stderr, "Can't open %s\n", argv[i]);
+			continue;
+		}
+
+		if (!S_ISDIR(st.st_mode)) {
+			rtn = realloc(rtn, sizeof(char *) * (*cnt + 1));
+			rtn[(*cnt)++] = strdup(argv[i]);
+			continue;
+		}
+
+		DIR *dir = opendir(argv[i]);
+		struct dirent *entry;
+		while (dir && (entry = readdir(dir))) {
+			if (!has_suffix(entry->d_name, ".opt"))
+				continue;
+			size_t len = strlen(argv[i]) + strlen(entry->d_name) + 2;
+			char *path = malloc(len);
+			snprintf(path, len, "%s/%s", argv[i], entry->d_name);
+			rtn = realloc(rtn, sizeof(char *) * (*cnt + 1));
+			rtn[(*cnt)++] = path;
+		}
+		if (dir)
+			closedir(dir);
+	}
+	if (*cnt)
+		qsort(rtn, *cnt, sizeof(char *), compare_str);
+	return rtn;
+}
+
+static const char *base_name(const char *path) {
+	const char *slash = strrchr(path, '/');
+	return slash ? slash + 1 : path;
+}
+
+// A fresh copy of the problem for each run, since a run leaves its answer and filtering in the buffers
+static bool run_once(const char *fn, const benchmark_config *config, struct survive_thread_pool *pool,
+					 double *ms, mp_result *result) {
+	survive_optimizer *opt = survive_optimizer_load(fn);
+	if (opt == 0)
+		return false;
+
+	survive_optimizer_settings settings = *opt->settings;
+	settings.sparse_solver = config->sparse;
+	settings.use_quat_model = config->quat_model;
+	opt->settings = &settings;
+	opt->thread_pool = config->threaded ? pool : 0;
+	for (int i = 0; config->numeric_jacobians && i < survive_optimizer_get_parameters_count(opt); i++) {
+		if (opt->mp_parameters_info[i].side == 3)
+			opt->mp_parameters_info[i].side = 0;
+	}
+
+	*result = (mp_result){0};
+	double start = OGGetAbsoluteTime();
+	int status = survive_optimizer_run(opt, result, 0);
+	*ms = (OGGetAbsoluteTime() - start) * 1000.;
+
+	survive_optimizer_free_loaded(opt);
+	return status > 0;
+}
+
+static void run_problem(const char *fn, const benchmark_config *config, const benchmark_options *options,
+						struct survive_thread_pool *pool, benchmark_result *out) {
+	double *times = calloc(options->runs, sizeof(double));
+	*out = (benchmark_result){.runs = options->runs};
+	snprintf(out->problem, sizeof(out->problem), "%s", base_name(fn));
+	snprintf(out->config, sizeof(out->config), "%s", config->name);
+
+	for (int i = 0; i < options->runs; i++) {
+		mp_result result = {0};
+		if (!run_once(fn, config, pool, &times[i], &result)) {
+			out->failures++;
+		}
+		out->mean_iterations += result.niter / (double)options->runs;
+		out->mean_fevals += result.nfev / (double)options->runs;
+		out->final_error = result.bestnorm;
+	}
+
+	qsort(times, options->runs, sizeof(double), compare_double);
+	out->median_ms = times[options->runs / 2];
+	free(times);
+}
+
+static void write_csv(const char *fn, const benchmark_result *results, size_t cnt) {
+	FILE *f = fopen(fn, "w");
+	if (f == 0) {
+		fprintf(stderr, "Can't write %s\n", fn);
+		return;
+	}
+	fprintf(f, "problem,config,runs,median_ms,mean_iterations,mean_fevals,final_error,failures\n");
+	for (size_t i = 0; i < cnt; i++) {
+		const benchmark_result *r = &results[i];
+		fprintf(f, "%s,%s,%d,%.6f,%.3f,%.3f,%.17g,%d\n", r->problem, r->config, r->runs, r->median_ms,
+				r->mean_iterations, r->mean_fevals, r->final_error, r->failures);
+	}
+	fclose(f);
+}
+
+static benchmark_result *read_csv(const char *fn, size_t *cnt) {
+	*cnt = 0;
+	FILE *f = fopen(fn, "r");
+	if (f == 0) {
+		fprintf(stderr, "Can't read baseline %s\n", fn);
+		return 0;
+	}
+
+	benchmark_result *rtn = 0;
+	char line[1024];
+	if (!fgets(line, sizeof(line), f)) {
+		fclose(f);
+		return 0;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		benchmark_result r = {0};
+		if (sscanf(line, "%255[^,],%31[^,],%d,%lf,%lf,%lf,%lf,%d", r.problem, r.config, &r.runs, &r.median_ms,
+				   &r.mean_iterations, &r.mean_fevals, &r.final_error, &r.failures) == 8) {
+			rtn = realloc(rtn, sizeof(benchmark_result) * (*cnt + 1));
+			rtn[(*cnt)++] = r;
+		}
+	}
+	fclose(f);
+	return rtn;
+}
+
+static bool worse(double value, double baseline, double tolerance) { return value > baseline * (1 + tolerance) + 1e-9; }
+
+// Prints each result that got slower, took more work or ended with more error than its baseline
+static int compare_baseline(const benchmark_result *results, size_t cnt, const benchmark_result *baseline,
+							size_t baseline_cnt, double tolerance) {
+	int regressions = 0;
+	for (size_t i = 0; i < cnt; i++) {
+		const benchmark_result *r = &results[i];
+		for (size_t j = 0; j < baseline_cnt; j++) {
+			const benchmark_result *b = &baseline[j];
+			if (strcmp(r->problem, b->problem) != 0 || strcmp(r->config, b->config) != 0)
+				continue;
+
+			bool regressed = false;
+			if (worse(r->median_ms, b->median_ms, tolerance)) {
+				printf("REGRESSION %s %s: %.3fms vs %.3fms\n", r->problem, r->config, r->median_ms, b->median_ms);
+				regressed = true;
+			}
+			if (worse(r->mean_fevals, b->mean_fevals, tolerance)) {
+				printf("REGRESSION %s %s: %.1f evaluations vs %.1f\n", r->problem, r->config, r->mean_fevals,
+					   b->mean_fevals);
+				regressed = true;
+			}
+			if (worse(r->final_error, b->final_error, tolerance)) {
+				printf("REGRESSION %s %s: error %g vs %g\n", r->problem, r->config, r->final_error, b->final_error);
+				regressed = true;
+			}
+			if (r->failures > b->failures) {
+				printf("REGRESSION %s %s: %d failed runs vs %d\n", r->problem, r->config, r->failures, b->failures);
+				regressed = true;
+			}
+			regressions += regressed;
+		}
+	}
+	return regressions;
+}
+
+static void usage(const char *name) {
+	fprintf(stderr,
+			"Usage: %s [options] <problem.opt | directory>...\n"
+			"\t--runs <n>          Runs of each problem per config (default 10)\n"
+			"\t--threads <n>       Threads for the threaded configs (default 4)\n"
+			"\t--config <name>     Only run this config\n"
+			"\t--csv <file>        Write the results as CSV\n"
+			"\t--baseline <file>   Compare against a CSV from an earlier run; regressions fail\n"
+			"\t--tolerance <frac>  Allowed slowdown / extra work / extra error against the baseline (default .2)\n",
+			name);
+}
+
+int main(int argc, char **argv) {
+	benchmark_options options = {.runs = 10, .threads = 4, .tolerance = .2};
+	char **paths = calloc(argc, sizeof(char *));
+	int path_cnt = 0;
+	for (int i = 1; i < argc; i++) {
+		bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "--runs") == 0 && has_value) {
+			options.runs = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--threads") == 0 && has_value) {
+			options.threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--config") == 0 && has_value) {
+			options.only_config = argv[++i];
+		} else if (strcmp(argv[i], "--csv") == 0 && has_value) {
+			options.csv = argv[++i];
+		} else if (strcmp(argv[i], "--baseline") == 0 && has_value) {
+			options.baseline = argv[++i];
+		} else if (strcmp(argv[i], "--tolerance") == 0 && has_value) {
+			options.tolerance = atof(argv[++i]);
+		} else if (argv[i][0] == '-') {
+			usage(argv[0]);
+			return -1;
+		} else {
+			paths[path_cnt++] = argv[i];
+		}
+	}
+
+	size_t problem_cnt = 0;
+	char **problems = collect_problems(path_cnt, paths, &problem_cnt);
+	if (problem_cnt == 0 || options.runs <= 0) {
+		usage(argv[0]);
+		return -1;
+	}
+
+	struct survive_thread_pool *pool = survive_thread_pool_create(options.threads);
+	benchmark_result *results = calloc(problem_cnt * CONFIG_CNT, sizeof(benchmark_result));
+	size_t result_cnt = 0;
+	int failures = 0;
+
+	printf("%-40s %-16s %10s %8s %8s %14s %6s\n", "problem", "config", "median ms", "iters", "fevals", "error",
+		   "failed");
+	for (size_t i = 0; i < problem_cnt; i++) {
+		for (size_t c = 0; c < CONFIG_CNT; c++) {
+			if (options.only_config && strcmp(options.only_config, configs[c].name) != 0)
+				continue;
+
+			benchmark_result *r = &results[result_cnt++];
+			run_problem(problems[i], &configs[c], &options, pool, r);
+			failures += r->failures;
+			printf("%-40s %-16s %10.3f %8.1f %8.1f %14.6g %6d\n", r->problem, r->config, r->median_ms,
+				   r->mean_iterations, r->mean_fevals, r->final_error, r->failures);
+		}
+	}
+
+	printf("\n%-16s %12s %12s\n", "config", "total ms", "fevals");
+	for (size_t c = 0; c < CONFIG_CNT; c++) {
+		double ms = 0, fevals = 0;
+		bool ran = false;
+		for (size_t i = 0; i < result_cnt; i++) {
+			if (strcmp(results[i].config, configs[c].name) == 0) {
+				ms += results[i].median_ms;
+				fevals += results[i].mean_fevals;
+				ran = true;
+			}
+		}
+		if (ran)
+			printf("%-16s %12.3f %12.1f\n", configs[c].name, ms, fevals);
+	}
+
+	if (options.csv) {
+		write_csv(options.csv, results, result_cnt);
+	}
+
+	int regressions = 0;
+	if (options.baseline) {
+		size_t baseline_cnt = 0;
+		benchmark_result *baseline = read_csv(options.baseline, &baseline_cnt);
+		regressions = compare_baseline(results, result_cnt, baseline, baseline_cnt, options.tolerance);
+		printf("\n%d regressions against %s\n", regressions, options.baseline);
+		free(baseline);
+	}
+
+	survive_thread_pool_free(pool);
+	for (size_t i = 0; i < problem_cnt; i++) {
+		free(problems[i]);
+	}
+	free(problems);
+	free(paths);
+	free(results);
+
+	return failures || regressions ? 1 : 0;
+}